@@ -35,7 +35,12 @@
 #include <osgEarthUtil/LatLongFormatter>
 #include <osgEarthUtil/ExampleResources>
 #include <osgEarthAnnotation/ModelNode>
+#include <osgEarth/ElevationPool>
+#include <osgDB/FileNameUtils>
+#include <osgDB/ReadFile>
+#include <osg/Timer>
 #include <iomanip>
+#include <fstream>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -190,10 +195,137 @@ struct ClickToRemoveElevation : public ControlEventHandler
 };
 
 
+
+// Reads points from a CSV ("x,y" per line; other lines are skipped) or binary (.bin, pairs of doubles) file.
+static bool readPoints(const std::string& filename, std::vector<osg::Vec3d>& points)
+{
+    bool binary = osgDB::getLowerCaseFileExtension(filename) == "bin";
+    std::ifstream in(filename.c_str(), binary ? std::ios::in|std::ios::binary : std::ios::in);
+    if ( !in.is_open() )
+        return false;
+
+    if ( binary )
+    {
+        double xy[2];
+        while( in.read(reinterpret_cast<char*>(xy), sizeof(xy)) )
+            points.push_back( osg::Vec3d(xy[0], xy[1], 0.0) );
+    }
+    else
+    {
+        ElevationPool::readPoints(in, points);
+    }
+    return true;
+}
+
+// Writes results as CSV ("x,y,z" per line) or binary (.bin, one float per point).
+static bool writeElevations(const std::string& filename, const std::vector<osg::Vec3d>& points, const std::vector<float>& elevations)
+{
+    bool binary = osgDB::getLowerCaseFileExtension(filename) == "bin";
+    std::ofstream out(filename.c_str(), binary ? std::ios::out|std::ios::binary : std::ios::out);
+    if ( !out.is_open() )
+        return false;
+
+    if ( binary )
+    {
+        if ( !elevations.empty() )
+            out.write(reinterpret_cast<const char*>(&elevations[0]), elevations.size()*sizeof(float));
+    }
+    else
+    {
+        out << std::setprecision(12);
+        for(unsigned i=0; i<points.size(); ++i)
+            out << points[i].x() << "," << points[i].y() << "," << elevations[i] << "\n";
+    }
+    return true;
+}
+
+// Non-interactive mode: samples every point in an input file and writes the results.
+// Without --lod or --resolution, samples at the deepest level the elevation data has.
+static int batch(osg::ArgumentParser& arguments)
+{
+    std::string inFile, outFile;
+    arguments.read("--batch", inFile);
+    if ( !arguments.read("--out", outFile) )
+    {
+        OE_WARN << "Batch mode requires --out <file>" << std::endl;
+        return -1;
+    }
+
+    std::string srsString = "wgs84";
+    arguments.read("--srs", srsString);
+
+    double resolution = 0.0;
+    arguments.read("--resolution", resolution);
+
+    unsigned lod = 0u;
+    bool lodSet = arguments.read("--lod", lod);
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles(arguments);
+    MapNode* mapNode = MapNode::findMapNode(node.get());
+    if ( !mapNode )
+    {
+        OE_WARN << "Unable to load earth file." << std::endl;
+        return -1;
+    }
+
+    const SpatialReference* srs = SpatialReference::get(srsString);
+    if ( !srs )
+    {
+        OE_WARN << "Unrecognized SRS: " << srsString << std::endl;
+        return -1;
+    }
+
+    ElevationPool* pool = mapNode->getMap()->getElevationPool();
+
+    if ( !lodSet )
+    {
+        // By default, sample as deep as the data goes; anything deeper only
+        // interpolates the same posts at the cost of many more tiles.
+        lod = pool->getMaxDataLevel(15u);
+
+        if ( resolution > 0.0 )
+        {
+            int level = mapNode->getMap()->getProfile()->getLevelOfDetailForHorizResolution(resolution, 257);
+            if ( level > 0 )
+                lod = osg::minimum(lod, (unsigned)level);
+        }
+    }
+
+    std::vector<osg::Vec3d> points;
+    if ( !readPoints(inFile, points) )
+    {
+        OE_WARN << "Unable to read " << inFile << std::endl;
+        return -1;
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    std::vector<float> elevations;
+    unsigned count = pool->getElevations(points, srs, lod, elevations);
+
+    double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    if ( !writeElevations(outFile, points, elevations) )
+    {
+        OE_WARN << "Unable to write " << outFile << std::endl;
+        return -1;
+    }
+
+    std::cout
+        << "Sampled " << count << " of " << points.size() << " points at LOD " << lod
+        << " in " << std::setprecision(3) << seconds << "s ("
+        << (seconds > 0.0 ? (unsigned)(points.size()/seconds) : 0u) << " points/s)" << std::endl;
+
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     osg::ArgumentParser arguments(&argc,argv);
 
+    if ( arguments.find("--batch") >= 0 )
+        return batch(arguments);
+
     osgViewer::Viewer viewer(arguments);
 
     s_mapNode = 0L;
@@ -0,0 +1,181 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_extentbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/DataExtentIndex>
+#include <osgEarth/Registry>
+#include <osgEarth/TileKey>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+using namespace osgEarth;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Benchmarks data extent lookups by comparing a linear scan of the\n"
+        << "extent list with the DataExtentIndex, on a synthetic tile index.\n\n"
+        << argv[0]
+        << "\n    --extents [int]       : number of data extents (default = 50000)"
+        << "\n    --queries [int]       : number of tile keys to look up (default = 100000)"
+        << "\n    --seed [int]          : random seed (default = 0)"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    double random01()
+    {
+        return (double)::rand() / (double)RAND_MAX;
+    }
+
+    // Scattered "source files" of varying size and resolution, like a
+    // multi-file GDAL source: larger files tend to be lower resolution.
+    void makeExtents(int count, const SpatialReference* srs, DataExtentList& extents)
+    {
+        for(int i=0; i<count; ++i)
+        {
+            double size = 0.02 + 0.5*random01()*random01();
+            double x = -180.0 + (360.0-size)*random01();
+            double y = -90.0 + (180.0-size)*random01();
+            unsigned maxLevel = 8u + (unsigned)(10.0*(1.0 - size/0.52));
+            unsigned minLevel = (unsigned)(4.0*random01());
+            extents.push_back( DataExtent(GeoExtent(srs, x, y, x+size, y+size), minLevel, maxLevel) );
+        }
+    }
+
+    // Keys that look like a terrain engine's requests: mostly deep, over
+    // random places on the globe.
+    void makeKeys(int count, const Profile* profile, std::vector<TileKey>& keys)
+    {
+        for(int i=0; i<count; ++i)
+        {
+            unsigned lod = 2u + (unsigned)(16.0*random01());
+            unsigned tx, ty;
+            profile->getNumTiles( lod, tx, ty );
+            keys.push_back( TileKey(lod, (unsigned)(random01()*(tx-1)), (unsigned)(random01()*(ty-1)), profile) );
+        }
+    }
+
+    // the lookup that TerrainLayer::getBestAvailableTileKey used to do.
+    bool linearMaxLevel(const DataExtentList& de, const TileKey& key, unsigned& out)
+    {
+        bool found = false;
+        out = 0u;
+        for(DataExtentList::const_iterator i = de.begin(); i != de.end(); ++i)
+        {
+            if ( key.getExtent().intersects(*i) )
+            {
+                if ( !i->minLevel().isSet() || key.getLOD() >= i->minLevel().get() )
+                {
+                    found = true;
+                    if ( !i->maxLevel().isSet() || key.getLOD() <= i->maxLevel().get() )
+                    {
+                        out = UINT_MAX;
+                        return true;
+                    }
+                    out = std::max( out, i->maxLevel().get() );
+                }
+            }
+        }
+        return found;
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") || args.read("-h") )
+        return usage(argv);
+
+    int numExtents = 50000, numQueries = 100000, seed = 0;
+    args.read( "--extents", numExtents );
+    args.read( "--queries", numQueries );
+    args.read( "--seed", seed );
+
+    if ( numExtents <= 0 || numQueries <= 0 )
+        return usage(argv);
+
+    osg::ref_ptr<const Profile> profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    ::srand( seed );
+    DataExtentList extents;
+    makeExtents( numExtents, profile->getSRS(), extents );
+
+    std::vector<TileKey> keys;
+    makeKeys( numQueries, profile.get(), keys );
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex( extents );
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    std::vector<bool> indexGood( keys.size() );
+    std::vector<unsigned> indexLevels( keys.size(), 0u );
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        unsigned level = 0u;
+        indexGood[i] = index->getMaxLevel( keys[i].getExtent(), keys[i].getLOD(), level );
+        indexLevels[i] = level >= keys[i].getLOD() ? UINT_MAX : level;
+    }
+
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+    unsigned mismatches = 0u, hits = 0u;
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        unsigned level;
+        bool good = linearMaxLevel( extents, keys[i], level );
+        if ( good != indexGood[i] || (good && level != indexLevels[i]) )
+            ++mismatches;
+        if ( good )
+            ++hits;
+    }
+
+    osg::Timer_t t3 = osg::Timer::instance()->tick();
+
+    double buildMs  = osg::Timer::instance()->delta_m(t0, t1);
+    double indexUs  = osg::Timer::instance()->delta_u(t1, t2) / (double)keys.size();
+    double linearUs = osg::Timer::instance()->delta_u(t2, t3) / (double)keys.size();
+
+    std::cout
+        << std::fixed << std::setprecision(3)
+        << "Extents: " << numExtents << ", queries: " << numQueries
+        << " (" << 100.0*(double)hits/(double)keys.size() << "% with data)\n"
+        << "  Index build           : " << buildMs << " ms\n"
+        << "  Linear scan           : " << linearUs << " us/query\n"
+        << "  DataExtentIndex       : " << indexUs << " us/query\n"
+        << "  Speedup               : " << (indexUs > 0.0 ? linearUs/indexUs : 0.0) << "x\n"
+        << "  Mismatched results    : " << mismatches
+        << std::endl;
+
+    return mismatches == 0u ? 0 : 1;
+}
@@ -31,9 +31,11 @@
 #include <osgEarth/TileVisitor>
 #include <osgEarth/ImageLayer>
 #include <osgEarth/ElevationLayer>
+#include <osgEarth/TileSource>
 #include <osgEarthUtil/TMSPackager>
 #include <osgEarthDrivers/feature_ogr/OGRFeatureOptions>
 #include <osgEarthDrivers/tms/TMSOptions>
+#include <osgEarthDrivers/mbtiles/MBTilesOptions>
 
 #include <iostream>
 #include <sstream>
@@ -75,6 +77,11 @@ usage( const std::string& msg = "" )
         << "            [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "            [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
         << "            [--alpha-mask]                  ; Mask out imagery that isn't in the provided extents." << std::endl
+        << "            [--mbtiles]                     ; Write each layer to an MBTiles file in the output folder instead of a TMS folder." << std::endl
+        << "            [--deduplicate]                 ; With --mbtiles, store identical tiles only once." << std::endl
+        << "            [--encode-threads <num>]        ; Number of threads encoding tiles (default = number of processors)." << std::endl
+        << "            [--write-threads <num>]         ; Number of threads writing tiles to disk (default = 2)." << std::endl
+        << "            [--queue-size <num>]            ; Max number of tiles waiting to be encoded, and to be written (default = 64)." << std::endl
         << std::endl
         << "            [--verbose]                     ; Displays progress of the operation" << std::endl;
 
@@ -108,6 +115,81 @@ findArgumentWithExtension( osg::ArgumentParser& args, const std::string& ext )
 }
 
 
+/** Driver options that read back what the packager just wrote. */
+TileSourceOptions
+getOutputOptions( TMSPackager& packager, bool mbtiles, const std::string& outEarthFile )
+{
+    if ( mbtiles )
+    {
+        // the database sits next to the earth file.
+        MBTilesTileSourceOptions options;
+        options.filename() = URI(
+            osgDB::getSimpleFileName( MBTilesTileSourceOptions(packager.getTileSource()->getOptions()).filename()->full() ),
+            outEarthFile );
+        return options;
+    }
+
+    // new TMS driver info:
+    TMSOptions tms;
+    tms.url() = URI(
+        osgDB::concatPaths( toLegalFileName( packager.getLayerName() ), "tms.xml" ),
+        outEarthFile );
+    return tms;
+}
+
+
+/**
+ * Points the packager at a new MBTiles database for a layer, named after
+ * the layer and placed in the output folder.
+ */
+bool
+setMBTilesOutput( TMSPackager& packager, TerrainLayer* layer, Map* map, const std::string& extension, const std::string& rootFolder, bool deduplicate )
+{
+    // Tile format; see TMSPackager::run.
+    std::string format = extension;
+    if ( dynamic_cast<ElevationLayer*>(layer) )
+    {
+        format = "tif";
+    }
+    else
+    {
+        if ( format.empty() && layer->getTileSource() )
+            format = layer->getTileSource()->getExtension();
+        if ( format == "jpg" && packager.getApplyAlphaMask() )
+            format = "png";
+    }
+    packager.setExtension( format );
+
+    std::string name = layer->getName();
+    if ( name.empty() )
+        name = Stringify() << "layer" << layer->getUID();
+
+    MBTilesTileSourceOptions mbtiles;
+    mbtiles.filename() = URI( osgDB::concatPaths( rootFolder, toLegalFileName(name) + ".mbtiles" ) );
+    mbtiles.format() = format;
+    mbtiles.batchSize() = 1000u;
+    mbtiles.deduplicate() = deduplicate;
+    mbtiles.profile() = map->getProfile()->toProfileOptions();
+
+    osg::ref_ptr<TileSource> output = TileSourceFactory::create( mbtiles );
+    if ( !output.valid() )
+    {
+        OE_WARN << LC << "Failed to load the MBTiles driver" << std::endl;
+        return false;
+    }
+
+    Status status = output->open( TileSource::MODE_WRITE | TileSource::MODE_CREATE );
+    if ( status.isError() )
+    {
+        OE_WARN << LC << "Failed to create " << mbtiles.filename()->full() << ": " << status.message() << std::endl;
+        return false;
+    }
+
+    packager.setTileSource( output.get() );
+    return true;
+}
+
+
 /** Packages an image layer as a TMS folder. */
 int
 makeTMS( osg::ArgumentParser& args )
@@ -150,6 +232,15 @@ makeTMS( osg::ArgumentParser& args )
 
     bool applyAlphaMask = args.read("--alpha-mask");
 
+    bool mbtiles = args.read("--mbtiles");
+    bool deduplicate = args.read("--deduplicate");
+
+    // pipeline stage sizes
+    unsigned encodeThreads = 0, writeThreads = 0, queueSize = 0;
+    args.read("--encode-threads", encodeThreads);
+    args.read("--write-threads", writeThreads);
+    args.read("--queue-size", queueSize);
+
     bool writeXML = true;
 
     // load up the map
@@ -333,6 +424,16 @@ makeTMS( osg::ArgumentParser& args )
     packager.setOverwrite(overwrite);
     packager.setKeepEmpties(keepEmpties);
     packager.setApplyAlphaMask(applyAlphaMask);
+    if (encodeThreads > 0)
+        packager.setNumEncodeThreads(encodeThreads);
+    if (writeThreads > 0)
+        packager.setNumWriteThreads(writeThreads);
+    if (queueSize > 0)
+        packager.setQueueSize(queueSize);
+
+    // the TMS XML only describes a TMS folder.
+    if (mbtiles)
+        writeXML = false;
 
 
     // new map for an output earth file if necessary.
@@ -352,6 +453,8 @@ makeTMS( osg::ArgumentParser& args )
         ImageLayer* layer = map->getLayerAt<ImageLayer>(imageLayerIndex);
         if (layer)
         {
+            if (mbtiles && !setMBTilesOutput(packager, layer, map, extension, rootFolder, deduplicate))
+                return 1;
             packager.run(layer, map);
             if (writeXML)
             {
@@ -370,6 +473,8 @@ makeTMS( osg::ArgumentParser& args )
         ElevationLayer* layer = map->getLayerAt<ElevationLayer>(elevationLayerIndex);
         if (layer)
         {
+            if (mbtiles && !setMBTilesOutput(packager, layer, map, extension, rootFolder, deduplicate))
+                return 1;
             packager.run(layer, map);
             if (writeXML)
             {
@@ -392,6 +497,8 @@ makeTMS( osg::ArgumentParser& args )
         {            
             ImageLayer* layer = imageLayers[i].get();
             OE_NOTICE << "Packaging " << layer->getName() << std::endl;
+            if (mbtiles && !setMBTilesOutput(packager, layer, map, extension, rootFolder, deduplicate))
+                continue;
             osg::Timer_t start = osg::Timer::instance()->tick();
             packager.run(layer, map);
             osg::Timer_t end = osg::Timer::instance()->tick();
@@ -408,15 +515,7 @@ makeTMS( osg::ArgumentParser& args )
             // save to the output map if requested:
             if( outMap.valid() )
             {
-                std::string layerFolder = toLegalFileName( packager.getLayerName() );
-
-                // new TMS driver info:
-                TMSOptions tms;
-                tms.url() = URI(
-                    osgDB::concatPaths( layerFolder, "tms.xml" ),
-                    outEarthFile );
-
-                ImageLayerOptions layerOptions( packager.getLayerName(), tms );
+                ImageLayerOptions layerOptions( packager.getLayerName(), getOutputOptions(packager, mbtiles, outEarthFile) );
 
                 outMap->addLayer( new ImageLayer( layerOptions ) );
             }
@@ -430,6 +529,8 @@ makeTMS( osg::ArgumentParser& args )
         {            
             ElevationLayer* layer = elevationLayers[i].get();
             OE_NOTICE << "Packaging " << layer->getName() << std::endl;
+            if (mbtiles && !setMBTilesOutput(packager, layer, map, extension, rootFolder, deduplicate))
+                continue;
             osg::Timer_t start = osg::Timer::instance()->tick();
             packager.run(layer, map);
             osg::Timer_t end = osg::Timer::instance()->tick();
@@ -445,15 +546,7 @@ makeTMS( osg::ArgumentParser& args )
             // save to the output map if requested:
             if( outMap.valid() )
             {
-                std::string layerFolder = toLegalFileName( packager.getLayerName() );
-
-                // new TMS driver info:
-                TMSOptions tms;
-                tms.url() = URI(
-                    osgDB::concatPaths( layerFolder, "tms.xml" ),
-                    outEarthFile );
-
-                ElevationLayerOptions layerOptions( packager.getLayerName(), tms );
+                ElevationLayerOptions layerOptions( packager.getLayerName(), getOutputOptions(packager, mbtiles, outEarthFile) );
 
                 outMap->addLayer( new ElevationLayer( layerOptions ) );
             }
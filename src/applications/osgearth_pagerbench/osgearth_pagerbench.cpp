@@ -0,0 +1,243 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_pagerbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/Registry>
+#include <osgEarthUtil/ExampleResources>
+#include <osgViewer/Viewer>
+#include <osgDB/DatabasePager>
+#include <osg/AnimationPath>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <set>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Benchmarks terrain paging by replaying a recorded camera path and measuring\n"
+        << "how long it takes the terrain to reach full resolution after the camera stops.\n"
+        << "Record a path in osgearth_viewer with the 'z' key (saves saved_animation.path).\n\n"
+        << argv[0] << " file.earth --path [file.path]"
+        << "\n    --path [file]         : osg::AnimationPath to replay (required)"
+        << "\n    --stops [int]         : number of evenly spaced stops along the path (default = 1, the end)"
+        << "\n    --speed [float]       : playback speed multiplier (default = 1.0)"
+        << "\n    --timeout [float]     : seconds to wait for full resolution at each stop (default = 60)"
+        << "\n    --settle [int]        : consecutive idle frames that count as full resolution (default = 10)"
+        << "\n" << MapNodeHelper().usage()
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    // True when nothing is waiting in the database pager and no loader
+    // activity (tile loads, merges) is outstanding.
+    bool isIdle(osgViewer::Viewer& viewer)
+    {
+        osgDB::DatabasePager* pager = viewer.getDatabasePager();
+        if ( pager &&
+            (pager->getFileRequestListSize() > 0 ||
+             pager->getDataToCompileListSize() > 0 ||
+             pager->getDataToMergeListSize() > 0 ||
+             pager->getRequestsInProgress()) )
+        {
+            return false;
+        }
+
+        std::set<std::string> activities;
+        Registry::instance()->getActivities( activities );
+        return activities.empty();
+    }
+
+    void setCamera(osgViewer::Viewer& viewer, osg::AnimationPath* path, double t)
+    {
+        osg::AnimationPath::ControlPoint cp;
+        path->getInterpolatedControlPoint( t, cp );
+        osg::Matrixd inverse;
+        cp.getInverse( inverse );
+        viewer.getCamera()->setViewMatrix( inverse );
+    }
+
+    struct FrameStats
+    {
+        FrameStats() : _frames(0), _totalMs(0.0), _maxMs(0.0) { }
+
+        void add(double ms)
+        {
+            ++_frames;
+            _totalMs += ms;
+            _maxMs = std::max(_maxMs, ms);
+        }
+
+        double average() const { return _frames > 0 ? _totalMs/(double)_frames : 0.0; }
+
+        unsigned _frames;
+        double   _totalMs;
+        double   _maxMs;
+    };
+
+    // runs one frame and returns its duration in milliseconds.
+    double frame(osgViewer::Viewer& viewer)
+    {
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        viewer.frame();
+        return osg::Timer::instance()->delta_m( t0, osg::Timer::instance()->tick() );
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") || args.read("-h") )
+        return usage(argv);
+
+    std::string pathFile;
+    int stops = 1, settle = 10;
+    double speed = 1.0, timeout = 60.0;
+    args.read( "--path", pathFile );
+    args.read( "--stops", stops );
+    args.read( "--speed", speed );
+    args.read( "--timeout", timeout );
+    args.read( "--settle", settle );
+
+    if ( pathFile.empty() || stops <= 0 || speed <= 0.0 || settle <= 0 )
+        return usage(argv);
+
+    osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath();
+    std::ifstream in( pathFile.c_str() );
+    if ( !in.is_open() )
+    {
+        OE_WARN << LC << "Unable to open camera path " << pathFile << std::endl;
+        return -1;
+    }
+    path->read( in );
+    if ( path->empty() )
+    {
+        OE_WARN << LC << "Camera path " << pathFile << " has no control points" << std::endl;
+        return -1;
+    }
+
+    osgViewer::Viewer viewer(args);
+    viewer.getCamera()->setSmallFeatureCullingPixelSize(-1.0f);
+    viewer.getCamera()->setNearFarRatio(0.0001);
+
+    osg::ref_ptr<osg::Node> node = MapNodeHelper().load( args, &viewer );
+    if ( !node.valid() )
+        return usage(argv);
+
+    viewer.setSceneData( node.get() );
+    viewer.realize();
+
+    const double firstTime = path->getFirstTime();
+    const double duration  = path->getLastTime() - firstTime;
+
+    std::cout
+        << std::fixed << std::setprecision(3)
+        << "Path: " << pathFile << ", " << duration << " s, "
+        << stops << " stop(s), speed x" << speed << "\n";
+
+    FrameStats flying, holding;
+    double totalToFullRes = 0.0;
+    bool allReached = true;
+    double t = firstTime;
+
+    for(int s=1; s<=stops; ++s)
+    {
+        const double stopTime = firstTime + duration*(double)s/(double)stops;
+
+        // fly to the stop at the recorded pace.
+        osg::Timer_t last = osg::Timer::instance()->tick();
+        while ( t < stopTime && !viewer.done() )
+        {
+            setCamera( viewer, path.get(), t );
+            flying.add( frame(viewer) );
+
+            osg::Timer_t now = osg::Timer::instance()->tick();
+            t = std::min( stopTime, t + speed*osg::Timer::instance()->delta_s(last, now) );
+            last = now;
+        }
+
+        // hold still until the pager settles.
+        setCamera( viewer, path.get(), stopTime );
+        osg::Timer_t holdStart = osg::Timer::instance()->tick();
+        osg::Timer_t idleStart = holdStart;
+        int idleFrames = 0;
+        bool reached = false;
+
+        while ( !viewer.done() )
+        {
+            holding.add( frame(viewer) );
+            osg::Timer_t now = osg::Timer::instance()->tick();
+
+            if ( isIdle(viewer) )
+            {
+                if ( idleFrames++ == 0 )
+                    idleStart = now;
+                if ( idleFrames >= settle )
+                {
+                    reached = true;
+                    break;
+                }
+            }
+            else
+            {
+                idleFrames = 0;
+            }
+
+            if ( osg::Timer::instance()->delta_s(holdStart, now) > timeout )
+            {
+                idleStart = now;
+                break;
+            }
+        }
+
+        double toFullRes = osg::Timer::instance()->delta_s( holdStart, idleStart );
+        totalToFullRes += toFullRes;
+        allReached = allReached && reached;
+
+        std::cout
+            << "  Stop " << s << " (t=" << stopTime-firstTime << " s): "
+            << (reached ? "full resolution after " : "timed out after ") << toFullRes << " s\n";
+    }
+
+    std::cout
+        << "  Time to full resolution : " << totalToFullRes << " s total, "
+        << totalToFullRes/(double)stops << " s per stop" << (allReached ? "" : " (some stops timed out)") << "\n"
+        << "  Flying frames           : " << flying._frames << ", avg " << flying.average() << " ms, max " << flying._maxMs << " ms\n"
+        << "  Holding frames          : " << holding._frames << ", avg " << holding.average() << " ms, max " << holding._maxMs << " ms"
+        << std::endl;
+
+    return allReached ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_pixelbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/ImageUtils>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+using namespace osgEarth;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Benchmarks ImageUtils pixel access for the common image formats by\n"
+        << "comparing per-pixel PixelReader/PixelWriter calls with the row kernels,\n"
+        << "and times resizeImage and mix, which use the row kernels internally.\n\n"
+        << argv[0]
+        << "\n    --size [int]          : image size in pixels (default = 256)"
+        << "\n    --iterations [int]    : number of passes over each image (default = 100)"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    struct Format
+    {
+        const char* _name;
+        GLenum      _pixelFormat;
+        GLenum      _dataType;
+    };
+
+    const Format s_formats[] = {
+        { "RGBA8", GL_RGBA,      GL_UNSIGNED_BYTE },
+        { "RGB8",  GL_RGB,       GL_UNSIGNED_BYTE },
+        { "R32F",  GL_LUMINANCE, GL_FLOAT },
+        { "R16",   GL_LUMINANCE, GL_UNSIGNED_SHORT }
+    };
+
+    osg::Image* allocate(const Format& format, int size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage( size, size, 1, format._pixelFormat, format._dataType );
+
+        unsigned char* data = image->data();
+        for(unsigned i=0; i<image->getTotalSizeInBytes(); ++i)
+            data[i] = (unsigned char)(::rand() & 0xff);
+
+        // keep floats in a sane range.
+        if ( format._dataType == GL_FLOAT )
+        {
+            float* f = (float*)image->data();
+            for(int i=0; i<size*size; ++i)
+                f[i] = (float)::rand() / (float)RAND_MAX;
+        }
+        return image;
+    }
+
+    // copies every pixel with one reader and one writer call per pixel.
+    void copyPerPixel(const osg::Image* src, osg::Image* dst)
+    {
+        ImageUtils::PixelReader read( src );
+        ImageUtils::PixelWriter write( dst );
+        for(int t=0; t<src->t(); ++t)
+            for(int s=0; s<src->s(); ++s)
+                write( read(s, t), s, t );
+    }
+
+    // copies every pixel a row at a time.
+    void copyPerRow(const osg::Image* src, osg::Image* dst)
+    {
+        ImageUtils::PixelReader read( src );
+        ImageUtils::PixelWriter write( dst );
+        std::vector<osg::Vec4> row( src->s() );
+        for(int t=0; t<src->t(); ++t)
+        {
+            read.readRow( &row[0], 0, t, src->s() );
+            write.writeRow( &row[0], 0, t, src->s() );
+        }
+    }
+
+    double mpixPerSecond(int size, int iterations, osg::Timer_t t0, osg::Timer_t t1)
+    {
+        double s = osg::Timer::instance()->delta_s(t0, t1);
+        return s > 0.0 ? (double)size*(double)size*(double)iterations / s / 1.0e6 : 0.0;
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") || args.read("-h") )
+        return usage(argv);
+
+    int size = 256, iterations = 100;
+    args.read( "--size", size );
+    args.read( "--iterations", iterations );
+
+    if ( size <= 0 || iterations <= 0 )
+        return usage(argv);
+
+    std::cout
+        << std::fixed << std::setprecision(1)
+        << "Images: " << size << "x" << size << ", " << iterations << " iterations (Mpix/s)\n"
+        << std::setw(8) << "format"
+        << std::setw(12) << "per-pixel"
+        << std::setw(12) << "per-row"
+        << std::setw(12) << "speedup"
+        << std::setw(12) << "resize"
+        << std::setw(12) << "mix"
+        << std::setw(10) << "match"
+        << std::endl;
+
+    for(unsigned f=0; f<sizeof(s_formats)/sizeof(Format); ++f)
+    {
+        const Format& format = s_formats[f];
+
+        osg::ref_ptr<osg::Image> src      = allocate( format, size );
+        osg::ref_ptr<osg::Image> pixelDst = allocate( format, size );
+        osg::ref_ptr<osg::Image> rowDst   = allocate( format, size );
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(int i=0; i<iterations; ++i)
+            copyPerPixel( src.get(), pixelDst.get() );
+
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+        for(int i=0; i<iterations; ++i)
+            copyPerRow( src.get(), rowDst.get() );
+
+        osg::Timer_t t2 = osg::Timer::instance()->tick();
+        for(int i=0; i<iterations; ++i)
+        {
+            osg::ref_ptr<osg::Image> resized;
+            ImageUtils::resizeImage( src.get(), size/2+1, size/2+1, resized );
+        }
+
+        osg::Timer_t t3 = osg::Timer::instance()->tick();
+        for(int i=0; i<iterations; ++i)
+            ImageUtils::mix( rowDst.get(), src.get(), 0.5f );
+
+        osg::Timer_t t4 = osg::Timer::instance()->tick();
+
+        // both copies must produce the same bytes.
+        copyPerPixel( src.get(), pixelDst.get() );
+        copyPerRow( src.get(), rowDst.get() );
+        bool match = ::memcmp( pixelDst->data(), rowDst->data(), src->getTotalSizeInBytes() ) == 0;
+
+        double perPixel = mpixPerSecond( size, iterations, t0, t1 );
+        double perRow   = mpixPerSecond( size, iterations, t1, t2 );
+
+        std::cout
+            << std::setw(8) << format._name
+            << std::setw(12) << perPixel
+            << std::setw(12) << perRow
+            << std::setw(11) << (perPixel > 0.0 ? perRow/perPixel : 0.0) << "x"
+            << std::setw(12) << mpixPerSecond( size/2+1, iterations, t2, t3 )
+            << std::setw(12) << mpixPerSecond( size, iterations, t3, t4 )
+            << std::setw(10) << (match ? "yes" : "NO")
+            << std::endl;
+    }
+
+    return 0;
+}
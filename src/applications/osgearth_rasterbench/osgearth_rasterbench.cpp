@@ -0,0 +1,254 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_rasterbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarthSymbology/Geometry>
+#include <osgEarthSymbology/ScanlineRasterizer>
+#include <osgEarthSymbology/AGG.h>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osgDB/WriteFile>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Benchmarks feature rasterization by comparing the per-feature AGG\n"
+        << "rasterizer with the batched ScanlineRasterizer on synthetic data.\n\n"
+        << argv[0]
+        << "\n    --size [int]          : tile size in pixels (default = 256)"
+        << "\n    --features [int]      : number of features per tile (default = 1000)"
+        << "\n    --vertices [int]      : average number of vertices per feature (default = 32)"
+        << "\n    --tiles [int]         : number of tiles to render with each rasterizer (default = 100)"
+        << "\n    --seed [int]          : random seed (default = 0)"
+        << "\n    --write [prefix]      : write the last tile from each rasterizer to [prefix]_agg.png and [prefix]_scanline.png"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    struct Shape
+    {
+        osg::ref_ptr<Geometry> _geom;
+        osg::Vec4f             _color;
+    };
+
+    double random01()
+    {
+        return (double)::rand() / (double)RAND_MAX;
+    }
+
+    // a star-shaped ring around (cx,cy), which exercises concave edges and
+    // edges of every slope.
+    Ring* makeRing(Ring* ring, double cx, double cy, double radius, int numVerts)
+    {
+        for(int i=0; i<numVerts; ++i)
+        {
+            double a = 2.0*osg::PI*(double)i/(double)numVerts;
+            double r = radius * (0.5 + 0.5*random01());
+            ring->push_back( osg::Vec3d(cx + r*cos(a), cy + r*sin(a), 0.0) );
+        }
+        return ring;
+    }
+
+    // A mix of mostly small features with a few large ones, some of which
+    // extend past the edges of the tile, similar to land cover data. One
+    // in five has a hole.
+    void makeShapes(int count, int numVerts, int size, std::vector<Shape>& shapes)
+    {
+        for(int i=0; i<count; ++i)
+        {
+            double cx = (random01()*1.2 - 0.1) * size;
+            double cy = (random01()*1.2 - 0.1) * size;
+            double radius = (i % 50 == 0) ? size*(0.25 + 0.5*random01()) : size*0.05*random01() + 1.0;
+            int verts = std::max(3, (int)(numVerts * (0.5 + random01())));
+
+            Polygon* poly = new Polygon();
+            makeRing( poly, cx, cy, radius, verts );
+            if ( i % 5 == 0 )
+            {
+                poly->getHoles().push_back( makeRing(new Ring(), cx, cy, radius*0.3, std::max(3, verts/2)) );
+            }
+
+            Shape shape;
+            shape._geom = poly;
+            shape._color.set( random01(), random01(), random01(), 0.5 + 0.5*random01() );
+            shapes.push_back( shape );
+        }
+    }
+
+    // the way features were rasterized before: one AGG render per feature.
+    void renderAGG(const std::vector<Shape>& shapes, osg::Image* image)
+    {
+        agg::rendering_buffer rbuf( image->data(), image->s(), image->t(), image->s()*4 );
+        agg::renderer<agg::span_abgr32, agg::rgba8> ren( rbuf );
+        ren.clear( agg::rgba8(0,0,0,0) );
+
+        agg::rasterizer ras;
+        ras.gamma( 1.3 );
+        ras.filling_rule( agg::fill_even_odd );
+
+        for(std::vector<Shape>::const_iterator s = shapes.begin(); s != shapes.end(); ++s)
+        {
+            const osg::Vec4f& c = s->_color;
+            unsigned a = (unsigned)(127.0f+(c.a()*255.0f)/2.0f);
+            agg::rgba8 fgColor( (unsigned)(c.r()*255.0f), (unsigned)(c.g()*255.0f), (unsigned)(c.b()*255.0f), a );
+
+            ConstGeometryIterator gi( s->_geom.get() );
+            while( gi.hasMore() )
+            {
+                const Geometry* g = gi.next();
+                for( Geometry::const_iterator p = g->begin(); p != g->end(); ++p )
+                {
+                    if ( p == g->begin() )
+                        ras.move_to_d( p->x(), p->y() );
+                    else
+                        ras.line_to_d( p->x(), p->y() );
+                }
+            }
+            ras.render( ren, fgColor );
+            ras.reset();
+        }
+
+        // convert from ABGR to RGBA
+        unsigned char* pixel = image->data();
+        for(int i=0; i<image->s()*image->t()*4; i+=4, pixel+=4)
+        {
+            std::swap( pixel[0], pixel[3] );
+            std::swap( pixel[1], pixel[2] );
+        }
+    }
+
+    // the batched way: queue every feature and render them in one pass.
+    void renderScanline(const std::vector<Shape>& shapes, osg::Image* image, ScanlineRasterizer& ras)
+    {
+        ::memset( image->data(), 0, image->getTotalSizeInBytes() );
+
+        for(std::vector<Shape>::const_iterator s = shapes.begin(); s != shapes.end(); ++s)
+        {
+            osg::Vec4f c = s->_color;
+            c.a() = (127.0f+(c.a()*255.0f)/2.0f)/255.0f;
+            ras.addGeometry( s->_geom.get(), c );
+        }
+        ras.render( image );
+    }
+
+    osg::Image* allocate(int size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage( size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+        return image;
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") || args.read("-h") )
+        return usage(argv);
+
+    int size = 256, features = 1000, vertices = 32, tiles = 100, seed = 0;
+    std::string prefix;
+    args.read( "--size", size );
+    args.read( "--features", features );
+    args.read( "--vertices", vertices );
+    args.read( "--tiles", tiles );
+    args.read( "--seed", seed );
+    args.read( "--write", prefix );
+
+    if ( size <= 0 || features <= 0 || vertices < 3 || tiles <= 0 )
+        return usage(argv);
+
+    ::srand( seed );
+    std::vector<Shape> shapes;
+    makeShapes( features, vertices, size, shapes );
+
+    osg::ref_ptr<osg::Image> aggImage      = allocate( size );
+    osg::ref_ptr<osg::Image> scanlineImage = allocate( size );
+
+    ScanlineRasterizer ras;
+    ras.setGamma( 1.3 );
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for(int i=0; i<tiles; ++i)
+        renderAGG( shapes, aggImage.get() );
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    for(int i=0; i<tiles; ++i)
+        renderScanline( shapes, scanlineImage.get(), ras );
+
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+    double aggMs      = osg::Timer::instance()->delta_m(t0, t1) / (double)tiles;
+    double scanlineMs = osg::Timer::instance()->delta_m(t1, t2) / (double)tiles;
+
+    // compare the output of the two rasterizers.
+    double totalDiff = 0.0;
+    unsigned numDiffering = 0;
+    const unsigned char* a = aggImage->data();
+    const unsigned char* b = scanlineImage->data();
+    for(int i=0; i<size*size; ++i, a+=4, b+=4)
+    {
+        int maxDiff = 0;
+        for(int c=0; c<4; ++c)
+        {
+            int d = std::abs( (int)a[c] - (int)b[c] );
+            totalDiff += d;
+            maxDiff = std::max( maxDiff, d );
+        }
+        if ( maxDiff > 8 )
+            ++numDiffering;
+    }
+
+    std::cout
+        << std::fixed << std::setprecision(3)
+        << "Tiles: " << tiles << " x " << size << "x" << size
+        << ", " << features << " features per tile, ~" << vertices << " vertices per feature\n"
+        << "  AGG (per feature)     : " << aggMs << " ms/tile\n"
+        << "  Scanline (batched)    : " << scanlineMs << " ms/tile\n"
+        << "  Speedup               : " << (scanlineMs > 0.0 ? aggMs/scanlineMs : 0.0) << "x\n"
+        << "  Mean channel diff     : " << totalDiff/(double)(size*size*4) << "\n"
+        << "  Pixels differing by >8: " << 100.0*(double)numDiffering/(double)(size*size) << "%"
+        << std::endl;
+
+    if ( !prefix.empty() )
+    {
+        osgDB::writeImageFile( *aggImage.get(), prefix + "_agg.png" );
+        osgDB::writeImageFile( *scanlineImage.get(), prefix + "_scanline.png" );
+    }
+
+    return 0;
+}
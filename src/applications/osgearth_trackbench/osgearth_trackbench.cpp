@@ -0,0 +1,170 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_trackbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/SpatialReference>
+#include <osgEarthAnnotation/TrackBatch>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Benchmarks the per-frame CPU work of a TrackBatch: moving every entity,\n"
+        << "recomputing world positions, and culling/decluttering for one view.\n"
+        << "No graphics context is required.\n\n"
+        << argv[0]
+        << "\n    --tracks [int]        : number of entities (default = 100000)"
+        << "\n    --frames [int]        : number of frames to simulate (default = 100)"
+        << "\n    --width [int]         : viewport width (default = 1920)"
+        << "\n    --height [int]        : viewport height (default = 1080)"
+        << "\n    --icon-size [int]     : icon size in pixels (default = 32)"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    double random(double lo, double hi)
+    {
+        return lo + (hi-lo) * (double)::rand() / (double)RAND_MAX;
+    }
+
+    double msPerFrame(int frames, osg::Timer_t t0, osg::Timer_t t1)
+    {
+        return osg::Timer::instance()->delta_m(t0, t1) / (double)frames;
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") || args.read("-h") )
+        return usage(argv);
+
+    int numTracks = 100000, frames = 100, width = 1920, height = 1080, iconSize = 32;
+    args.read( "--tracks", numTracks );
+    args.read( "--frames", frames );
+    args.read( "--width", width );
+    args.read( "--height", height );
+    args.read( "--icon-size", iconSize );
+
+    if ( numTracks <= 0 || frames <= 0 || width <= 0 || height <= 0 || iconSize <= 0 )
+        return usage(argv);
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    osg::ref_ptr<TrackBatch> batch = new TrackBatch( srs, true );
+
+    // entities scattered over the whole globe, airliner altitude.
+    batch->reserve( numTracks );
+    std::vector<double> x(numTracks), y(numTracks), z(numTracks);
+    std::vector<double> dx(numTracks), dy(numTracks);
+    std::vector<float>  headings(numTracks);
+    for(int i=0; i<numTracks; ++i)
+    {
+        x[i] = random(-180.0, 180.0);
+        y[i] = random(-80.0, 80.0);
+        z[i] = 10000.0;
+        dx[i] = random(-0.01, 0.01);
+        dy[i] = random(-0.01, 0.01);
+        headings[i] = (float)osg::RadiansToDegrees(atan2(dx[i], dy[i]));
+        batch->add( osg::Vec3d(x[i], y[i], z[i]), headings[i], 0u, "TRACK", (float)random(0.0, 1.0) );
+    }
+    batch->computeWorldPositions();
+
+    // a view of one hemisphere from 20,000 km up.
+    double R = srs->getEllipsoid()->getRadiusEquator();
+    osg::Matrixd view = osg::Matrixd::lookAt( osg::Vec3d(R + 2.0e7, 0, 0), osg::Vec3d(0,0,0), osg::Vec3d(0,0,1) );
+    osg::Matrixd proj = osg::Matrixd::perspective( 45.0, (double)width/(double)height, 1.0e6, 5.0e7 );
+    osg::Matrixd mvpw =
+        view * proj *
+        osg::Matrixd::translate(1.0, 1.0, 1.0) *
+        osg::Matrixd::scale(0.5*width, 0.5*height, 0.5);
+    osg::Vec3d eye(R + 2.0e7, 0, 0);
+
+    TrackBatch::CullResult culled;
+
+    // each frame moves every entity.
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for(int f=0; f<frames; ++f)
+    {
+        for(int i=0; i<numTracks; ++i)
+        {
+            x[i] += dx[i];
+            y[i] += dy[i];
+        }
+        batch->setPositions( 0, numTracks, &x[0], &y[0], &z[0], &headings[0] );
+    }
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    for(int f=0; f<frames; ++f)
+    {
+        batch->setPositions( 0, numTracks, &x[0], &y[0], &z[0] );
+        batch->computeWorldPositions();
+    }
+
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+    unsigned drawn = 0u;
+    for(int f=0; f<frames; ++f)
+        drawn = batch->cull( mvpw, eye, width, height, (float)iconSize, false, culled );
+
+    osg::Timer_t t3 = osg::Timer::instance()->tick();
+    unsigned decluttered = 0u;
+    for(int f=0; f<frames; ++f)
+        decluttered = batch->cull( mvpw, eye, width, height, (float)iconSize, true, culled );
+
+    osg::Timer_t t4 = osg::Timer::instance()->tick();
+
+    double update    = msPerFrame( frames, t0, t1 );
+    double transform = msPerFrame( frames, t1, t2 );
+    double cull      = msPerFrame( frames, t2, t3 );
+    double declutter = msPerFrame( frames, t3, t4 );
+    double total     = update + transform + declutter;
+
+    std::cout
+        << std::fixed << std::setprecision(3)
+        << "Tracks: " << numTracks << ", " << frames << " frames, "
+        << width << "x" << height << " viewport, " << iconSize << "px icons\n"
+        << std::setw(22) << "update (ms/frame): "     << update << "\n"
+        << std::setw(22) << "transform (ms/frame): "  << transform << "\n"
+        << std::setw(22) << "cull (ms/frame): "       << cull << " (" << drawn << " drawn)\n"
+        << std::setw(22) << "declutter (ms/frame): "  << declutter << " (" << decluttered << " drawn)\n"
+        << std::setw(22) << "total (ms/frame): "      << total << "\n"
+        << std::setprecision(0)
+        << std::setw(22) << "tracks/s: "              << (total > 0.0 ? (double)numTracks * 1000.0 / total : 0.0)
+        << std::endl;
+
+    return 0;
+}
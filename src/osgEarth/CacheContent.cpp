@@ -0,0 +1,176 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CacheContent>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/StringUtils>
+#include <cstring>
+#include <iomanip>
+
+using namespace osgEarth;
+
+#define LC "[CacheContent] "
+
+// Layout of a single-color description (little-endian):
+//   [0..3]   magic "OESC"
+//   [4..7]   s, [8..11] t, [12..15] r
+//   [16..19] internal texture format
+//   [20..23] pixel format, [24..27] data type, [28..31] packing
+//   [32..35] origin
+//   [36..39] bytes per pixel (n)
+//   [40..]   the n bytes of the pixel
+#define SC_MAGIC       "OESC"
+#define SC_HEADER_SIZE 40
+#define SC_MAX_PIXEL   64
+
+namespace
+{
+    void writeU32(std::string& out, unsigned v)
+    {
+        for(int i=0; i<4; ++i, v >>= 8)
+            out.push_back( (char)(v & 0xff) );
+    }
+
+    unsigned readU32(const char* p)
+    {
+        return
+              (unsigned)(unsigned char)p[0]
+            | (unsigned)(unsigned char)p[1] << 8
+            | (unsigned)(unsigned char)p[2] << 16
+            | (unsigned)(unsigned char)p[3] << 24;
+    }
+}
+
+std::string
+CacheContent::hash(const std::string& payload)
+{
+    // 64-bit FNV-1a. Callers compare the bytes before sharing a payload,
+    // so this only needs to spread well, not resist collisions.
+    unsigned long long h = 14695981039346656037ULL;
+    for(std::string::const_iterator i = payload.begin(); i != payload.end(); ++i)
+    {
+        h ^= (unsigned char)*i;
+        h *= 1099511628211ULL;
+    }
+
+    return Stringify()
+        << std::hex << std::setfill('0')
+        << std::setw(8) << (unsigned)(h >> 32)
+        << std::setw(8) << (unsigned)(h & 0xffffffffu)
+        << "-" << payload.size();
+}
+
+bool
+CacheContent::encodeSingleColor(const osg::Image* image, std::string& out)
+{
+    if ( !image || !image->data() || image->isCompressed() || image->isMipmap() )
+        return false;
+
+    // anything hanging off the image would be lost.
+    if ( image->getUserDataContainer() )
+        return false;
+
+    unsigned pixelBits = image->getPixelSizeInBits();
+    if ( pixelBits == 0 || pixelBits % 8 != 0 || pixelBits/8 > SC_MAX_PIXEL )
+        return false;
+
+    std::string pixel;
+    if ( ImageUtils::isSingleColorImage(image, 0.0f) )
+    {
+        pixel.assign( (const char*)image->data(), pixelBits/8 );
+    }
+    else if ( ImageUtils::isEmptyImage(image, 0.0f) )
+    {
+        // fully transparent; the color under it doesn't matter.
+        pixel.assign( pixelBits/8, '\0' );
+    }
+    else
+    {
+        return false;
+    }
+
+    out.clear();
+    out.reserve( SC_HEADER_SIZE + pixel.size() );
+    out.append( SC_MAGIC, 4 );
+    writeU32( out, image->s() );
+    writeU32( out, image->t() );
+    writeU32( out, image->r() );
+    writeU32( out, (unsigned)image->getInternalTextureFormat() );
+    writeU32( out, image->getPixelFormat() );
+    writeU32( out, image->getDataType() );
+    writeU32( out, image->getPacking() );
+    writeU32( out, (unsigned)image->getOrigin() );
+    writeU32( out, pixel.size() );
+    out.append( pixel );
+    return true;
+}
+
+bool
+CacheContent::isSingleColor(const char* data, unsigned length)
+{
+    return
+        length >= SC_HEADER_SIZE &&
+        ::memcmp(data, SC_MAGIC, 4) == 0 &&
+        length == SC_HEADER_SIZE + readU32(data+36);
+}
+
+osg::Image*
+CacheContent::decodeSingleColor(const std::string& data)
+{
+    if ( !isSingleColor(data) )
+        return 0L;
+
+    const char* p = data.data();
+    unsigned s         = readU32(p+4);
+    unsigned t         = readU32(p+8);
+    unsigned r         = readU32(p+12);
+    int      internal  = (int)readU32(p+16);
+    GLenum   format    = readU32(p+20);
+    GLenum   type      = readU32(p+24);
+    unsigned packing   = readU32(p+28);
+    unsigned origin    = readU32(p+32);
+    unsigned pixelSize = readU32(p+36);
+
+    if ( s == 0 || t == 0 || r == 0 || pixelSize == 0 || pixelSize > SC_MAX_PIXEL )
+        return 0L;
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( s, t, r, format, type, packing );
+    if ( !image->data() || image->getPixelSizeInBits() != pixelSize*8 )
+    {
+        OE_WARN << LC << "Unusable single-color description" << std::endl;
+        return 0L;
+    }
+
+    image->setInternalTextureFormat( internal );
+    image->setOrigin( (osg::Image::Origin)origin );
+
+    // allocateImage may pad the rows, so fill row by row.
+    const char* pixel = p + SC_HEADER_SIZE;
+    for(unsigned k=0; k<r; ++k)
+    {
+        for(unsigned j=0; j<t; ++j)
+        {
+            unsigned char* row = image->data(0, j, k);
+            for(unsigned i=0; i<s; ++i)
+                ::memcpy( row + i*pixelSize, pixel, pixelSize );
+        }
+    }
+
+    return image.release();
+}
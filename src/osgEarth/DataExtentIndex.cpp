@@ -0,0 +1,328 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/DataExtentIndex>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace osgEarth;
+
+#define MAX_CHILDREN 16u
+
+namespace
+{
+    template<typename NODE>
+    struct SortByX {
+        bool operator()(const NODE& a, const NODE& b) const { return a._xmin+a._xmax < b._xmin+b._xmax; }
+    };
+
+    template<typename NODE>
+    struct SortByY {
+        bool operator()(const NODE& a, const NODE& b) const { return a._ymin+a._ymax < b._ymin+b._ymax; }
+    };
+
+    template<typename A, typename B>
+    inline bool overlaps(const A& a, const B& b)
+    {
+        return a._xmin <= b._xmax && a._xmax >= b._xmin && a._ymin <= b._ymax && a._ymax >= b._ymin;
+    }
+}
+
+DataExtentIndex::DataExtentIndex(const DataExtentList& extents) :
+_extents( extents ),
+_indexed( false )
+{
+    build();
+}
+
+void
+DataExtentIndex::build()
+{
+    if ( _extents.empty() )
+        return;
+
+    // all extents must share an SRS for their boxes to be comparable.
+    _srs = _extents.front().getSRS();
+    for(unsigned i=0; i<_extents.size(); ++i)
+    {
+        const DataExtent& de = _extents[i];
+        if ( !de.isValid() || !_srs.valid() || !_srs->isHorizEquivalentTo(de.getSRS()) )
+        {
+            _srs = 0L;
+            return;
+        }
+    }
+
+    std::vector<Node> level;
+    level.reserve( _extents.size() );
+
+    for(unsigned i=0; i<_extents.size(); ++i)
+    {
+        const DataExtent& de = _extents[i];
+
+        Node entry;
+        entry._minLevel = de.minLevel().isSet() ? de.minLevel().get() : 0u;
+        entry._maxLevel = de.maxLevel().isSet() ? de.maxLevel().get() : UINT_MAX;
+        entry._first    = i;
+        entry._count    = 0u;
+        entry._leaf     = false;
+
+        // an extent that crosses the antimeridian gets one entry per side.
+        GeoExtent parts[2];
+        unsigned numParts = 1u;
+        if ( de.crossesAntimeridian() && de.splitAcrossAntimeridian(parts[0], parts[1]) )
+            numParts = 2u;
+        else
+            parts[0] = de;
+
+        for(unsigned p=0; p<numParts; ++p)
+        {
+            entry._xmin = parts[p].xMin(); entry._ymin = parts[p].yMin();
+            entry._xmax = parts[p].xMax(); entry._ymax = parts[p].yMax();
+            level.push_back( entry );
+        }
+    }
+
+    // pack the entries into leaves, then each level above, until one node
+    // remains. Packing reorders "level", which is why each level is only
+    // stored after its parents have been built.
+    std::vector<Node> parents;
+    pack( level, parents, true );
+    _entries.swap( level );
+    level.swap( parents );
+
+    while( level.size() > 1u )
+    {
+        unsigned base = _nodes.size();
+        pack( level, parents, false );
+        for(unsigned i=0; i<parents.size(); ++i)
+            parents[i]._first += base;
+
+        _nodes.insert( _nodes.end(), level.begin(), level.end() );
+        level.swap( parents );
+    }
+
+    // root is the last node.
+    _nodes.push_back( level.front() );
+    _indexed = true;
+}
+
+void
+DataExtentIndex::pack(std::vector<Node>& items, std::vector<Node>& parents, bool leaf) const
+{
+    unsigned numNodes  = (items.size() + MAX_CHILDREN - 1u) / MAX_CHILDREN;
+    unsigned numSlices = (unsigned)::ceil( ::sqrt((double)numNodes) );
+    unsigned sliceSize = numSlices * MAX_CHILDREN;
+
+    std::sort( items.begin(), items.end(), SortByX<Node>() );
+
+    parents.clear();
+    parents.reserve( numNodes );
+
+    for(unsigned s=0; s<items.size(); s += sliceSize)
+    {
+        unsigned end = std::min( (unsigned)items.size(), s + sliceSize );
+        std::sort( items.begin() + s, items.begin() + end, SortByY<Node>() );
+
+        for(unsigned i=s; i<end; i += MAX_CHILDREN)
+        {
+            unsigned last = std::min( end, i + MAX_CHILDREN );
+
+            Node parent = items[i];
+            parent._first = i;
+            parent._count = last - i;
+            parent._leaf  = leaf;
+
+            for(unsigned j=i+1; j<last; ++j)
+            {
+                const Node& child = items[j];
+                parent._xmin = std::min(parent._xmin, child._xmin);
+                parent._ymin = std::min(parent._ymin, child._ymin);
+                parent._xmax = std::max(parent._xmax, child._xmax);
+                parent._ymax = std::max(parent._ymax, child._ymax);
+                parent._minLevel = std::min(parent._minLevel, child._minLevel);
+                parent._maxLevel = std::max(parent._maxLevel, child._maxLevel);
+            }
+
+            parents.push_back( parent );
+        }
+    }
+}
+
+unsigned
+DataExtentIndex::getQueryBoxes(const GeoExtent& extent, QueryBox boxes[2]) const
+{
+    if ( !_indexed || !extent.isValid() )
+        return 0u;
+
+    GeoExtent local = extent;
+    if ( !_srs->isHorizEquivalentTo(extent.getSRS()) )
+    {
+        local = extent.transform( _srs.get() );
+        if ( !local.isValid() )
+            return 0u;
+    }
+
+    GeoExtent parts[2];
+    unsigned numParts = 1u;
+    if ( local.crossesAntimeridian() && local.splitAcrossAntimeridian(parts[0], parts[1]) )
+        numParts = 2u;
+    else
+        parts[0] = local;
+
+    for(unsigned p=0; p<numParts; ++p)
+    {
+        boxes[p]._xmin = parts[p].xMin(); boxes[p]._ymin = parts[p].yMin();
+        boxes[p]._xmax = parts[p].xMax(); boxes[p]._ymax = parts[p].yMax();
+    }
+    return numParts;
+}
+
+bool
+DataExtentIndex::intersects(const GeoExtent& extent) const
+{
+    if ( _extents.empty() || !extent.isValid() )
+        return false;
+
+    QueryBox boxes[2];
+    unsigned numBoxes = getQueryBoxes( extent, boxes );
+
+    if ( numBoxes == 0u )
+    {
+        for(DataExtentList::const_iterator i = _extents.begin(); i != _extents.end(); ++i)
+        {
+            if ( extent.intersects(*i) )
+                return true;
+        }
+        return false;
+    }
+
+    std::vector<unsigned> stack;
+    for(unsigned b=0; b<numBoxes; ++b)
+    {
+        stack.push_back( _nodes.size()-1u );
+        while( !stack.empty() )
+        {
+            const Node& node = _nodes[stack.back()];
+            stack.pop_back();
+
+            if ( !overlaps(node, boxes[b]) )
+                continue;
+
+            if ( node._leaf )
+            {
+                for(unsigned i=node._first; i<node._first+node._count; ++i)
+                {
+                    if ( overlaps(_entries[i], boxes[b]) && extent.intersects(_extents[_entries[i]._first]) )
+                        return true;
+                }
+            }
+            else
+            {
+                for(unsigned i=node._first; i<node._first+node._count; ++i)
+                    stack.push_back( i );
+            }
+        }
+    }
+
+    return false;
+}
+
+void
+DataExtentIndex::getMaxLevelLinear(const GeoExtent& extent, unsigned lod, bool& found, unsigned& maxLevel) const
+{
+    for(DataExtentList::const_iterator i = _extents.begin(); i != _extents.end(); ++i)
+    {
+        if ( i->minLevel().isSet() && lod < i->minLevel().get() )
+            continue;
+
+        if ( !extent.intersects(*i) )
+            continue;
+
+        found = true;
+        maxLevel = std::max( maxLevel, i->maxLevel().isSet() ? i->maxLevel().get() : UINT_MAX );
+        if ( maxLevel >= lod )
+            return;
+    }
+}
+
+bool
+DataExtentIndex::getMaxLevel(const GeoExtent& extent, unsigned lod, unsigned& out_maxLevel) const
+{
+    if ( _extents.empty() || !extent.isValid() )
+        return false;
+
+    bool     found    = false;
+    unsigned maxLevel = 0u;
+
+    QueryBox boxes[2];
+    unsigned numBoxes = getQueryBoxes( extent, boxes );
+
+    if ( numBoxes == 0u )
+    {
+        getMaxLevelLinear( extent, lod, found, maxLevel );
+    }
+    else
+    {
+        std::vector<unsigned> stack;
+        for(unsigned b=0; b<numBoxes && !(found && maxLevel >= lod); ++b)
+        {
+            stack.push_back( _nodes.size()-1u );
+            while( !stack.empty() && !(found && maxLevel >= lod) )
+            {
+                const Node& node = _nodes[stack.back()];
+                stack.pop_back();
+
+                // skip subtrees that are too detailed for "lod", or that
+                // can't raise the level we already have.
+                if ( node._minLevel > lod || (found && node._maxLevel <= maxLevel) || !overlaps(node, boxes[b]) )
+                    continue;
+
+                if ( node._leaf )
+                {
+                    for(unsigned i=node._first; i<node._first+node._count; ++i)
+                    {
+                        const Node& entry = _entries[i];
+                        if ( entry._minLevel > lod || (found && entry._maxLevel <= maxLevel) || !overlaps(entry, boxes[b]) )
+                            continue;
+
+                        if ( extent.intersects(_extents[entry._first]) )
+                        {
+                            found = true;
+                            maxLevel = entry._maxLevel;
+                            if ( maxLevel >= lod )
+                                break;
+                        }
+                    }
+                }
+                else
+                {
+                    for(unsigned i=node._first; i<node._first+node._count; ++i)
+                        stack.push_back( i );
+                }
+            }
+            stack.clear();
+        }
+    }
+
+    if ( found )
+        out_maxLevel = maxLevel;
+
+    return found;
+}
@@ -656,38 +656,52 @@ namespace
     //typedef std::pair<RefElevationLayer, TileKey> LayerAndKey;
     typedef std::vector<LayerData>              LayerDataVector;
 
-    //! Gets the normal vector for elevation data at column s, row t.
-    osg::Vec3 getNormal(const GeoExtent& extent, const osg::HeightField* hf, int s, int t)
+    //! Computes the (unnormalized) normal vector of every sample in the
+    //! heightfield in one pass. Per-row terms are computed once per row.
+    void computeNormals(const GeoExtent& extent, const osg::HeightField* hf, std::vector<osg::Vec3>& normals)
     {
         int w = hf->getNumColumns();
         int h = hf->getNumRows();
 
+        normals.resize(w*h);
+
         osg::Vec2d res(
             extent.width() / (double)(w-1),
             extent.height() / (double)(h-1));
 
-        float e = hf->getHeight(s, t);
-
-        double dx = res.x(), dy = res.y();
-
-        if (extent.getSRS()->isGeographic())
+        bool geographic = extent.getSRS()->isGeographic();
+        double mPerDegAtEquator = 0.0;
+        if (geographic)
         {
             double R = extent.getSRS()->getEllipsoid()->getRadiusEquator();
-            double mPerDegAtEquator = (2.0 * osg::PI * R) / 360.0;
-            dy = dy * mPerDegAtEquator;
-            double lat = extent.yMin() + res.y()*(double)t;
-            dx = dx * mPerDegAtEquator * cos(osg::DegreesToRadians(lat));
+            mPerDegAtEquator = (2.0 * osg::PI * R) / 360.0;
         }
-        
-        osg::Vec3d west(0, 0, e), east(0, 0, e), south(0, 0, e), north(0, 0, e);
 
-        if (s > 0)     west.set (-dx, 0, hf->getHeight(s-1, t));
-        if (s < w - 1) east.set ( dx, 0, hf->getHeight(s+1, t));
-        if (t > 0)     south.set(0, -dy, hf->getHeight(s, t-1));
-        if (t < h - 1) north.set(0,  dy, hf->getHeight(s, t+1));
+        for (int t = 0; t < h; ++t)
+        {
+            double dx = res.x(), dy = res.y();
 
-        osg::Vec3d normal = (east - west) ^ (north - south);
-        return normal;
+            if (geographic)
+            {
+                dy = dy * mPerDegAtEquator;
+                double lat = extent.yMin() + res.y()*(double)t;
+                dx = dx * mPerDegAtEquator * cos(osg::DegreesToRadians(lat));
+            }
+
+            for (int s = 0; s < w; ++s)
+            {
+                float e = hf->getHeight(s, t);
+
+                osg::Vec3d west(0, 0, e), east(0, 0, e), south(0, 0, e), north(0, 0, e);
+
+                if (s > 0)     west.set (-dx, 0, hf->getHeight(s-1, t));
+                if (s < w - 1) east.set ( dx, 0, hf->getHeight(s+1, t));
+                if (t > 0)     south.set(0, -dy, hf->getHeight(s, t-1));
+                if (t < h - 1) north.set(0,  dy, hf->getHeight(s, t+1));
+
+                normals[t*w + s] = (east - west) ^ (north - south);
+            }
+        }
     }
 
     //! Creates a normal map for heightfield "hf" and stores it in the
@@ -709,21 +723,23 @@ namespace
         int w = hf->getNumColumns();
         int h = hf->getNumRows();
 
-        for (int t = 0; t < hf->getNumRows(); ++t)
+        // The raw normals are computed in a separate pass, so the
+        // interpolation below never computes the same normal twice.
+        std::vector<osg::Vec3> normals;
+        computeNormals(extent, hf, normals);
+
+        for (int t = 0; t < h; ++t)
         {
-            for (int s = 0; s<hf->getNumColumns(); ++s)
+            for (int s = 0; s < w; ++s)
             {
-                int step = 1 << (*deltaLOD)[t*h + s];
+                int step = 1 << (*deltaLOD)[t*w + s];
 
                 osg::Vec3 normal;
 
-                // four corners:
-                int s0=s, s1=s, t0=t, t1=t;
-
                 if (step == 1)
                 {
                     // Same LOD, simple query
-                    normal = getNormal(extent, hf, s, t);
+                    normal = normals[t*w + s];
                 }
                 else
                 {
@@ -735,29 +751,29 @@ namespace
                     if (s0 == s1 && t0 == t1)
                     {
                         // on-pixel, simple query
-                        normal = getNormal(extent, hf, s0, t0);
+                        normal = normals[t0*w + s0];
                     }
                     else if (s0 == s1)
                     {
                         // same column; linear interpolate along row
-                        osg::Vec3 S = getNormal(extent, hf, s0, t0);
-                        osg::Vec3 N = getNormal(extent, hf, s0, t1);
+                        const osg::Vec3& S = normals[t0*w + s0];
+                        const osg::Vec3& N = normals[t1*w + s0];
                         normal = S*(double)(t1 - t) + N*(double)(t - t0);
                     }
                     else if (t0 == t1)
                     {
                         // same row; linear interpolate along column
-                        osg::Vec3 W = getNormal(extent, hf, s0, t0);
-                        osg::Vec3 E = getNormal(extent, hf, s1, t0);
+                        const osg::Vec3& W = normals[t0*w + s0];
+                        const osg::Vec3& E = normals[t0*w + s1];
                         normal = W*(double)(s1 - s) + E*(double)(s - s0);
                     }
                     else
                     {
                         // bilinear interpolate
-                        osg::Vec3 SW = getNormal(extent, hf, s0, t0);
-                        osg::Vec3 SE = getNormal(extent, hf, s1, t0);
-                        osg::Vec3 NW = getNormal(extent, hf, s0, t1);
-                        osg::Vec3 NE = getNormal(extent, hf, s1, t1);
+                        const osg::Vec3& SW = normals[t0*w + s0];
+                        const osg::Vec3& SE = normals[t0*w + s1];
+                        const osg::Vec3& NW = normals[t1*w + s0];
+                        const osg::Vec3& NE = normals[t1*w + s1];
 
                         osg::Vec3 S = SW*(double)(s1 - s) + SE*(double)(s - s0);
                         osg::Vec3 N = NW*(double)(s1 - s) + NE*(double)(s - s0);
@@ -771,6 +787,83 @@ namespace
             }
         }
     }
+
+    //! Index (0..8, 4 = center) of the tile around "key" that holds the
+    //! sample (x,y). Only samples in the border can fall outside the key.
+    inline int getSampleTileIndex(const GeoExtent& keyExtent, unsigned border, double x, double y)
+    {
+        if (border > 0u && !keyExtent.contains(x, y))
+        {
+            int dTx = x < keyExtent.xMin() ? -1 : x > keyExtent.xMax() ? +1 : 0;
+            int dTy = y < keyExtent.yMin() ? +1 : y > keyExtent.yMax() ? -1 : 0;
+            return (dTy+1)*3 + (dTx+1);
+        }
+        return 4;
+    }
+
+    //! Key of the tile at neighbor index "n" around "key".
+    inline TileKey getSampleTileKey(const TileKey& key, int n)
+    {
+        return n == 4 ? key : key.createNeighborKey((n%3)-1, (n/3)-1);
+    }
+
+    /**
+     * Samples one source heightfield at output grid locations. When the
+     * heightfield is in the output SRS (the common case) the samples read the
+     * raw heights directly, skipping the per-sample SRS transform and datum
+     * checks of GeoHeightField::getElevation; the result is the same.
+     */
+    struct HeightFieldSampler
+    {
+        GeoHeightField          _geoHF;
+        ElevationInterpolation  _interp;
+        const SpatialReference* _srs;
+        bool                    _direct;
+        const osg::HeightField* _hf;
+        double                  _xmin, _ymin, _xInterval, _yInterval;
+
+        HeightFieldSampler() : _hf(0L) { }
+
+        void set(const GeoHeightField& geoHF, const SpatialReference* srs, ElevationInterpolation interp)
+        {
+            _geoHF = geoHF;
+            _srs = srs;
+            _interp = interp;
+
+            const GeoExtent& extent = _geoHF.getExtent();
+            const SpatialReference* extentSRS = extent.getSRS();
+
+            _direct = srs->isEquivalentTo(extentSRS) && extentSRS->isVertEquivalentTo(srs);
+            _hf = _geoHF.getHeightField();
+            _xmin = extent.xMin();
+            _ymin = extent.yMin();
+            _xInterval = extent.width()  / (double)(_hf->getNumColumns()-1);
+            _yInterval = extent.height() / (double)(_hf->getNumRows()-1);
+        }
+
+        bool valid() const
+        {
+            return _hf != 0L;
+        }
+
+        bool sample(double x, double y, float& out_elevation) const
+        {
+            if (!_direct)
+            {
+                return _geoHF.getElevation(_srs, x, y, _interp, _srs, out_elevation);
+            }
+
+            if (!_geoHF.getExtent().contains(x, y))
+            {
+                out_elevation = 0.0f;
+                return false;
+            }
+
+            out_elevation = HeightFieldUtils::getHeightAtLocation(
+                _hf, x, y, _xmin, _ymin, _xInterval, _yInterval, _interp);
+            return true;
+        }
+    };
 }
 
 bool
@@ -900,33 +993,9 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
     }
     
     // We will load the actual heightfields on demand. We might not need them all.
-#if 0
-    GeoHeightFieldVector heightFields(contenders.size());
-    GeoHeightFieldVector offsetFields(offsets.size());
-    std::vector<bool>    heightFallback(contenders.size(), false);
-    std::vector<bool>    heightFailed(contenders.size(), false);
-    std::vector<bool>    offsetFailed(offsets.size(), false);
-#else
-    GeoHeightFieldVector heightFields[9];
-    GeoHeightFieldVector offsetFields[9]; //(offsets.size());
-    std::vector<bool>    heightFallback[9]; //(contenders.size(), false);
-    std::vector<bool>    heightFailed[9]; //(contenders.size(), false);
-    std::vector<bool>    offsetFailed[9]; //(offsets.size(), false);
-
-    for (int n = 0; n < 9; ++n)
-    {
-        heightFields[n].resize(contenders.size());
-        offsetFields[n].resize(offsets.size());
-        heightFallback[n].assign(9, false);
-        heightFailed[n].assign(9, false);
-        offsetFailed[n].assign(9, false);
-    }
-#endif
-
-    // The maximum number of heightfields to keep in this local cache
-    unsigned int maxHeightFields = 50;
-    unsigned numHeightFieldsInCache = 0;
-
+    // Layers are composited one at a time (highest priority first), and each
+    // layer only samples the points that no higher-priority layer resolved, so
+    // at most 9 heightfields (the tile and its neighbors) are held at once.
     const SpatialReference* keySRS = keyToUse.getProfile()->getSRS();
 
     bool realData = false;
@@ -935,51 +1004,57 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
 
     // query resolution interval (x, y) of each sample.
     osg::ref_ptr<osg::ShortArray> deltaLOD = new osg::ShortArray(total);
-    
+
+    // index of the layer that resolved each sample, or -1 if none did yet.
+    std::vector<int> resolved(total, -1);
+    unsigned numUnresolved = total;
+
     int nodataCount = 0;
 
-    for (unsigned c = 0; c < numColumns; ++c)
+    for(unsigned i=0; i<contenders.size() && numUnresolved > 0u; ++i)
     {
-        double x = xmin + (dx * (double)c);
+        ElevationLayer* layer = contenders[i].layer.get();
+        const TileKey& contenderKey = contenders[i].key;
+        const GeoExtent& contenderExtent = contenderKey.getExtent();
+        int index = contenders[i].index;
+
+        HeightFieldSampler samplers[9];
+        TileKey            actualKeys[9];
+        bool               fallback[9];
+        bool               failed[9];
+        for (int n = 0; n < 9; ++n)
+        {
+            fallback[n] = false;
+            failed[n] = false;
+        }
+
         for (unsigned r = 0; r < numRows; ++r)
         {
             double y = ymin + (dy * (double)r);
 
-            // Collect elevations from each layer as necessary.
-            int resolvedIndex = -1;
-
-            osg::Vec3 normal_sum(0,0,0);
-            unsigned normal_count = 0u;
-
-            for(int i=0; i<contenders.size() && resolvedIndex<0; ++i)
+            for (unsigned c = 0; c < numColumns; ++c)
             {
-                ElevationLayer* layer = contenders[i].layer.get();                
-                TileKey contenderKey = contenders[i].key;
-                int index = contenders[i].index;
+                unsigned s = r*numColumns + c;
+                if (resolved[s] >= 0)
+                    continue;
+
+                double x = xmin + (dx * (double)c);
 
                 // If there is a border, the edge points may not fall within the key extents 
                 // and we may need to fetch a neighboring key.
+                int n = getSampleTileIndex(contenderExtent, border, x, y);
 
-                int n = 4; // index 4 is the center/default tile
-
-                if (border > 0u && !contenderKey.getExtent().contains(x, y))
-                {
-                    int dTx = x < contenderKey.getExtent().xMin() ? -1 : x > contenderKey.getExtent().xMax() ? +1 : 0;
-                    int dTy = y < contenderKey.getExtent().yMin() ? +1 : y > contenderKey.getExtent().yMax() ? -1 : 0;
-                    contenderKey = contenderKey.createNeighborKey(dTx, dTy);
-                    n = (dTy+1)*3 + (dTx+1);
-                }
-
-                if ( heightFailed[n][i] )
+                if (failed[n])
                     continue;
 
-                TileKey actualKey = contenderKey;
+                HeightFieldSampler& sampler = samplers[n];
 
-                GeoHeightField& layerHF = heightFields[n][i];
-
-                if (!layerHF.valid())
+                if (!sampler.valid())
                 {
-                    // We couldn't get the heightfield from the cache, so try to create it.
+                    TileKey sampleKey = getSampleTileKey(contenderKey, n);
+                    TileKey actualKey = sampleKey;
+                    GeoHeightField layerHF;
+
                     // We also fallback on parent layers to make sure that we have data at the location even if it's fallback.
                     while (!layerHF.valid() && actualKey.valid())
                     {
@@ -990,114 +1065,110 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                         }
                     }
 
-                    // Mark this layer as fallback if necessary.
-                    if (layerHF.valid())
+                    if (!layerHF.valid())
                     {
-                        heightFallback[n][i] = (actualKey != contenderKey); // actualKey != contenders[i].second;
-                        numHeightFieldsInCache++;
-                    }
-                    else
-                    {
-                        heightFailed[n][i] = true;
+                        failed[n] = true;
                         continue;
                     }
+
+                    // Mark this layer as fallback if necessary.
+                    fallback[n] = (actualKey != sampleKey);
+                    actualKeys[n] = actualKey;
+                    sampler.set(layerHF, keySRS, interpolation);
                 }
 
-                if (layerHF.valid())
+                // We only have real data if this is not a fallback heightfield.
+                if (!fallback[n])
                 {
-                    bool isFallback = heightFallback[n][i];
+                    realData = true;
+                }
 
-                    // We only have real data if this is not a fallback heightfield.
-                    if (!isFallback)
-                    {
-                        realData = true;
-                    }
-                    
-                    float elevation;
-                    if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation))
+                float elevation;
+                if (sampler.sample(x, y, elevation))
+                {
+                    if ( elevation != NO_DATA_VALUE )
                     {
-                        if ( elevation != NO_DATA_VALUE )
-                        {
-                            // remember the index so we can only apply offset layers that
-                            // sit on TOP of this layer.
-                            resolvedIndex = index;
+                        // remember the index so we can only apply offset layers that
+                        // sit on TOP of this layer.
+                        resolved[s] = index;
+                        --numUnresolved;
 
-                            hf->setHeight(c, r, elevation);
+                        hf->setHeight(c, r, elevation);
 
-                            if (deltaLOD)
-                            {
-                                (*deltaLOD)[r*numColumns + c] = key.getLOD() - actualKey.getLOD();
-                            }
-                        }
-                        else
+                        if (deltaLOD)
                         {
-                            ++nodataCount;
+                            (*deltaLOD)[s] = key.getLOD() - actualKeys[n].getLOD();
                         }
-                    }                    
-                }
-
-
-                // Clear the heightfield cache if we have too many heightfields in the cache.
-                if (numHeightFieldsInCache >= maxHeightFields)
-                {
-                    //OE_NOTICE << "Clearing cache" << std::endl;
-                    for (unsigned int j = 0; j < 9; ++j)
+                    }
+                    else
                     {
-                        for (unsigned int k = 0; k < heightFields[j].size(); k++)
-                        {
-                            heightFields[j][k] = GeoHeightField::INVALID;
-                            heightFallback[j][k] = false;
-                        }
+                        ++nodataCount;
                     }
-                    numHeightFieldsInCache = 0;
                 }
             }
+        }
+    }
+
+    for(int i=offsets.size()-1; i>=0; --i)
+    {
+        ElevationLayer* offset = offsets[i].layer.get();
+        const TileKey& offsetKey = offsets[i].key;
+        const GeoExtent& offsetExtent = offsetKey.getExtent();
+        int index = offsets[i].index;
+
+        HeightFieldSampler samplers[9];
+        TileKey            sampleKeys[9];
+        bool               failed[9];
+        for (int n = 0; n < 9; ++n)
+        {
+            failed[n] = false;
+        }
 
-            for(int i=offsets.size()-1; i>=0; --i)
+        for (unsigned r = 0; r < numRows; ++r)
+        {
+            double y = ymin + (dy * (double)r);
+
+            for (unsigned c = 0; c < numColumns; ++c)
             {
+                unsigned s = r*numColumns + c;
+
                 // Only apply an offset layer if it sits on top of the resolved layer
                 // (or if there was no resolved layer).
-                if (resolvedIndex >= 0 && offsets[i].index < resolvedIndex)
+                if (resolved[s] >= 0 && index < resolved[s])
                     continue;
 
-                TileKey contenderKey = offsets[i].key;
+                double x = xmin + (dx * (double)c);
 
                 // If there is a border, the edge points may not fall within the key extents 
                 // and we may need to fetch a neighboring key.
+                int n = getSampleTileIndex(offsetExtent, border, x, y);
 
-                int n = 4; // index 4 is the center/default tile
-
-                if (border > 0u && !contenderKey.getExtent().contains(x, y))
-                {
-                    int dTx = x < contenderKey.getExtent().xMin() ? -1 : x > contenderKey.getExtent().xMax() ? +1 : 0;
-                    int dTy = y < contenderKey.getExtent().yMin() ? +1 : x > contenderKey.getExtent().yMax() ? -1 : 0;
-                    contenderKey = contenderKey.createNeighborKey(dTx, dTy);
-                    n = (dTy+1)*3 + (dTx+1);
-                }
-                
-                if ( offsetFailed[n][i] == true )
+                if (failed[n])
                     continue;
 
-                GeoHeightField& layerHF = offsetFields[n][i];
-                if ( !layerHF.valid() )
+                HeightFieldSampler& sampler = samplers[n];
+
+                if (!sampler.valid())
                 {
-                    ElevationLayer* offset = offsets[i].layer.get();
+                    sampleKeys[n] = getSampleTileKey(offsetKey, n);
 
-                    layerHF = offset->createHeightField(contenderKey, progress);
+                    GeoHeightField layerHF = offset->createHeightField(sampleKeys[n], progress);
                     if ( !layerHF.valid() )
                     {
-                        offsetFailed[n][i] = true;
+                        failed[n] = true;
                         continue;
                     }
+
+                    sampler.set(layerHF, keySRS, interpolation);
                 }
 
                 // If we actually got a layer then we have real data
                 realData = true;
 
                 float elevation = 0.0f;
-                if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation) &&
+                if (sampler.sample(x, y, elevation) &&
                     elevation != NO_DATA_VALUE)
-                {                    
+                {
                     hf->getHeight(c, r) += elevation;
 
                     // Update the resolution tracker to account for the offset. Sadly this
@@ -1105,7 +1176,7 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                     // normal faceting. See the comments on "createNormalMap" for more info
                     if (deltaLOD)
                     {
-                        (*deltaLOD)[r*numColumns + c] = key.getLOD() - contenderKey.getLOD();
+                        (*deltaLOD)[s] = key.getLOD() - sampleKeys[n].getLOD();
                     }
                 }
             }
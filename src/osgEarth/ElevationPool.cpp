@@ -22,7 +22,13 @@
 #include <osgEarth/Map>
 #include <osgEarth/Metrics>
 #include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <osgEarth/Progress>
+#include <osgEarth/StringUtils>
 #include <osg/Shape>
+#include <algorithm>
+#include <cfloat>
+#include <sstream>
 
 using namespace osgEarth;
 
@@ -34,7 +40,8 @@ using namespace osgEarth;
 ElevationPool::ElevationPool() :
 _entries(0u),
 _maxEntries( 128u ),
-_tileSize( 257u )
+_tileSize( 257u ),
+_numBulkThreads( osg::maximum(OpenThreads::GetNumberOfProcessors(), 1) )
 {
     //nop
     //_opQueue = Registry::instance()->getAsyncOperationQueue();
@@ -90,6 +97,57 @@ ElevationPool::setTileSize(unsigned value)
     clearImpl();
 }
 
+unsigned
+ElevationPool::getMaxDataLevel(unsigned defaultValue) const
+{
+    ElevationLayerVector layers;
+    {
+        Threading::ScopedMutexLock lock(_tilesMutex);
+        layers = _layers;
+    }
+
+    osg::ref_ptr<const osg::Referenced> mapRef;
+    if ( layers.empty() && _map.lock(mapRef) )
+        static_cast<const Map*>(mapRef.get())->getLayers(layers);
+
+    bool found = false;
+    unsigned maxLevel = 0u;
+
+    for(ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        const ElevationLayer* layer = i->get();
+        if ( !layer->getEnabled() )
+            continue;
+
+        if ( layer->options().maxDataLevel().isSet() )
+        {
+            maxLevel = osg::maximum(maxLevel, layer->options().maxDataLevel().get());
+            found = true;
+            continue;
+        }
+
+        // otherwise the layer's data extents have to tell us; an extent
+        // with no max level means we don't know.
+        const DataExtentList& extents = layer->getDataExtents();
+        bool known = !extents.empty();
+        unsigned layerMax = 0u;
+        for(DataExtentList::const_iterator e = extents.begin(); e != extents.end() && known; ++e)
+        {
+            known = e->maxLevel().isSet();
+            if ( known )
+                layerMax = osg::maximum(layerMax, e->maxLevel().get());
+        }
+
+        if ( known )
+        {
+            maxLevel = osg::maximum(maxLevel, layerMax);
+            found = true;
+        }
+    }
+
+    return found ? maxLevel : defaultValue;
+}
+
 Future<ElevationSample>
 ElevationPool::getElevation(const GeoPoint& point, unsigned lod)
 {
@@ -117,6 +175,257 @@ ElevationPool::GetElevationOp::operator()(osg::Object*)
     }
 }
 
+namespace
+{
+    // Point to sample, located in a tile of the query LOD.
+    struct TilePoint
+    {
+        unsigned _tx, _ty;
+        unsigned _index;
+    };
+
+    // Sorts points into Morton (Z-curve) order of their tiles without
+    // interleaving any bits: the axis whose coordinates differ in the
+    // highest bit decides.
+    struct ZOrder
+    {
+        static bool lessMSB(unsigned a, unsigned b) { return a < b && a < (a ^ b); }
+
+        bool operator()(const TilePoint& lhs, const TilePoint& rhs) const
+        {
+            unsigned dx = lhs._tx ^ rhs._tx, dy = lhs._ty ^ rhs._ty;
+            if ( dx == 0u && dy == 0u )
+                return lhs._index < rhs._index;
+            else if ( lessMSB(dx, dy) )
+                return lhs._ty < rhs._ty;
+            else
+                return lhs._tx < rhs._tx;
+        }
+    };
+}
+
+void
+ElevationPool::binPoints(const std::vector<osg::Vec3d>& points,
+                         const Profile*                 profile,
+                         unsigned                       lod,
+                         std::vector<TileBin>&          out_bins)
+{
+    out_bins.clear();
+    if ( !profile )
+        return;
+
+    // locate each point's tile (same arithmetic as Profile::createTileKey):
+    unsigned tilesX, tilesY;
+    profile->getNumTiles( lod, tilesX, tilesY );
+    if ( tilesX == 0u || tilesY == 0u )
+        return;
+
+    const GeoExtent& pe = profile->getExtent();
+
+    std::vector<TilePoint> sorted;
+    sorted.reserve( points.size() );
+    for(unsigned i=0; i<points.size(); ++i)
+    {
+        const osg::Vec3d& p = points[i];
+        if ( !pe.contains(p.x(), p.y()) )
+            continue;
+
+        double rx = (p.x() - pe.xMin()) / pe.width();
+        double ry = (p.y() - pe.yMin()) / pe.height();
+
+        TilePoint tp;
+        tp._tx = osg::clampBelow( (unsigned)(rx * (double)tilesX), tilesX-1 );
+        tp._ty = osg::clampBelow( (unsigned)((1.0-ry) * (double)tilesY), tilesY-1 );
+        tp._index = i;
+        sorted.push_back( tp );
+    }
+
+    std::sort( sorted.begin(), sorted.end(), ZOrder() );
+
+    for(unsigned i=0; i<sorted.size(); ++i)
+    {
+        if ( out_bins.empty() || out_bins.back()._tx != sorted[i]._tx || out_bins.back()._ty != sorted[i]._ty )
+        {
+            out_bins.push_back( TileBin() );
+            out_bins.back()._tx = sorted[i]._tx;
+            out_bins.back()._ty = sorted[i]._ty;
+        }
+        out_bins.back()._indices.push_back( sorted[i]._index );
+    }
+}
+
+unsigned
+ElevationPool::readPoints(std::istream& in, std::vector<osg::Vec3d>& out_points)
+{
+    unsigned count = 0u;
+    std::string line;
+    while( std::getline(in, line) )
+    {
+        StringVector tokens;
+        StringTokenizer(line, tokens, ", \t", "", false, true);
+        if ( tokens.size() < 2 )
+            continue;
+
+        // skip headers, comments and anything else that isn't a coordinate pair.
+        double x, y;
+        std::istringstream xs(tokens[0]), ys(tokens[1]);
+        if ( !(xs >> x) || !xs.eof() || !(ys >> y) || !ys.eof() )
+            continue;
+
+        out_points.push_back( osg::Vec3d(x, y, 0.0) );
+        ++count;
+    }
+    return count;
+}
+
+// Fetches a run of tiles and samples their points.
+struct ElevationPool::SampleTilesJob
+{
+    ElevationPool*                 _pool;
+    const Map*                     _map;
+    unsigned                       _lod;
+    const std::vector<osg::Vec3d>* _points;
+    const std::vector<TileBin>*    _bins;
+    unsigned                       _firstBin, _lastBin;
+    std::vector<float>*            _output;
+    ProgressCallback*              _progressCallback;
+    unsigned                       _count;
+
+    void execute()
+    {
+        _count = 0u;
+        MapFrame frame( _map );
+
+        for(unsigned b=_firstBin; b<_lastBin; ++b)
+        {
+            if ( _progressCallback && _progressCallback->isCanceled() )
+                return;
+
+            const TileBin& bin = (*_bins)[b];
+            TileKey key( _lod, bin._tx, bin._ty, _map->getProfile() );
+
+            osg::ref_ptr<Tile> tile;
+            if ( !_pool->getTile(key, frame, tile) || !tile.valid() )
+                continue;
+
+            for(std::vector<unsigned>::const_iterator i = bin._indices.begin(); i != bin._indices.end(); ++i)
+            {
+                const osg::Vec3d& p = (*_points)[*i];
+
+                float elevation;
+                if ( tile->_hf.getElevation(0L, p.x(), p.y(), INTERP_BILINEAR, 0L, elevation) )
+                {
+                    (*_output)[*i] = elevation;
+                    if ( elevation != NO_DATA_VALUE )
+                        ++_count;
+                }
+            }
+        }
+    }
+};
+
+void
+ElevationPool::setNumBulkThreads(unsigned value)
+{
+    Threading::ScopedMutexLock lock(_bulkServiceMutex);
+    _numBulkThreads = osg::maximum(value, 1u);
+    _bulkService = 0L;
+}
+
+unsigned
+ElevationPool::getElevations(const std::vector<osg::Vec3d>& points,
+                             const SpatialReference*        pointsSRS,
+                             unsigned                       lod,
+                             std::vector<float>&            out_elevations,
+                             ProgressCallback*              progress)
+{
+    METRIC_SCOPED_EX("ElevationPool::getElevations", 1, "num", toString(points.size()).c_str());
+
+    out_elevations.assign( points.size(), NO_DATA_VALUE );
+
+    osg::ref_ptr<const osg::Referenced> mapRef;
+    if ( points.empty() || !_map.lock(mapRef) )
+        return 0u;
+
+    const Map* map = static_cast<const Map*>(mapRef.get());
+    const Profile* profile = map->getProfile();
+    if ( !profile )
+        return 0u;
+
+    // bring the points into the profile's SRS:
+    std::vector<osg::Vec3d> local( points );
+    if ( pointsSRS && !pointsSRS->isHorizEquivalentTo(profile->getSRS()) )
+    {
+        if ( !pointsSRS->transform(local, profile->getSRS()) )
+        {
+            // do them one by one, so only the bad ones fail.
+            for(unsigned i=0; i<points.size(); ++i)
+            {
+                if ( !pointsSRS->transform(points[i], profile->getSRS(), local[i]) )
+                    local[i].set( DBL_MAX, DBL_MAX, 0.0 );
+            }
+        }
+    }
+
+    std::vector<TileBin> bins;
+    binPoints( local, profile, lod, bins );
+    if ( bins.empty() )
+        return 0u;
+
+    // split the bins into jobs of neighboring tiles; use more jobs than
+    // threads so that a few slow tiles don't hold everyone up.
+    osg::ref_ptr<TaskService> service;
+    unsigned numThreads;
+    {
+        Threading::ScopedMutexLock lock(_bulkServiceMutex);
+        numThreads = _numBulkThreads;
+        if ( numThreads > 1u && !_bulkService.valid() )
+            _bulkService = new TaskService( "ElevationPool", (int)numThreads );
+        service = _bulkService.get();
+    }
+
+    unsigned numJobs = osg::minimum( (unsigned)bins.size(), numThreads > 1u ? numThreads*4u : 1u );
+    unsigned binsPerJob = ((unsigned)bins.size() + numJobs - 1u) / numJobs;
+    numJobs = ((unsigned)bins.size() + binsPerJob - 1u) / binsPerJob;
+
+    std::vector< osg::ref_ptr< ParallelTask<SampleTilesJob> > > jobs;
+    Threading::MultiEvent semaphore( (int)numJobs );
+
+    for(unsigned j=0; j<numJobs; ++j)
+    {
+        ParallelTask<SampleTilesJob>* job = new ParallelTask<SampleTilesJob>( &semaphore );
+        job->_pool     = this;
+        job->_map      = map;
+        job->_lod      = lod;
+        job->_points   = &local;
+        job->_bins     = &bins;
+        job->_firstBin = j*binsPerJob;
+        job->_lastBin  = osg::minimum( (j+1)*binsPerJob, (unsigned)bins.size() );
+        job->_output   = &out_elevations;
+        job->_progressCallback = progress;
+        job->_count    = 0u;
+        jobs.push_back( job );
+    }
+
+    if ( numJobs > 1u && service.valid() )
+    {
+        for(unsigned j=0; j<jobs.size(); ++j)
+            service->add( jobs[j].get() );
+        semaphore.wait();
+    }
+    else
+    {
+        for(unsigned j=0; j<jobs.size(); ++j)
+            jobs[j]->execute();
+    }
+
+    unsigned count = 0u;
+    for(unsigned j=0; j<jobs.size(); ++j)
+        count += jobs[j]->_count;
+
+    return count;
+}
+
 bool
 ElevationPool::fetchTileFromMap(const TileKey& key, MapFrame& frame, Tile* tile)
 {
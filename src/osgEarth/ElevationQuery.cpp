@@ -97,6 +97,37 @@ ElevationQuery::gatherPatchLayers()
 }
 
 
+unsigned
+ElevationQuery::getLOD(double desiredResolution) const
+{
+    // tile size (resolution of elevation tiles)
+    unsigned tileSize = 257; // yes?
+
+    // default LOD:
+    unsigned lod = 23u;
+
+    // attempt to map the requested resolution to an LOD:
+    if (desiredResolution > 0.0)
+    {
+        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
+        if ( level > 0 )
+            lod = level;
+    }
+
+    return lod;
+}
+
+bool
+ElevationQuery::canQueryInBulk() const
+{
+    // terrain patches need an intersection test per point, and with no
+    // elevation layers the per-point path reports NO_DATA_VALUE as success.
+    return
+        _patchLayers.empty() &&
+        !_mapf.elevationLayers().empty() &&
+        _mapf.getElevationPool() != 0L;
+}
+
 float
 ElevationQuery::getElevation(const GeoPoint& point,
                              double          desiredResolution,
@@ -125,6 +156,19 @@ ElevationQuery::getElevations(std::vector<osg::Vec3d>& points,
                               double                   desiredResolution )
 {
     sync();
+
+    if ( canQueryInBulk() )
+    {
+        std::vector<float> elevations;
+        _mapf.getElevationPool()->getElevations( points, pointsSRS, getLOD(desiredResolution), elevations );
+        for(unsigned i=0; i<points.size(); ++i)
+        {
+            if ( elevations[i] != NO_DATA_VALUE )
+                points[i].z() = ignoreZ ? elevations[i] : elevations[i] + points[i].z();
+        }
+        return true;
+    }
+
     for( osg::Vec3dArray::iterator i = points.begin(); i != points.end(); ++i )
     {
         float elevation;
@@ -145,6 +189,18 @@ ElevationQuery::getElevations(const std::vector<osg::Vec3d>& points,
                               double                         desiredResolution )
 {
     sync();
+
+    if ( canQueryInBulk() )
+    {
+        std::vector<float> elevations;
+        _mapf.getElevationPool()->getElevations( points, pointsSRS, getLOD(desiredResolution), elevations );
+        for(unsigned i=0; i<elevations.size(); ++i)
+        {
+            out_elevations.push_back( elevations[i] != NO_DATA_VALUE ? elevations[i] : 0.0f );
+        }
+        return true;
+    }
+
     for( osg::Vec3dArray::const_iterator i = points.begin(); i != points.end(); ++i )
     {
         float elevation;
@@ -251,19 +307,7 @@ ElevationQuery::getElevationImpl(const GeoPoint& point,
         return true;
     }
 
-    // tile size (resolution of elevation tiles)
-    unsigned tileSize = 257; // yes?
-
-    // default LOD:
-    unsigned lod = 23u;
-
-    // attempt to map the requested resolution to an LOD:
-    if (desiredResolution > 0.0)
-    {
-        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
-        if ( level > 0 )
-            lod = level;
-    }
+    unsigned lod = getLOD(desiredResolution);
 
     // do we need a new ElevationEnvelope?
     if (!_envelope.valid() ||
@@ -25,6 +25,7 @@
 #include <osgEarth/Cube>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Terrain>
+#include <osgEarth/StringUtils>
 
 #include <osg/Notify>
 #include <osg/Timer>
@@ -1818,6 +1819,291 @@ namespace
     }    
 
 
+    // Spacing (in destination pixels) of the exactly-transformed control grid
+    // used by the approximate reprojection transform.
+    const unsigned REPROJECT_GRID_STEP = 16u;
+
+    // Maximum error, in source pixels, tolerated when interpolating source
+    // coordinates between control points. Set OSGEARTH_REPROJECT_MAX_ERROR
+    // to override; a value of zero transforms every pixel exactly.
+    double getReprojectMaxError()
+    {
+        static double s_maxError = -1.0;
+        if ( s_maxError < 0.0 )
+        {
+            double value = 0.125;
+            const char* env = ::getenv("OSGEARTH_REPROJECT_MAX_ERROR");
+            if ( env )
+                value = osg::maximum(as<double>(env, value), 0.0);
+            s_maxError = value;
+        }
+        return s_maxError;
+    }
+
+    // Builds the list of control indices (every "step" samples, always
+    // including the last one) along one axis of the sample grid.
+    void buildControlIndices(unsigned num, unsigned step, std::vector<unsigned>& out)
+    {
+        out.clear();
+        for(unsigned i=0; i<num-1; i += step)
+            out.push_back(i);
+        out.push_back(num-1);
+    }
+
+    /**
+     * Same contract as SpatialReference::transformExtentPoints (the output
+     * arrays are laid out column-major, index = c*numy + r), but only a sparse
+     * control grid is transformed exactly. Each control cell is checked by
+     * exactly transforming its center and edge midpoints; if bilinear
+     * interpolation of the cell's corners reproduces them to within
+     * maxErrorX/maxErrorY (in output SRS units), the whole cell is
+     * interpolated. Otherwise every sample in the cell is transformed
+     * exactly. This is the same idea as GDAL's approximate transformer.
+     */
+    bool transformExtentPointsApprox(
+        const SpatialReference* fromSRS,
+        const SpatialReference* toSRS,
+        double xmin, double ymin, double xmax, double ymax,
+        double* x, double* y,
+        unsigned numx, unsigned numy,
+        double maxErrorX, double maxErrorY)
+    {
+        if ( numx < 2 || numy < 2 || maxErrorX <= 0.0 || maxErrorY <= 0.0 ||
+             !fromSRS->isContiguous() || !toSRS->isContiguous() ||
+             (numx <= REPROJECT_GRID_STEP && numy <= REPROJECT_GRID_STEP) )
+        {
+            return fromSRS->transformExtentPoints(toSRS, xmin, ymin, xmax, ymax, x, y, numx, numy);
+        }
+
+        const double dx = (xmax - xmin) / (numx - 1);
+        const double dy = (ymax - ymin) / (numy - 1);
+
+        std::vector<unsigned> cols, rows;
+        buildControlIndices(numx, REPROJECT_GRID_STEP, cols);
+        buildControlIndices(numy, REPROJECT_GRID_STEP, rows);
+        const unsigned numCols = cols.size();
+        const unsigned numRows = rows.size();
+        const unsigned numCells = (numCols-1) * (numRows-1);
+
+        // Exactly transform the control points.
+        std::vector<osg::Vec3d> control;
+        control.reserve(numCols * numRows);
+        for(unsigned i=0; i<numCols; ++i)
+            for(unsigned j=0; j<numRows; ++j)
+                control.push_back(osg::Vec3d(xmin + dx*cols[i], ymin + dy*rows[j], 0.0));
+
+        // Exactly transform the test points: center, left, right, bottom and
+        // top edge midpoints of each cell, in that order.
+        std::vector<osg::Vec3d> tests;
+        tests.reserve(numCells * 5);
+        for(unsigned i=0; i<numCols-1; ++i)
+        {
+            const double c0 = xmin + dx*cols[i], c1 = xmin + dx*cols[i+1], cm = 0.5*(c0+c1);
+            for(unsigned j=0; j<numRows-1; ++j)
+            {
+                const double r0 = ymin + dy*rows[j], r1 = ymin + dy*rows[j+1], rm = 0.5*(r0+r1);
+                tests.push_back(osg::Vec3d(cm, rm, 0.0));
+                tests.push_back(osg::Vec3d(c0, rm, 0.0));
+                tests.push_back(osg::Vec3d(c1, rm, 0.0));
+                tests.push_back(osg::Vec3d(cm, r0, 0.0));
+                tests.push_back(osg::Vec3d(cm, r1, 0.0));
+            }
+        }
+
+        if ( !fromSRS->transform(control, toSRS) || !fromSRS->transform(tests, toSRS) )
+        {
+            return fromSRS->transformExtentPoints(toSRS, xmin, ymin, xmax, ymax, x, y, numx, numy);
+        }
+
+        // Interpolate the cells that pass the error test, and collect the
+        // samples of the ones that don't.
+        static const double u[5] = { 0.5, 0.0, 1.0, 0.5, 0.5 };
+        static const double v[5] = { 0.5, 0.5, 0.5, 0.0, 1.0 };
+
+        std::vector<unsigned>   exactIndices;
+        std::vector<osg::Vec3d> exactPoints;
+
+        unsigned cell = 0;
+        for(unsigned i=0; i<numCols-1; ++i)
+        {
+            const unsigned cBegin = cols[i], cEnd = cols[i+1];
+            for(unsigned j=0; j<numRows-1; ++j, ++cell)
+            {
+                const unsigned rBegin = rows[j], rEnd = rows[j+1];
+
+                const osg::Vec3d& ll = control[i*numRows + j];
+                const osg::Vec3d& ul = control[i*numRows + j+1];
+                const osg::Vec3d& lr = control[(i+1)*numRows + j];
+                const osg::Vec3d& ur = control[(i+1)*numRows + j+1];
+
+                bool ok = true;
+                for(unsigned k=0; k<5 && ok; ++k)
+                {
+                    osg::Vec3d est =
+                        ll*((1.0-u[k])*(1.0-v[k])) + lr*(u[k]*(1.0-v[k])) +
+                        ul*((1.0-u[k])*v[k])       + ur*(u[k]*v[k]);
+                    const osg::Vec3d& exact = tests[cell*5 + k];
+                    ok =
+                        fabs(est.x()-exact.x()) <= maxErrorX &&
+                        fabs(est.y()-exact.y()) <= maxErrorY;
+                }
+
+                if ( ok )
+                {
+                    const double cSpan = (double)(cEnd - cBegin);
+                    const double rSpan = (double)(rEnd - rBegin);
+                    for(unsigned c=cBegin; c<=cEnd; ++c)
+                    {
+                        const double s = (double)(c - cBegin) / cSpan;
+                        const osg::Vec3d bottom = ll + (lr-ll)*s;
+                        const osg::Vec3d top    = ul + (ur-ul)*s;
+                        for(unsigned r=rBegin; r<=rEnd; ++r)
+                        {
+                            const double t = (double)(r - rBegin) / rSpan;
+                            const unsigned index = c*numy + r;
+                            x[index] = bottom.x() + (top.x()-bottom.x())*t;
+                            y[index] = bottom.y() + (top.y()-bottom.y())*t;
+                        }
+                    }
+                }
+                else
+                {
+                    for(unsigned c=cBegin; c<=cEnd; ++c)
+                    {
+                        for(unsigned r=rBegin; r<=rEnd; ++r)
+                        {
+                            exactIndices.push_back(c*numy + r);
+                            exactPoints.push_back(osg::Vec3d(xmin + dx*c, ymin + dy*r, 0.0));
+                        }
+                    }
+                }
+            }
+        }
+
+        // Exact samples go last so they win on edges shared with interpolated cells.
+        if ( !exactPoints.empty() )
+        {
+            if ( !fromSRS->transform(exactPoints, toSRS) )
+            {
+                return fromSRS->transformExtentPoints(toSRS, xmin, ymin, xmax, ymax, x, y, numx, numy);
+            }
+
+            for(unsigned i=0; i<exactPoints.size(); ++i)
+            {
+                x[exactIndices[i]] = exactPoints[i].x();
+                y[exactIndices[i]] = exactPoints[i].y();
+            }
+        }
+
+        return true;
+    }
+
+    template<typename T> inline T toChannel(float value) { return (T)value; }
+    template<> inline GLubyte toChannel<GLubyte>(float value) { return (GLubyte)osg::clampBetween(value + 0.5f, 0.0f, 255.0f); }
+
+    /**
+     * Resampling kernel for images whose channels are all of type T and
+     * independent of each other (RGBA, RGB, luminance...). Works on the raw
+     * channel values, with the same sampling rules as the generic
+     * PixelReader/PixelWriter path in manualReproject.
+     */
+    template<typename T>
+    void resampleDirect(
+        const osg::Image* image,
+        osg::Image*       result,
+        unsigned          numComponents,
+        const GeoExtent&  src_extent,
+        const double*     srcPointsX,
+        const double*     srcPointsY,
+        unsigned          width,
+        unsigned          height,
+        bool              interpolate)
+    {
+        const int s = image->s();
+        const int t = image->t();
+        const double xfac = (s - 1) / src_extent.width();
+        const double yfac = (t - 1) / src_extent.height();
+
+        unsigned pixel = 0;
+        for (unsigned int c = 0; c < width; ++c)
+        {
+            for (unsigned int r = 0; r < height; ++r, ++pixel)
+            {
+                double src_x = srcPointsX[pixel];
+                double src_y = srcPointsY[pixel];
+
+                if ( src_x < src_extent.xMin() || src_x > src_extent.xMax() || src_y < src_extent.yMin() || src_y > src_extent.yMax() )
+                    continue;
+
+                float px = (src_x - src_extent.xMin()) * xfac;
+                float py = (src_y - src_extent.yMin()) * yfac;
+
+                T* out = (T*)result->data(c, r);
+
+                if ( !interpolate )
+                {
+                    int px_i = osg::clampBetween( (int)osg::round(px), 0, s-1 );
+                    int py_i = osg::clampBetween( (int)osg::round(py), 0, t-1 );
+                    const T* in = (const T*)image->data(px_i, py_i);
+                    for(unsigned i=0; i<numComponents; ++i)
+                        out[i] = in[i];
+                }
+                else
+                {
+                    int rowMin = osg::maximum((int)floor(py), 0);
+                    int rowMax = osg::maximum(osg::minimum((int)ceil(py), t-1), 0);
+                    int colMin = osg::maximum((int)floor(px), 0);
+                    int colMax = osg::maximum(osg::minimum((int)ceil(px), s-1), 0);
+
+                    if (rowMin > rowMax) rowMin = rowMax;
+                    if (colMin > colMax) colMin = colMax;
+
+                    const float fx = colMax > colMin ? px - (float)colMin : 0.0f;
+                    const float fy = rowMax > rowMin ? py - (float)rowMin : 0.0f;
+
+                    const T* ll = (const T*)image->data(colMin, rowMin);
+                    const T* lr = (const T*)image->data(colMax, rowMin);
+                    const T* ul = (const T*)image->data(colMin, rowMax);
+                    const T* ur = (const T*)image->data(colMax, rowMax);
+
+                    for(unsigned i=0; i<numComponents; ++i)
+                    {
+                        float r1 = (float)ll[i] + ((float)lr[i] - (float)ll[i]) * fx;
+                        float r2 = (float)ul[i] + ((float)ur[i] - (float)ul[i]) * fx;
+                        out[i] = toChannel<T>(r1 + (r2 - r1) * fy);
+                    }
+                }
+            }
+        }
+    }
+
+    // Returns the number of channels if the image can use resampleDirect
+    // with its data type, or zero to use the generic path.
+    unsigned getDirectResampleComponents(const osg::Image* image)
+    {
+        if ( image->getDataType() != GL_UNSIGNED_BYTE && image->getDataType() != GL_FLOAT )
+            return 0u;
+
+        switch( image->getPixelFormat() )
+        {
+        case GL_RGBA:
+        case GL_BGRA:
+            return 4u;
+        case GL_RGB:
+        case GL_BGR:
+            return 3u;
+        case GL_LUMINANCE_ALPHA:
+            return 2u;
+        case GL_LUMINANCE:
+        case GL_RED:
+        case GL_ALPHA:
+            return 1u;
+        default:
+            return 0u;
+        }
+    }
+
+
     osg::Image* manualReproject(
         const osg::Image* image, 
         const GeoExtent&  src_extent, 
@@ -1862,11 +2148,30 @@ namespace
         // the sample grid into the source coordinate system.
         double *srcPointsX = new double[numPixels * 2];
         double *srcPointsY = srcPointsX + numPixels;
-        dest_extent.getSRS()->transformExtentPoints(
+        // Only a sparse grid is transformed exactly; the rest is interpolated
+        // to within a fraction of a source pixel.
+        const double maxError = getReprojectMaxError();
+        transformExtentPointsApprox(
+            dest_extent.getSRS(),
             src_extent.getSRS(),
             dest_extent.xMin() + .5 * dx, dest_extent.yMin() + .5 * dy,
             dest_extent.xMax() - .5 * dx, dest_extent.yMax() - .5 * dy,
-            srcPointsX, srcPointsY, width, height);
+            srcPointsX, srcPointsY, width, height,
+            maxError * src_extent.width() / (double)image->s(),
+            maxError * src_extent.height() / (double)image->t());
+
+        // Common formats are resampled directly on their channel values.
+        const unsigned directComponents = getDirectResampleComponents(image);
+        if ( directComponents > 0u )
+        {
+            if ( image->getDataType() == GL_UNSIGNED_BYTE )
+                resampleDirect<GLubyte>(image, result, directComponents, src_extent, srcPointsX, srcPointsY, width, height, interpolate);
+            else
+                resampleDirect<GLfloat>(image, result, directComponents, src_extent, srcPointsX, srcPointsY, width, height, interpolate);
+
+            delete[] srcPointsX;
+            return result;
+        }
 
         // Next, go through the source-SRS sample grid, read the color at each point from the source image,
         // and write it to the corresponding pixel in the destination image.
@@ -47,9 +47,25 @@ osg::MatrixTransform(rhs, op)
     _dirtyClamp = rhs._dirtyClamp;
 }
 
+GeoTransform::~GeoTransform()
+{
+    osg::ref_ptr<Terrain> terrain;
+    if (_terrainCallbackInstalled && _terrain.lock(terrain))
+    {
+        terrain->removeTerrainCallback(_terrainCallback.get());
+    }
+}
+
 void
 GeoTransform::setTerrain(Terrain* terrain)
 {
+    osg::ref_ptr<Terrain> oldTerrain;
+    if (_terrainCallbackInstalled && _terrain.lock(oldTerrain) && oldTerrain.get() != terrain)
+    {
+        oldTerrain->removeTerrainCallback(_terrainCallback.get());
+        _terrainCallbackInstalled = false;
+    }
+
     _terrain = terrain;
     setPosition(_position);
 }
@@ -120,14 +136,26 @@ GeoTransform::setPosition(const GeoPoint& position)
 
     // Is this is a relative-Z position, we need to install a terrain callback
     // so we can recompute the altitude when new terrain tiles become available.
+    // The callback is indexed at our location so that the terrain only calls it
+    // for tiles that can change our height; re-index it when we move.
     if (_position.altitudeMode() == ALTMODE_RELATIVE &&
         _autoRecomputeHeights &&
-        !_terrainCallbackInstalled &&
         terrain.valid())
     {
-        // The Adapter template auto-destructs, so we never need to remote it manually.
-        terrain->addTerrainCallback( new TerrainCallbackAdapter<GeoTransform>(this) );
-        _terrainCallbackInstalled = true;
+        osg::Vec2d location(p.x(), p.y());
+
+        if (!_terrainCallbackInstalled || location != _terrainCallbackLocation)
+        {
+            if (!_terrainCallback.valid())
+                _terrainCallback = new TerrainCallbackAdapter<GeoTransform>(this);
+
+            terrain->addTerrainCallback(
+                _terrainCallback.get(),
+                GeoExtent(p.getSRS(), p.x(), p.y(), p.x(), p.y()) );
+
+            _terrainCallbackLocation = location;
+            _terrainCallbackInstalled = true;
+        }
     }
 
     // Finally, assemble the matrix from our position point.
@@ -104,37 +104,99 @@ GeometryClamper::apply(osg::Drawable& drawable)
         }
     }
 
+    // First pass: find each vertex's location in the terrain SRS, and decide
+    // which vertices to clamp.
+    std::vector<osg::Vec3d> world( verts->size() );
+    std::vector<osg::Vec3d> mapPoints;
+    std::vector<unsigned>   indices;
+    mapPoints.reserve( verts->size() );
+    indices.reserve( verts->size() );
+
+    bool limitToExtent = _clampExtent.isValid();
+
     for( unsigned k=0; k<verts->size(); ++k )
     {
-        osg::Vec3d vw = (*verts)[k];
-        vw = vw * local2world;
+        osg::Vec3d& vw = world[k];
+        vw = (*verts)[k] * local2world;
 
+        osg::Vec3d mapPoint;
         if ( isGeocentric )
         {
-            // normal to the ellipsoid:
-            n_vector = em->computeLocalUpVector(vw.x(),vw.y(),vw.z());
+            double lat, lon, hae;
+            em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, hae);
+            mapPoint.set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), hae );
+        }
+        else
+        {
+            mapPoint = vw;
+        }
+
+        if ( buildZOffsets )
+        {
+            zOffsets->push_back( float(mapPoint.z()) );
+        }
+
+        if ( !limitToExtent || _clampExtent.contains(mapPoint.x(), mapPoint.y()) )
+        {
+            mapPoints.push_back( mapPoint );
+            indices.push_back( k );
+        }
+    }
+
+    // Second pass: sample all the heights we can straight from the terrain tiles.
+    std::vector<float> heights;
+    if ( _sampler.valid() && !mapPoints.empty() )
+    {
+        _sampler->getHeights( mapPoints, heights );
+    }
+
+    // Third pass: move the vertices.
+    for( unsigned i=0; i<indices.size(); ++i )
+    {
+        unsigned k = indices[i];
+        const osg::Vec3d& vw = world[k];
+        const osg::Vec3d& mapPoint = mapPoints[i];
 
-            // if we need to build to z-offsets array, calculate the z offset now:
-            if ( buildZOffsets || _scale != 1.0 )
+        if ( i < heights.size() && heights[i] != NO_DATA_VALUE )
+        {
+            double h = heights[i];
+            if ( _scale != 1.0 )
+                h += h*_scale;
+            h += _offset;
+            if ( _preserveZ && (zOffsets != 0L) )
+                h += (*zOffsets)[k];
+
+            osg::Vec3d fw;
+            if ( isGeocentric )
+            {
+                em->convertLatLongHeightToXYZ(
+                    osg::DegreesToRadians(mapPoint.y()), osg::DegreesToRadians(mapPoint.x()), h,
+                    fw.x(), fw.y(), fw.z() );
+            }
+            else
             {
-                double lat,lon,hae;
-                em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, hae);
-
-                if ( buildZOffsets )
-                {
-                    zOffsets->push_back( hae ); //(*verts)[k].z() );
-                }
-
-                if ( _scale != 1.0 )
-                {
-                    msl = vw - n_vector*hae;
-                }
+                fw.set( mapPoint.x(), mapPoint.y(), h );
             }
+
+            (*verts)[k] = (fw * world2local);
+            geomDirty = true;
+            ++count;
+            continue;
         }
 
-        else if ( buildZOffsets ) // flat map
+        // No tile data for this vertex; intersect the terrain patch instead.
+        if ( !_terrainPatch.valid() )
+            continue;
+
+        if ( isGeocentric )
         {
-            zOffsets->push_back( float(vw.z()) );
+            // normal to the ellipsoid:
+            n_vector = em->computeLocalUpVector(vw.x(),vw.y(),vw.z());
+
+            if ( _scale != 1.0 )
+            {
+                msl = vw - n_vector*mapPoint.z();
+            }
         }
 
         _lsi->reset();
@@ -190,5 +252,10 @@ GeometryClamperCallback::onTileAdded(const TileKey&          key,
                                      osg::Node*              tile, 
                                      TerrainCallbackContext& context)
 {
+    if ( context.getTerrain() )
+        _clamper.setHeightSampler( context.getTerrain()->getHeightSampler() );
+
+    // only the part of the geometry under the new tile can have moved.
+    _clamper.setClampExtent( key.valid() ? key.getExtent() : GeoExtent::INVALID );
     tile->accept( _clamper );
 }
@@ -25,6 +25,7 @@
 #include <osgEarth/URI>
 #include <osgEarth/ElevationPool>
 #include <osgEarth/Utils>
+#include <osgEarth/TaskService>
 #include <iterator>
 
 using namespace osgEarth;
@@ -259,6 +260,61 @@ Map::endUpdate()
     }
 }
 
+void
+Map::prepareLayer(Layer* layer)
+{
+    // Pass along the Read Options (including the cache settings, etc.) to the layer:
+    layer->setReadOptions(_readOptions.get());
+
+    // If this is a terrain layer, tell it about the Map profile.
+    TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
+    if (terrainLayer && _profile.valid())
+    {
+        terrainLayer->setTargetProfileHint( _profile.get() );
+    }
+}
+
+void
+Map::layerOpened(Layer* layer)
+{
+    // If this is an elevation layer, install a callback so we know when
+    // it's visibility changes:
+    ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>(layer);
+    if (elevationLayer)
+    {
+        elevationLayer->addCallback(_elevationLayerCB.get());
+
+        // invalidate the elevation pool
+        getElevationPool()->clear();
+    }
+}
+
+void
+Map::pushLayer(Layer* layer)
+{
+    int newRevision;
+    unsigned index = -1;
+
+    // Add the layer to our stack.
+    {
+        Threading::ScopedWriteLock lock( _mapDataMutex );
+
+        _layers.push_back( layer );
+        index = _layers.size() - 1;
+        newRevision = ++_dataModelRevision;
+    }
+
+    // tell the layer it was just added.
+    layer->addedToMap(this);
+
+    // a separate block b/c we don't need the mutex
+    for( MapCallbackList::iterator i = _mapCallbacks.begin(); i != _mapCallbacks.end(); i++ )
+    {
+        i->get()->onMapModelChanged(MapModelChange(
+            MapModelChange::ADD_LAYER, newRevision, layer, index));
+    }
+}
+
 void
 Map::addLayer(Layer* layer)
 {
@@ -267,51 +323,80 @@ Map::addLayer(Layer* layer)
     {
         if (layer->getEnabled())
         {
-            // Pass along the Read Options (including the cache settings, etc.) to the layer:
-            layer->setReadOptions(_readOptions.get());
-            
-            // If this is a terrain layer, tell it about the Map profile.
-            TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
-            if (terrainLayer && _profile.valid())
-            {
-                terrainLayer->setTargetProfileHint( _profile.get() );
-            }            
+            prepareLayer(layer);
 
             // Attempt to open the layer. Don't check the status here.
             layer->open();
 
-            // If this is an elevation layer, install a callback so we know when
-            // it's visibility changes:
-            ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>(layer);
-            if (elevationLayer)
-            {
-                elevationLayer->addCallback(_elevationLayerCB.get());
+            layerOpened(layer);
+        }
 
-                // invalidate the elevation pool
-                getElevationPool()->clear();
-            }
+        pushLayer(layer);
+    }
+}
+
+namespace
+{
+    struct OpenLayerJob
+    {
+        osg::ref_ptr<Layer> _layer;
+
+        void execute()
+        {
+            // Attempt to open the layer. Don't check the status here.
+            _layer->open();
         }
+    };
+}
 
-        int newRevision;
-        unsigned index = -1;
+void
+Map::addLayers(const LayerVector& layers)
+{
+    osgEarth::Registry::instance()->clearBlacklist();
 
-        // Add the layer to our stack.
+    LayerVector toOpen;
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        if (i->valid() && i->get()->getEnabled())
         {
-            Threading::ScopedWriteLock lock( _mapDataMutex );
+            prepareLayer(i->get());
+            toOpen.push_back(i->get());
+        }
+    }
 
-            _layers.push_back( layer );
-            index = _layers.size() - 1;
-            newRevision = ++_dataModelRevision;
+    if (toOpen.size() > 1)
+    {
+        // Opening a layer is mostly spent waiting on I/O (probing a driver,
+        // indexing a dataset, reading a remote capabilities document), so
+        // use more threads than there are cores.
+        int numThreads = std::min((int)toOpen.size(), 2 * std::max(OpenThreads::GetNumberOfProcessors(), 2));
+
+        osg::ref_ptr<TaskService> service = new TaskService("Map.addLayers", numThreads);
+        Threading::MultiEvent semaphore( (int)toOpen.size() );
+        for (LayerVector::iterator i = toOpen.begin(); i != toOpen.end(); ++i)
+        {
+            ParallelTask<OpenLayerJob>* job = new ParallelTask<OpenLayerJob>( &semaphore );
+            job->_layer = i->get();
+            service->add( job );
         }
+        semaphore.wait();
+    }
+    else if (toOpen.size() == 1)
+    {
+        toOpen.front()->open();
+    }
 
-        // tell the layer it was just added.
-        layer->addedToMap(this);
+    for (LayerVector::iterator i = toOpen.begin(); i != toOpen.end(); ++i)
+    {
+        layerOpened(i->get());
+    }
 
-        // a separate block b/c we don't need the mutex
-        for( MapCallbackList::iterator i = _mapCallbacks.begin(); i != _mapCallbacks.end(); i++ )
+    // Add them in order, once all are open.
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        if (i->valid())
         {
-            i->get()->onMapModelChanged(MapModelChange(
-                MapModelChange::ADD_LAYER, newRevision, layer, index));
+            pushLayer(i->get());
         }
     }
 }
@@ -324,29 +409,12 @@ Map::insertLayer(Layer* layer, unsigned index)
     {
         if (layer->getEnabled())
         {
-            // Pass along the Read Options (including the cache settings, etc.) to the layer:
-            layer->setReadOptions(_readOptions.get());
-            
-            // If this is a terrain layer, tell it about the Map profile.
-            TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
-            if (terrainLayer && _profile.valid())
-            {
-                terrainLayer->setTargetProfileHint( _profile.get() );
-            }            
+            prepareLayer(layer);
 
             // Attempt to open the layer. Don't check the status here.
             layer->open();
 
-            // If this is an elevation layer, install a callback so we know when
-            // it's visibility changes:
-            ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>(layer);
-            if (elevationLayer)
-            {
-                elevationLayer->addCallback(_elevationLayerCB.get());
-
-                // invalidate the elevation pool
-                getElevationPool()->clear();
-            }
+            layerOpened(layer);
         }
 
         int newRevision;
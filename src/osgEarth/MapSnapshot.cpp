@@ -0,0 +1,270 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/MapSnapshot>
+#include <osgEarth/Map>
+#include <osgEarth/Notify>
+#include <fstream>
+
+using namespace osgEarth;
+
+#define LC "[MapSnapshot] "
+
+#define SNAPSHOT_MAGIC   "osgEarth.MapSnapshot"
+#define SNAPSHOT_VERSION 1u
+
+namespace
+{
+    // Limits that keep a damaged file from triggering huge allocations.
+    const unsigned MAX_STRING_LENGTH = 1u << 26;
+    const unsigned MAX_CHILDREN      = 1u << 20;
+    const unsigned MAX_DEPTH         = 256u;
+
+    enum
+    {
+        FLAG_IS_LOCATION  = 1u << 0,
+        FLAG_REFERRER     = 1u << 1,
+        FLAG_EXTERNAL_REF = 1u << 2
+    };
+
+    // integers are stored little-endian so snapshots are portable.
+    void writeUInt(std::ostream& out, unsigned value)
+    {
+        char b[4];
+        b[0] = (char)(value & 0xff);
+        b[1] = (char)((value >> 8) & 0xff);
+        b[2] = (char)((value >> 16) & 0xff);
+        b[3] = (char)((value >> 24) & 0xff);
+        out.write(b, 4);
+    }
+
+    bool readUInt(std::istream& in, unsigned& value)
+    {
+        unsigned char b[4];
+        if (!in.read((char*)b, 4))
+            return false;
+        value = (unsigned)b[0] | ((unsigned)b[1] << 8) | ((unsigned)b[2] << 16) | ((unsigned)b[3] << 24);
+        return true;
+    }
+
+    void writeString(std::ostream& out, const std::string& value)
+    {
+        writeUInt(out, value.size());
+        out.write(value.data(), value.size());
+    }
+
+    bool readString(std::istream& in, std::string& value)
+    {
+        unsigned len;
+        if (!readUInt(in, len) || len > MAX_STRING_LENGTH)
+            return false;
+        value.resize(len);
+        return len == 0 || in.read(&value[0], len);
+    }
+
+    // A Config's referrer is only stored when it differs from its parent's,
+    // which in practice means once per file (the earth file and each include).
+    void writeConfig(std::ostream& out, const Config& conf, const std::string& parentReferrer)
+    {
+        unsigned flags = 0u;
+        if (conf.isLocation())
+            flags |= FLAG_IS_LOCATION;
+        if (conf.referrer() != parentReferrer)
+            flags |= FLAG_REFERRER;
+        if (!conf.externalRef().empty())
+            flags |= FLAG_EXTERNAL_REF;
+
+        writeUInt(out, flags);
+        writeString(out, conf.key());
+        writeString(out, conf.value());
+        if (flags & FLAG_REFERRER)
+            writeString(out, conf.referrer());
+        if (flags & FLAG_EXTERNAL_REF)
+            writeString(out, conf.externalRef());
+
+        writeUInt(out, conf.children().size());
+        for (ConfigSet::const_iterator i = conf.children().begin(); i != conf.children().end(); ++i)
+        {
+            writeConfig(out, *i, conf.referrer());
+        }
+    }
+
+    bool readConfig(std::istream& in, Config& conf, const std::string& parentReferrer, unsigned depth)
+    {
+        unsigned flags, numChildren;
+        std::string referrer(parentReferrer), externalRef;
+
+        if (depth > MAX_DEPTH ||
+            !readUInt(in, flags) ||
+            !readString(in, conf.key()) ||
+            !readString(in, conf.value()))
+        {
+            return false;
+        }
+
+        if ((flags & FLAG_REFERRER) && !readString(in, referrer))
+            return false;
+
+        if ((flags & FLAG_EXTERNAL_REF) && !readString(in, externalRef))
+            return false;
+
+        if (!readUInt(in, numChildren) || numChildren > MAX_CHILDREN)
+            return false;
+
+        // set the referrer before adding children, so it is not propagated to them.
+        conf.setReferrer(referrer);
+        conf.setIsLocation((flags & FLAG_IS_LOCATION) != 0u);
+        conf.setExternalRef(externalRef);
+
+        for (unsigned i = 0; i < numChildren; ++i)
+        {
+            conf.children().push_back(Config());
+            if (!readConfig(in, conf.children().back(), referrer, depth + 1))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+//------------------------------------------------------------------------
+
+MapSnapshot::MapSnapshot()
+{
+    //nop
+}
+
+MapSnapshot::MapSnapshot(const Config& mapConf, const Map* map) :
+_mapConf( mapConf )
+{
+    if (map)
+    {
+        LayerVector layers;
+        map->getLayers(layers);
+
+        for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+        {
+            Config layerConf("layer");
+
+            const TerrainLayer* terrainLayer = dynamic_cast<const TerrainLayer*>(i->get());
+            if (terrainLayer && terrainLayer->getStatus().isOK())
+            {
+                osg::ref_ptr<TerrainLayer::CacheBinMetadata> meta = terrainLayer->createSourceMetadata();
+                if (meta.valid())
+                {
+                    layerConf.add("metadata", meta->getConfig());
+                }
+            }
+
+            _layers.push_back(layerConf);
+        }
+    }
+}
+
+bool
+MapSnapshot::apply(Layer* layer, unsigned index) const
+{
+    TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
+    if (!terrainLayer || index >= _layers.size())
+        return false;
+
+    const Config* metaConf = _layers[index].child_ptr("metadata");
+    if (!metaConf)
+        return false;
+
+    osg::ref_ptr<TerrainLayer::CacheBinMetadata> meta = new TerrainLayer::CacheBinMetadata(*metaConf);
+
+    // make sure it describes the same layer.
+    std::string driver;
+    if (terrainLayer->options().driver().isSet())
+        driver = terrainLayer->options().driver()->getDriver();
+
+    if (meta->_sourceName.getOrUse(std::string()) != terrainLayer->getName() ||
+        meta->_sourceDriver.getOrUse(std::string()) != driver ||
+        !meta->_sourceProfile.isSet())
+    {
+        OE_INFO << LC << "Snapshot does not match layer \"" << terrainLayer->getName() << "\"; ignoring\n";
+        return false;
+    }
+
+    terrainLayer->setSourceMetadata(meta.get());
+    return true;
+}
+
+bool
+MapSnapshot::write(const std::string& filename) const
+{
+    Config layersConf("layers");
+    for (std::vector<Config>::const_iterator i = _layers.begin(); i != _layers.end(); ++i)
+        layersConf.add(*i);
+
+    Config root("snapshot");
+    root.set("source_hash", _sourceHash);
+    root.add("map", _mapConf);
+    root.add(layersConf);
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        OE_WARN << LC << "Cannot write snapshot to " << filename << std::endl;
+        return false;
+    }
+
+    writeString(out, SNAPSHOT_MAGIC);
+    writeUInt(out, SNAPSHOT_VERSION);
+    writeConfig(out, root, std::string());
+    out.close();
+
+    return !out.fail();
+}
+
+MapSnapshot*
+MapSnapshot::read(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open())
+        return 0L;
+
+    std::string magic;
+    unsigned version;
+    if (!readString(in, magic) || magic != SNAPSHOT_MAGIC ||
+        !readUInt(in, version) || version != SNAPSHOT_VERSION)
+    {
+        OE_INFO << LC << filename << " is not a compatible snapshot\n";
+        return 0L;
+    }
+
+    Config root;
+    if (!readConfig(in, root, std::string(), 0u))
+    {
+        OE_WARN << LC << "Snapshot " << filename << " is damaged\n";
+        return 0L;
+    }
+
+    osg::ref_ptr<MapSnapshot> snapshot = new MapSnapshot();
+    snapshot->_sourceHash = root.value("source_hash");
+    snapshot->_mapConf = root.child("map");
+
+    const Config* layersConf = root.child_ptr("layers");
+    if (layersConf)
+    {
+        snapshot->_layers.assign(layersConf->children().begin(), layersConf->children().end());
+    }
+
+    return snapshot.release();
+}
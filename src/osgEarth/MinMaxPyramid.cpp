@@ -0,0 +1,301 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/MinMaxPyramid>
+#include <osgEarth/GeoCommon>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace osgEarth;
+
+#define MINMAX_COLS  "osgEarth.minmax.cols"
+#define MINMAX_ROWS  "osgEarth.minmax.rows"
+#define MINMAX_BLOCK "osgEarth.minmax.block"
+
+MinMaxPyramid::MinMaxPyramid() :
+_gridCols ( 0u ),
+_gridRows ( 0u ),
+_blockSize( 1u )
+{
+    //nop
+}
+
+MinMaxPyramid::MinMaxPyramid(const osg::HeightField* hf, unsigned blockSize) :
+_gridCols ( 0u ),
+_gridRows ( 0u ),
+_blockSize( 1u )
+{
+    if ( !hf || hf->getNumColumns() == 0 || hf->getNumRows() == 0 )
+        return;
+
+    allocate( hf->getNumColumns(), hf->getNumRows(), blockSize );
+
+    // finest level: each cell covers the posts [c*B, (c+1)*B] x [r*B, (r+1)*B]
+    Level& level0 = _levels[0];
+    for(unsigned r=0; r<level0._rows; ++r)
+    {
+        unsigned rowStart = r*_blockSize;
+        unsigned rowEnd   = std::min( rowStart+_blockSize, _gridRows-1 );
+
+        for(unsigned c=0; c<level0._cols; ++c)
+        {
+            unsigned colStart = c*_blockSize;
+            unsigned colEnd   = std::min( colStart+_blockSize, _gridCols-1 );
+
+            float cellMin = FLT_MAX, cellMax = -FLT_MAX;
+            for(unsigned row=rowStart; row<=rowEnd; ++row)
+            {
+                for(unsigned col=colStart; col<=colEnd; ++col)
+                {
+                    float h = hf->getHeight(col, row);
+                    if ( h != NO_DATA_VALUE )
+                    {
+                        if ( h < cellMin ) cellMin = h;
+                        if ( h > cellMax ) cellMax = h;
+                    }
+                }
+            }
+
+            level0._min[r*level0._cols + c] = cellMin;
+            level0._max[r*level0._cols + c] = cellMax;
+        }
+    }
+
+    // coarser levels: each cell combines (up to) 2x2 cells of the level below
+    for(unsigned i=1; i<_levels.size(); ++i)
+    {
+        const Level& below = _levels[i-1];
+        Level& level = _levels[i];
+
+        for(unsigned r=0; r<level._rows; ++r)
+        {
+            for(unsigned c=0; c<level._cols; ++c)
+            {
+                float cellMin = FLT_MAX, cellMax = -FLT_MAX;
+                for(unsigned row=2*r; row<std::min(2*r+2, below._rows); ++row)
+                {
+                    for(unsigned col=2*c; col<std::min(2*c+2, below._cols); ++col)
+                    {
+                        cellMin = std::min( cellMin, below._min[row*below._cols + col] );
+                        cellMax = std::max( cellMax, below._max[row*below._cols + col] );
+                    }
+                }
+                level._min[r*level._cols + c] = cellMin;
+                level._max[r*level._cols + c] = cellMax;
+            }
+        }
+    }
+}
+
+void
+MinMaxPyramid::allocate(unsigned gridCols, unsigned gridRows, unsigned blockSize)
+{
+    _gridCols  = gridCols;
+    _gridRows  = gridRows;
+    _blockSize = std::max( blockSize, 1u );
+
+    unsigned cols = std::max( (_gridCols-1 + _blockSize-1) / _blockSize, 1u );
+    unsigned rows = std::max( (_gridRows-1 + _blockSize-1) / _blockSize, 1u );
+
+    while( true )
+    {
+        _levels.push_back( Level() );
+        Level& level = _levels.back();
+        level._cols = cols;
+        level._rows = rows;
+        level._min.resize( cols*rows, FLT_MAX );
+        level._max.resize( cols*rows, -FLT_MAX );
+
+        if ( cols == 1 && rows == 1 )
+            break;
+
+        cols = (cols+1)/2;
+        rows = (rows+1)/2;
+    }
+}
+
+MinMaxPyramid*
+MinMaxPyramid::create(const osg::Image* image)
+{
+    if ( !image || image->getDataType() != GL_FLOAT || image->getPixelFormat() != GL_LUMINANCE_ALPHA )
+        return 0L;
+
+    unsigned gridCols, gridRows, blockSize;
+    if ( !image->getUserValue(MINMAX_COLS, gridCols)  ||
+         !image->getUserValue(MINMAX_ROWS, gridRows)  ||
+         !image->getUserValue(MINMAX_BLOCK, blockSize) ||
+         gridCols == 0 || gridRows == 0 )
+    {
+        return 0L;
+    }
+
+    osg::ref_ptr<MinMaxPyramid> pyramid = new MinMaxPyramid();
+    pyramid->allocate( gridCols, gridRows, blockSize );
+
+    // make sure the image matches the layout we expect:
+    unsigned height = 0u;
+    for(unsigned i=0; i<pyramid->_levels.size(); ++i)
+        height += pyramid->_levels[i]._rows;
+
+    if ( image->s() != (int)pyramid->_levels[0]._cols || image->t() != (int)height )
+        return 0L;
+
+    unsigned t = 0u;
+    for(unsigned i=0; i<pyramid->_levels.size(); ++i)
+    {
+        Level& level = pyramid->_levels[i];
+        for(unsigned r=0; r<level._rows; ++r, ++t)
+        {
+            const float* ptr = reinterpret_cast<const float*>(image->data(0, t));
+            for(unsigned c=0; c<level._cols; ++c)
+            {
+                level._min[r*level._cols + c] = *ptr++;
+                level._max[r*level._cols + c] = *ptr++;
+            }
+        }
+    }
+
+    return pyramid.release();
+}
+
+const MinMaxPyramid*
+MinMaxPyramid::get(const osg::Object* object)
+{
+    return object ? dynamic_cast<const MinMaxPyramid*>(object->getUserData()) : 0L;
+}
+
+MinMaxPyramid*
+MinMaxPyramid::get(osg::Object* object)
+{
+    return object ? dynamic_cast<MinMaxPyramid*>(object->getUserData()) : 0L;
+}
+
+bool
+MinMaxPyramid::valid() const
+{
+    return !_levels.empty() && _levels.back()._min[0] <= _levels.back()._max[0];
+}
+
+float
+MinMaxPyramid::getMinHeight() const
+{
+    return _levels.empty() ? FLT_MAX : _levels.back()._min[0];
+}
+
+float
+MinMaxPyramid::getMaxHeight() const
+{
+    return _levels.empty() ? -FLT_MAX : _levels.back()._max[0];
+}
+
+float
+MinMaxPyramid::getMin(unsigned level, unsigned col, unsigned row) const
+{
+    const Level& L = _levels[level];
+    return L._min[row*L._cols + col];
+}
+
+float
+MinMaxPyramid::getMax(unsigned level, unsigned col, unsigned row) const
+{
+    const Level& L = _levels[level];
+    return L._max[row*L._cols + col];
+}
+
+bool
+MinMaxPyramid::getMinMax(double u0, double v0, double u1, double v1,
+                         float& out_min, float& out_max) const
+{
+    if ( _levels.empty() )
+        return false;
+
+    if ( u0 > u1 ) std::swap(u0, u1);
+    if ( v0 > v1 ) std::swap(v0, v1);
+
+    u0 = osg::clampBetween(u0, 0.0, 1.0);
+    u1 = osg::clampBetween(u1, 0.0, 1.0);
+    v0 = osg::clampBetween(v0, 0.0, 1.0);
+    v1 = osg::clampBetween(v1, 0.0, 1.0);
+
+    // map the region into finest-level cells:
+    const Level& level0 = _levels[0];
+    double cellsPerU = (double)(_gridCols-1) / (double)_blockSize;
+    double cellsPerV = (double)(_gridRows-1) / (double)_blockSize;
+
+    unsigned c0 = std::min( (unsigned)floor(u0*cellsPerU), level0._cols-1 );
+    unsigned c1 = std::min( (unsigned)floor(u1*cellsPerU), level0._cols-1 );
+    unsigned r0 = std::min( (unsigned)floor(v0*cellsPerV), level0._rows-1 );
+    unsigned r1 = std::min( (unsigned)floor(v1*cellsPerV), level0._rows-1 );
+
+    // climb to the first level at which the region spans no more than 2x2 cells.
+    unsigned L = 0u;
+    while( L+1 < _levels.size() && ((c1>>L)-(c0>>L) > 1u || (r1>>L)-(r0>>L) > 1u) )
+        ++L;
+
+    const Level& level = _levels[L];
+    out_min = FLT_MAX;
+    out_max = -FLT_MAX;
+    for(unsigned r=(r0>>L); r<=(r1>>L); ++r)
+    {
+        for(unsigned c=(c0>>L); c<=(c1>>L); ++c)
+        {
+            out_min = std::min( out_min, level._min[r*level._cols + c] );
+            out_max = std::max( out_max, level._max[r*level._cols + c] );
+        }
+    }
+
+    return out_min <= out_max;
+}
+
+osg::Image*
+MinMaxPyramid::createImage() const
+{
+    if ( _levels.empty() )
+        return 0L;
+
+    unsigned height = 0u;
+    for(unsigned i=0; i<_levels.size(); ++i)
+        height += _levels[i]._rows;
+
+    osg::Image* image = new osg::Image();
+    image->allocateImage( _levels[0]._cols, height, 1, GL_LUMINANCE_ALPHA, GL_FLOAT );
+    ::memset( image->data(), 0, image->getTotalSizeInBytes() );
+
+    unsigned t = 0u;
+    for(unsigned i=0; i<_levels.size(); ++i)
+    {
+        const Level& level = _levels[i];
+        for(unsigned r=0; r<level._rows; ++r, ++t)
+        {
+            float* ptr = reinterpret_cast<float*>(image->data(0, t));
+            for(unsigned c=0; c<level._cols; ++c)
+            {
+                *ptr++ = level._min[r*level._cols + c];
+                *ptr++ = level._max[r*level._cols + c];
+            }
+        }
+    }
+
+    image->setUserValue( MINMAX_COLS,  _gridCols );
+    image->setUserValue( MINMAX_ROWS,  _gridRows );
+    image->setUserValue( MINMAX_BLOCK, _blockSize );
+
+    return image;
+}
@@ -26,6 +26,7 @@
 #include <osg/Uniform>
 #include <osg/Geode>
 #include <osg/Geometry>
+#include <deque>
 
 using namespace osgEarth;
 
@@ -34,8 +35,15 @@ using namespace osgEarth;
 //#undef OE_DEBUG
 //#define OE_DEBUG OE_NOTICE
 
-// Object IDs under this reserved
-#define STARTING_OBJECT_ID 10
+// Layout of an ObjectID, from the low bits up: shard, slot, generation.
+// Generations start at 1, so every ID is above the reserved ones
+// (OSGEARTH_OBJECTID_EMPTY, OSGEARTH_OBJECTID_TERRAIN, ...).
+#define SHARD_BITS       4
+#define NUM_SHARDS       (1u << SHARD_BITS)
+#define SLOT_BITS        20
+#define MAX_SLOTS        (1u << SLOT_BITS)
+#define GENERATION_SHIFT (SHARD_BITS + SLOT_BITS)
+#define MAX_GENERATION   0xffu
 
 namespace
 {
@@ -61,9 +69,81 @@ namespace
         "} \n";
 }
 
+// One independently locked part of the index.
+struct ObjectIndex::Shard
+{
+    struct Slot
+    {
+        Slot() : _generation( 1u ) { }
+        osg::ref_ptr<osg::Referenced> _object;
+        unsigned                      _generation;
+    };
+
+    Threading::Mutex     _mutex;
+    std::vector<Slot>    _slots;
+    std::deque<unsigned> _free;  // FIFO, so freed slots rest as long as possible
+
+    // allocates a slot for the object; assumes the mutex is locked.
+    bool allocate(unsigned shard, osg::Referenced* object, ObjectID& id)
+    {
+        unsigned slot;
+        if ( !_free.empty() )
+        {
+            slot = _free.front();
+            _free.pop_front();
+        }
+        else if ( _slots.size() < MAX_SLOTS )
+        {
+            slot = _slots.size();
+            _slots.push_back( Slot() );
+        }
+        else
+        {
+            return false;
+        }
+
+        Slot& s = _slots[slot];
+        s._object = object;
+        id = (s._generation << GENERATION_SHIFT) | (slot << SHARD_BITS) | shard;
+        return true;
+    }
+
+    // finds the slot for an ID, or NULL if the ID is stale; assumes the mutex is locked.
+    Slot* find(ObjectID id)
+    {
+        unsigned slot       = (id >> SHARD_BITS) & (MAX_SLOTS-1u);
+        unsigned generation = id >> GENERATION_SHIFT;
+        if ( slot < _slots.size() && _slots[slot]._generation == generation && _slots[slot]._object.valid() )
+            return &_slots[slot];
+        return 0L;
+    }
+
+    // frees the slot for an ID; assumes the mutex is locked.
+    bool release(ObjectID id)
+    {
+        Slot* s = find(id);
+        if ( !s )
+            return false;
+
+        s->_object = 0L;
+
+        // a slot that has used up its generations is retired instead of wrapping,
+        // since its next ID would repeat one that was handed out before.
+        if ( s->_generation < MAX_GENERATION )
+        {
+            ++s->_generation;
+            _free.push_back( (id >> SHARD_BITS) & (MAX_SLOTS-1u) );
+        }
+        return true;
+    }
+};
+
 ObjectIndex::ObjectIndex() :
-_idGen( STARTING_OBJECT_ID )
+_nextShard( 0u ),
+_size     ( 0u )
 {
+    _shards = new Shard[NUM_SHARDS];
+
     _attribName     = "oe_index_objectid_attr";
     _attribLocation = osg::Drawable::SECONDARY_COLORS;
     _oidUniformName = "oe_index_objectid_uniform";
@@ -72,6 +152,11 @@ _idGen( STARTING_OBJECT_ID )
     _shaders.add( "ObjectIndex.vert.glsl", indexVertexInit );
 }
 
+ObjectIndex::~ObjectIndex()
+{
+    delete [] _shards;
+}
+
 bool
 ObjectIndex::loadShaders(VirtualProgram* vp) const
 {
@@ -86,7 +171,7 @@ ObjectIndex::loadShaders(VirtualProgram* vp) const
 void
 ObjectIndex::setObjectIDAtrribLocation(int value)
 {
-    if ( _index.size() == 0 )
+    if ( _size == 0u )
     {
         _attribLocation = value;
     } 
@@ -99,49 +184,100 @@ ObjectIndex::setObjectIDAtrribLocation(int value)
 ObjectID
 ObjectIndex::insert(osg::Referenced* object)
 {
-    Threading::ScopedMutexLock excl( _mutex );
-    return insertImpl( object );
+    // spread the inserting threads over the shards; if one is full, try the next.
+    unsigned first = (unsigned)(++_nextShard);
+    for(unsigned i = 0; i < NUM_SHARDS; ++i)
+    {
+        unsigned shard = (first + i) % NUM_SHARDS;
+        Threading::ScopedMutexLock lock( _shards[shard]._mutex );
+
+        ObjectID id;
+        if ( _shards[shard].allocate(shard, object, id) )
+        {
+            ++_size;
+            OE_DEBUG << LC << "Insert " << id << "; size = " << (unsigned)_size << "\n";
+            return id;
+        }
+    }
+
+    OE_WARN << LC << "Index is full; object not indexed" << std::endl;
+    return OSGEARTH_OBJECTID_EMPTY;
 }
 
-ObjectID
-ObjectIndex::insertImpl(osg::Referenced* object)
+void
+ObjectIndex::insert(osg::Referenced* object, unsigned count, std::vector<ObjectID>& output)
 {
-    // internal: assume mutex is locked
-    ObjectID id = ++_idGen;
-    _index[id] = object;
-    OE_DEBUG << LC << "Insert " << id << "; size = " << _index.size() << "\n";
-    return id;
+    unsigned first = (unsigned)(++_nextShard);
+    for(unsigned i = 0; i < NUM_SHARDS && count > 0u; ++i)
+    {
+        unsigned shard = (first + i) % NUM_SHARDS;
+        Threading::ScopedMutexLock lock( _shards[shard]._mutex );
+
+        ObjectID id;
+        while( count > 0u && _shards[shard].allocate(shard, object, id) )
+        {
+            output.push_back( id );
+            ++_size;
+            --count;
+        }
+    }
+
+    if ( count > 0u )
+    {
+        OE_WARN << LC << "Index is full; " << count << " objects not indexed" << std::endl;
+    }
 }
 
-osg::Referenced*
+osg::ref_ptr<osg::Referenced>
 ObjectIndex::getImpl(ObjectID id) const
 {
-    // assume the mutex is locked
-    IndexMap::const_iterator i = _index.find(id);
-    return i != _index.end() ? i->second.get() : 0L;
+    Shard& shard = _shards[id & (NUM_SHARDS-1u)];
+    Threading::ScopedMutexLock lock( shard._mutex );
+    Shard::Slot* slot = shard.find(id);
+    return slot ? slot->_object.get() : 0L;
 }
 
 void
 ObjectIndex::remove(ObjectID id)
 {
-    Threading::ScopedMutexLock excl(_mutex);
-    removeImpl(id);
+    Shard& shard = _shards[id & (NUM_SHARDS-1u)];
+    Threading::ScopedMutexLock lock( shard._mutex );
+    if ( shard.release(id) )
+        --_size;
+    OE_DEBUG << LC << "Remove " << id << "; size = " << (unsigned)_size << "\n";
 }
 
 void
-ObjectIndex::removeImpl(ObjectID id)
+ObjectIndex::removeImpl(const std::vector<ObjectID>& ids)
 {
-    // internal - assume mutex is locked
-    _index.erase( id );
-    OE_DEBUG << "Remove " << id << "; size = " << _index.size() << "\n";
+    // visit each shard once, taking its lock once for all its IDs.
+    for(unsigned shard = 0; shard < NUM_SHARDS; ++shard)
+    {
+        bool locked = false;
+        for(std::vector<ObjectID>::const_iterator i = ids.begin(); i != ids.end(); ++i)
+        {
+            if ( (*i & (NUM_SHARDS-1u)) != shard )
+                continue;
 
+            if ( !locked )
+            {
+                _shards[shard]._mutex.lock();
+                locked = true;
+            }
+
+            if ( _shards[shard].release(*i) )
+                --_size;
+        }
+
+        if ( locked )
+            _shards[shard]._mutex.unlock();
+    }
 }
 
 ObjectID
 ObjectIndex::tagDrawable(osg::Drawable* drawable, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagDrawable(drawable, oid);
     return oid;
 }
@@ -198,8 +334,7 @@ namespace
 ObjectID
 ObjectIndex::tagAllDrawables(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagAllDrawables(node, oid);
     return oid;
 }
@@ -217,8 +352,7 @@ ObjectIndex::tagAllDrawables(osg::Node* node, ObjectID id) const
 ObjectID
 ObjectIndex::tagNode(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagNode(node, oid);
     return oid;
 }
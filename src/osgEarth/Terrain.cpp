@@ -22,11 +22,38 @@
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
 #include <osgViewer/View>
+#include <algorithm>
 
 #define LC "[Terrain] "
 
 using namespace osgEarth;
 
+namespace
+{
+    // Boxes under which to index an extent in the terrain SRS.
+    bool getIndexBoxes(const GeoExtent& extent, const SpatialReference* srs, std::vector<osg::Vec4d>& boxes)
+    {
+        if ( !extent.isValid() || !srs )
+            return false;
+
+        GeoExtent local = extent;
+        if ( !extent.getSRS()->isHorizEquivalentTo(srs) && !extent.transform(srs, local) )
+            return false;
+
+        GeoExtent west, east;
+        if ( local.crossesAntimeridian() && local.splitAcrossAntimeridian(west, east) )
+        {
+            boxes.push_back(osg::Vec4d(west.xMin(), west.yMin(), west.xMax(), west.yMax()));
+            boxes.push_back(osg::Vec4d(east.xMin(), east.yMin(), east.xMax(), east.yMax()));
+        }
+        else
+        {
+            boxes.push_back(osg::Vec4d(local.xMin(), local.yMin(), local.xMax(), local.yMax()));
+        }
+        return true;
+    }
+}
+
 //---------------------------------------------------------------------------
 
 Terrain::OnTileAddedOperation::OnTileAddedOperation(const TileKey& key, osg::Node* node, Terrain* terrain)
@@ -77,6 +104,7 @@ void
 Terrain::update()
 {
     _updateQueue->runOperations();
+    firePendingTilesAdded();
 }
 
 bool
@@ -285,6 +313,36 @@ Terrain::addTerrainCallback( TerrainCallback* cb )
     }
 }
 
+void
+Terrain::addTerrainCallback( TerrainCallback* cb, const GeoExtent& extent )
+{
+    if ( cb )
+    {
+        std::vector<osg::Vec4d> boxes;
+        if ( !getIndexBoxes(extent, getSRS(), boxes) )
+        {
+            // no usable extent; the callback will have to see everything.
+            addTerrainCallback( cb );
+            return;
+        }
+
+        removeTerrainCallback( cb );
+
+        Threading::ScopedWriteLock exclusiveLock( _callbacksMutex );
+
+        IndexedCallback& entry = _indexedCallbacks[cb];
+        entry._callback = cb;
+        entry._boxes.swap( boxes );
+
+        for(std::vector<osg::Vec4d>::const_iterator b = entry._boxes.begin(); b != entry._boxes.end(); ++b)
+        {
+            _callbackIndex.insert( b->x(), b->y(), b->z(), b->w(), cb );
+        }
+
+        ++_callbacksSize; // atomic increment
+    }
+}
+
 void
 Terrain::removeTerrainCallback( TerrainCallback* cb )
 {
@@ -302,6 +360,27 @@ Terrain::removeTerrainCallback( TerrainCallback* cb )
             ++i;
         }
     }
+
+    removeIndexedCallback( cb );
+}
+
+void
+Terrain::removeIndexedCallback( TerrainCallback* cb )
+{
+    // caller must hold the write lock.
+    IndexedCallbackMap::iterator i = _indexedCallbacks.find( cb );
+    if ( i != _indexedCallbacks.end() )
+    {
+        const std::vector<osg::Vec4d>& boxes = i->second._boxes;
+        for(std::vector<osg::Vec4d>::const_iterator b = boxes.begin(); b != boxes.end(); ++b)
+        {
+            _callbackIndex.remove( b->x(), b->y(), b->z(), b->w(), cb );
+        }
+
+        // erase last, since it holds the only guaranteed reference to cb.
+        _indexedCallbacks.erase( i );
+        --_callbacksSize;
+    }
 }
 
 void
@@ -315,27 +394,103 @@ Terrain::notifyTileAdded( const TileKey& key, osg::Node* node )
     if (_callbacksSize > 0)
     {
         if (!key.valid())
+        {
             OE_WARN << LC << "notifyTileAdded with key = NULL\n";
+            _updateQueue->add(new OnTileAddedOperation(key, node, this));
+            return;
+        }
 
-        _updateQueue->add(new OnTileAddedOperation(key, node, this));
+        // Queue the tile; the next update dispatches all queued tiles at once.
+        // A tile that's added more than once before then only fires once.
+        Threading::ScopedMutexLock lock( _pendingTilesMutex );
+        _pendingTiles[key] = node;
+    }
+}
+
+void
+Terrain::firePendingTilesAdded()
+{
+    PendingTiles tiles;
+    {
+        Threading::ScopedMutexLock lock( _pendingTilesMutex );
+        if ( _pendingTiles.empty() )
+            return;
+        tiles.swap( _pendingTiles );
+    }
+
+    for(PendingTiles::const_iterator i = tiles.begin(); i != tiles.end(); ++i)
+    {
+        osg::ref_ptr<osg::Node> node;
+        if ( i->second.lock(node) )
+        {
+            fireTileAdded( i->first, node.get() );
+        }
+        else
+        {
+            // nop; tile expired; let it go.
+            OE_DEBUG << "Tile expired before notification: " << i->first.str() << std::endl;
+        }
     }
 }
 
 void
 Terrain::fireTileAdded( const TileKey& key, osg::Node* node )
 {
-    Threading::ScopedReadLock sharedLock( _callbacksMutex );
+    // Collect the callbacks that need to hear about this tile, and call them
+    // outside the lock so they are free to add or remove callbacks.
+    std::vector< osg::ref_ptr<TerrainCallback> > targets;
+    {
+        Threading::ScopedReadLock sharedLock( _callbacksMutex );
 
-    for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); )
-    {       
+        targets.reserve( _callbacks.size() );
+        targets.insert( targets.end(), _callbacks.begin(), _callbacks.end() );
+
+        if ( !_indexedCallbacks.empty() )
+        {
+            if ( key.valid() )
+            {
+                GeoExtent extent = key.getExtent();
+                if ( !extent.getSRS()->isHorizEquivalentTo(getSRS()) )
+                    extent = extent.transform(getSRS());
+
+                if ( extent.isValid() )
+                {
+                    std::vector<TerrainCallback*> hits;
+                    _callbackIndex.search( extent.xMin(), extent.yMin(), extent.xMax(), extent.yMax(), hits );
+
+                    // a callback split across the antimeridian can appear twice.
+                    std::sort( hits.begin(), hits.end() );
+                    hits.erase( std::unique(hits.begin(), hits.end()), hits.end() );
+
+                    targets.insert( targets.end(), hits.begin(), hits.end() );
+                }
+            }
+            else
+            {
+                // no key means the change is not localized.
+                for(IndexedCallbackMap::const_iterator i = _indexedCallbacks.begin(); i != _indexedCallbacks.end(); ++i)
+                {
+                    targets.push_back( i->second._callback.get() );
+                }
+            }
+        }
+    }
+
+    std::vector<TerrainCallback*> removals;
+
+    for(unsigned i = 0; i < targets.size(); ++i)
+    {
         TerrainCallbackContext context( this );
-        i->get()->onTileAdded( key, node, context );
+        targets[i]->onTileAdded( key, node, context );
 
         // if the callback set the "remove" flag, discard the callback.
         if ( context.markedForRemoval() )
-            i = _callbacks.erase( i );
-        else
-            ++i;
+            removals.push_back( targets[i].get() );
+    }
+
+    for(unsigned i = 0; i < removals.size(); ++i)
+    {
+        removeTerrainCallback( removals[i] );
     }
 }
 
@@ -245,7 +245,8 @@ TerrainLayer::TerrainLayer(TerrainLayerOptions* optionsPtr) :
 VisibleLayer(optionsPtr ? optionsPtr : &_optionsConcrete),
 _options(optionsPtr ? optionsPtr : &_optionsConcrete),
 _openCalled(false),
-_tileSourceExpected(true)
+_tileSourceExpected(true),
+_tileSourceDeferred(0u)
 {
     //nop - init() called by subclass
 }
@@ -255,7 +256,8 @@ VisibleLayer(optionsPtr ? optionsPtr : &_optionsConcrete),
 _options(optionsPtr ? optionsPtr : &_optionsConcrete),
 _tileSource(tileSource),
 _openCalled(false),
-_tileSourceExpected(true)
+_tileSourceExpected(true),
+_tileSourceDeferred(0u)
 {
     //nop - init() called by subclass
 }
@@ -322,6 +324,11 @@ TerrainLayer::open()
             // this appears to be a NOP; review for removal -gw
             _runtimeCacheId = options().cacheId().get();
         }
+        else if (_sourceMetadata.valid() && _sourceMetadata->_cacheBinId.isSet())
+        {
+            // the cacheId was generated in an earlier session.
+            _runtimeCacheId = _sourceMetadata->_cacheBinId.get();
+        }
         else
         {
             // system will generate a cacheId from the layer configuration.
@@ -362,6 +369,24 @@ TerrainLayer::open()
             {
                 OE_INFO << LC << "Opening in cache-only mode\n";
             }
+            else if (isTileSourceExpected() && _sourceMetadata.valid() && _sourceMetadata->_sourceProfile.isSet())
+            {
+                // We already know the profile and the data extents, so put off
+                // opening the tile source (which can be slow) until it's needed.
+                setProfile( Profile::create(_sourceMetadata->_sourceProfile.get()) );
+                if (_profile.valid())
+                {
+                    applyProfileOverrides();
+                    _dataExtents = _sourceMetadata->_dataExtents;
+                    dirtyDataExtents();
+                    _tileSourceDeferred.exchange(1u);
+                    OE_INFO << LC << "Tile source will open on first use\n";
+                }
+                else
+                {
+                    ts = createAndOpenTileSource();
+                }
+            }
             else if (isTileSourceExpected())
             {
                 // Initialize the tile source once and only once.
@@ -372,26 +397,7 @@ TerrainLayer::open()
             // if appropriate.
             if (ts.valid())
             {
-                if (_cacheSettings->isCacheEnabled())
-                {
-                    // read the cache policy hint from the tile source unless user expressly set 
-                    // a policy in the initialization options. In other words, the hint takes
-                    // ultimate priority (even over the Registry override) unless expressly
-                    // overridden in the layer options!
-                    refreshTileSourceCachePolicyHint( ts.get() );
-
-                    // Unless the user has already configured an expiration policy, use the "last modified"
-                    // timestamp of the TileSource to set a minimum valid cache entry timestamp.
-                    const CachePolicy& cp = options().cachePolicy().get();
-
-                    if ( !cp.minTime().isSet() && !cp.maxAge().isSet() && ts->getLastModifiedTime() > 0)
-                    {
-                        // The "effective" policy overrides the runtime policy, but it does not get serialized.
-                        _cacheSettings->cachePolicy()->mergeAndOverride( cp );
-                        _cacheSettings->cachePolicy()->minTime() = ts->getLastModifiedTime();
-                        OE_INFO << LC << "driver says min valid timestamp = " << DateTime(*cp.minTime()).asRFC1123() << "\n";
-                    }
-                }
+                applyTileSourceCachePolicy( ts.get() );
 
                 // All is well - set the tile source.
                 if ( !_tileSource.valid() )
@@ -434,11 +440,85 @@ TerrainLayer::open()
     return getStatus();
 }
 
+void
+TerrainLayer::applyTileSourceCachePolicy(TileSource* ts)
+{
+    if (_cacheSettings->isCacheEnabled())
+    {
+        // read the cache policy hint from the tile source unless user expressly set 
+        // a policy in the initialization options. In other words, the hint takes
+        // ultimate priority (even over the Registry override) unless expressly
+        // overridden in the layer options!
+        refreshTileSourceCachePolicyHint( ts );
+
+        // Unless the user has already configured an expiration policy, use the "last modified"
+        // timestamp of the TileSource to set a minimum valid cache entry timestamp.
+        const CachePolicy& cp = options().cachePolicy().get();
+
+        if ( !cp.minTime().isSet() && !cp.maxAge().isSet() && ts->getLastModifiedTime() > 0)
+        {
+            // The "effective" policy overrides the runtime policy, but it does not get serialized.
+            _cacheSettings->cachePolicy()->mergeAndOverride( cp );
+            _cacheSettings->cachePolicy()->minTime() = ts->getLastModifiedTime();
+            OE_INFO << LC << "driver says min valid timestamp = " << DateTime(*cp.minTime()).asRFC1123() << "\n";
+        }
+    }
+}
+
+void
+TerrainLayer::openDeferredTileSource()
+{
+    osg::ref_ptr<TileSource> ts = createAndOpenTileSource();
+    if (ts.valid())
+    {
+        applyTileSourceCachePolicy( ts.get() );
+        _tileSource = ts.get();
+    }
+    else if ( getStatus().isOK() )
+    {
+        // createAndOpenTileSource() only reports errors that leave the layer
+        // without a cache, so make sure the failure is visible either way.
+        setStatus( Status::Error(Status::ResourceUnavailable, "Failed to open deferred tile source") );
+        OE_WARN << LC << getStatus().message() << std::endl;
+    }
+
+    // Clear the flag last; getTileSource() reads _tileSource without
+    // the lock once it sees the flag down.
+    _tileSourceDeferred.exchange(0u);
+}
+
+TerrainLayer::CacheBinMetadata*
+TerrainLayer::createSourceMetadata() const
+{
+    if (!_openCalled || !getProfile())
+        return 0L;
+
+    CacheBinMetadata* meta = new CacheBinMetadata();
+    meta->_valid          = true;
+    meta->_cacheBinId     = _runtimeCacheId;
+    meta->_sourceName     = getName();
+    meta->_sourceTileSize = getTileSize();
+    meta->_sourceProfile  = getProfile()->toProfileOptions();
+    meta->_dataExtents    = getDataExtents();
+
+    if (options().driver().isSet())
+        meta->_sourceDriver = options().driver()->getDriver();
+
+    return meta;
+}
+
+void
+TerrainLayer::setSourceMetadata(const CacheBinMetadata* meta)
+{
+    _sourceMetadata = meta;
+}
+
 void
 TerrainLayer::close()
 {
     setProfile(0L);
     _tileSource = 0L;
+    _tileSourceDeferred.exchange(0u);
     _openCalled = false;
     setStatus(Status());
     _readOptions = 0L;
@@ -464,7 +544,8 @@ TerrainLayer::setTargetProfileHint( const Profile* profile )
     _targetProfileHint = profile;
 
     // Re-read the  cache policy hint since it may change due to the target profile change.
-    refreshTileSourceCachePolicyHint( getTileSource() );
+    // (A deferred tile source will read it when it opens.)
+    refreshTileSourceCachePolicyHint( _tileSource.get() );
 }
 
 void
@@ -485,6 +566,14 @@ TerrainLayer::refreshTileSourceCachePolicyHint(TileSource* ts)
 TileSource*
 TerrainLayer::getTileSource() const
 {
+    if ( isTileSourceDeferred() )
+    {
+        Threading::ScopedMutexLock lock( _initTileSourceMutex );
+        if ( isTileSourceDeferred() ) // double-check
+        {
+            const_cast<TerrainLayer*>(this)->openDeferredTileSource();
+        }
+    }
     return _tileSource.get();
 }
 
@@ -753,8 +842,13 @@ TerrainLayer::createAndOpenTileSource()
             if (options().tileSize().isSet())
                 ts->setPixelsPerTile(options().tileSize().get());
 
-            if (!ts->getDataExtents().empty())
+            // A deferred tile source keeps the extents it was opened with,
+            // since other threads may already be reading them.
+            if (!isTileSourceDeferred() && !ts->getDataExtents().empty())
+            {
                 _dataExtents = ts->getDataExtents();
+                dirtyDataExtents();
+            }
 
             if (options().noDataValue().isSet())
                 ts->setNoDataValue(options().noDataValue().get());
@@ -863,14 +957,12 @@ TerrainLayer::mayHaveDataInExtent(const GeoExtent& ex) const
         return true;
     }
 
-    // Check each extent in turn:
-    for (DataExtentList::const_iterator i = de.begin(); i != de.end(); ++i)
+    // Check the individual extents:
+    osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
+    if (index.valid() && index->intersects(localExtent))
     {
-        if (i->intersects(localExtent))
-        {
-            // possible yes
-            return true;
-        }
+        // possible yes
+        return true;
     }
 
     // definite no.
@@ -1012,6 +1104,7 @@ TerrainLayer::dirtyDataExtents()
 {
     Threading::ScopedMutexLock lock(_mutex);
     _dataExtentsUnion = GeoExtent::INVALID;
+    _dataExtentIndex = 0L;
 }
 
 const GeoExtent&
@@ -1037,6 +1130,19 @@ TerrainLayer::getDataExtentsUnion() const
     return _dataExtentsUnion;
 }
 
+osg::ref_ptr<const DataExtentIndex>
+TerrainLayer::getDataExtentIndex() const
+{
+    const DataExtentList& de = getDataExtents();
+
+    Threading::ScopedMutexLock lock(_mutex);
+    if (!_dataExtentIndex.valid() && !de.empty())
+    {
+        _dataExtentIndex = new DataExtentIndex(de);
+    }
+    return _dataExtentIndex.get();
+}
+
 
 void
 TerrainLayer::storeProxySettings(osgDB::Options* readOptions)
@@ -1114,47 +1220,20 @@ TerrainLayer::getBestAvailableTileKey(const TileKey& key) const
         return TileKey::INVALID;
     }
 
-    bool     intersects = false;
+    // Check the data extents that intersect the key:
+    osg::ref_ptr<const DataExtentIndex> index = getDataExtentIndex();
     unsigned highestLOD = 0;
-    
-    // Check each data extent in turn:
-    for (DataExtentList::const_iterator itr = de.begin(); itr != de.end(); ++itr)
+
+    if (index.valid() && index->getMaxLevel(key.getExtent(), localLOD, highestLOD))
     {
-        // check for 2D intersection:
-        if (key.getExtent().intersects(*itr))
+        // Is our key at a lower or equal LOD than the max level of some
+        // intersecting extent (or is that max level unknown)? If so, our key is good.
+        if ( localLOD <= highestLOD )
         {
-            // check that the extent isn't higher-resolution than our key:
-            if ( !itr->minLevel().isSet() || localLOD >= (int)itr->minLevel().get() )
-            {
-                // Got an intersetion; now test the LODs:
-                intersects = true;
-
-                // Is the high-LOD set? If not, there's not enough information
-                // so just assume our key might be good.
-                if ( itr->maxLevel().isSet() == false )
-                {
-                    return localLOD > MDL ? key.createAncestorKey(MDL) : key;
-                }
-
-                // Is our key at a lower or equal LOD than the max key in this extent?
-                // If so, our key is good.
-                else if ( localLOD <= (int)itr->maxLevel().get() )
-                {
-                    return localLOD > MDL ? key.createAncestorKey(MDL) : key;
-                }
-
-                // otherwise, record the highest encountered LOD that
-                // intersects our key.
-                else if ( itr->maxLevel().get() > highestLOD )
-                {
-                    highestLOD = itr->maxLevel().get();
-                }
-            }
+            return localLOD > MDL ? key.createAncestorKey(MDL) : key;
         }
-    }
 
-    if ( intersects )
-    {
+        // otherwise, fall back on the highest intersecting LOD.
         return key.createAncestorKey(std::min(highestLOD, MDL));
     }
 
@@ -1170,6 +1249,10 @@ TerrainLayer::mayHaveData(const TileKey& key) const
 unsigned
 TerrainLayer::getTileSize() const
 {
+    // Don't open a deferred tile source just to report the tile size.
+    if ( isTileSourceDeferred() && _sourceMetadata->_sourceTileSize.isSet() )
+        return _sourceMetadata->_sourceTileSize.get();
+
     return getTileSource() ? getTileSource()->getPixelsPerTile() : options().tileSize().get();
 }
 
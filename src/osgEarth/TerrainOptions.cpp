@@ -48,7 +48,8 @@ _minNormalMapLOD( 0u ),
 _gpuTessellation( false ),
 _debug( false ),
 _binNumber( 0 ),
-_castShadows( false )
+_castShadows( false ),
+_layerFetchThreads( 0 )
 {
     fromConfig( _conf );
 }
@@ -81,6 +82,7 @@ TerrainOptions::getConfig() const
     conf.set( "min_expiry_time", _minExpiryTime);
     conf.set( "min_expiry_frames", _minExpiryFrames);
     conf.set( "cast_shadows", _castShadows);
+    conf.set( "layer_fetch_threads", _layerFetchThreads);
 
     //Save the filter settings
 	conf.set("mag_filter","LINEAR",                _magFilter,osg::Texture::LINEAR);
@@ -124,6 +126,7 @@ TerrainOptions::fromConfig( const Config& conf )
     conf.getIfSet( "min_expiry_time", _minExpiryTime);
     conf.getIfSet( "min_expiry_frames", _minExpiryFrames);
     conf.getIfSet( "cast_shadows", _castShadows);
+    conf.getIfSet( "layer_fetch_threads", _layerFetchThreads);
 
     //Load the filter settings
 	conf.getIfSet("mag_filter","LINEAR",                _magFilter,osg::Texture::LINEAR);
@@ -25,6 +25,8 @@
 #include <osgEarth/MapFrame>
 
 #include <osg/Texture2D>
+#include <OpenThreads/Thread>
+#include <algorithm>
 
 #define LC "[TerrainTileModelFactory] "
 
@@ -32,6 +34,93 @@ using namespace osgEarth;
 
 //.........................................................................
 
+namespace
+{
+    /**
+     * Progress callback for one layer fetch running on the task pool.
+     * Cancelation comes from the tile's own callback; stats and errors are
+     * kept here and merged back on the calling thread after the join, since
+     * the parent's stats table isn't thread-safe.
+     */
+    struct LayerFetchProgress : public ProgressCallback
+    {
+        osg::ref_ptr<ProgressCallback> _parent;
+
+        LayerFetchProgress(ProgressCallback* parent) : _parent(parent)
+        {
+            collectStats() = parent->collectStats();
+        }
+
+        bool isCanceled()
+        {
+            return _canceled || _parent->isCanceled();
+        }
+
+        void merge()
+        {
+            for(Stats::const_iterator i = stats().begin(); i != stats().end(); ++i)
+                _parent->stats()[i->first] += i->second;
+
+            if (needsRetry())
+                _parent->setNeedsRetry(true);
+
+            if (failed())
+                _parent->reportError(message());
+        }
+    };
+
+    LayerFetchProgress* createFetchProgress(ProgressCallback* parent)
+    {
+        return parent ? new LayerFetchProgress(parent) : 0L;
+    }
+
+    void mergeFetchProgress(ProgressCallback* progress)
+    {
+        if (progress)
+            static_cast<LayerFetchProgress*>(progress)->merge();
+    }
+}
+
+struct TerrainTileModelFactory::FetchImageLayerJob
+{
+    TerrainTileModelFactory*       _factory;
+    osg::ref_ptr<ImageLayer>       _layer;
+    TileKey                        _key;
+    osg::ref_ptr<ProgressCallback> _progressCallback;
+    osg::ref_ptr<osg::Texture>     _texture;
+    osg::Matrixf                   _textureMatrix;
+
+    void execute()
+    {
+        // the tile may have been canceled while this job sat in the queue.
+        if (_progressCallback.valid() && _progressCallback->isCanceled())
+            return;
+
+        _texture = _factory->createImageLayerTexture(_layer.get(), _key, _textureMatrix, _progressCallback.get());
+    }
+};
+
+struct TerrainTileModelFactory::FetchElevationJob
+{
+    TerrainTileModelFactory*       _factory;
+    TerrainTileModel*              _model;
+    const MapFrame*                _frame;
+    TileKey                        _key;
+    const CreateTileModelFilter*   _filter;
+    unsigned                       _border;
+    osg::ref_ptr<ProgressCallback> _progressCallback;
+
+    void execute()
+    {
+        if (_progressCallback.valid() && _progressCallback->isCanceled())
+            return;
+
+        _factory->addElevation(_model, *_frame, _key, *_filter, _border, _progressCallback.get());
+    }
+};
+
+//.........................................................................
+
 TerrainTileModelFactory::TerrainTileModelFactory(const TerrainOptions& options) :
 _options         ( options ),
 _heightFieldCache( true, 128 )
@@ -40,6 +129,15 @@ _heightFieldCache( true, 128 )
 
     // Create an empty texture that we can use as a placeholder
     _emptyTexture = new osg::Texture2D(ImageUtils::createEmptyImage());
+
+    // Fetching a layer is mostly spent waiting on I/O, so by default use
+    // more threads than there are cores.
+    int numThreads = options.layerFetchThreads().get();
+    if (numThreads <= 0)
+        numThreads = 2 * std::max(OpenThreads::GetNumberOfProcessors(), 2);
+
+    if (numThreads > 1)
+        _taskService = new TaskService("TerrainTileModelFactory", numThreads);
 }
 
 TerrainTileModel*
@@ -54,16 +152,43 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
         key,
         frame.getRevision() );
 
+    // Start fetching the elevation in the background; it only touches the
+    // elevation parts of the model, so it can run alongside the imagery.
+    osg::ref_ptr< ParallelTask<FetchElevationJob> > elevationJob;
+    Threading::Event elevationDone;
+
+    if ( requirements == 0L || requirements->elevationTexturesRequired() )
+    {
+        unsigned border = requirements->elevationBorderRequired() ? 1u : 0u;
+
+        if ( _taskService.valid() )
+        {
+            elevationJob = new ParallelTask<FetchElevationJob>( &elevationDone );
+            elevationJob->_factory = this;
+            elevationJob->_model = model.get();
+            elevationJob->_frame = &frame;
+            elevationJob->_key = key;
+            elevationJob->_filter = &filter;
+            elevationJob->_border = border;
+            elevationJob->_progressCallback = createFetchProgress(progress);
+            _taskService->add( elevationJob.get() );
+        }
+        else
+        {
+            addElevation( model.get(), frame, key, filter, border, progress );
+        }
+    }
+
     // assemble all the components:
     addImageLayers(model.get(), frame, requirements, key, filter, progress);
 
     addPatchLayers(model.get(), frame, key, filter, progress);
 
-    if ( requirements == 0L || requirements->elevationTexturesRequired() )
+    // join:
+    if ( elevationJob.valid() )
     {
-        unsigned border = requirements->elevationBorderRequired() ? 1u : 0u;
-
-        addElevation( model.get(), frame, key, filter, border, progress );
+        elevationDone.wait();
+        mergeFetchProgress( elevationJob->_progressCallback.get() );
     }
 
 #if 0
@@ -77,6 +202,38 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
     return model.release();
 }
 
+osg::Texture*
+TerrainTileModelFactory::createImageLayerTexture(ImageLayer*       layer,
+                                                 const TileKey&    key,
+                                                 osg::Matrixf&     textureMatrix,
+                                                 ProgressCallback* progress)
+{
+    osg::Texture* tex = 0L;
+
+    if (layer->isKeyInLegalRange(key) && layer->mayHaveDataInExtent(key.getExtent()))
+    {
+        if (layer->createTextureSupported())
+        {
+            tex = layer->createTexture( key, progress, textureMatrix );
+        }
+
+        else
+        {
+            GeoImage geoImage = layer->createImage( key, progress );
+       
+            if ( geoImage.valid() )
+            {
+                if ( layer->isCoverage() )
+                    tex = createCoverageTexture(geoImage.getImage(), layer);
+                else
+                    tex = createImageTexture(geoImage.getImage(), layer);
+            }
+        }
+    }
+
+    return tex;
+}
+
 void
 TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
                                         const MapFrame&   frame,
@@ -87,14 +244,15 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
 {
     OE_START_TIMER(fetch_image_layers);
 
-    int order = 0;
-
     ImageLayerVector imageLayers;
     frame.getLayers(imageLayers);
 
+    typedef std::vector< osg::ref_ptr< ParallelTask<FetchImageLayerJob> > > Jobs;
+    Jobs jobs;
+
     for(ImageLayerVector::const_iterator i = imageLayers.begin();
         i != imageLayers.end();
-        ++i, ++order )
+        ++i )
     {
         ImageLayer* layer = i->get();
 
@@ -104,29 +262,44 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
         if (!layer->getEnabled())
             continue;
 
-        osg::Texture* tex = 0L;
-        osg::Matrixf textureMatrix;
+        ParallelTask<FetchImageLayerJob>* job = new ParallelTask<FetchImageLayerJob>();
+        job->_factory = this;
+        job->_layer = layer;
+        job->_key = key;
+        jobs.push_back(job);
+    }
 
-        if (layer->isKeyInLegalRange(key) && layer->mayHaveDataInExtent(key.getExtent()))
+    // Fetch all the layers at once, and wait for them all to finish.
+    if (_taskService.valid() && jobs.size() > 1)
+    {
+        Threading::MultiEvent semaphore( (int)jobs.size() );
+        for(Jobs::iterator job = jobs.begin(); job != jobs.end(); ++job)
         {
-            if (layer->createTextureSupported())
-            {
-                tex = layer->createTexture( key, progress, textureMatrix );
-            }
+            (*job)->_mev = &semaphore;
+            (*job)->_progressCallback = createFetchProgress(progress);
+            _taskService->add( job->get() );
+        }
+        semaphore.wait();
 
-            else
-            {
-                GeoImage geoImage = layer->createImage( key, progress );
-           
-                if ( geoImage.valid() )
-                {
-                    if ( layer->isCoverage() )
-                        tex = createCoverageTexture(geoImage.getImage(), layer);
-                    else
-                        tex = createImageTexture(geoImage.getImage(), layer);
-                }
-            }
+        for(Jobs::iterator job = jobs.begin(); job != jobs.end(); ++job)
+        {
+            mergeFetchProgress( (*job)->_progressCallback.get() );
+        }
+    }
+    else
+    {
+        for(Jobs::iterator job = jobs.begin(); job != jobs.end(); ++job)
+        {
+            (*job)->_progressCallback = progress;
+            (*job)->execute();
         }
+    }
+
+    // Add the results to the model in map order.
+    for(Jobs::iterator job = jobs.begin(); job != jobs.end(); ++job)
+    {
+        ImageLayer* layer = (*job)->_layer.get();
+        osg::Texture* tex = (*job)->_texture.get();
         
         // if this is the first LOD, and the engine requires that the first LOD
         // be populated, make an empty texture if we didn't get one.
@@ -144,7 +317,7 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
             layerModel->setImageLayer(layer);
 
             layerModel->setTexture(tex);
-            layerModel->setMatrix(new osg::RefMatrixf(textureMatrix));
+            layerModel->setMatrix(new osg::RefMatrixf((*job)->_textureMatrix));
 
             model->colorLayers().push_back(layerModel);
 
@@ -232,18 +405,14 @@ TerrainTileModelFactory::addElevation(TerrainTileModel*            model,
         osg::ref_ptr<TerrainTileElevationModel> layerModel = new TerrainTileElevationModel();
         layerModel->setHeightField( mainHF.get() );
 
-        // pre-calculate the min/max heights:
-        for( unsigned col = 0; col < mainHF->getNumColumns(); ++col )
+        // min/max heights come from the pyramid built along with the heightfield:
+        MinMaxPyramid* pyramid = MinMaxPyramid::get(mainHF.get());
+        if ( pyramid && pyramid->valid() )
         {
-            for( unsigned row = 0; row < mainHF->getNumRows(); ++row )
-            {
-                float h = mainHF->getHeight(col, row);
-                if ( h > layerModel->getMaxHeight() )
-                    layerModel->setMaxHeight( h );
-                if ( h < layerModel->getMinHeight() )
-                    layerModel->setMinHeight( h );
-            }
-        }        
+            layerModel->setMinMaxPyramid( pyramid );
+            layerModel->setMinHeight( pyramid->getMinHeight() );
+            layerModel->setMaxHeight( pyramid->getMaxHeight() );
+        }
 
         // needed for normal map generation
         model->heightFields().setNeighbor(0, 0, mainHF.get());
@@ -255,6 +424,9 @@ TerrainTileModelFactory::addElevation(TerrainTileModel*            model,
 
         if ( hfImage )
         {
+            // the engine reads the pyramid back from the raster for its tile bounds.
+            hfImage->setUserData( pyramid );
+
             // Made an image, so store this as a texture with no matrix.
             osg::Texture* texture = createElevationTexture( hfImage );
             layerModel->setTexture( texture );
@@ -398,6 +570,9 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
             HeightFieldUtils::scaleHeightFieldToDegrees( out_hf.get() );
         }
 
+        // summarize the heights once, so cache hits get the pyramid for free.
+        out_hf->setUserData( new MinMaxPyramid(out_hf.get()) );
+
         // cache it.
         if (_heightFieldCacheEnabled )
         {
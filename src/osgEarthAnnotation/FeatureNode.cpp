@@ -217,7 +217,8 @@ FeatureNode::build()
         {
             if ( ap.sceneClamping )
             {
-                getMapNode()->getTerrain()->addTerrainCallback( _clampCallback.get() );
+                // index the callback by our extent so only nearby tiles trigger it.
+                getMapNode()->getTerrain()->addTerrainCallback( _clampCallback.get(), _extent );
                 clamp( getMapNode()->getTerrain()->getGraph(), getMapNode()->getTerrain() );
             }
             else
@@ -301,34 +302,48 @@ FeatureNode::onTileAdded(const TileKey&          key,
                          osg::Node*              graph,
                          TerrainCallbackContext& context)
 {
-    if (!_clampDirty)
-    {
-        bool needsClamp;
+    // already set to clamp everything
+    if (_clampDirty && !_clampExtent.isValid())
+        return;
 
-        if (key.valid())
-        {
-            osg::Polytope tope;
-            key.getExtent().createPolytope(tope);
-            needsClamp = tope.contains(this->getBound());
-        }
-        else
-        {
-            // without a valid tilekey we don't know the extent of the change,
-            // so clamping is required.
-            needsClamp = true;
-        }
+    bool needsClamp;
+
+    if (key.valid())
+    {
+        osg::Polytope tope;
+        key.getExtent().createPolytope(tope);
+        needsClamp = tope.contains(this->getBound());
+    }
+    else
+    {
+        // without a valid tilekey we don't know the extent of the change,
+        // so clamping is required.
+        needsClamp = true;
+    }
 
-        if (needsClamp)
+    if (needsClamp)
+    {
+        // Track the area that changed so the next clamp only has to
+        // touch the vertices within it. An invalid extent means everything.
+        if (!_clampDirty)
         {
+            _clampExtent = key.valid() ? key.getExtent() : GeoExtent::INVALID;
             _clampDirty = true;
             ADJUST_UPDATE_TRAV_COUNT(this, +1);
-            //clamp(graph, context.getTerrain());
         }
+        else if (_clampExtent.isValid())
+        {
+            if (key.valid())
+                _clampExtent.expandToInclude(key.getExtent());
+            else
+                _clampExtent = GeoExtent::INVALID;
+        }
+        //clamp(graph, context.getTerrain());
     }
 }
 
 void
-FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
+FeatureNode::clamp(osg::Node* graph, const Terrain* terrain, const GeoExtent& extent)
 {
     if ( terrain && graph )
     {
@@ -342,6 +357,8 @@ FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
         GeometryClamper clamper;
         clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain->getSRS() );
+        clamper.setHeightSampler( terrain->getHeightSampler() );
+        clamper.setClampExtent( extent );
         clamper.setPreserveZ( relative );
         clamper.setOffset( offset );
 
@@ -358,10 +375,11 @@ FeatureNode::traverse(osg::NodeVisitor& nv)
         {
             osg::ref_ptr<Terrain> terrain = getMapNode()->getTerrain();
             if (terrain.valid())
-                clamp(terrain->getGraph(), terrain.get());
+                clamp(terrain->getGraph(), terrain.get(), _clampExtent);
 
             ADJUST_UPDATE_TRAV_COUNT(this, -1);
             _clampDirty = false;
+            _clampExtent = GeoExtent::INVALID;
         }
     }
     AnnotationNode::traverse(nv);
@@ -792,6 +792,7 @@ ImageOverlay::clamp(osg::Node* graph, const Terrain* terrain)
         GeometryClamper clamper;
         clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain->getSRS() );
+        clamper.setHeightSampler( terrain->getHeightSampler() );
 
         this->accept( clamper );
         this->dirtyBound();
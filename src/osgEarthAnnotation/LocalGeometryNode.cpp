@@ -234,8 +234,8 @@ LocalGeometryNode::onTileAdded(const TileKey&          key,
                                osg::Node*              graph, 
                                TerrainCallbackContext& context)
 {
-    // If we are already set to clamp, ignore this
-    if (_clampDirty)
+    // If we are already set to clamp everything, ignore this
+    if (_clampDirty && !_clampExtent.isValid())
         return;
 
     bool needsClamp;
@@ -260,8 +260,23 @@ LocalGeometryNode::onTileAdded(const TileKey&          key,
     if (needsClamp)
     {
         //clamp(graph, context.getTerrain());
-        _clampDirty = true;
-        ADJUST_UPDATE_TRAV_COUNT(this, +1);
+
+        // Track the area that changed so the clamp only has to touch
+        // the vertices within it. An invalid extent means everything.
+        if (!_clampDirty)
+        {
+            _clampExtent = key.valid() ? key.getExtent() : GeoExtent::INVALID;
+            _clampDirty = true;
+            ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        }
+        else if (key.valid())
+        {
+            _clampExtent.expandToInclude(key.getExtent());
+        }
+        else
+        {
+            _clampExtent = GeoExtent::INVALID;
+        }
         OE_DEBUG << LC << "LGN: clamp requested b/c of key " << key.str() << std::endl;
     }
 }
@@ -275,6 +290,8 @@ LocalGeometryNode::clamp(osg::Node* graph, const Terrain* terrain)
 
         clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain ? terrain->getSRS() : 0L );
+        clamper.setHeightSampler( terrain->getHeightSampler() );
+        clamper.setClampExtent( _clampExtent );
         clamper.setPreserveZ( _clampRelative );
         //clamper.setOffset( getPosition().alt() );
 
@@ -295,6 +312,7 @@ LocalGeometryNode::traverse(osg::NodeVisitor& nv)
 
         ADJUST_UPDATE_TRAV_COUNT(this, -1);
         _clampDirty = false;
+        _clampExtent = GeoExtent::INVALID;
     }
     GeoPositionNode::traverse(nv);
 }
@@ -353,9 +371,10 @@ LocalGeometryNode::dirty()
 {
     GeoPositionNode::dirty();
 
-    // re-clamp the geometry if necessary.
+    // re-clamp the geometry if necessary. It moved, so clamp all of it.
     if ( _clampCallback.valid() && getMapNode() )
     {
+        _clampExtent = GeoExtent::INVALID;
         clamp( getMapNode()->getTerrain()->getGraph(), getMapNode()->getTerrain() );
     }
 }
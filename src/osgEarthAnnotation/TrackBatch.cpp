@@ -0,0 +1,439 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthAnnotation/TrackBatch>
+#include <osgEarth/GeoCommon>
+#include <osgEarth/Horizon>
+#include <algorithm>
+#include <cmath>
+
+#define LC "[TrackBatch] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+namespace
+{
+    // orders entity indices by descending priority.
+    struct HigherPriority
+    {
+        HigherPriority(const std::vector<float>& priority) : _priority(priority) { }
+        bool operator()(unsigned a, unsigned b) const { return _priority[a] > _priority[b]; }
+        const std::vector<float>& _priority;
+    };
+}
+
+//------------------------------------------------------------------------
+
+TrackBatch::TrackBatch(const SpatialReference* srs, bool geocentric) :
+_srs       ( srs ),
+_geocentric( geocentric && srs && srs->isGeographic() ),
+_numClamped( 0u ),
+_orderDirty( false )
+{
+    //nop
+}
+
+void
+TrackBatch::reserve(unsigned count)
+{
+    _x.reserve(count);
+    _y.reserve(count);
+    _z.reserve(count);
+    _terrainZ.reserve(count);
+    _heading.reserve(count);
+    _priority.reserve(count);
+    _icon.reserve(count);
+    _flags.reserve(count);
+    _label.reserve(count);
+    _wx.reserve(count);
+    _wy.reserve(count);
+    _wz.reserve(count);
+}
+
+void
+TrackBatch::clear()
+{
+    _x.clear();
+    _y.clear();
+    _z.clear();
+    _terrainZ.clear();
+    _heading.clear();
+    _priority.clear();
+    _icon.clear();
+    _flags.clear();
+    _label.clear();
+    _wx.clear();
+    _wy.clear();
+    _wz.clear();
+    _order.clear();
+    _worldBound.init();
+    _bound.init();
+    _numClamped = 0u;
+    _orderDirty = false;
+}
+
+unsigned
+TrackBatch::add(const osg::Vec3d&  position,
+                float              heading,
+                unsigned           icon,
+                const std::string& label,
+                float              priority)
+{
+    unsigned i = _x.size();
+
+    _x.push_back(position.x());
+    _y.push_back(position.y());
+    _z.push_back(position.z());
+    _terrainZ.push_back(0.0);
+    _heading.push_back(heading);
+    _priority.push_back(priority);
+    _icon.push_back((unsigned short)icon);
+    _flags.push_back(FLAG_VISIBLE | FLAG_MOVED);
+    _label.push_back(label);
+    _wx.push_back(0.0);
+    _wy.push_back(0.0);
+    _wz.push_back(0.0);
+
+    _orderDirty = true;
+    return i;
+}
+
+void
+TrackBatch::markMoved(unsigned i)
+{
+    _flags[i] |= (_flags[i] & FLAG_CLAMP) ? (FLAG_MOVED | FLAG_UNCLAMPED) : FLAG_MOVED;
+}
+
+void
+TrackBatch::update(const std::vector<Update>& updates)
+{
+    const unsigned count = _x.size();
+
+    for(std::vector<Update>::const_iterator u = updates.begin(); u != updates.end(); ++u)
+    {
+        const unsigned i = u->_index;
+        if ( i >= count )
+            continue;
+
+        _x[i] = u->_position.x();
+        _y[i] = u->_position.y();
+        _z[i] = u->_position.z();
+        _heading[i] = u->_heading;
+        markMoved(i);
+    }
+}
+
+void
+TrackBatch::setPositions(unsigned      first,
+                         unsigned      count,
+                         const double* x,
+                         const double* y,
+                         const double* z,
+                         const float*  headings)
+{
+    if ( first >= _x.size() )
+        return;
+
+    count = std::min(count, (unsigned)_x.size() - first);
+
+    std::copy(x, x + count, _x.begin() + first);
+    std::copy(y, y + count, _y.begin() + first);
+    std::copy(z, z + count, _z.begin() + first);
+
+    if ( headings )
+        std::copy(headings, headings + count, _heading.begin() + first);
+
+    for(unsigned i = first; i < first + count; ++i)
+        markMoved(i);
+}
+
+void
+TrackBatch::setPriority(unsigned i, float priority)
+{
+    if ( _priority[i] != priority )
+    {
+        _priority[i] = priority;
+        _orderDirty = true;
+    }
+}
+
+void
+TrackBatch::setVisible(unsigned i, bool value)
+{
+    if ( value )
+        _flags[i] |= FLAG_VISIBLE;
+    else
+        _flags[i] &= ~FLAG_VISIBLE;
+}
+
+void
+TrackBatch::setClamped(unsigned i, bool value)
+{
+    if ( value == getClamped(i) )
+        return;
+
+    if ( value )
+    {
+        _flags[i] |= (FLAG_CLAMP | FLAG_UNCLAMPED | FLAG_MOVED);
+        ++_numClamped;
+    }
+    else
+    {
+        _flags[i] &= ~(FLAG_CLAMP | FLAG_UNCLAMPED);
+        _flags[i] |= FLAG_MOVED;
+        _terrainZ[i] = 0.0;
+        --_numClamped;
+    }
+}
+
+unsigned
+TrackBatch::clamp(const TerrainHeightSampler* sampler, bool all)
+{
+    if ( !sampler || _numClamped == 0u )
+        return 0u;
+
+    const unsigned count = _x.size();
+
+    // gather the entities that need a new terrain height:
+    _clampIndices.clear();
+    _clampPoints.clear();
+
+    for(unsigned i = 0; i < count; ++i)
+    {
+        const unsigned char flags = _flags[i];
+        if ( (flags & FLAG_CLAMP) && (all || (flags & FLAG_UNCLAMPED)) )
+        {
+            _clampIndices.push_back(i);
+            _clampPoints.push_back(osg::Vec3d(_x[i], _y[i], 0.0));
+        }
+    }
+
+    if ( _clampIndices.empty() )
+        return 0u;
+
+    // one query for the lot; the sampler is fastest when nearby points are adjacent,
+    // which index order usually gives us for free.
+    sampler->getHeights(_clampPoints, _clampHeights);
+
+    for(unsigned k = 0; k < _clampIndices.size(); ++k)
+    {
+        const unsigned i = _clampIndices[k];
+
+        // leave the last good height alone if no tile covers the point yet.
+        if ( k < _clampHeights.size() && _clampHeights[k] != NO_DATA_VALUE )
+        {
+            if ( _terrainZ[i] != (double)_clampHeights[k] )
+            {
+                _terrainZ[i] = (double)_clampHeights[k];
+                _flags[i] |= FLAG_MOVED;
+            }
+        }
+
+        _flags[i] &= ~FLAG_UNCLAMPED;
+    }
+
+    return _clampIndices.size();
+}
+
+unsigned
+TrackBatch::invalidateClamping(const GeoExtent& extent)
+{
+    if ( _numClamped == 0u || !extent.isValid() )
+        return 0u;
+
+    GeoExtent local = extent;
+    if ( _srs.valid() && !extent.getSRS()->isHorizEquivalentTo(_srs.get()) )
+    {
+        local = extent.transform(_srs.get());
+        if ( !local.isValid() )
+            return 0u;
+    }
+
+    const unsigned count = _x.size();
+    unsigned numMarked = 0u;
+
+    for(unsigned i = 0; i < count; ++i)
+    {
+        if ( (_flags[i] & FLAG_CLAMP) && local.contains(_x[i], _y[i]) )
+        {
+            _flags[i] |= FLAG_UNCLAMPED;
+            ++numMarked;
+        }
+    }
+
+    return numMarked;
+}
+
+unsigned
+TrackBatch::computeWorldPositions()
+{
+    const unsigned count = _x.size();
+    unsigned numMoved = 0u;
+
+    const osg::EllipsoidModel* em = _geocentric ? _srs->getEllipsoid() : 0L;
+
+    for(unsigned i = 0; i < count; ++i)
+    {
+        if ( (_flags[i] & FLAG_MOVED) == 0 )
+            continue;
+
+        const double z = _z[i] + _terrainZ[i];
+
+        if ( em )
+        {
+            em->convertLatLongHeightToXYZ(
+                osg::DegreesToRadians(_y[i]), osg::DegreesToRadians(_x[i]), z,
+                _wx[i], _wy[i], _wz[i]);
+        }
+        else
+        {
+            _wx[i] = _x[i];
+            _wy[i] = _y[i];
+            _wz[i] = z;
+        }
+
+        _flags[i] &= ~FLAG_MOVED;
+        ++numMoved;
+    }
+
+    if ( numMoved > 0u )
+    {
+        _worldBound.init();
+        _bound.init();
+        for(unsigned i = 0; i < count; ++i)
+        {
+            _worldBound.expandBy(_wx[i], _wy[i], _wz[i]);
+            _bound.expandBy(_x[i], _y[i], 0.0);
+        }
+    }
+
+    return numMoved;
+}
+
+GeoExtent
+TrackBatch::getExtent() const
+{
+    if ( !_bound.valid() || !_srs.valid() )
+        return GeoExtent::INVALID;
+
+    return GeoExtent(_srs.get(), _bound.xMin(), _bound.yMin(), _bound.xMax(), _bound.yMax());
+}
+
+void
+TrackBatch::updateOrder()
+{
+    if ( !_orderDirty && _order.size() == _priority.size() )
+        return;
+
+    _order.resize(_priority.size());
+    for(unsigned i = 0; i < _order.size(); ++i)
+        _order[i] = i;
+
+    std::stable_sort(_order.begin(), _order.end(), HigherPriority(_priority));
+    _orderDirty = false;
+}
+
+unsigned
+TrackBatch::cull(const osg::Matrixd& mvpw,
+                 const osg::Vec3d&   eye,
+                 double              width,
+                 double              height,
+                 float               iconSize,
+                 bool                declutter,
+                 CullResult&         out) const
+{
+    out._indices.clear();
+    out._window.clear();
+
+    if ( _x.empty() || width <= 0.0 || height <= 0.0 )
+        return 0u;
+
+    Horizon horizon;
+    if ( _geocentric )
+    {
+        horizon.setEllipsoid(*_srs->getEllipsoid());
+        horizon.setEye(eye);
+    }
+
+    const double half = 0.5 * (double)iconSize;
+
+    // declutter grid of half-icon cells:
+    const double cell = std::max(half, 1.0);
+    const int cols = (int)std::ceil(width / cell) + 1;
+    const int rows = (int)std::ceil(height / cell) + 1;
+    if ( declutter )
+        out._grid.assign(cols*rows, 0);
+
+    const double* m = mvpw.ptr();
+
+    // the sorted entities, then any added since the last updateOrder().
+    const unsigned numSorted = _order.size();
+    const unsigned count = _x.size();
+
+    for(unsigned k = 0; k < count; ++k)
+    {
+        const unsigned i = k < numSorted ? _order[k] : k;
+        if ( (_flags[i] & FLAG_VISIBLE) == 0 )
+            continue;
+
+        const double x = _wx[i], y = _wy[i], z = _wz[i];
+
+        // project; osg matrices multiply row vectors, so this is (x,y,z,1) * mvpw.
+        const double w = x*m[3] + y*m[7] + z*m[11] + m[15];
+        if ( w <= 0.0 )
+            continue;
+
+        const double sx = (x*m[0] + y*m[4] + z*m[8] + m[12]) / w;
+        const double sy = (x*m[1] + y*m[5] + z*m[9] + m[13]) / w;
+
+        if ( sx < -half || sx > width + half || sy < -half || sy > height + half )
+            continue;
+
+        if ( _geocentric && !horizon.isVisible(osg::Vec3d(x, y, z)) )
+            continue;
+
+        if ( declutter )
+        {
+            const int c0 = osg::clampBetween((int)std::floor((sx - half) / cell), 0, cols-1);
+            const int c1 = osg::clampBetween((int)std::floor((sx + half) / cell), 0, cols-1);
+            const int r0 = osg::clampBetween((int)std::floor((sy - half) / cell), 0, rows-1);
+            const int r1 = osg::clampBetween((int)std::floor((sy + half) / cell), 0, rows-1);
+
+            bool occupied = false;
+            for(int r = r0; r <= r1 && !occupied; ++r)
+                for(int c = c0; c <= c1 && !occupied; ++c)
+                    occupied = out._grid[r*cols + c] != 0;
+
+            if ( occupied )
+                continue;
+
+            for(int r = r0; r <= r1; ++r)
+                for(int c = c0; c <= c1; ++c)
+                    out._grid[r*cols + c] = 1;
+        }
+
+        out._indices.push_back(i);
+        out._window.push_back(osg::Vec2f((float)sx, (float)sy));
+    }
+
+    return out._indices.size();
+}
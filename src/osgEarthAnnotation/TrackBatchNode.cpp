@@ -0,0 +1,513 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthAnnotation/TrackBatchNode>
+#include <osgEarthAnnotation/AnnotationUtils>
+#include <osgEarth/MapNode>
+#include <osgEarth/Registry>
+#include <osgEarth/Capabilities>
+#include <osgEarth/CullingUtils>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/NodeUtils>
+#include <osgEarth/ShaderGenerator>
+#include <osgEarth/VirtualProgram>
+#include <osg/BlendFunc>
+#include <osg/TextureBuffer>
+#include <osgText/Text>
+#include <osgUtil/CullVisitor>
+#include <cmath>
+
+#define LC "[TrackBatchNode] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+using namespace osgEarth::Symbology;
+
+// texture image units for the icon atlas and the per-instance data
+#define ATLAS_UNIT     0
+#define INSTANCES_UNIT 5
+
+// floats per instance: (x, y, z, heading) and (icon, unused...)
+#define TEXELS_PER_INSTANCE 2
+
+namespace
+{
+    // Replaces the vertex (a quad corner) with the instance position, and
+    // computes the texture coordinates of the instance's icon in the atlas.
+    const char* vertexModelSource =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform samplerBuffer oe_tb_instances; \n"
+        "uniform vec2 oe_tb_atlasGrid; \n"
+        "out vec2 oe_tb_texcoord; \n"
+        "vec2 oe_tb_corner; \n"
+        "float oe_tb_heading; \n"
+        "void oe_tb_vertexModel(inout vec4 vertex) \n"
+        "{ \n"
+        "    vec4 pos  = texelFetch(oe_tb_instances, 2*gl_InstanceID); \n"
+        "    vec4 info = texelFetch(oe_tb_instances, 2*gl_InstanceID+1); \n"
+        "    float col = mod(info.x, oe_tb_atlasGrid.x); \n"
+        "    float row = floor(info.x / oe_tb_atlasGrid.x); \n"
+        "    oe_tb_texcoord = (vec2(col, row) + vertex.xy + 0.5) / oe_tb_atlasGrid; \n"
+        "    oe_tb_corner = vertex.xy; \n"
+        "    oe_tb_heading = pos.w; \n"
+        "    vertex = vec4(pos.xyz, 1.0); \n"
+        "} \n";
+
+    // Rotates the quad corner so the top of the icon points along the heading,
+    // measured from the direction of local north on the screen.
+    const char* vertexViewSource =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform mat4 osg_ViewMatrix; \n"
+        "uniform mat4 osg_ViewMatrixInverse; \n"
+        "uniform bool oe_tb_geocentric; \n"
+        "vec2 oe_tb_corner; \n"
+        "float oe_tb_heading; \n"
+        "void oe_tb_vertexView(inout vec4 vertex) \n"
+        "{ \n"
+        "    vec3 north = vec3(0.0, 1.0, 0.0); \n"
+        "    if (oe_tb_geocentric) \n"
+        "    { \n"
+        "        vec3 up = normalize((osg_ViewMatrixInverse * vertex).xyz); \n"
+        "        vec3 n = vec3(0.0, 0.0, 1.0) - up*up.z; \n"
+        "        north = dot(n, n) > 1e-12 ? normalize(n) : vec3(1.0, 0.0, 0.0); \n"
+        "    } \n"
+        "    vec3 northView = mat3(osg_ViewMatrix) * north; \n"
+        "    float a = atan(northView.y, northView.x) - oe_tb_heading - 1.5707963; \n"
+        "    float c = cos(a), s = sin(a); \n"
+        "    oe_tb_corner = vec2(oe_tb_corner.x*c - oe_tb_corner.y*s, oe_tb_corner.x*s + oe_tb_corner.y*c); \n"
+        "} \n";
+
+    // Expands the corner to the icon size in pixels.
+    const char* vertexClipSource =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform vec2 oe_tb_viewport; \n"
+        "uniform float oe_tb_iconSize; \n"
+        "vec2 oe_tb_corner; \n"
+        "void oe_tb_vertexClip(inout vec4 vertex) \n"
+        "{ \n"
+        "    vertex.xy += oe_tb_corner * oe_tb_iconSize * 2.0 / oe_tb_viewport * vertex.w; \n"
+        "} \n";
+
+    const char* fragmentSource =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform sampler2D oe_tb_atlas; \n"
+        "in vec2 oe_tb_texcoord; \n"
+        "void oe_tb_fragment(inout vec4 color) \n"
+        "{ \n"
+        "    color = texture(oe_tb_atlas, oe_tb_texcoord); \n"
+        "} \n";
+
+    // assume x is positive
+    unsigned nextPowerOf2(unsigned x)
+    {
+        --x;
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        return x+1;
+    }
+}
+
+//------------------------------------------------------------------------
+
+TrackBatchNode::TrackBatchNode(MapNode* mapNode, unsigned iconSize) :
+_mapNode       ( mapNode ),
+_terrainChanged( false ),
+_iconSize      ( std::max(iconSize, 1u) ),
+_declutter     ( true ),
+_maxLabels     ( 100u )
+{
+    _batch = new TrackBatch(
+        mapNode ? mapNode->getMapSRS() : 0L,
+        mapNode ? mapNode->isGeocentric() : false );
+
+    // we do our own per-entity culling, and a small batch has a tiny bound.
+    setCullingActive( false );
+
+    // default label appearance: to the right of the icon.
+    TextSymbol* symbol = new TextSymbol();
+    symbol->alignment() = TextSymbol::ALIGN_LEFT_CENTER;
+    symbol->halo()->color() = Color::Black;
+    _labelSymbol = symbol;
+
+    // unit quad, centered on the origin; each vertex is a corner of the icon.
+    _quad = new osg::Vec3Array();
+    _quad->push_back( osg::Vec3(-0.5f, -0.5f, 0.0f) );
+    _quad->push_back( osg::Vec3( 0.5f, -0.5f, 0.0f) );
+    _quad->push_back( osg::Vec3(-0.5f,  0.5f, 0.0f) );
+    _quad->push_back( osg::Vec3( 0.5f,  0.5f, 0.0f) );
+
+    // state shared by every view:
+    _atlas = new osg::Texture2D();
+    _atlas->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR );
+    _atlas->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+    _atlas->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+    _atlas->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+    _atlas->setResizeNonPowerOfTwoHint( false );
+
+    _iconStateSet = new osg::StateSet();
+    _iconStateSet->setTextureAttribute( ATLAS_UNIT, _atlas.get() );
+    _iconStateSet->addUniform( new osg::Uniform("oe_tb_atlas", ATLAS_UNIT) );
+    _iconStateSet->addUniform( new osg::Uniform("oe_tb_instances", INSTANCES_UNIT) );
+    _iconStateSet->addUniform( new osg::Uniform("oe_tb_iconSize", (float)_iconSize) );
+    _iconStateSet->addUniform( new osg::Uniform("oe_tb_geocentric", _batch->isGeocentric()) );
+    _iconStateSet->getOrCreateUniform( "oe_tb_atlasGrid", osg::Uniform::FLOAT_VEC2 )->set( osg::Vec2f(1.0f, 1.0f) );
+    _iconStateSet->setMode( GL_BLEND, osg::StateAttribute::ON );
+    _iconStateSet->setMode( GL_DEPTH_TEST, osg::StateAttribute::OFF );
+    _iconStateSet->setRenderBinDetails( 98, "RenderBin" );
+
+    VirtualProgram* vp = VirtualProgram::getOrCreate( _iconStateSet.get() );
+    vp->setName( "TrackBatchNode" );
+    vp->setFunction( "oe_tb_vertexModel", vertexModelSource, ShaderComp::LOCATION_VERTEX_MODEL, 0.0f );
+    vp->setFunction( "oe_tb_vertexView",  vertexViewSource,  ShaderComp::LOCATION_VERTEX_VIEW,  0.0f );
+    vp->setFunction( "oe_tb_vertexClip",  vertexClipSource,  ShaderComp::LOCATION_VERTEX_CLIP,  0.0f );
+    vp->setFunction( "oe_tb_fragment",    fragmentSource,    ShaderComp::LOCATION_FRAGMENT_COLORING, 0.0f );
+
+    _labelStateSet = new osg::StateSet();
+    _labelStateSet->setMode( GL_BLEND, osg::StateAttribute::ON );
+    _labelStateSet->setMode( GL_DEPTH_TEST, osg::StateAttribute::OFF );
+    _labelStateSet->setRenderBinDetails( 99, "RenderBin" );
+
+    if ( !Registry::capabilities().supportsGLSL() || !Registry::capabilities().supportsDrawInstanced() )
+    {
+        OE_WARN << LC << "Instanced drawing is not available; tracks will not render" << std::endl;
+    }
+
+    // re-clamp when the terrain changes. The callback is registered with the
+    // extent of the batch once there are clamped entities to care about.
+    _terrainCallback = new TerrainCallbackAdapter<TrackBatchNode>(this);
+
+    ADJUST_UPDATE_TRAV_COUNT( this, +1 );
+}
+
+TrackBatchNode::~TrackBatchNode()
+{
+    osg::ref_ptr<MapNode> mapNode;
+    if ( _terrainCallbackExtent.isValid() && _mapNode.lock(mapNode) && mapNode->getTerrain() )
+    {
+        mapNode->getTerrain()->removeTerrainCallback( _terrainCallback.get() );
+    }
+}
+
+unsigned
+TrackBatchNode::addIcon(const osg::Image* image)
+{
+    osg::ref_ptr<osg::Image> icon;
+    if ( !image || !ImageUtils::resizeImage(image, _iconSize, _iconSize, icon) || !icon.valid() )
+    {
+        OE_WARN << LC << "Failed to add an icon" << std::endl;
+        return ~0u;
+    }
+
+    _icons.push_back( icon.get() );
+    buildAtlas();
+    return _icons.size() - 1;
+}
+
+void
+TrackBatchNode::buildAtlas()
+{
+    // lay the icons out on a square-ish grid; icon i is at (i % cols, i / cols).
+    unsigned cols = (unsigned)std::ceil(std::sqrt((double)_icons.size()));
+    unsigned rows = (_icons.size() + cols - 1) / cols;
+
+    osg::Image* atlas = new osg::Image();
+    atlas->allocateImage( cols*_iconSize, rows*_iconSize, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    atlas->setInternalTextureFormat( GL_RGBA8 );
+    ::memset( atlas->data(), 0, atlas->getTotalSizeInBytes() );
+
+    for(unsigned i = 0; i < _icons.size(); ++i)
+    {
+        ImageUtils::copyAsSubImage( _icons[i].get(), atlas, (i % cols)*_iconSize, (i / cols)*_iconSize );
+    }
+
+    _atlas->setImage( atlas );
+    _iconStateSet->getOrCreateUniform( "oe_tb_atlasGrid", osg::Uniform::FLOAT_VEC2 )->set( osg::Vec2f((float)cols, (float)rows) );
+}
+
+void
+TrackBatchNode::onTileAdded(const TileKey&          key,
+                            osg::Node*              graph,
+                            TerrainCallbackContext& context)
+{
+    // map-wide notifications carry no key.
+    if ( key.valid() )
+        _batch->invalidateClamping( key.getExtent() );
+    else
+        _terrainChanged = true;
+}
+
+void
+TrackBatchNode::updateTerrainCallback(MapNode* mapNode)
+{
+    GeoExtent extent = _batch->getExtent();
+    if ( !extent.isValid() || !mapNode->getTerrain() )
+        return;
+
+    if ( _terrainCallbackExtent.isValid() && _terrainCallbackExtent.contains(extent) )
+        return;
+
+    // pad the extent so that entities moving about don't re-index the
+    // callback every frame. Adding it again replaces the old extent.
+    extent.expand( std::max(extent.width(), 1e-3), std::max(extent.height(), 1e-3) );
+    _terrainCallbackExtent = extent;
+    mapNode->getTerrain()->addTerrainCallback( _terrainCallback.get(), _terrainCallbackExtent );
+}
+
+osg::BoundingSphere
+TrackBatchNode::computeBound() const
+{
+    const osg::BoundingBoxd& box = _batch->getWorldBound();
+    if ( !box.valid() )
+        return osg::BoundingSphere();
+
+    return osg::BoundingSphere( osg::Vec3(box.center()), (float)box.radius() );
+}
+
+void
+TrackBatchNode::traverse(osg::NodeVisitor& nv)
+{
+    if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
+    {
+        // resolve terrain heights in one query, then the world positions.
+        osg::ref_ptr<MapNode> mapNode;
+        const bool clamping = _batch->hasClampedEntities() && _mapNode.lock(mapNode) && mapNode->getTerrain();
+        if ( clamping )
+        {
+            _batch->clamp( mapNode->getTerrain()->getHeightSampler(), _terrainChanged );
+            _terrainChanged = false;
+        }
+
+        if ( _batch->computeWorldPositions() > 0u )
+        {
+            _anchor = _batch->getWorldBound().center();
+            dirtyBound();
+
+            if ( clamping )
+                updateTerrainCallback( mapNode.get() );
+        }
+
+        // sort here so that cull only reads the batch.
+        _batch->updateOrder();
+    }
+
+    else if ( nv.getVisitorType() == nv.CULL_VISITOR )
+    {
+        osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
+        if ( cv )
+        {
+            cull( cv );
+        }
+    }
+}
+
+void
+TrackBatchNode::initSlot(Slot& slot)
+{
+    slot._stateSet = new osg::StateSet();
+    slot._stateSet->setDataVariance( osg::Object::DYNAMIC );
+    slot._stateSet->getOrCreateUniform( "oe_tb_viewport", osg::Uniform::FLOAT_VEC2 );
+
+    slot._geometry = new osg::Geometry();
+    slot._geometry->setUseVertexBufferObjects( true );
+    slot._geometry->setUseDisplayList( false );
+    slot._geometry->setVertexArray( _quad.get() );
+    slot._geometry->addPrimitiveSet( new osg::DrawArrays(GL_TRIANGLE_STRIP, 0, 4) );
+    slot._geometry->setCullingActive( false );
+    slot._geometry->setDataVariance( osg::Object::DYNAMIC );
+
+    slot._geode = new osg::Geode();
+    slot._geode->addDrawable( slot._geometry.get() );
+    slot._geode->setCullingActive( false );
+
+    // labels draw in window coordinates under a nested ortho camera.
+    slot._labels = new osg::Geode();
+    slot._labels->setCullingActive( false );
+
+    slot._labelCamera = new osg::Camera();
+    slot._labelCamera->setReferenceFrame( osg::Transform::ABSOLUTE_RF );
+    slot._labelCamera->setRenderOrder( osg::Camera::NESTED_RENDER );
+    slot._labelCamera->setClearMask( 0 );
+    slot._labelCamera->setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
+    slot._labelCamera->setAllowEventFocus( false );
+    slot._labelCamera->setViewMatrix( osg::Matrix::identity() );
+    slot._labelCamera->setStateSet( _labelStateSet.get() );
+    slot._labelCamera->addChild( slot._labels.get() );
+}
+
+void
+TrackBatchNode::cull(osgUtil::CullVisitor* cv)
+{
+    const osg::Camera* camera = cv->getCurrentCamera();
+    const osg::Viewport* viewport = camera ? camera->getViewport() : 0L;
+    if ( !viewport || _batch->size() == 0u || _icons.empty() )
+        return;
+
+    const double width  = viewport->width();
+    const double height = viewport->height();
+
+    PerViewData& view = _perView.get( camera );
+
+    const unsigned frame = cv->getFrameStamp() ? cv->getFrameStamp()->getFrameNumber() : 0u;
+    Slot& slot = view._slots[frame & 1u];
+    if ( !slot._stateSet.valid() )
+        initSlot( slot );
+
+    // world to window, with the window origin at the viewport corner:
+    const osg::Matrixd& mv = *cv->getModelViewMatrix();
+    osg::Matrixd mvpw =
+        mv *
+        (*cv->getProjectionMatrix()) *
+        osg::Matrixd::translate(1.0, 1.0, 1.0) *
+        osg::Matrixd::scale(0.5*width, 0.5*height, 0.5);
+
+    osg::Vec3d eye = osg::Vec3d(0,0,0) * osg::Matrixd::inverse(mv);
+
+    unsigned count = _batch->cull( mvpw, eye, width, height, (float)_iconSize, _declutter, view._culled );
+    if ( count == 0u )
+        return;
+
+    // respect the maximum texture buffer size (in bytes).
+    const unsigned bytesPerInstance = TEXELS_PER_INSTANCE * 4u * sizeof(GLfloat);
+    const int maxBytes = Registry::capabilities().getMaxTextureBufferSize();
+    if ( maxBytes > 0 && count > (unsigned)maxBytes / bytesPerInstance )
+    {
+        count = (unsigned)maxBytes / bytesPerInstance;
+    }
+
+    // (re)allocate the instance buffer if it's too small.
+    const unsigned texels = count * TEXELS_PER_INSTANCE;
+    if ( !slot._instances.valid() || (unsigned)slot._instances->s() < texels )
+    {
+        unsigned capacity = nextPowerOf2( std::max(texels, 256u) );
+
+        slot._instances = new osg::Image();
+        slot._instances->allocateImage( capacity, 1, 1, GL_RGBA, GL_FLOAT );
+
+        osg::TextureBuffer* tbo = new osg::TextureBuffer( slot._instances.get() );
+        tbo->setInternalFormat( GL_RGBA32F_ARB );
+        ShaderGenerator::setIgnoreHint( tbo, true );
+        slot._stateSet->setTextureAttribute( INSTANCES_UNIT, tbo );
+    }
+
+    // write the survivors, relative to the anchor to preserve precision.
+    GLfloat* ptr = reinterpret_cast<GLfloat*>( slot._instances->data() );
+    const std::vector<unsigned>& indices = view._culled._indices;
+    for(unsigned k = 0; k < count; ++k)
+    {
+        const unsigned i = indices[k];
+        osg::Vec3d p = _batch->getWorldPosition(i) - _anchor;
+        *ptr++ = (GLfloat)p.x();
+        *ptr++ = (GLfloat)p.y();
+        *ptr++ = (GLfloat)p.z();
+        *ptr++ = (GLfloat)osg::DegreesToRadians( _batch->getHeading(i) );
+        *ptr++ = (GLfloat)_batch->getIcon(i);
+        *ptr++ = 0.0f;
+        *ptr++ = 0.0f;
+        *ptr++ = 0.0f;
+    }
+    slot._instances->dirty();
+
+    slot._stateSet->getUniform( "oe_tb_viewport" )->set( osg::Vec2f((float)width, (float)height) );
+    slot._geometry->getPrimitiveSet(0)->setNumInstances( count );
+
+    // static bounds for near/far computation, since instancing hides the real ones.
+    const osg::BoundingBoxd& box = _batch->getWorldBound();
+    slot._geometry->setInitialBound( osg::BoundingBox(
+        osg::Vec3(box._min - _anchor),
+        osg::Vec3(box._max - _anchor)) );
+    slot._geometry->dirtyBound();
+
+    osg::ref_ptr<osg::RefMatrix> anchored = new osg::RefMatrix( osg::Matrixd::translate(_anchor) * mv );
+
+    cv->pushStateSet( _iconStateSet.get() );
+    cv->pushStateSet( slot._stateSet.get() );
+    cv->pushModelViewMatrix( anchored.get(), osg::Transform::RELATIVE_RF );
+    slot._geode->accept( *cv );
+    cv->popModelViewMatrix();
+    cv->popStateSet();
+    cv->popStateSet();
+
+    if ( _maxLabels > 0u )
+    {
+        updateLabels( slot, view._culled, width, height );
+        slot._labelCamera->accept( *cv );
+    }
+}
+
+void
+TrackBatchNode::updateLabels(Slot&                         slot,
+                             const TrackBatch::CullResult& culled,
+                             double                        width,
+                             double                        height)
+{
+    slot._labelCamera->setProjectionMatrixAsOrtho2D( 0.0, width, 0.0, height );
+
+    const float offset = 0.5f*(float)_iconSize + 2.0f;
+    unsigned numLabels = 0u;
+
+    for(unsigned k = 0; k < culled._indices.size() && numLabels < _maxLabels; ++k)
+    {
+        const std::string& label = _batch->getLabel( culled._indices[k] );
+        if ( label.empty() )
+            continue;
+
+        // grow the pool of text drawables as necessary.
+        if ( numLabels == slot._labels->getNumDrawables() )
+        {
+            osg::Drawable* d = AnnotationUtils::createTextDrawable( "", _labelSymbol.get(), osg::Vec3() );
+            d->setDataVariance( osg::Object::DYNAMIC );
+            slot._labels->addDrawable( d );
+            slot._labelText.push_back( std::string() );
+        }
+
+        osgText::Text* text = static_cast<osgText::Text*>( slot._labels->getDrawable(numLabels) );
+
+        // only re-layout the text if it changed.
+        if ( slot._labelText[numLabels] != label )
+        {
+            text->setText( label );
+            slot._labelText[numLabels] = label;
+        }
+
+        const osg::Vec2f& window = culled._window[k];
+        text->setPosition( osg::Vec3(window.x() + offset, window.y(), 0.0f) );
+
+        ++numLabels;
+    }
+
+    // blank out the leftovers.
+    for(unsigned i = numLabels; i < slot._labels->getNumDrawables(); ++i)
+    {
+        if ( !slot._labelText[i].empty() )
+        {
+            static_cast<osgText::Text*>( slot._labels->getDrawable(i) )->setText( "" );
+            slot._labelText[i].clear();
+        }
+    }
+}
@@ -22,8 +22,7 @@
 #include <osgEarthFeatures/TransformFilter>
 #include <osgEarthFeatures/BufferFilter>
 #include <osgEarthSymbology/Style>
-//TODO: replace this with GeometryRasterizer
-#include <osgEarthSymbology/AGG.h>
+#include <osgEarthSymbology/ScanlineRasterizer>
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/ImageUtils>
@@ -38,6 +37,8 @@
 #include "AGGLiteOptions"
 
 #include <sstream>
+#include <algorithm>
+#include <string.h>
 #include <OpenThreads/Mutex>
 #include <OpenThreads/ScopedLock>
 
@@ -49,67 +50,10 @@ using namespace osgEarth::Symbology;
 using namespace osgEarth::Drivers;
 using namespace OpenThreads;
 
-namespace
-{
-    struct float32
-    {
-        float32() : value(NO_DATA_VALUE) { }
-        float32(float v) : value(v) { }
-
-        float value;
-    };
-
-    struct span_coverage32
-    {
-        static void render(unsigned char* ptr, 
-                           int x,
-                           unsigned count, 
-                           const unsigned char* covers, 
-                           const float32& c)
-        {
-            unsigned char* p = ptr + (x << 2);
-            float* f = (float*)p;
-            do
-            {
-                unsigned char cover = *covers++;
-                int hasData = cover > 127;
-                *f++ = hasData ? c.value : NO_DATA_VALUE;
-            }
-            while(--count);
-        }
-
-        static void hline(unsigned char* ptr, 
-                          int x,
-                          unsigned count, 
-                          const float32& c)
-        {
-            unsigned char* p = ptr + (x << 2);
-            float* f = (float*)p;
-            do {
-                *f++ = c.value;
-            }
-            while(--count);
-        }
-
-        static float32 get(unsigned char* ptr, int x)
-        {
-            unsigned char* p = ptr + (x << 2);
-            float* f = (float*)p;
-            return float32(*f);
-        }
-    };
-}
-
 /********************************************************************/
 
 class AGGLiteRasterizerTileSource : public FeatureTileSource
 {
-public:
-    struct RenderFrame {
-        double xmin, ymin;
-        double xf, yf;
-    };
-
 public:
     AGGLiteRasterizerTileSource( const TileSourceOptions& options ) : FeatureTileSource( options ),
         _options( options )
@@ -134,18 +78,15 @@ public:
     //override
     bool preProcess(osg::Image* image, osg::Referenced* buildData)
     {
-        agg::rendering_buffer rbuf( image->data(), image->s(), image->t(), image->s()*4 );
-
         // clear the buffer.
         if ( _options.coverage() == true )
         {
-            agg::renderer<span_coverage32, float32> ren(rbuf);
-            ren.clear( float32(NO_DATA_VALUE) );
+            float* f = (float*)image->data();
+            std::fill( f, f + image->s()*image->t(), (float)NO_DATA_VALUE );
         }
         else
         {
-            agg::renderer<agg::span_abgr32, agg::rgba8> ren(rbuf);
-            ren.clear(agg::rgba8(0,0,0,0));
+            memset( image->data(), 0, image->getTotalSizeInBytes() );
         }
         return true;
     }
@@ -208,13 +149,6 @@ public:
             }
         }
 
-        // initialize:
-        RenderFrame frame;
-        frame.xmin = imageExtent.xMin();
-        frame.ymin = imageExtent.yMin();
-        frame.xf   = (double)image->s() / imageExtent.width();
-        frame.yf   = (double)image->t() / imageExtent.height();
-
         if ( lines.size() > 0 )
         {
             // We are buffering in the features native extent, so we need to use the
@@ -303,30 +237,20 @@ public:
         FilterContext polysContext = xform.push( polygons, context );
         FilterContext linesContext = xform.push( lines, context );
 
-        // set up the AGG renderer:
-        agg::rendering_buffer rbuf( image->data(), image->s(), image->t(), image->s()*4 );
+        // set up the rasterizer. All the features for this style go into a single
+        // batch, and are rendered in order in one pass over the image.
+        ScanlineRasterizer ras;
+        ras.setTransform(
+            imageExtent.xMin(), imageExtent.yMin(),
+            (double)image->s() / imageExtent.width(),
+            (double)image->t() / imageExtent.height() );
 
-        // Create the renderer and the rasterizer
-        agg::rasterizer ras;
+        ras.setFillRule( ScanlineRasterizer::FILL_EVEN_ODD );
 
-        // Setup the rasterizer
         if ( _options.coverage() == true )
-            ras.gamma(1.0);
+            ras.setGamma( 1.0 );
         else
-            ras.gamma(_options.gamma().get());
-
-        ras.filling_rule(agg::fill_even_odd);
-
-        // construct an extent for cropping the geometry to our tile.
-        // extend just outside the actual extents so we don't get edge artifacts:
-        GeoExtent cropExtent = GeoExtent(imageExtent);
-        cropExtent.scale(1.1, 1.1);
-
-        osg::ref_ptr<Symbology::Polygon> cropPoly = new Symbology::Polygon( 4 );
-        cropPoly->push_back( osg::Vec3d( cropExtent.xMin(), cropExtent.yMin(), 0 ));
-        cropPoly->push_back( osg::Vec3d( cropExtent.xMax(), cropExtent.yMin(), 0 ));
-        cropPoly->push_back( osg::Vec3d( cropExtent.xMax(), cropExtent.yMax(), 0 ));
-        cropPoly->push_back( osg::Vec3d( cropExtent.xMin(), cropExtent.yMax(), 0 ));
+            ras.setGamma( _options.gamma().get() );
 
         // If there's a coverage symbol, make a copy of the expressions so we can evaluate them
         optional<NumericExpression> covValue;
@@ -334,136 +258,64 @@ public:
         if (covsym && covsym->valueExpression().isSet())
             covValue = covsym->valueExpression().get();
 
-        // render the polygons
+        // queue the polygons. There is no need to crop them to the tile first;
+        // the rasterizer clips each edge to the image as it goes.
         for(FeatureList::iterator i = polygons.begin(); i != polygons.end(); i++)
         {
             Feature*  feature  = i->get();
             Geometry* geometry = feature->getGeometry();
+            if ( !geometry )
+                continue;
 
-            osg::ref_ptr<Geometry> croppedGeometry;
-            if ( geometry->crop( cropPoly.get(), croppedGeometry ) )
-            {
-                const PolygonSymbol* poly =
-                    feature->style().isSet() && feature->style()->has<PolygonSymbol>() ? feature->style()->get<PolygonSymbol>() :
-                    masterPoly;
+            const PolygonSymbol* poly =
+                feature->style().isSet() && feature->style()->has<PolygonSymbol>() ? feature->style()->get<PolygonSymbol>() :
+                masterPoly;
 
-                if ( _options.coverage() == true && covValue.isSet() )
-                {
-                    float value = (float)feature->eval(covValue.mutable_value(), &context);
-                    rasterizeCoverage(croppedGeometry.get(), value, frame, ras, rbuf);
-                }
-                else
-                {
-                    osg::Vec4f color = poly->fill()->color();
-                    rasterize(croppedGeometry.get(), color, frame, ras, rbuf);
-                }
-                
+            if ( _options.coverage() == true && covValue.isSet() )
+            {
+                float value = (float)feature->eval(covValue.mutable_value(), &context);
+                ras.addGeometry( geometry, value );
+            }
+            else
+            {
+                osg::Vec4f color = poly ? static_cast<osg::Vec4>(poly->fill()->color()) : osg::Vec4(1,1,1,1);
+                ras.addGeometry( geometry, scaleAlpha(color) );
             }
         }
 
-        // render the lines
+        // queue the lines
         for(FeatureList::iterator i = lines.begin(); i != lines.end(); i++)
         {
             Feature*  feature  = i->get();
             Geometry* geometry = feature->getGeometry();
+            if ( !geometry )
+                continue;
 
-            osg::ref_ptr<Geometry> croppedGeometry;
-            if ( geometry->crop( cropPoly.get(), croppedGeometry ) )
-            {
-                const LineSymbol* line =
-                    feature->style().isSet() && feature->style()->has<LineSymbol>() ? feature->style()->get<LineSymbol>() :
-                    masterLine;
-
-                if ( _options.coverage() == true && covValue.isSet() )
-                {
-                    float value = (float)feature->eval(covValue.mutable_value(), &context);
-                    rasterizeCoverage(croppedGeometry.get(), value, frame, ras, rbuf);
-                }
-                else
-                {   osg::Vec4f color = line ? static_cast<osg::Vec4>(line->stroke()->color()) : osg::Vec4(1,1,1,1);
-                    rasterize(croppedGeometry.get(), color, frame, ras, rbuf);
-                }
-            }
-        }
-
-        return true;
-    }
+            const LineSymbol* line =
+                feature->style().isSet() && feature->style()->has<LineSymbol>() ? feature->style()->get<LineSymbol>() :
+                masterLine;
 
-    //override
-    bool postProcess( osg::Image* image, osg::Referenced* data )
-    {
-        if ( _options.coverage() == false )
-        {
-            //convert from ABGR to RGBA
-            unsigned char* pixel = image->data();
-            for(int i=0; i<image->s()*image->t()*4; i+=4, pixel+=4)
+            if ( _options.coverage() == true && covValue.isSet() )
             {
-                std::swap( pixel[0], pixel[3] );
-                std::swap( pixel[1], pixel[2] );
+                float value = (float)feature->eval(covValue.mutable_value(), &context);
+                ras.addGeometry( geometry, value );
             }
-        }
-
-        return true;
-    }
-
-    // rasterizes a geometry to color
-    void rasterize(const Geometry* geometry, const osg::Vec4& color, RenderFrame& frame, 
-                   agg::rasterizer& ras, agg::rendering_buffer& buffer)
-    {
-        unsigned a = (unsigned)(127.0f+(color.a()*255.0f)/2.0f); // scale alpha up
-        agg::rgba8 fgColor = agg::rgba8( (unsigned)(color.r()*255.0f), (unsigned)(color.g()*255.0f), (unsigned)(color.b()*255.0f), a );
-        
-        ConstGeometryIterator gi( geometry );
-        while( gi.hasMore() )
-        {
-            const Geometry* g = gi.next();
-
-            for( Geometry::const_iterator p = g->begin(); p != g->end(); p++ )
+            else
             {
-                const osg::Vec3d& p0 = *p;
-                double x0 = frame.xf*(p0.x()-frame.xmin);
-                double y0 = frame.yf*(p0.y()-frame.ymin);
-
-                if ( p == g->begin() )
-                    ras.move_to_d( x0, y0 );
-                else
-                    ras.line_to_d( x0, y0 );
+                osg::Vec4f color = line ? static_cast<osg::Vec4>(line->stroke()->color()) : osg::Vec4(1,1,1,1);
+                ras.addGeometry( geometry, scaleAlpha(color) );
             }
         }
-        agg::renderer<agg::span_abgr32, agg::rgba8> ren(buffer);
-        ras.render(ren, fgColor);
 
-        ras.reset();
+        return ras.render( image );
     }
 
-
-    void rasterizeCoverage(const Geometry* geometry, float value, RenderFrame& frame, 
-                           agg::rasterizer& ras, agg::rendering_buffer& buffer)
+    // scales the alpha up so that translucent features remain visible
+    osg::Vec4f scaleAlpha(const osg::Vec4f& color) const
     {
-        ConstGeometryIterator gi( geometry );
-        while( gi.hasMore() )
-        {
-            const Geometry* g = gi.next();
-
-            for( Geometry::const_iterator p = g->begin(); p != g->end(); p++ )
-            {
-                const osg::Vec3d& p0 = *p;
-                double x0 = frame.xf*(p0.x()-frame.xmin);
-                double y0 = frame.yf*(p0.y()-frame.ymin);
-
-                if ( p == g->begin() )
-                    ras.move_to_d( x0, y0 );
-                else
-                    ras.line_to_d( x0, y0 );
-            }
-        }
-        
-        agg::renderer<span_coverage32, float32> ren(buffer);
-        ras.render(ren, value);
-        ras.reset();
+        return osg::Vec4f(color.r(), color.g(), color.b(), (127.0f+(color.a()*255.0f)/2.0f)/255.0f);
     }
 
-
     virtual std::string getExtension()  const 
     {
         return "png";
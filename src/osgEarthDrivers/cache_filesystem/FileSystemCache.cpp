@@ -25,6 +25,7 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/CacheContent>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <fstream>
@@ -34,7 +35,9 @@ using namespace osgEarth;
 using namespace osgEarth::Drivers;
 using namespace osgEarth::Threading;
 
-#ifndef _WIN32
+#ifdef _WIN32
+#   include <windows.h>
+#else
 #   include <unistd.h>
 #endif
 
@@ -42,6 +45,12 @@ using namespace osgEarth::Threading;
 #define OSG_EXT   ".osgb"
 #define OSG_COMPRESS
 
+// extension of a single-color image description (see CacheContent)
+#define COLOR_EXT ".color"
+
+// folder, under the bin, holding the shared payloads of a deduplicating bin
+#define BLOB_DIR  "blobs"
+
 namespace
 {
     /** 
@@ -72,6 +81,7 @@ namespace
         void init();
 
         std::string _rootPath;
+        bool        _deduplicate;
     };
 
     /** 
@@ -81,7 +91,7 @@ namespace
     class FileSystemCacheBin : public CacheBin
     {
     public:
-        FileSystemCacheBin( const std::string& name, const std::string& rootPath );
+        FileSystemCacheBin( const std::string& name, const std::string& rootPath, bool deduplicate );
 
     public: // CacheBin interface
 
@@ -103,6 +113,8 @@ namespace
 
         bool clear();
 
+        bool compact();
+
         Config readMetadata();
 
         bool writeMetadata( const Config& meta );
@@ -118,7 +130,14 @@ namespace
 
         const osgDB::Options* mergeOptions(const osgDB::Options* in);
 
+        // stores a serialized object under a key, sharing the file with any
+        // identical payload already in the bin; assumes the write lock is held.
+        bool writeShared(const std::string& path, const std::string& payload);
+
+        ReadResult readSingleColor(const URI& fileURI);
+
         bool                              _ok;
+        bool                              _deduplicate;
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
         std::string                       _binPath;        // full path to the bin's root folder
@@ -138,6 +157,38 @@ namespace
         }
     }
 
+    bool readFile( const std::string& fullPath, std::string& out )
+    {
+        std::ifstream in( fullPath.c_str(), std::ios::in | std::ios::binary );
+        if ( !in.is_open() )
+            return false;
+        std::stringstream buf;
+        buf << in.rdbuf();
+        out = buf.str();
+        return true;
+    }
+
+    bool writeFile( const std::string& fullPath, const std::string& data )
+    {
+        std::ofstream out( fullPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+        if ( !out.is_open() )
+            return false;
+        out.write( data.data(), data.size() );
+        out.close();
+        return !out.fail();
+    }
+
+    // Makes "link" another name for the file "target". The file system keeps
+    // the reference count: the data goes away when its last name does.
+    bool hardLink( const std::string& target, const std::string& link )
+    {
+#ifdef _WIN32
+        return ::CreateHardLinkA( link.c_str(), target.c_str(), NULL ) != 0;
+#else
+        return ::link( target.c_str(), link.c_str() ) == 0;
+#endif
+    }
+
     void readMeta( const std::string& fullPath, Config& meta )
     {
         std::ifstream inmeta( fullPath.c_str() );
@@ -178,19 +229,21 @@ namespace
         }
 
         _rootPath = URI( *fsco.rootPath(), options.referrer() ).full();
+        _deduplicate = fsco.deduplicate().get();
         init();
     }
 
     void
     FileSystemCache::init()
     {
-        OE_INFO << LC << "Opened a filesystem cache at \"" << _rootPath << "\"\n";
+        OE_INFO << LC << "Opened a filesystem cache at \"" << _rootPath << "\""
+            << (_deduplicate ? " (deduplicating)" : "") << "\n";
     }
 
     CacheBin*
     FileSystemCache::addBin( const std::string& name )
     {
-        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath ) );
+        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath, _deduplicate ) );
     }
 
     CacheBin*
@@ -202,7 +255,7 @@ namespace
             Threading::ScopedMutexLock lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin( "__default", _rootPath );
+                _defaultBin = new FileSystemCacheBin( "__default", _rootPath, _deduplicate );
             }
         }
         return _defaultBin.get();
@@ -288,10 +341,12 @@ namespace
     }
 
     FileSystemCacheBin::FileSystemCacheBin(const std::string&   binID,
-                                           const std::string&   rootPath) :
+                                           const std::string&   rootPath,
+                                           bool                 deduplicate) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok( true ),
+    _deduplicate        ( deduplicate )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
@@ -336,7 +391,7 @@ namespace
         std::string path = fileURI.full() + OSG_EXT;
 
         if ( !osgDB::fileExists(path) )
-            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+            return readSingleColor( fileURI );
 
         osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);     
 
@@ -373,7 +428,7 @@ namespace
         std::string path = fileURI.full() + OSG_EXT;
 
         if ( !osgDB::fileExists(path) )
-            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+            return readSingleColor( fileURI );
 
         osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
 
@@ -399,6 +454,35 @@ namespace
         }
     }
 
+    ReadResult
+    FileSystemCacheBin::readSingleColor(const URI& fileURI)
+    {
+        std::string path = fileURI.full() + COLOR_EXT;
+        if ( !osgDB::fileExists(path) )
+            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+
+        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
+
+        ScopedReadLock lock(_mutex);
+
+        std::string data;
+        if ( !readFile(path, data) )
+            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+
+        osg::ref_ptr<osg::Image> image = CacheContent::decodeSingleColor( data );
+        if ( !image.valid() )
+            return ReadResult( ReadResult::RESULT_READER_ERROR );
+
+        Config meta;
+        std::string metafile = fileURI.full() + ".meta";
+        if ( osgDB::fileExists(metafile) )
+            readMeta( metafile, meta );
+
+        ReadResult rr( image.get(), meta );
+        rr.setLastModifiedTime(timeStamp);
+        return rr;
+    }
+
     ReadResult
     FileSystemCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
     {
@@ -438,23 +522,56 @@ namespace
 
             osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
-            if ( dynamic_cast<const osg::Image*>(object) )
+            // a key holds either a serialized object or a single-color description,
+            // never both.
+            std::string objectPath = fileURI.full() + OSG_EXT;
+            std::string colorPath  = fileURI.full() + COLOR_EXT;
+
+            std::string singleColor;
+            if ( _deduplicate &&
+                 dynamic_cast<const osg::Image*>(object) &&
+                 CacheContent::encodeSingleColor(static_cast<const osg::Image*>(object), singleColor) )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
-                objWriteOK = r.success();
+                ::unlink( objectPath.c_str() );
+                objWriteOK = writeFile( colorPath, singleColor );
             }
-            else if ( dynamic_cast<const osg::Node*>(object) )
+            else if ( _deduplicate )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeNode(*static_cast<const osg::Node*>(object), filename, dbo.get());
-                objWriteOK = r.success();
+                ::unlink( colorPath.c_str() );
+
+                std::stringstream buf;
+                if ( dynamic_cast<const osg::Image*>(object) )
+                    r = _rw->writeImage( *static_cast<const osg::Image*>(object), buf, dbo.get() );
+                else if ( dynamic_cast<const osg::Node*>(object) )
+                    r = _rw->writeNode( *static_cast<const osg::Node*>(object), buf, dbo.get() );
+                else
+                    r = _rw->writeObject( *object, buf, dbo.get() );
+
+                objWriteOK = r.success() && writeShared( objectPath, buf.str() );
             }
             else
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeObject(*object, filename, dbo.get());
-                objWriteOK = r.success();
+                // The key may still name a payload shared with other keys, by a
+                // bin that was written with deduplication on; writing through it
+                // would change them all. Give the key a file of its own.
+                ::unlink( colorPath.c_str() );
+                ::unlink( objectPath.c_str() );
+
+                if ( dynamic_cast<const osg::Image*>(object) )
+                {
+                    r = _rw->writeImage( *static_cast<const osg::Image*>(object), objectPath, dbo.get() );
+                    objWriteOK = r.success();
+                }
+                else if ( dynamic_cast<const osg::Node*>(object) )
+                {
+                    r = _rw->writeNode(*static_cast<const osg::Node*>(object), objectPath, dbo.get());
+                    objWriteOK = r.success();
+                }
+                else
+                {
+                    r = _rw->writeObject(*object, objectPath, dbo.get());
+                    objWriteOK = r.success();
+                }
             }
 
             // write metadata
@@ -478,6 +595,41 @@ namespace
         return objWriteOK;
     }
 
+    bool
+    FileSystemCacheBin::writeShared(const std::string& path, const std::string& payload)
+    {
+        // shared payloads live under their content hash:
+        std::string hash = CacheContent::hash( payload );
+        std::string blobPath = osgDB::concatPaths(
+            osgDB::concatPaths( osgDB::concatPaths(_binPath, BLOB_DIR), hash.substr(0, 2) ),
+            hash + OSG_EXT );
+
+        bool shareable = true;
+        if ( osgDB::fileExists(blobPath) )
+        {
+            // the hash only narrows it down; make sure it really is the same payload.
+            std::string existing;
+            shareable = readFile(blobPath, existing) && existing == payload;
+        }
+        else
+        {
+            osgEarth::makeDirectoryForFile( blobPath );
+            shareable = writeFile( blobPath, payload );
+        }
+
+        ::unlink( path.c_str() );
+
+        if ( shareable && hardLink(blobPath, path) )
+        {
+            // all names of a file share its timestamp; this one was just written.
+            osgEarth::touchFile( path );
+            return true;
+        }
+
+        // no luck; store a private copy.
+        return writeFile( path, payload );
+    }
+
     CacheBin::RecordStatus
     FileSystemCacheBin::getRecordStatus(const std::string& key)
     {
@@ -486,7 +638,7 @@ namespace
 
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
-        if ( !osgDB::fileExists(path) )
+        if ( !osgDB::fileExists(path) && !osgDB::fileExists(fileURI.full() + COLOR_EXT) )
             return STATUS_NOT_FOUND;
 
         return STATUS_OK;
@@ -498,9 +650,12 @@ namespace
         if ( !binValidForReading() ) return false;
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
+        std::string colorPath( fileURI.full() + COLOR_EXT );
 
         ScopedWriteLock lock(_mutex);
-        return ::unlink( path.c_str() ) == 0;
+        bool removed = ::unlink( path.c_str() ) == 0;
+        removed = (::unlink( colorPath.c_str() ) == 0) || removed;
+        return removed;
     }
 
     bool
@@ -511,6 +666,8 @@ namespace
         std::string path( fileURI.full() + OSG_EXT );
 
         ScopedWriteLock lock(_mutex);
+        if ( !osgDB::fileExists(path) )
+            path = fileURI.full() + COLOR_EXT;
         return osgEarth::touchFile( path );
     }
 
@@ -566,6 +723,47 @@ namespace
         return purgeDirectory( binDir );
     }
 
+    bool
+    FileSystemCacheBin::compact()
+    {
+        if ( !binValidForReading() || !_deduplicate )
+            return false;
+
+#ifdef _WIN32
+        // stat() doesn't report link counts here, so we can't tell an
+        // orphaned payload from a shared one.
+        return false;
+#else
+        ScopedWriteLock lock(_mutex);
+
+        // a payload whose only name is the one in the blob folder is unused.
+        unsigned count = 0;
+        std::string blobDir = osgDB::concatPaths( _binPath, BLOB_DIR );
+        osgDB::DirectoryContents dirs = osgDB::getDirectoryContents( blobDir );
+        for( osgDB::DirectoryContents::iterator d = dirs.begin(); d != dirs.end(); ++d )
+        {
+            if ( d->compare(".") == 0 || d->compare("..") == 0 )
+                continue;
+
+            std::string dir = osgDB::concatPaths( blobDir, *d );
+            osgDB::DirectoryContents files = osgDB::getDirectoryContents( dir );
+            for( osgDB::DirectoryContents::iterator f = files.begin(); f != files.end(); ++f )
+            {
+                std::string full = osgDB::concatPaths( dir, *f );
+                struct stat buf;
+                if ( ::stat(full.c_str(), &buf) == 0 && S_ISREG(buf.st_mode) && buf.st_nlink == 1 )
+                {
+                    if ( ::unlink(full.c_str()) == 0 )
+                        ++count;
+                }
+            }
+        }
+
+        OE_INFO << LC << "Bin " << getID() << ": removed " << count << " unused payload(s)" << std::endl;
+        return true;
+#endif
+    }
+
     Config
     FileSystemCacheBin::readMetadata()
     {
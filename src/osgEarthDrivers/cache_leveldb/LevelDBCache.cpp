@@ -35,7 +35,7 @@
 
 #define OSGEARTH_ENV_CACHE_MAX_SIZE_MB "OSGEARTH_CACHE_MAX_SIZE_MB"
 
-#define LEVELDB_CACHE_VERSION 1
+#define LEVELDB_CACHE_VERSION 2
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers::LevelDBCache;
@@ -103,6 +103,11 @@ _active        ( true )
 
 LevelDBCacheImpl::~LevelDBCacheImpl()
 {
+    if ( _touchQueue.valid() )
+    {
+        _touchQueue->stop();
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -133,6 +138,10 @@ LevelDBCacheImpl::init()
     if ( _db )
     {
         _tracker->calcSize();
+
+        // Record touches are applied in the background.
+        _touchQueue = new TouchQueue(_db, _tracker.get());
+        _touchQueue->startThread();
     }
 
     if ( _active )
@@ -179,7 +188,7 @@ CacheBin*
 LevelDBCacheImpl::addBin( const std::string& name )
 {
     return _db ?
-        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get())) :
+        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get(), _touchQueue.get())) :
         0L;
 }
 
@@ -195,7 +204,7 @@ LevelDBCacheImpl::getOrCreateDefaultBin()
         Threading::ScopedMutexLock lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get());
+            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get(), _touchQueue.get());
         }
     }
     return _defaultBin.get();
@@ -17,9 +17,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "LevelDBCacheBin"
+#include "RecordHeader"
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/Random>
+#include <osgEarth/CacheContent>
 #include <osgDB/Registry>
 #include <leveldb/write_batch.h>
 #include <string>
@@ -66,6 +68,36 @@ namespace
     {
         blend(data, seed);
     }
+
+    // A data record whose payload is shared with other records holds a
+    // reference instead: this magic followed by the hash of the payload.
+    // The payload itself lives under the "c" key of that hash, prefixed
+    // with its reference count.
+    const char REFERENCE_MAGIC[] = "OECR";
+
+    bool isReference(const std::string& payload)
+    {
+        return payload.size() > 4 && payload.compare(0, 4, REFERENCE_MAGIC) == 0;
+    }
+
+    void encodeCount(unsigned count, const std::string& payload, std::string& out)
+    {
+        out.resize(4);
+        for(int i=0; i<4; ++i, count >>= 8)
+            out[i] = (char)(count & 0xff);
+        out.append(payload);
+    }
+
+    unsigned decodeCount(const std::string& value)
+    {
+        if ( value.size() < 4 )
+            return 0u;
+        return
+              (unsigned)(unsigned char)value[0]
+            | (unsigned)(unsigned char)value[1] << 8
+            | (unsigned)(unsigned char)value[2] << 16
+            | (unsigned)(unsigned char)value[3] << 24;
+    }
 }
 
 //------------------------------------------------------------------------
@@ -76,15 +108,17 @@ namespace
 #undef  OE_TEST
 #define OE_TEST OE_NOTICE
 
-#define TIME_FIELD "leveldb.time"
+#define TIME_FIELD LEVELDB_TIME_FIELD
 
 
 LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
                                  leveldb::DB*       db,
-                                 Tracker*           tracker) :
+                                 Tracker*           tracker,
+                                 TouchQueue*        touchQueue) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
+_touchQueue       ( touchQueue ),
 _debug            ( false )
 {
     // reader to parse data:
@@ -226,6 +260,12 @@ LevelDBCacheBin::timeEndGlobal() const
     return "t" + SEP + "\xff";
 }
 
+std::string
+LevelDBCacheBin::sharedKey(const std::string& hash) const
+{
+    return "c" + SEP + hash;
+}
+
 ReadResult
 LevelDBCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -254,46 +294,78 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     ++_tracker->reads;
 
     Config metadata;
+    TimeStamp lastModified = (TimeStamp)0;
     leveldb::Status status;
     leveldb::ReadOptions ro;
 
-    // first read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
-        
-    // next read the data record.
-    std::string datakey = dataKey(key);
+    // read the data record; it carries its own header.
     std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
+    status = _db->Get( ro, dataKey(key), &datavalue );
     if ( !status.ok() )
     {
         // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
     }
 
+    RecordHeader header;
+    if ( RecordHeader::decode(datavalue.data(), datavalue.size(), header) )
+    {
+        lastModified = header._timeStamp;
+        if ( header._metaLength > 0 )
+            metadata.fromJSON( datavalue.substr(RecordHeader::SIZE, header._metaLength) );
+        datavalue.erase(0, header.payloadOffset());
+    }
+    else
+    {
+        // version 1 record: the metadata lives in its own record.
+        std::string metavalue;
+        if ( _db->Get( ro, metaKey(key), &metavalue ).ok() )
+        {
+            decodeMeta(metavalue, metadata);
+            DateTime t( metadata.value(TIME_FIELD));
+            lastModified = t.asTimeStamp();
+
+            // rewrite it in the current format so the next read is a single Get.
+            upgrade(key, metadata, datavalue);
+        }
+    }
+
     // blend the data string
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
-    std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    // the payload may be shared with other records:
+    if ( isReference(datavalue) && !resolve(datavalue) )
     {
-        OE_WARN << LC << "Cache read failure!"
-            << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
-            << "\n";
+        OE_WARN << LC << "Bin " << getID() << ": shared payload of (" << key << ") is missing" << std::endl;
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+    }
+
+    osg::ref_ptr<osg::Object> object;
 
-        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    if ( CacheContent::isSingleColor(datavalue) )
+    {
+        // a uniform image, stored as its color.
+        object = CacheContent::decodeSingleColor(datavalue);
+        if ( !object.valid() )
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
+    else
+    {
+        // finally, decode the OSGB stream into an object.
+        std::istringstream datastream(datavalue);
+        osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+        if ( !r.success() )
+        {
+            OE_WARN << LC << "Cache read failure!"
+                << "\n reader = " << reader.name()
+                << "\n error detail = " << r.message()
+                << "\n data value = " << datavalue
+                << "\n";
+
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+        object = r.getObject();
     }
         
     if ( _debug )
@@ -304,13 +376,11 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     // if there's a size limit, we need to 'touch' the record.
     if ( _tracker->hasSizeLimit() )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        _touchQueue->touch( binDataKeyTuple(key), false );
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
@@ -343,8 +413,16 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
 
     std::string       data;
     std::stringstream datastream;
+    std::string       singleColor;
 
-    if ( dynamic_cast<const osg::Image*>(object) )
+    if ( _tracker->deduplicate() &&
+         dynamic_cast<const osg::Image*>(object) &&
+         CacheContent::encodeSingleColor(static_cast<const osg::Image*>(object), singleColor) )
+    {
+        // a uniform image needs only its color; no need to share it.
+        objWriteOK = true;
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
     {
         if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
         {
@@ -380,22 +458,46 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
         DateTime now;
         leveldb::WriteBatch batch;
 
-        // write the data:
-        data = datastream.str();
-        if ( _tracker->seed().isSet() )
-            blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
+        // the reference counts of shared payloads must agree with the
+        // records that hold them. (Released before postWrite(), which may
+        // purge and takes the same lock.)
+        {
+            ScopedMutexLock lock( _tracker->sharedMutex() );
+
+            // the record we're replacing, if any, may hold a reference:
+            std::string previous;
+            bool replacing = _db->Get( leveldb::ReadOptions(), dataKey(key), &previous ).ok();
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+            // write the data, prefixed with the record header:
+            std::string payload = singleColor.empty() ? datastream.str() : singleColor;
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+            std::string reference;
+            if ( _tracker->deduplicate() && singleColor.empty() && share(payload, reference) )
+                payload = reference;
 
-        objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+            if ( _tracker->seed().isSet() )
+                blend(payload, _tracker->seed().value());
+
+            std::string metavalue;
+            if ( !meta.empty() )
+                encodeMeta( meta, metavalue );
+
+            RecordHeader::encode( now.asTimeStamp(), metavalue, payload, data );
+            batch.Put( dataKey(key), data );
+
+            // write the timestamp index:
+            batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+
+            // write the access time:
+            batch.Put( metaKey(key), now.asCompactISO8601() );
+
+            objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+
+            if ( objWriteOK && replacing )
+                release( previous );
+            else if ( !objWriteOK && !reference.empty() )
+                release( data );
+        }
 
         if ( objWriteOK )
         {
@@ -419,6 +521,79 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     return objWriteOK;
 }
 
+bool
+LevelDBCacheBin::share(const std::string& payload, std::string& reference)
+{
+    std::string hash = CacheContent::hash(payload);
+    std::string key  = sharedKey(hash);
+
+    std::string stored = payload;
+    if ( _tracker->seed().isSet() )
+        blend(stored, _tracker->seed().value());
+
+    unsigned count = 0u;
+    std::string value;
+    if ( _db->Get(leveldb::ReadOptions(), key, &value).ok() )
+    {
+        // the hash only narrows it down; make sure it really is the same payload.
+        if ( value.size() < 4 || value.compare(4, std::string::npos, stored) != 0 )
+            return false;
+        count = decodeCount(value);
+    }
+
+    encodeCount(count+1, stored, value);
+    if ( _db->Put(leveldb::WriteOptions(), key, value).ok() == false )
+        return false;
+
+    reference = std::string(REFERENCE_MAGIC) + hash;
+    return true;
+}
+
+bool
+LevelDBCacheBin::resolve(std::string& payload)
+{
+    std::string value;
+    if ( _db->Get(leveldb::ReadOptions(), sharedKey(payload.substr(4)), &value).ok() == false )
+        return false;
+
+    payload = value.substr(4);
+    if ( _tracker->seed().isSet() )
+        unblend(payload, _tracker->seed().value());
+    return true;
+}
+
+void
+LevelDBCacheBin::release(const std::string& record)
+{
+    RecordHeader header;
+    if ( !RecordHeader::decode(record.data(), record.size(), header) )
+        return;
+
+    std::string payload = record.substr(header.payloadOffset());
+    if ( _tracker->seed().isSet() )
+        unblend(payload, _tracker->seed().value());
+
+    if ( !isReference(payload) )
+        return;
+
+    std::string key = sharedKey(payload.substr(4));
+    std::string value;
+    if ( _db->Get(leveldb::ReadOptions(), key, &value).ok() == false )
+        return;
+
+    unsigned count = decodeCount(value);
+    if ( count > 1u )
+    {
+        std::string shared;
+        encodeCount(count-1, value.substr(4), shared);
+        _db->Put(leveldb::WriteOptions(), key, shared);
+    }
+    else
+    {
+        _db->Delete(leveldb::WriteOptions(), key);
+    }
+}
+
 void
 LevelDBCacheBin::postWrite()
 {
@@ -488,16 +663,22 @@ LevelDBCacheBin::remove(const std::string& key)
     if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime t(metadata.value(TIME_FIELD));
+    ScopedMutexLock lock( _tracker->sharedMutex() );
+
+    std::string datavalue;
+    bool found = _db->Get(leveldb::ReadOptions(), dataKey(key), &datavalue).ok();
 
     leveldb::WriteBatch batch;
     batch.Delete( dataKey(key) );
     batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
+    batch.Delete( timeKey(DateTime(TouchQueue::getAccessTime(metavalue)), key) );
         
     leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
+    if ( status.ok() && found )
+    {
+        release( datavalue );
+    }
+
     if ( !status.ok() )
     {
         OE_WARN << LC << "Failed to remove (" << key << ") from bin " << getID() << std::endl;
@@ -517,39 +698,14 @@ LevelDBCacheBin::touch(const std::string& key)
     if ( !binValidForWriting() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
-        return false;
-
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime oldtime(metadata.value(TIME_FIELD));
-        
-    leveldb::WriteBatch batch;
+    // Resets the last-modified time; applied asynchronously.
+    _touchQueue->touch( binDataKeyTuple(key), true );
 
-    // In a transaction, update the metadata record with the current time.
-    std::string newtime = DateTime().asCompactISO8601();
-    metadata.set(TIME_FIELD, newtime);
-    encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
-
-    // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
-
-    // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
-
-    leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
-    if ( !status.ok() )
-    {
-        OE_WARN << LC << "Failed to touch (" << key << ") in bin " << getID() << std::endl;
-    }
-    else if ( _debug )
+    if ( _debug )
     {
         OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
     }
-    return status.ok();
+    return true;
 }
 
 bool
@@ -558,8 +714,11 @@ LevelDBCacheBin::clear()
     if ( !binValidForWriting() )
         return false;
     
+    ScopedMutexLock lock( _tracker->sharedMutex() );
+
     leveldb::WriteOptions wo;
     std::string binphrase = binPhrase();
+    std::string databegin = dataBegin();
     leveldb::WriteBatch batch;
     leveldb::Iterator* i = _db->NewIterator(leveldb::ReadOptions());
     for(i->SeekToFirst(); i->Valid(); i->Next())
@@ -567,6 +726,9 @@ LevelDBCacheBin::clear()
         std::string key = i->key().ToString();
         if ( key.find(binphrase) != std::string::npos )
         {
+            if ( key.compare(0, databegin.size(), databegin) == 0 )
+                release( i->value().ToString() );
+
             _db->Delete( wo, i->key() );
         }
     }
@@ -586,12 +748,72 @@ LevelDBCacheBin::compact()
     if ( !binValidForWriting() )
         return false;
 
+    // bring any version 1 records up to date first.
+    unsigned count = migrate();
+    if ( count > 0 )
+    {
+        OE_INFO << LC << "Bin " << getID() << ": migrated " << count << " record(s)" << std::endl;
+    }
+
     // This could take a while.
     _db->CompactRange(0L, 0L);
 
     return false;
 }
 
+bool
+LevelDBCacheBin::upgrade(const std::string& key, const Config& legacyMeta, const std::string& payload)
+{
+    DateTime t(legacyMeta.value(TIME_FIELD));
+
+    std::string usermeta;
+    Config metadata(legacyMeta);
+    metadata.remove(TIME_FIELD);
+    if ( !metadata.empty() )
+        encodeMeta(metadata, usermeta);
+
+    std::string data;
+    RecordHeader::encode(t.asTimeStamp(), usermeta, payload, data);
+
+    // the access time and its index record are unchanged.
+    leveldb::WriteBatch batch;
+    batch.Put( dataKey(key), data );
+    batch.Put( metaKey(key), t.asCompactISO8601() );
+    return _db->Write(leveldb::WriteOptions(), &batch).ok();
+}
+
+unsigned
+LevelDBCacheBin::migrate()
+{
+    leveldb::ReadOptions ro;
+    std::string limit = dataEnd();
+    std::string prefix = dataBegin();
+    unsigned count = 0;
+
+    leveldb::Iterator* it = _db->NewIterator(ro);
+    for(it->Seek(prefix); it->Valid() && it->key().ToString() < limit; it->Next())
+    {
+        RecordHeader header;
+        if ( RecordHeader::decode(it->value().data(), it->value().size(), header) )
+            continue;
+
+        std::string key = it->key().ToString().substr(prefix.size());
+
+        // the version 1 metadata record holds the timestamp and user metadata.
+        std::string metavalue;
+        if ( _db->Get(ro, metaKey(key), &metavalue).ok() == false )
+            continue;
+
+        Config metadata;
+        decodeMeta(metavalue, metadata);
+        if ( upgrade(key, metadata, it->value().ToString()) )
+            ++count;
+    }
+    delete it;
+
+    return count;
+}
+
 unsigned
 LevelDBCacheBin::getStorageSize()
 {
@@ -659,6 +881,8 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
     if ( !binValidForWriting() )
         return false;
 
+    ScopedMutexLock lock( _tracker->sharedMutex() );
+
     leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
 
     unsigned count = 0;
@@ -674,6 +898,10 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
 
         std::string tuple = it->value().ToString();
 
+        std::string datavalue;
+        if ( _db->Get(leveldb::ReadOptions(), dataKeyFromTuple(tuple), &datavalue).ok() )
+            release( datavalue );
+
         // doing this in a WriteBatch did not work. The size of the
         // database would never go down.
         leveldb::WriteOptions wo;
@@ -37,7 +37,7 @@
 
 #define OSGEARTH_ENV_CACHE_MAX_SIZE_MB "OSGEARTH_CACHE_MAX_SIZE_MB"
 
-#define ROCKSDB_CACHE_VERSION 1
+#define ROCKSDB_CACHE_VERSION 2
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers::RocksDBCache;
@@ -105,6 +105,11 @@ _active        ( true )
 
 RocksDBCacheImpl::~RocksDBCacheImpl()
 {
+    if ( _touchQueue.valid() )
+    {
+        _touchQueue->stop();
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -135,6 +140,10 @@ RocksDBCacheImpl::init()
     if ( _db )
     {
         _tracker->calcSize();
+
+        // Record touches are applied in the background.
+        _touchQueue = new TouchQueue(_db, _tracker.get());
+        _touchQueue->startThread();
     }
 
     if ( _active )
@@ -200,7 +209,7 @@ CacheBin*
 RocksDBCacheImpl::addBin( const std::string& name )
 {
     return _db ?
-        _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, _tracker.get())) :
+        _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, _tracker.get(), _touchQueue.get())) :
         0L;
 }
 
@@ -216,7 +225,7 @@ RocksDBCacheImpl::getOrCreateDefaultBin()
         Threading::ScopedMutexLock lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new RocksDBCacheBin("_default", _db, _tracker.get());
+            _defaultBin = new RocksDBCacheBin("_default", _db, _tracker.get(), _touchQueue.get());
         }
     }
     return _defaultBin.get();
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "RocksDBCacheBin"
+#include "RecordHeader"
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/Random>
@@ -76,15 +77,17 @@ namespace
 #undef  OE_TEST
 #define OE_TEST OE_NOTICE
 
-#define TIME_FIELD "rocksdb.time"
+#define TIME_FIELD ROCKSDB_TIME_FIELD
 
 
 RocksDBCacheBin::RocksDBCacheBin(const std::string& binID,
                                  rocksdb::DB*       db,
-                                 Tracker*           tracker) :
+                                 Tracker*           tracker,
+                                 TouchQueue*        touchQueue) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
+_touchQueue       ( touchQueue ),
 _debug            ( false )
 {
     // reader to parse data:
@@ -248,30 +251,46 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     ++_tracker->reads;
 
     Config metadata;
+    TimeStamp lastModified = (TimeStamp)0;
     rocksdb::Status status;
     rocksdb::ReadOptions ro;
 
-    // first read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
-        
-    // next read the data record.
-    std::string datakey = dataKey(key);
-    std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
+    // read the data record; it carries its own header. Pinning the value
+    // avoids a copy out of the block cache.
+    rocksdb::PinnableSlice record;
+    status = _db->Get( ro, _db->DefaultColumnFamily(), dataKey(key), &record );
     if ( !status.ok() )
     {
         // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
     }
 
+    std::string datavalue;
+    RecordHeader header;
+    if ( RecordHeader::decode(record.data(), record.size(), header) )
+    {
+        lastModified = header._timeStamp;
+        if ( header._metaLength > 0 )
+            metadata.fromJSON( std::string(record.data() + RecordHeader::SIZE, header._metaLength) );
+        datavalue.assign(record.data() + header.payloadOffset(), record.size() - header.payloadOffset());
+    }
+    else
+    {
+        datavalue = record.ToString();
+
+        // version 1 record: the metadata lives in its own record.
+        std::string metavalue;
+        if ( _db->Get( ro, metaKey(key), &metavalue ).ok() )
+        {
+            decodeMeta(metavalue, metadata);
+            DateTime t( metadata.value(TIME_FIELD));
+            lastModified = t.asTimeStamp();
+
+            // rewrite it in the current format so the next read is a single Get.
+            upgrade(key, metadata, datavalue);
+        }
+    }
+
     // blend the data string
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
@@ -298,9 +317,7 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     // if there's a size limit, we need to 'touch' the record.
     if ( _tracker->hasSizeLimit() )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        _touchQueue->touch( binDataKeyTuple(key), false );
     }
 
     ++_tracker->hits;
@@ -374,22 +391,30 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
         DateTime now;
         rocksdb::WriteBatch batch;
 
-        // write the data:
-        data = datastream.str();
+        // write the data, prefixed with the record header:
+        std::string payload = datastream.str();
         if ( _tracker->seed().isSet() )
-            blend(data, _tracker->seed().value());
+            blend(payload, _tracker->seed().value());
+
+        std::string metavalue;
+        if ( !meta.empty() )
+            encodeMeta( meta, metavalue );
+
+        RecordHeader::encode( now.asTimeStamp(), metavalue, payload, data );
         batch.Put( dataKey(key), data );
 
         // write the timestamp index:
         batch.Put( timeKey(now, key), binDataKeyTuple(key) );
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+        // write the access time:
+        batch.Put( metaKey(key), now.asCompactISO8601() );
 
-        objWriteOK = _db->Write( rocksdb::WriteOptions(), &batch ).ok();
+        // the index records must not interleave with a touch. (Released before
+        // postWrite(), which may purge and takes the same lock.)
+        {
+            ScopedMutexLock lock( _tracker->indexMutex() );
+            objWriteOK = _db->Write( rocksdb::WriteOptions(), &batch ).ok();
+        }
 
         if ( objWriteOK )
         {
@@ -477,19 +502,17 @@ RocksDBCacheBin::remove(const std::string& key)
     if ( !binValidForReading() )
         return false;
 
+    ScopedMutexLock lock( _tracker->indexMutex() );
+
     // first read in the time from the metadata record.
     std::string metavalue;
     if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime t(metadata.value(TIME_FIELD));
-
     rocksdb::WriteBatch batch;
     batch.Delete( dataKey(key) );
     batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
+    batch.Delete( timeKey(DateTime(TouchQueue::getAccessTime(metavalue)), key) );
         
     rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
     if ( !status.ok() )
@@ -511,39 +534,14 @@ RocksDBCacheBin::touch(const std::string& key)
     if ( !binValidForWriting() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
-        return false;
-
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime oldtime(metadata.value(TIME_FIELD));
-        
-    rocksdb::WriteBatch batch;
-
-    // In a transaction, update the metadata record with the current time.
-    std::string newtime = DateTime().asCompactISO8601();
-    metadata.set(TIME_FIELD, newtime);
-    encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
+    // Resets the last-modified time; applied asynchronously.
+    _touchQueue->touch( binDataKeyTuple(key), true );
 
-    // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
-
-    // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
-
-    rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
-    if ( !status.ok() )
-    {
-        OE_WARN << LC << "Failed to touch (" << key << ") in bin " << getID() << std::endl;
-    }
-    else if ( _debug )
+    if ( _debug )
     {
         OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
     }
-    return status.ok();
+    return true;
 }
 
 bool
@@ -552,6 +550,8 @@ RocksDBCacheBin::clear()
     if ( !binValidForWriting() )
         return false;
     
+    ScopedMutexLock lock( _tracker->indexMutex() );
+
     rocksdb::WriteOptions wo;
     std::string binphrase = binPhrase();
     rocksdb::WriteBatch batch;
@@ -580,12 +580,72 @@ RocksDBCacheBin::compact()
     if ( !binValidForWriting() )
         return false;
 
+    // bring any version 1 records up to date first.
+    unsigned count = migrate();
+    if ( count > 0 )
+    {
+        OE_INFO << LC << "Bin " << getID() << ": migrated " << count << " record(s)" << std::endl;
+    }
+
     // This could take a while.
     _db->CompactRange(0L, 0L);
 
     return false;
 }
 
+bool
+RocksDBCacheBin::upgrade(const std::string& key, const Config& legacyMeta, const std::string& payload)
+{
+    DateTime t(legacyMeta.value(TIME_FIELD));
+
+    std::string usermeta;
+    Config metadata(legacyMeta);
+    metadata.remove(TIME_FIELD);
+    if ( !metadata.empty() )
+        encodeMeta(metadata, usermeta);
+
+    std::string data;
+    RecordHeader::encode(t.asTimeStamp(), usermeta, payload, data);
+
+    // the access time and its index record are unchanged.
+    rocksdb::WriteBatch batch;
+    batch.Put( dataKey(key), data );
+    batch.Put( metaKey(key), t.asCompactISO8601() );
+    return _db->Write(rocksdb::WriteOptions(), &batch).ok();
+}
+
+unsigned
+RocksDBCacheBin::migrate()
+{
+    rocksdb::ReadOptions ro;
+    std::string limit = dataEnd();
+    std::string prefix = dataBegin();
+    unsigned count = 0;
+
+    rocksdb::Iterator* it = _db->NewIterator(ro);
+    for(it->Seek(prefix); it->Valid() && it->key().ToString() < limit; it->Next())
+    {
+        RecordHeader header;
+        if ( RecordHeader::decode(it->value().data(), it->value().size(), header) )
+            continue;
+
+        std::string key = it->key().ToString().substr(prefix.size());
+
+        // the version 1 metadata record holds the timestamp and user metadata.
+        std::string metavalue;
+        if ( _db->Get(ro, metaKey(key), &metavalue).ok() == false )
+            continue;
+
+        Config metadata;
+        decodeMeta(metavalue, metadata);
+        if ( upgrade(key, metadata, it->value().ToString()) )
+            ++count;
+    }
+    delete it;
+
+    return count;
+}
+
 unsigned
 RocksDBCacheBin::getStorageSize()
 {
@@ -653,6 +713,8 @@ RocksDBCacheBin::purgeOldest(unsigned maxnum)
     if ( !binValidForWriting() )
         return false;
 
+    ScopedMutexLock lock( _tracker->indexMutex() );
+
     rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
 
     unsigned count = 0;
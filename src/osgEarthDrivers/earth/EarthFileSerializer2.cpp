@@ -331,13 +331,17 @@ namespace
         return 0L;
     }
 
-    bool addLayer(const Config& conf, Map* map)
+    // Creates a layer and queues it for adding to the map.
+    bool createLayer(const Config& conf, LayerVector& layers, const MapSnapshot* snapshot)
     {
         std::string name = conf.key();
         Layer* layer = Layer::create(name, conf);
         if (layer)
         {
-            map->addLayer(layer);
+            if (snapshot)
+                snapshot->apply(layer, layers.size());
+
+            layers.push_back(layer);
         }
         return layer != 0L;
     }
@@ -408,6 +412,9 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
     // Start a batch update of the map:
     map->beginUpdate();
 
+    // Layers are collected and added in batches, so the map can open them concurrently.
+    LayerVector layers;
+
     // Read all the elevation layers in FIRST so other layers can access them for things like clamping.
     // TODO: revisit this since we should really be listening for elevation data changes and
     // re-clamping based on that..
@@ -418,15 +425,18 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         {
             Config temp = *i;
             temp.key() = "elevation";
-            addLayer(temp, map);
+            createLayer(temp, layers, _snapshot.get());
         }
 
         else if ( i->key() == "elevation" ) // || i->key() == "heightfield" )
         {
-            addLayer(*i, map);
+            createLayer(*i, layers, _snapshot.get());
         }
     }
 
+    map->addLayers(layers);
+    unsigned numElevationLayers = layers.size();
+
     Config externalConfig;
     std::vector<osg::ref_ptr<Extension> > extensions;
 
@@ -471,7 +481,7 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         else if ( !isReservedWord(i->key()) ) // plugins/extensions.
         {
             // try to add as a plugin Layer first:
-            bool addedLayer = addLayer(*i, map); 
+            bool addedLayer = createLayer(*i, layers, _snapshot.get()); 
 
             // failing that, try to load as an extension:
             if ( !addedLayer )
@@ -483,6 +493,8 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         }
     }
 
+    map->addLayers(LayerVector(layers.begin() + numElevationLayers, layers.end()));
+
     // Complete the batch update of the map
     map->endUpdate();
 
@@ -21,11 +21,14 @@
 #include <osgEarth/MapNode>
 #include <osgEarth/Registry>
 #include <osgEarth/XmlUtils>
+#include <osgEarth/MapSnapshot>
+#include <osgEarth/StringUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <string>
 #include <sstream>
+#include <cstdlib>
 #include <osgEarthUtil/Common>
 
 using namespace osgEarth_osgearth;
@@ -68,6 +71,13 @@ using namespace osgEarth;
 // cause the writer to try making absolute paths relative to the new save location.
 #define EARTH_REWRITE_ABSOLUTE_PATHS "RewriteAbsolutePaths"
 
+// Load the map from a binary snapshot ("file.earth.snapshot") if there is an
+// up-to-date one; otherwise load the earth file and write a snapshot for next
+// time. Setting the OSGEARTH_EARTH_SNAPSHOT environment variable does the same.
+// Only the earth file itself is checked for changes; delete the snapshot after
+// editing a file it includes, or after changing the data behind a layer.
+#define EARTH_USE_SNAPSHOT "UseSnapshot"
+
 
 namespace
 {
@@ -217,12 +227,82 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
 
                 URIContext( fullFileName ).store( myReadOptions.get() );
 
+                if ( useSnapshot(readOptions) && !osgDB::containsServerAddress(fullFileName) )
+                {
+                    return readNodeWithSnapshot( r.getString(), fullFileName, myReadOptions.get() );
+                }
+
                 std::stringstream in( r.getString() );
                 return readNode( in, myReadOptions.get() );
             }
         }
 
         virtual ReadResult readNode(std::istream& in, const osgDB::Options* readOptions) const
+        {
+            Config conf;
+            if ( !parse(in, readOptions, conf) )
+                return ReadResult::ERROR_IN_READING_FILE;
+
+            osg::ref_ptr<osg::Node> node = build( conf, readOptions, 0L );
+            return ReadResult(node.get());
+        }
+
+    private:
+
+        bool useSnapshot(const osgDB::Options* options) const
+        {
+            if ( ::getenv("OSGEARTH_EARTH_SNAPSHOT") )
+                return true;
+
+            return
+                options &&
+                toLower(options->getOptionString()).find(toLower(EARTH_USE_SNAPSHOT)) != std::string::npos;
+        }
+
+        // Loads the map from an up-to-date snapshot, or from the earth file
+        // (in which case it records a new snapshot).
+        ReadResult readNodeWithSnapshot(const std::string& earthFile, const std::string& fileName, const osgDB::Options* readOptions) const
+        {
+            std::string snapshotFile = fileName + ".snapshot";
+
+            // The snapshot is only good for this exact file, location and set of default options.
+            std::string hashInput = fileName + "\n" + earthFile;
+            if ( readOptions )
+                hashInput += "\n" + readOptions->getPluginStringData("osgEarth.defaultOptions");
+            std::string hash = hashToString( hashInput );
+
+            osg::ref_ptr<MapSnapshot> snapshot = MapSnapshot::read( snapshotFile );
+            if ( snapshot.valid() && snapshot->getSourceHash() == hash )
+            {
+                OE_INFO << LC << "Loading from snapshot " << snapshotFile << std::endl;
+                osg::ref_ptr<osg::Node> node = build( snapshot->getMapConfig(), readOptions, snapshot.get() );
+                return ReadResult(node.get());
+            }
+
+            Config conf;
+            std::stringstream in( earthFile );
+            if ( !parse(in, readOptions, conf) )
+                return ReadResult::ERROR_IN_READING_FILE;
+
+            osg::ref_ptr<osg::Node> node = build( conf, readOptions, 0L );
+
+            // version 1 files cannot be restored from a snapshot.
+            MapNode* mapNode = MapNode::get(node.get());
+            if ( mapNode && conf.value("version") != "1" )
+            {
+                snapshot = new MapSnapshot( conf, mapNode->getMap() );
+                snapshot->setSourceHash( hash );
+                if ( snapshot->write(snapshotFile) )
+                {
+                    OE_INFO << LC << "Wrote snapshot " << snapshotFile << std::endl;
+                }
+            }
+
+            return ReadResult(node.get());
+        }
+
+        // Parses earth file XML into the map Config, merging in any default options.
+        bool parse(std::istream& in, const osgDB::Options* readOptions, Config& conf) const
         {
             // pull the URI context from the options structure (since we're reading
             // from an "anonymous" stream here)
@@ -230,23 +310,56 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
 
             osg::ref_ptr<XmlDocument> doc = XmlDocument::load( in, uriContext );
             if ( !doc.valid() )
-                return ReadResult::ERROR_IN_READING_FILE;
+                return false;
 
             Config docConf = doc->getConfig();
 
             // support both "map" and "earth" tag names at the top level
-            Config conf;
             if ( docConf.hasChild( "map" ) )
                 conf = docConf.child( "map" );
             else if ( docConf.hasChild( "earth" ) )
                 conf = docConf.child( "earth" );
 
+            if ( !conf.empty() && conf.value("version") != "1" )
+            {
+                // attempt to parse a "default options" JSON string:
+                std::string defaultConfStr;
+                if ( readOptions )
+                {
+                    defaultConfStr = readOptions->getPluginStringData("osgEarth.defaultOptions");
+                    if ( !defaultConfStr.empty() )
+                    {
+                        Config optionsConf("options");
+                        if (optionsConf.fromJSON(defaultConfStr))
+                        {
+                            //OE_NOTICE << "\n\nOriginal = \n" << conf.toJSON(true) << "\n";
+                            Config* original = conf.mutable_child("options");
+                            if ( original )
+                            {
+                                recursiveUniqueKeyMerge(optionsConf, *original);
+                            }
+                            if ( !optionsConf.empty() )
+                            {
+                                conf.set("options", optionsConf);
+                            }
+                            //OE_NOTICE << "\n\nMerged = \n" << conf.toJSON(true) << "\n";
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // Builds the scene graph for a map Config.
+        osg::Node* build(const Config& conf, const osgDB::Options* readOptions, const MapSnapshot* snapshot) const
+        {
             osg::ref_ptr<osg::Node> node;
 
             if ( !conf.empty() )
             {
                 // see if we were given a reference URI to use:
-                std::string refURI = uriContext.referrer();
+                std::string refURI = URIContext( readOptions ).referrer();
 
                 if ( conf.value("version") == "1" )
                 {
@@ -260,32 +373,8 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
                     if ( conf.value("version") != "2" )
                         OE_DEBUG << LC << "No valid earth file version; assuming version='2'" << std::endl;
 
-                    // attempt to parse a "default options" JSON string:
-                    std::string defaultConfStr;
-                    if ( readOptions )
-                    {
-                        defaultConfStr = readOptions->getPluginStringData("osgEarth.defaultOptions");
-                        if ( !defaultConfStr.empty() )
-                        {
-                            Config optionsConf("options");
-                            if (optionsConf.fromJSON(defaultConfStr))
-                            {
-                                //OE_NOTICE << "\n\nOriginal = \n" << conf.toJSON(true) << "\n";
-                                Config* original = conf.mutable_child("options");
-                                if ( original )
-                                {
-                                    recursiveUniqueKeyMerge(optionsConf, *original);
-                                }
-                                if ( !optionsConf.empty() )
-                                {
-                                    conf.set("options", optionsConf);
-                                }
-                                //OE_NOTICE << "\n\nMerged = \n" << conf.toJSON(true) << "\n";
-                            }
-                        }
-                    }
-
                     EarthFileSerializer2 ser;
+                    ser.setSnapshot( snapshot );
                     node = ser.deserialize( conf, refURI );
                 }
             }
@@ -302,7 +391,7 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
                 }
             }
 
-            return ReadResult(node.get());
+            return node.release();
         }
 };
 
@@ -42,7 +42,8 @@ EngineContext::EngineContext(const Map*                     map,
                              const RenderBindings&          renderBindings,
                              const RexTerrainEngineOptions& options,
                              const SelectionInfo&           selectionInfo,
-                             ModifyBoundingBoxCallback*     bboxCB) :
+                             ModifyBoundingBoxCallback*     bboxCB,
+                             ResidencyManager*              residency) :
 _map           ( map ),
 _terrainEngine ( terrainEngine ),
 _geometryPool  ( geometryPool ),
@@ -54,6 +55,7 @@ _renderBindings( renderBindings ),
 _options       ( options ),
 _selectionInfo ( selectionInfo ),
 _bboxCB        ( bboxCB ),
+_residency     ( residency ),
 _tick(0),
 _tilesLastCull(0)
 {
@@ -188,6 +190,18 @@ EngineContext::endCull(osgUtil::CullVisitor* cv)
         getUnloader()->unloadChildren( tilesWithChildrenToUnload );
     }
 
+    // Enforce the memory budget (and publish residency stats), if there is one.
+    if ( _residency && _residency->getBudget() > 0ull )
+    {
+        std::vector<TileKey> tilesWithChildrenToEvict;
+        _residency->update( cv->getFrameStamp(), tilesWithChildrenToEvict );
+
+        if ( !tilesWithChildrenToEvict.empty() )
+        {
+            getUnloader()->evictChildren( tilesWithChildrenToEvict );
+        }
+    }
+
     //Registry::instance()->startActivity("REX live tiles", Stringify()<<_liveTiles->size());
 }
 
@@ -21,6 +21,7 @@
 
 #include <osgEarth/Registry>
 #include <osgEarth/Utils>
+#include <osgEarth/Metrics>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -28,6 +29,7 @@
 #include <osgDB/ReaderWriter>
 
 #include <string>
+#include <algorithm>
 
 #define REPORT_ACTIVITY true
 
@@ -181,6 +183,7 @@ namespace
 PagerLoader::PagerLoader(TerrainEngineNode* engine) :
 _checkpoint    ( (osg::Timer_t)0 ),
 _mergesPerFrame( 0 ),
+_mergeBudget   ( 0.0f ),
 _frameNumber   ( 0 ),
 _numLODs       ( 20u )
 {
@@ -212,6 +215,14 @@ PagerLoader::setMergesPerFrame(int value)
     this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
+void
+PagerLoader::setMergeBudget(float ms)
+{
+    _mergeBudget = std::max(ms, 0.0f);
+    if ( _mergeBudget > 0.0f )
+        this->setNumChildrenRequiringUpdateTraversal( 1 );
+}
+
 void
 PagerLoader::setLODPriorityScale(unsigned lod, float priorityScale)
 {
@@ -226,9 +237,32 @@ PagerLoader::setLODPriorityOffset(unsigned lod, float offset)
         _priorityOffsets[lod] = offset;
 }
 
+float
+PagerLoader::getNormalizedPriority(const Loader::Request* request, float priority) const
+{
+    // scale and bias the priority, and then normalize it to [0..1] range.
+    unsigned lod = request->getTileKey().getLOD();
+    float p = priority * _priorityScales[lod] + _priorityOffsets[lod];
+    return p / (float)(_numLODs+1);
+}
+
 bool
 PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
 {
+    // A request that's waiting to merge is still wanted; keep its priority
+    // current so the merge queue can favor what's on screen right now.
+    if ( request && request->isMerging() )
+    {
+        request->lock();
+        {
+            request->_priority = getNormalizedPriority(request, priority);
+            if ( nv.getFrameStamp() )
+                request->setFrameNumber( nv.getFrameStamp()->getFrameNumber() );
+        }
+        request->unlock();
+        return false;
+    }
+
     // check that the request is not already completed but unmerged:
     //if ( request && !request->isMerging() && nv.getDatabaseRequestHandler() )
     if ( request && !request->isMerging() && !request->isFinished() && nv.getDatabaseRequestHandler() )
@@ -252,10 +286,8 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
             // remember the last tick at which this request was submitted
             request->_lastTick = osg::Timer::instance()->tick();
 
-            // update the priority, scale and bias it, and then normalize it to [0..1] range.
-            unsigned lod = request->getTileKey().getLOD();
-            float p = priority * _priorityScales[lod] + _priorityOffsets[lod];            
-            request->_priority = p / (float)(_numLODs+1);
+            // update the priority.
+            request->_priority = getNormalizedPriority(request, priority);
 
             // timestamp it
             request->setFrameNumber( fn );
@@ -310,30 +342,16 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             setFrameStamp(nv.getFrameStamp());
         }
 
-        int count;
-        for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
-        {
-            Request* req = _mergeQueue.begin()->get();
-            if ( req && req->_lastTick >= _checkpoint )
-            {
-                OE_START_TIMER(req_apply);
-                req->apply( getFrameStamp() );
-                double s = OE_STOP_TIMER(req_apply);
-
-                req->setState(Request::FINISHED);
-            }
+        unsigned fn = 0;
+        if ( nv.getFrameStamp() )
+            fn = nv.getFrameStamp()->getFrameNumber();
 
-            _mergeQueue.erase( _mergeQueue.begin() );
-        }
+        mergeQueuedRequests( fn );
 
         // cull finished requests.
         {
             Threading::ScopedMutexLock lock( _requestsMutex );
 
-            unsigned fn = 0;
-            if ( nv.getFrameStamp() )
-                fn = nv.getFrameStamp()->getFrameNumber();
-
             // Purge expired requests.
             for(Requests::iterator i = _requests.begin(); i != _requests.end(); )
             {
@@ -350,8 +368,9 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
                     _requests.erase( i++ );
                 }
 
-                // Discard requests that are no longer required:
-                else if ( !req->isMerging() && frameDiff > 2 )
+                // Discard requests that the culler stopped asking for last frame;
+                // the pager will drop them instead of loading stale tiles.
+                else if ( !req->isMerging() && frameDiff > 1 )
                 {
                     //OE_INFO << LC << req->getName() << "(" << i->second->getUID() << ") died waiting after " << frameDiff << " frames" << std::endl; 
                     req->setState( Request::IDLE );
@@ -383,6 +402,89 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
     LoaderGroup::traverse( nv );
 }
 
+namespace
+{
+    struct MergeEntry
+    {
+        bool     _fresh;
+        float    _priority;
+        Loader::Request* _request;
+    };
+
+    // Requests the culler still wants go first, most important first.
+    struct SortMergeEntry
+    {
+        bool operator()(const MergeEntry& lhs, const MergeEntry& rhs) const
+        {
+            if ( lhs._fresh != rhs._fresh )
+                return lhs._fresh;
+            return lhs._priority > rhs._priority;
+        }
+    };
+}
+
+void
+PagerLoader::mergeQueuedRequests(unsigned fn)
+{
+    if ( _mergeQueue.empty() )
+        return;
+
+    // Snapshot the sort keys; cull threads may update priorities while we sort.
+    std::vector<MergeEntry> entries;
+    entries.reserve( _mergeQueue.size() );
+    for(MergeQueue::iterator i = _mergeQueue.begin(); i != _mergeQueue.end(); ++i)
+    {
+        Request* req = i->get();
+
+        // drop requests that expired while waiting in the queue.
+        if ( !req->isMerging() )
+            continue;
+
+        req->lock();
+        MergeEntry e;
+        e._fresh = (fn - req->getLastFrameSubmitted()) <= 1u;
+        e._priority = req->_priority;
+        e._request = req;
+        req->unlock();
+        entries.push_back( e );
+    }
+    std::stable_sort( entries.begin(), entries.end(), SortMergeEntry() );
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    unsigned count = 0;
+    unsigned next = 0;
+
+    for( ; next < entries.size(); ++next )
+    {
+        if ( _mergesPerFrame > 0 && count >= (unsigned)_mergesPerFrame )
+            break;
+
+        if ( _mergeBudget > 0.0f && count > 0 &&
+             osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) >= _mergeBudget )
+            break;
+
+        Request* req = entries[next]._request;
+
+        // requests from before the last clear() finish without applying.
+        if ( req->_lastTick >= _checkpoint )
+        {
+            req->apply( getFrameStamp() );
+            ++count;
+        }
+        req->setState( Request::FINISHED );
+    }
+
+    MergeQueue remaining;
+    remaining.reserve( entries.size() - next );
+    for(unsigned i = next; i < entries.size(); ++i)
+        remaining.push_back( entries[i]._request );
+    _mergeQueue.swap( remaining );
+
+    Metrics::counter("RexLoader",
+        "Merged", (double)count,
+        "Queued", (double)_mergeQueue.size(),
+        "Merge ms", osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()));
+}
 
 bool
 PagerLoader::addChild(osg::Node* node)
@@ -395,9 +497,9 @@ PagerLoader::addChild(osg::Node* node)
         {
             if ( req->_lastTick >= _checkpoint )
             {
-                if ( _mergesPerFrame > 0 )
+                if ( _mergesPerFrame > 0 || _mergeBudget > 0.0f )
                 {
-                    _mergeQueue.insert( req );
+                    _mergeQueue.push_back( req );
                     req->setState( Request::MERGING );
                 }
                 else
@@ -0,0 +1,156 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2014 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "ResidencyManager"
+#include "TileNode"
+#include "TileNodeRegistry"
+
+#include <osgEarth/Metrics>
+#include <algorithm>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+
+#define LC "[ResidencyManager] "
+
+//........................................................................
+
+namespace
+{
+    // Totals the live tiles and gathers eviction candidates.
+    struct ResidencyScanner : public TileNodeRegistry::ConstOperation
+    {
+        unsigned                        _frame;
+        mutable unsigned long long      _bytes;
+        std::vector<ResidencyManager::Candidate>& _candidates;
+
+        ResidencyScanner(unsigned frame, std::vector<ResidencyManager::Candidate>& candidates)
+            : _frame(frame), _bytes(0ull), _candidates(candidates) { }
+
+        void operator()(const TileNodeRegistry::TileNodeMap& tiles) const
+        {
+            for (TileNodeRegistry::TileNodeMap::const_iterator i = tiles.begin(); i != tiles.end(); ++i)
+            {
+                const TileNode* tile = i->second.tile.get();
+                _bytes += tile->getResidentBytes();
+
+                if ( !tile->areSubTilesReady() || tile->getNumChildren() < 4 )
+                    continue;
+
+                // Only evict leaf subtiles that were not drawn in the last frame;
+                // a subtree is peeled from the bottom up over several frames.
+                unsigned long long bytes = 0ull;
+                float importance = 0.0f;
+                unsigned lastUsed = 0u;
+                bool evictable = true;
+
+                for(unsigned c=0; c<4 && evictable; ++c)
+                {
+                    const TileNode* sub = tile->getSubTile(c);
+                    if ( !ResidencyManager::isIdleLeaf(sub->areSubTilesReady(), sub->getLastTraversalFrame(), _frame) )
+                    {
+                        evictable = false;
+                    }
+                    else
+                    {
+                        bytes += sub->getResidentBytes();
+                        importance = std::max( importance, sub->getScreenSpaceImportance() );
+                        lastUsed = std::max( lastUsed, sub->getLastTraversalFrame() );
+                    }
+                }
+
+                if ( evictable && bytes > 0ull )
+                {
+                    ResidencyManager::Candidate c;
+                    c._key   = i->first;
+                    c._bytes = bytes;
+                    c._score = ResidencyManager::score( bytes, importance, lastUsed, _frame );
+                    _candidates.push_back( c );
+                }
+            }
+        }
+    };
+}
+
+//........................................................................
+
+ResidencyManager::ResidencyManager(TileNodeRegistry* tiles) :
+_tiles        ( tiles ),
+_budget       ( 0ull ),
+_residentBytes( 0ull ),
+_evictingBytes( 0ull )
+{
+    //nop
+}
+
+void
+ResidencyManager::update(const osg::FrameStamp* stamp, std::vector<TileKey>& out_parentKeys)
+{
+    // no budget: nothing to enforce, so skip the scan and the stats.
+    if ( _budget == 0ull || !stamp || !_tiles )
+        return;
+
+    std::vector<Candidate> candidates;
+    ResidencyScanner scanner( stamp->getFrameNumber(), candidates );
+    _tiles->run( scanner );
+
+    _residentBytes = scanner._bytes;
+    _evictingBytes = select( candidates, _residentBytes, _budget, out_parentKeys );
+
+    if ( _evictingBytes > 0ull )
+    {
+        OE_DEBUG << LC << "Over budget by " << (_residentBytes - _budget) << " bytes; evicting "
+            << _evictingBytes << " bytes from " << out_parentKeys.size() << " tiles\n";
+    }
+
+    Metrics::counter("RexResidency",
+        "Resident MB", (double)_residentBytes / 1048576.0,
+        "Budget MB",   (double)_budget / 1048576.0,
+        "Evicting MB", (double)_evictingBytes / 1048576.0);
+}
+
+unsigned
+ResidencyManager::getTextureBytes(const osg::Texture* texture)
+{
+    if ( !texture )
+        return 0u;
+
+    unsigned bytes = 0u;
+    for(unsigned i=0; i<texture->getNumImages(); ++i)
+    {
+        const osg::Image* image = texture->getImage(i);
+        if ( image )
+        {
+            // mipmaps generated on the GPU add about a third
+            unsigned imageBytes = image->getTotalSizeInBytesIncludingMipmaps();
+            if ( !image->isMipmap() && texture->getFilter(osg::Texture::MIN_FILTER) != osg::Texture::LINEAR &&
+                 texture->getFilter(osg::Texture::MIN_FILTER) != osg::Texture::NEAREST )
+            {
+                imageBytes += imageBytes/3u;
+            }
+            bytes += imageBytes;
+        }
+    }
+
+    // image data already released after apply: estimate from the GL dimensions
+    if ( bytes == 0u )
+    {
+        bytes = 4u * texture->getTextureWidth() * texture->getTextureHeight() * std::max(texture->getTextureDepth(), 1);
+    }
+
+    return bytes;
+}
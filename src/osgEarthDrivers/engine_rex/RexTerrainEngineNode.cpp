@@ -20,6 +20,7 @@
 #include "Shaders"
 #include "SelectionInfo"
 #include "TerrainCuller"
+#include "TileHeightSampler"
 
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Registry>
@@ -221,6 +222,14 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
         OE_INFO << LC << "Expiration threshold set by env var = " << _terrainOptions.expirationThreshold().get() << "\n";
     }
 
+    // if the envvar for the residency budget is set, overide the options setting
+    const char* budget = ::getenv("OSGEARTH_REX_RESIDENCY_BUDGET_MB");
+    if ( budget )
+    {
+        _terrainOptions.residencyBudget() = as<unsigned>(budget, _terrainOptions.residencyBudget().get());
+        OE_INFO << LC << "Residency budget set by env var = " << _terrainOptions.residencyBudget().get() << " MB\n";
+    }
+
     // if the envvar for hires prioritization is set, override the options setting
     const char* hiresFirst = ::getenv("OSGEARTH_HIGH_RES_FIRST");
     if ( hiresFirst )
@@ -251,6 +260,10 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     _liveTiles = new TileNodeRegistry("live");
     _liveTiles->setMapRevision( _mapFrame.getRevision() );
 
+    // Lets clients (like the GeometryClamper) read heights straight from the live tiles.
+    if ( getTerrain() )
+        getTerrain()->setHeightSampler( new TileHeightSampler(_liveTiles.get(), map->getProfile()) );
+
     // A resource releaser that will call releaseGLObjects() on expired objects.
     _releaser = new ResourceReleaser();
     this->addChild(_releaser.get());
@@ -264,6 +277,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     PagerLoader* loader = new PagerLoader( this );
     loader->setNumLODs(_terrainOptions.maxLOD().getOrUse(DEFAULT_MAX_LOD));
     loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+    loader->setMergeBudget( _terrainOptions.mergeBudget().get() );
     for (std::vector<RexTerrainEngineOptions::LODOptions>::const_iterator i = _terrainOptions.lods().begin(); i != _terrainOptions.lods().end(); ++i) {
         if (i->_lod.isSet()) {
             loader->setLODPriorityScale(i->_lod.get(), i->_priorityScale.getOrUse(1.0f));
@@ -280,6 +294,10 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     _unloader->setReleaser(_releaser.get());
     this->addChild( _unloader.get() );
 
+    // Residency manager keeps the tiles' memory under budget
+    _residency = new ResidencyManager( _liveTiles.get() );
+    _residency->setBudget( (unsigned long long)_terrainOptions.residencyBudget().get() * 1048576ull );
+
     // Tile rasterizer in case we need one
     _rasterizer = new TileRasterizer();
     this->addChild( _rasterizer );
@@ -317,7 +335,8 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
         _renderBindings,
         _terrainOptions,
         _selectionInfo,
-        _modifyBBoxCallback.get());
+        _modifyBBoxCallback.get(),
+        _residency.get());
 
     // Calculate the LOD morphing parameters:
     unsigned maxLOD = _terrainOptions.maxLOD().getOrUse(DEFAULT_MAX_LOD);
@@ -23,6 +23,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/MinMaxPyramid>
 
 using namespace osg;
 using namespace osgEarth::Drivers::RexTerrainEngine;
@@ -37,7 +38,10 @@ TileDrawable::TileDrawable(const TileKey& key,
 osg::Drawable( ),
 _key         ( key ),
 _geom        ( geometry ),
-_tileSize    ( tileSize )
+_tileSize    ( tileSize ),
+_hasElevationBounds( false ),
+_elevationMin( 0.0f ),
+_elevationMax( 0.0f )
 {   
     // a mesh to materialize the heightfield for functors
     _mesh = new osg::Vec3f[ tileSize*tileSize ];
@@ -121,6 +125,13 @@ TileDrawable::setElevationRaster(const osg::Image*   image,
                 _mesh[index] = verts[index] + normals[index] * elevation(u, v).r();
             }
         }
+
+        // The mesh only samples the raster at the vertices; the pyramid bounds
+        // everything in between, so peaks between vertices can't escape the box.
+        const MinMaxPyramid* pyramid = MinMaxPyramid::get(_elevationRaster.get());
+        _hasElevationBounds = pyramid && pyramid->getMinMax(
+            biasU, biasV, biasU+scaleU, biasV+scaleV,
+            _elevationMin, _elevationMax);
     }
 
     else
@@ -129,6 +140,8 @@ TileDrawable::setElevationRaster(const osg::Image*   image,
         {
             _mesh[i] = verts[i];
         }
+
+        _hasElevationBounds = false;
     }
 
     dirtyBound();    
@@ -158,6 +171,18 @@ TileDrawable::computeBoundingBox() const
         box.expandBy(_mesh[i]);
     }
 
+    if (_hasElevationBounds)
+    {
+        const osg::Vec3Array& verts   = *static_cast<osg::Vec3Array*>(_geom->getVertexArray());
+        const osg::Vec3Array& normals = *static_cast<osg::Vec3Array*>(_geom->getNormalArray());
+
+        for(unsigned i=0; i<_tileSize*_tileSize; ++i)
+        {
+            box.expandBy(verts[i] + normals[i]*_elevationMin);
+            box.expandBy(verts[i] + normals[i]*_elevationMax);
+        }
+    }
+
     if (_bboxCB)
     {
         (*_bboxCB)(_key, box);
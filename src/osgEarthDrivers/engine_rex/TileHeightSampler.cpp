@@ -0,0 +1,130 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "TileHeightSampler"
+#include <osgEarth/ImageUtils>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+#define LC "[TileHeightSampler] "
+
+namespace
+{
+    // Samples a batch of points against the locked tile set.
+    struct SampleHeights : public TileNodeRegistry::ConstOperation
+    {
+        const Profile*                 _profile;
+        const std::vector<osg::Vec3d>& _points;
+        std::vector<float>&            _heights;
+        unsigned&                      _count;
+
+        SampleHeights(const Profile* profile, const std::vector<osg::Vec3d>& points, std::vector<float>& heights, unsigned& count) :
+            _profile(profile), _points(points), _heights(heights), _count(count) { }
+
+        void operator()(const TileNodeRegistry::TileNodeMap& tiles) const
+        {
+            // Consecutive points usually fall in the same tile, so remember the
+            // last one and start the search there.
+            const TileNode* last = 0L;
+            const osg::Image* lastRaster = 0L;
+            ImageUtils::PixelReader reader(0L);
+            reader.setBilinear(true);
+
+            for(unsigned i=0; i<_points.size(); ++i)
+            {
+                double x = _points[i].x(), y = _points[i].y();
+
+                const TileNode* tile = 0L;
+                if ( last && last->getKey().getExtent().contains(x, y) )
+                {
+                    tile = last;
+                }
+                else
+                {
+                    TileKey root = _profile->createTileKey(x, y, 0u);
+                    if ( root.valid() )
+                        tile = tiles.find(root);
+                }
+
+                // descend to the deepest tile that has elevation data.
+                while( tile )
+                {
+                    const TileKey& key = tile->getKey();
+                    const GeoExtent& ex = key.getExtent();
+                    unsigned quadrant =
+                        (x >= ex.xMin() + 0.5*ex.width()  ? 1u : 0u) +
+                        (y <  ex.yMin() + 0.5*ex.height() ? 2u : 0u);
+
+                    const TileNode* child = tiles.find(key.createChildKey(quadrant));
+                    if ( !child || !child->getElevationRaster() )
+                        break;
+
+                    tile = child;
+                }
+
+                last = tile;
+
+                const osg::Image* raster = tile ? tile->getElevationRaster() : 0L;
+                if ( !raster )
+                {
+                    _heights[i] = NO_DATA_VALUE;
+                    continue;
+                }
+
+                if ( raster != lastRaster )
+                {
+                    reader.setImage(raster);
+                    lastRaster = raster;
+                }
+
+                // the raster may belong to an ancestor; the matrix maps our
+                // unit coordinates into it.
+                const osg::Matrixf& m = tile->getElevationMatrix();
+                const GeoExtent& ex = tile->getKey().getExtent();
+                float u = (float)((x - ex.xMin()) / ex.width())  * m(0,0) + m(3,0);
+                float v = (float)((y - ex.yMin()) / ex.height()) * m(1,1) + m(3,1);
+
+                _heights[i] = reader(osg::clampBetween(u, 0.0f, 1.0f), osg::clampBetween(v, 0.0f, 1.0f)).r();
+                ++_count;
+            }
+        }
+    };
+}
+
+TileHeightSampler::TileHeightSampler(TileNodeRegistry* tiles, const Profile* profile) :
+_tiles  ( tiles ),
+_profile( profile )
+{
+    //nop
+}
+
+unsigned
+TileHeightSampler::getHeights(const std::vector<osg::Vec3d>& points,
+                              std::vector<float>&            out_heights) const
+{
+    out_heights.assign( points.size(), NO_DATA_VALUE );
+
+    osg::ref_ptr<TileNodeRegistry> tiles;
+    if ( !_tiles.lock(tiles) || !_profile.valid() )
+        return 0u;
+
+    unsigned count = 0u;
+    tiles->run( SampleHeights(_profile.get(), points, out_heights, count) );
+    return count;
+}
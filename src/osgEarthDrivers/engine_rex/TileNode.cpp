@@ -26,6 +26,7 @@
 #include "ElevationTextureUtils"
 #include "TerrainCuller"
 #include "RexTerrainEngineNode"
+#include "ResidencyManager"
 
 #include <osgEarth/CullingUtils>
 #include <osgEarth/ImageUtils>
@@ -72,7 +73,9 @@ _minExpiryFrames( 0 ),
 _lastTraversalTime(0.0),
 _lastTraversalFrame(0.0),
 _count(0),
-_stitchNormalMap(false)
+_stitchNormalMap(false),
+_screenSpaceImportance(0.0f),
+_residentBytes(0u)
 {
     //nop
 }
@@ -475,6 +478,11 @@ TileNode::accept_cull(TerrainCuller* culler)
         _lastTraversalFrame.exchange( culler->getFrameStamp()->getFrameNumber() );
         _lastTraversalTime = culler->getFrameStamp()->getReferenceTime();
 
+        // remember how much of the view this tile occupies, for residency decisions.
+        const osg::BoundingSphere& bs = getBound();
+        float range = culler->getDistanceToViewPoint(bs.center(), true);
+        _screenSpaceImportance = bs.radius() / std::max(range, bs.radius());
+
         if ( !culler->isCulled(*this) )
         {
             visible = cull( culler );
@@ -686,6 +694,8 @@ TileNode::merge(const TerrainTileModel* model, const RenderBindings& bindings)
         getSubTile(3)->refreshInheritedData(this, bindings);
     }
 
+    updateResidentBytes();
+
     if (newElevationData)
     {
         OE_DEBUG << LC << "notify (merge) key " << getKey().str() << std::endl;
@@ -860,14 +870,23 @@ TileNode::load(TerrainCuller* culler)
     if ( _context->getOptions().highResolutionFirst() == false )
         lodPriority = (float)(numLods - lod);
 
-    float distance = culler->getDistanceToViewPoint(getBound().center(), true);
+    const osg::BoundingSphere& bs = getBound();
+    float distance = culler->getDistanceToViewPoint(bs.center(), true);
+
+    // Within an LOD, favor tiles with the largest screen-space error (the
+    // tile's angular size) and those nearest the center of the view.
+    float sse = bs.radius() / std::max(distance, bs.radius());
 
-    // dist priority uis in the range [0..1]
-    float distPriority = 1.0 - distance/si.visParameters(0)._visibilityRange;
+    osg::Vec3 toTile = bs.center() - culler->getViewPointLocal();
+    toTile.normalize();
+    float centrality = osg::clampBetween(toTile * culler->getLookVectorLocal(), 0.0f, 1.0f);
+
+    // tile priority is in the range [0..1)
+    float tilePriority = std::min(0.75f*sse + 0.25f*centrality, 0.999f);
 
     // add them together, and you get tiles sorted first by lodPriority
-    // (because of the biggest range), and second by distance.
-    float priority = lodPriority + distPriority;
+    // (because of the biggest range), and second by their importance on screen.
+    float priority = lodPriority + tilePriority;
 
     // normalize the composite priority to [0..1].
     //priority /= (float)(numLods+1); // GW: moved this to the PagerLoader.
@@ -904,6 +923,37 @@ TileNode::removeSubTiles()
 }
 
 
+void
+TileNode::updateResidentBytes()
+{
+    // Only count textures this tile owns; inherited ones carry a scale/bias matrix
+    // and belong to an ancestor.
+    unsigned bytes = 0u;
+
+    for (unsigned s = 0; s < _renderModel._sharedSamplers.size(); ++s)
+    {
+        const Sampler& sampler = _renderModel._sharedSamplers[s];
+        if (sampler._texture.valid() && sampler._matrix.isIdentity())
+            bytes += ResidencyManager::getTextureBytes(sampler._texture.get());
+    }
+
+    for (unsigned p = 0; p < _renderModel._passes.size(); ++p)
+    {
+        const Samplers& samplers = _renderModel._passes[p]._samplers;
+        for (unsigned s = 0; s < samplers.size(); ++s)
+        {
+            if (samplers[s]._texture.valid() && samplers[s]._matrix.isIdentity())
+                bytes += ResidencyManager::getTextureBytes(samplers[s]._texture.get());
+        }
+    }
+
+    // CPU-side mesh and index copies held by the tile drawable:
+    unsigned tileSize = _context->getOptions().tileSize().get();
+    bytes += tileSize*tileSize*sizeof(osg::Vec3f) + (tileSize-1)*(tileSize-1)*6*sizeof(GLuint);
+
+    _residentBytes = bytes;
+}
+
 void
 TileNode::notifyOfArrival(TileNode* that)
 {
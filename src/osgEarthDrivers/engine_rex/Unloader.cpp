@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "Unloader"
+#include "ResidencyManager"
 #include "TileNode"
 #include "TileNodeRegistry"
 
@@ -83,11 +84,61 @@ UnloaderGroup::unloadChildren(const std::vector<TileKey>& keys)
     _mutex.unlock();
 }
 
+void
+UnloaderGroup::evictChildren(const std::vector<TileKey>& keys)
+{
+    _mutex.lock();
+    for(std::vector<TileKey>::const_iterator i = keys.begin(); i != keys.end(); ++i)
+        _evictKeys.insert(*i);
+    _mutex.unlock();
+}
+
 void
 UnloaderGroup::traverse(osg::NodeVisitor& nv)
 {
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
-    {        
+    {
+        // Evictions requested by the residency manager bypass the threshold.
+        if ( !_evictKeys.empty() && nv.getFrameStamp() )
+        {
+            ScopedMetric m("Unloader evict");
+
+            unsigned evicted=0;
+            Threading::ScopedMutexLock lock( _mutex );
+            unsigned frame = nv.getFrameStamp()->getFrameNumber();
+
+            for(std::set<TileKey>::const_iterator parentKey = _evictKeys.begin(); parentKey != _evictKeys.end(); ++parentKey)
+            {
+                osg::ref_ptr<TileNode> parentNode;
+                if ( _tiles->get(*parentKey, parentNode) && parentNode->areSubTilesReady() )
+                {
+                    // re-check that the subtiles are still idle leaves
+                    bool idle = true;
+                    for(unsigned i=0; i<parentNode->getNumChildren() && idle; ++i)
+                    {
+                        TileNode* sub = parentNode->getSubTile(i);
+                        idle = ResidencyManager::isIdleLeaf(sub->areSubTilesReady(), sub->getLastTraversalFrame(), frame);
+                    }
+
+                    if ( idle )
+                    {
+                        ExpirationCollector collector( _tiles );
+                        for(unsigned i=0; i<parentNode->getNumChildren(); ++i)
+                            parentNode->getSubTile(i)->accept( collector );
+                        evicted += collector._count;
+
+                        if (!collector._nodes.empty() && _releaser.valid())
+                            _releaser->push(collector._nodes);
+
+                        parentNode->removeSubTiles();
+                    }
+                }
+            }
+
+            OE_DEBUG << LC << "Evicted " << evicted << " tiles for residency\n";
+            _evictKeys.clear();
+        }
+
         if ( _parentKeys.size() > _threshold )
         {
             ScopedMetric m("Unloader expire");
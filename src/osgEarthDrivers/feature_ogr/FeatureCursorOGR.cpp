@@ -20,8 +20,10 @@
 #include <osgEarthFeatures/OgrUtils>
 #include <osgEarthFeatures/Feature>
 #include <osgEarth/Registry>
+#include <osgEarth/ThreadingUtils>
 #include <osg/Math>
 #include <algorithm>
+#include <vector>
 
 #define LC "[FeatureCursorOGR] "
 
@@ -68,13 +70,54 @@ namespace
     }
 }
 
+//........................................................................
+
+/**
+ * Reads the next chunk of features in the background. Either the task
+ * thread or the cursor itself may end up doing the read; whichever claims
+ * the task first wins, so a cursor never waits on a prefetch that is still
+ * sitting in the service queue behind other work.
+ */
+struct FeatureCursorOGR::PrefetchTask : public TaskRequest
+{
+    PrefetchTask(FeatureCursorOGR* cursor) : _cursor(cursor), _claimed(false) { }
+
+    void operator()(ProgressCallback* progress)
+    {
+        if ( claim() )
+        {
+            _cursor->readChunk( _features );
+        }
+        _done.set();
+    }
+
+    // returns true if the caller now owns the read.
+    bool claim()
+    {
+        Threading::ScopedMutexLock lock( _claimMutex );
+        if ( _claimed )
+            return false;
+        _claimed = true;
+        return true;
+    }
+
+    FeatureCursorOGR* _cursor;
+    FeatureList       _features;
+    Threading::Event  _done;
+    Threading::Mutex  _claimMutex;
+    bool              _claimed;
+};
+
+//........................................................................
+
 
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
                                    OGRLayerH                   layerHandle,
                                    const FeatureSource*        source,
                                    const FeatureProfile*       profile,
                                    const Symbology::Query&     query,
-                                   const FeatureFilterList&    filters) :
+                                   const FeatureFilterList&    filters,
+                                   TaskService*                prefetchService) :
 _source           ( source ),
 _dsHandle         ( dsHandle ),
 _layerHandle      ( layerHandle ),
@@ -83,9 +126,10 @@ _spatialFilter    ( 0L ),
 _query            ( query ),
 _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
-_resultSetEndReached(false),
+_resultSetEndReached( 0u ),
 _profile          ( profile ),
-_filters          ( filters )
+_filters          ( filters ),
+_prefetchService  ( prefetchService )
 {
     {
         OGR_SCOPED_LOCK;
@@ -184,6 +228,14 @@ _filters          ( filters )
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
+    // a prefetch may still be using the result set; wait for it to finish
+    // (or make sure it never starts) before releasing the handles.
+    if ( _prefetch.valid() && !_prefetch->claim() )
+    {
+        _prefetch->_done.wait();
+    }
+    _prefetch = 0L;
+
     OGR_SCOPED_LOCK;
 
     if ( _nextHandleToQueue )
@@ -196,7 +248,7 @@ FeatureCursorOGR::~FeatureCursorOGR()
         OGR_G_DestroyGeometry( _spatialFilter );
 
     if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+        OGR_DS_Destroy( _dsHandle );
 }
 
 bool
@@ -223,25 +275,91 @@ FeatureCursorOGR::nextFeature()
     return _lastFeatureReturned.get();
 }
 
-// reads a chunk of features into a memory cache; do this for performance
-// and to avoid needing the OGR Mutex every time
+// moves the next chunk of features into the queue, either from a completed
+// prefetch or by reading it directly, and then schedules the following chunk.
 void
 FeatureCursorOGR::readChunk()
 {
     if ( !_resultSetHandle )
         return;
-    
-    OGR_SCOPED_LOCK;
 
-    while( _queue.size() < _chunkSize && !_resultSetEndReached )
+    while( _queue.size() < _chunkSize && (!isEndReached() || _prefetch.valid()) )
+    {
+        FeatureList features;
+
+        if ( _prefetch.valid() )
+        {
+            // if the task hasn't started yet, do the read here instead of waiting
+            // for a task thread to pick it up.
+            if ( _prefetch->claim() )
+            {
+                readChunk( features );
+            }
+            else
+            {
+                _prefetch->_done.wait();
+                features.swap( _prefetch->_features );
+            }
+            _prefetch = 0L;
+        }
+        else
+        {
+            readChunk( features );
+        }
+
+        for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+        {
+            _queue.push( i->get() );
+        }
+    }
+
+    startPrefetch();
+}
+
+void
+FeatureCursorOGR::startPrefetch()
+{
+    if ( _prefetchService.valid() && !_prefetch.valid() && !isEndReached() )
+    {
+        _prefetch = new PrefetchTask( this );
+        _prefetchService->add( _prefetch.get() );
+    }
+}
+
+// reads a chunk of features from the result set. The cursor owns a private
+// data source handle (OGROpen, not OGROpenShared), so the OGR mutex is only
+// held while pulling feature handles from the result set and destroying them;
+// converting the features and running the filters happen outside of it, and
+// other cursors can read in the meantime.
+void
+FeatureCursorOGR::readChunk(FeatureList& output)
+{
+    std::vector<OGRFeatureH> handles;
+    handles.reserve( _chunkSize );
+
+    while( output.size() < _chunkSize && !isEndReached() )
     {
         FeatureList filterList;
-        while( filterList.size() < _chunkSize && !_resultSetEndReached )
+        while( filterList.size() < _chunkSize && !isEndReached() )
         {
-            OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
-            if ( handle )
+            handles.clear();
+            {
+                OGR_SCOPED_LOCK;
+                while( filterList.size() + handles.size() < _chunkSize )
+                {
+                    OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
+                    if ( !handle )
+                    {
+                        _resultSetEndReached.exchange( 1u );
+                        break;
+                    }
+                    handles.push_back( handle );
+                }
+            }
+
+            for(std::vector<OGRFeatureH>::const_iterator h = handles.begin(); h != handles.end(); ++h)
             {
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
+                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( *h, _profile.get() );
 
                 if (feature.valid() &&
                     !_source->isBlacklisted( feature->getFID() ) &&
@@ -249,11 +367,15 @@ FeatureCursorOGR::readChunk()
                 {
                     filterList.push_back( feature.release() );
                 }
-                OGR_F_Destroy( handle );
             }
-            else
+
+            if ( !handles.empty() )
             {
-                _resultSetEndReached = true;
+                OGR_SCOPED_LOCK;
+                for(std::vector<OGRFeatureH>::const_iterator h = handles.begin(); h != handles.end(); ++h)
+                {
+                    OGR_F_Destroy( *h );
+                }
             }
         }
 
@@ -278,10 +400,6 @@ FeatureCursorOGR::readChunk()
             }
         }
 
-        for(FeatureList::const_iterator i = filterList.begin(); i != filterList.end(); ++i)
-        {
-            _queue.push( i->get() );
-        }
+        output.insert( output.end(), filterList.begin(), filterList.end() );
     }
 }
-
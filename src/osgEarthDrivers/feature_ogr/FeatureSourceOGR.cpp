@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
 #include <osgEarthFeatures/FeatureSource>
 #include <osgEarthFeatures/Filter>
 #include <osgEarthFeatures/BufferFilter>
@@ -305,6 +306,15 @@ public:
                 featureProfile->geoInterp() = _options.geoInterp().get();
             }
             setFeatureProfile(featureProfile);
+
+            // cursors read their next chunk of features on these threads
+            // while the caller is busy with the current one.
+            if ( !_geometry.valid() && _options.prefetchThreads().get() > 0u )
+            {
+                _prefetchService = new TaskService(
+                    Stringify() << "OGR prefetch (" << getName() << ")",
+                    _options.prefetchThreads().get() );
+            }
         }
 
         else
@@ -334,9 +344,14 @@ public:
             {
                 OGR_SCOPED_LOCK;
 
-                // Each cursor requires its own DS handle so that multi-threaded access will work.
+                // make our own edits visible to the new handle.
+                if ( _writable && _layerHandle )
+                    OGR_L_SyncToDisk( _layerHandle );
+
+                // Each cursor requires its own private DS handle (not a shared one) so it
+                // can read its features without holding the OGR lock the whole time.
                 // The cursor impl will dispose of the new DS handle.
-                dsHandle = OGROpenShared( _source.c_str(), 0, &_ogrDriverHandle );
+                dsHandle = OGROpen( _source.c_str(), 0, &_ogrDriverHandle );
                 if ( dsHandle )
                 {
                     layerHandle = openLayer(dsHandle, _options.layer().get());
@@ -352,14 +367,15 @@ public:
                     this,
                     getFeatureProfile(),
                     query,
-                    getFilters() );
+                    getFilters(),
+                    _prefetchService.get() );
             }
             else
             {
                 if ( dsHandle )
                 {
                     OGR_SCOPED_LOCK;
-                    OGRReleaseDataSource( dsHandle );
+                    OGR_DS_Destroy( dsHandle );
                 }
 
                 return 0L;
@@ -372,9 +388,26 @@ public:
         if (_writable && _layerHandle)
         {
             OGR_SCOPED_LOCK;
+
+            // remember where the feature was, so consumers can redraw just that area.
+            GeoExtent extent;
+            OGRFeatureH feature_handle = OGR_L_GetFeature( _layerHandle, fid );
+            if ( feature_handle )
+            {
+                OGRGeometryH geom_handle = OGR_F_GetGeometryRef( feature_handle );
+                if ( geom_handle && getFeatureProfile() )
+                {
+                    OGREnvelope env;
+                    OGR_G_GetEnvelope( geom_handle, &env );
+                    extent = GeoExtent( getFeatureProfile()->getSRS(), env.MinX, env.MinY, env.MaxX, env.MaxY );
+                }
+                OGR_F_Destroy( feature_handle );
+            }
+
             if (OGR_L_DeleteFeature( _layerHandle, fid ) == OGRERR_NONE)
             {
                 _needsSync = true;
+                dirtyExtent( extent );
                 return true;
             }            
         }
@@ -482,7 +515,10 @@ public:
             return false;
         }
 
-        dirty();
+        if ( feature->getGeometry() && getFeatureProfile() )
+            dirtyExtent( GeoExtent(getFeatureProfile()->getSRS(), feature->getGeometry()->getBounds()) );
+        else
+            dirty();
 
         return true;
     }
@@ -541,6 +577,7 @@ private:
     bool _writable;
     FeatureSchema _schema;
     Geometry::Type _geometryType;
+    osg::ref_ptr<TaskService> _prefetchService;
 };
 
 
@@ -17,8 +17,19 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "KMLReader"
+#include "KMLStreamParser"
 #include "KML_Root"
 #include "KML_Geometry"
+#include "KML_Feature"
+#include "KML_Style"
+#include "KML_StyleMap"
+#include "KML_Schema"
+#include "KML_Placemark"
+#include "KML_GroundOverlay"
+#include "KML_ScreenOverlay"
+#include "KML_PhotoOverlay"
+#include "KML_NetworkLink"
+#include "KML_NetworkLinkControl"
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
 #include <osgEarth/XmlUtils>
@@ -30,6 +41,262 @@
 using namespace osgEarth_kml;
 using namespace osgEarth;
 
+namespace
+{
+    bool isContainerName(const std::string& name)
+    {
+        return name == "kml" || name == "document" || name == "folder";
+    }
+
+    bool isStyleName(const std::string& name)
+    {
+        return name == "style" || name == "stylemap" || name == "schema";
+    }
+
+    template<typename T>
+    void scanElement(xml_node<>* node, KMLContext& cx)
+    {
+        T instance;
+        instance.scan( node, cx );
+        instance.scan2( node, cx );
+    }
+
+    template<typename T>
+    void buildElement(xml_node<>* node, KMLContext& cx)
+    {
+        T instance;
+        instance.scan( node, cx );
+        instance.scan2( node, cx );
+        instance.build( node, cx );
+    }
+
+    // Adds a shared style (Style, StyleMap or Schema) to the style sheet.
+    void scanStyle(const std::string& name, std::string& source, KMLContext& cx)
+    {
+        xml_document<> doc;
+        xml_node<>* node = KMLStreamParser::parseElement( source, doc );
+        if ( !node )
+            return;
+
+        if ( name == "style" )
+            scanElement<KML_Style>( node, cx );
+        else if ( name == "stylemap" )
+            scanElement<KML_StyleMap>( node, cx );
+        else if ( name == "schema" )
+            scanElement<KML_Schema>( node, cx );
+    }
+
+    // First pass over a seekable stream. Loads the shared styles only, so
+    // that a placemark can use a style declared after it.
+    struct StyleHandler : public KMLStreamParser::Handler
+    {
+        StyleHandler(KMLContext& cx) : _cx(cx) { }
+
+        bool isContainer(const std::string& name) { return isContainerName(name); }
+
+        bool wantElement(const std::string& name) { return isStyleName(name); }
+
+        void element(const std::string& name, std::string& source)
+        {
+            // style maps refer to styles, so resolve them after all the styles are in.
+            if ( name == "stylemap" )
+                _styleMaps.push_back( source );
+            else
+                scanStyle( name, source, _cx );
+        }
+
+        void finish()
+        {
+            for(unsigned i=0; i<_styleMaps.size(); ++i)
+                scanStyle( "stylemap", _styleMaps[i], _cx );
+            _styleMaps.clear();
+        }
+
+        KMLContext&              _cx;
+        std::vector<std::string> _styleMaps;
+    };
+
+    // Builds the scene graph one feature at a time.
+    struct BuildHandler : public KMLStreamParser::Handler
+    {
+        BuildHandler(KMLContext& cx, bool stylesLoaded) :
+            _cx          ( cx ),
+            _stylesLoaded( stylesLoaded ),
+            _chunkSize   ( 256u ),
+            _inChunk     ( 0u ),
+            _numFeatures ( 0u )
+        {
+            _callback = cx._options->chunkCallback();
+            _chunkSize = osg::maximum( cx._options->chunkSize().get(), 1u );
+        }
+
+        bool isContainer(const std::string& name) { return isContainerName(name); }
+
+        void startContainer(const std::string& name)
+        {
+            attachContainers();
+
+            Container c;
+            if ( name != "kml" )
+                c._group = new osg::Group();
+            _containers.push_back( c );
+        }
+
+        void endContainer(const std::string& name)
+        {
+            // attach it now even if it's empty, so its properties still show up.
+            attachContainers();
+
+            if ( _containers.back()._group.valid() )
+                _cx._groupStack.pop();
+
+            _containers.pop_back();
+        }
+
+        void element(const std::string& name, std::string& source)
+        {
+            if ( isStyleName(name) )
+            {
+                if ( !_stylesLoaded )
+                    scanStyle( name, source, _cx );
+            }
+
+            else if ( name == "networklinkcontrol" )
+            {
+                xml_document<> doc;
+                xml_node<>* node = KMLStreamParser::parseElement( source, doc );
+                if ( node )
+                    scanElement<KML_NetworkLinkControl>( node, _cx );
+            }
+
+            else if (
+                name == "placemark"     ||
+                name == "groundoverlay" ||
+                name == "screenoverlay" ||
+                name == "photooverlay"  ||
+                name == "networklink" )
+            {
+                attachContainers();
+                buildFeature( name, source );
+            }
+
+            else if ( !_containers.empty() && _containers.back()._group.valid() && !_containers.back()._attached )
+            {
+                // a property of the container (name, visibility, LookAt...)
+                _containers.back()._properties.append( source );
+            }
+        }
+
+        void buildFeature(const std::string& name, std::string& source)
+        {
+            xml_document<> doc;
+            xml_node<>* node = KMLStreamParser::parseElement( source, doc );
+            if ( !node )
+                return;
+
+            // with a chunk callback, build into a staging group and hand
+            // the results to the callback instead of attaching them.
+            osg::ref_ptr<osg::Group> parent = _cx._groupStack.top();
+            osg::ref_ptr<osg::Group> staging;
+            if ( _callback.valid() )
+            {
+                staging = new osg::Group();
+                _cx._groupStack.push( staging.get() );
+            }
+
+            if ( name == "placemark" )
+                buildElement<KML_Placemark>( node, _cx );
+            else if ( name == "groundoverlay" )
+                buildElement<KML_GroundOverlay>( node, _cx );
+            else if ( name == "screenoverlay" )
+                buildElement<KML_ScreenOverlay>( node, _cx );
+            else if ( name == "photooverlay" )
+                buildElement<KML_PhotoOverlay>( node, _cx );
+            else if ( name == "networklink" )
+                buildElement<KML_NetworkLink>( node, _cx );
+
+            if ( staging.valid() )
+            {
+                _cx._groupStack.pop();
+                for(unsigned i=0; i<staging->getNumChildren(); ++i)
+                    add( parent.get(), staging->getChild(i) );
+            }
+
+            ++_numFeatures;
+            if ( ++_inChunk >= _chunkSize )
+                flush();
+        }
+
+        // Attaches any containers that haven't been attached yet, applying
+        // the properties collected so far.
+        void attachContainers()
+        {
+            for(unsigned i=0; i<_containers.size(); ++i)
+            {
+                Container& c = _containers[i];
+                if ( !c._group.valid() || c._attached )
+                    continue;
+
+                std::string source = "<folder>" + c._properties + "</folder>";
+                xml_document<> doc;
+                xml_node<>* node = KMLStreamParser::parseElement( source, doc );
+                if ( node )
+                {
+                    KML_Feature feature;
+                    feature.build( node, _cx, c._group.get() );
+                }
+                c._properties.clear();
+
+                add( _cx._groupStack.top(), c._group.get() );
+                _cx._groupStack.push( c._group.get() );
+                c._attached = true;
+            }
+        }
+
+        void add(osg::Group* parent, osg::Node* child)
+        {
+            if ( _callback.valid() )
+            {
+                KMLChunkCallback::Addition a;
+                a._parent = parent;
+                a._child  = child;
+                _additions.push_back( a );
+            }
+            else
+            {
+                parent->addChild( child );
+            }
+        }
+
+        void flush()
+        {
+            if ( _callback.valid() && !_additions.empty() )
+            {
+                (*_callback.get())( _additions );
+                _additions.clear();
+            }
+            _inChunk = 0u;
+        }
+
+        struct Container
+        {
+            Container() : _attached(false) { }
+            osg::ref_ptr<osg::Group> _group;
+            std::string              _properties;
+            bool                     _attached;
+        };
+
+        KMLContext&                    _cx;
+        bool                           _stylesLoaded;
+        osg::ref_ptr<KMLChunkCallback> _callback;
+        unsigned                       _chunkSize;
+        unsigned                       _inChunk;
+        unsigned                       _numFeatures;
+        std::vector<Container>         _containers;
+        KMLChunkCallback::Additions    _additions;
+    };
+}
+
 
 KMLReader::KMLReader( MapNode* mapNode, const KMLOptions* options ) :
 _mapNode( mapNode ),
@@ -38,43 +305,15 @@ _options( options )
     //nop
 }
 
-osg::Node*
-KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
-{
-    // pull the URI context out of the DB options:
-    URIContext context(dbOptions);
-
-	// Load the XML
-    osg::Timer_t start = osg::Timer::instance()->tick();
-	std::stringstream buffer;
-    buffer << in.rdbuf();
-    std::string xmlStr;
-    xmlStr = buffer.str();
-	xml_document<> doc;
-	doc.parse<0>(&xmlStr[0]);
-    osg::Timer_t end = osg::Timer::instance()->tick();
-	OE_INFO << "Loaded KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
-
-    start = osg::Timer::instance()->tick();
-	osg::Node* node = read(doc, dbOptions);
-    end = osg::Timer::instance()->tick();
-	OE_INFO << "Parsed KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
-	node->setName( context.referrer() );
-
-	return node;
-}
-
-osg::Node*
-KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
+void
+KMLReader::initContext(KMLContext&           cx,
+                       osg::Group*           root,
+                       const osgDB::Options* dbOptions,
+                       URIResultCache&       defaultUriCache,
+                       const KMLOptions&     blankOptions) const
 {
-    osg::Group* root = new osg::Group();
-    root->ref();
-
     URIContext context(dbOptions);
 
-	root->setName( context.referrer() );
-
-    KMLContext cx;
     cx._mapNode   = _mapNode;
     cx._sheet     = new StyleSheet();
     cx._options   = _options;
@@ -84,9 +323,7 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
     cx._referrer = context.referrer();
     cx._groupStack.push( root );
 
-
     // clone the dbOptions, and install a resource cache if there isn't one already:
-    URIResultCache defaultUriCache;
     if ( !URIResultCache::from(dbOptions) )
     {
         osgDB::Options* newOptions = Registry::instance()->cloneOrCreateOptions();
@@ -99,9 +336,87 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
     }
 
     // intialize the KML options with the defaults if necessary:
-    KMLOptions blankOptions;
     if ( cx._options == 0L )
         cx._options = &blankOptions;
+}
+
+osg::Node*
+KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
+{
+    // pull the URI context out of the DB options:
+    URIContext context(dbOptions);
+
+    osg::ref_ptr<osg::Group> root = new osg::Group();
+    root->setName( context.referrer() );
+
+    // Make sure the KML gets rendered after the terrain.
+    root->getOrCreateStateSet()->setRenderBinDetails(2, "RenderBin");
+
+    KMLContext     cx;
+    URIResultCache defaultUriCache;
+    KMLOptions     blankOptions;
+    initContext( cx, root.get(), dbOptions, defaultUriCache, blankOptions );
+
+    // If we can rewind the stream, load the shared styles first so that
+    // features can use styles that are declared after them.
+    bool stylesLoaded = false;
+    std::streampos origin;
+    if ( KMLStreamParser::canRewind(in, origin) )
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        StyleHandler styles( cx );
+        KMLStreamParser().parse( in, styles );
+        styles.finish();
+
+        in.clear();
+        in.seekg( origin );
+        stylesLoaded = !in.fail();
+        if ( !stylesLoaded )
+        {
+            // canRewind() said we could, so this shouldn't happen; the
+            // document is consumed and there's nothing left to build.
+            OE_WARN << LC << "Failed to rewind the stream after loading styles" << std::endl;
+            in.clear();
+        }
+
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        OE_INFO << LC << "Loaded styles in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
+    }
+
+    if ( !in.fail() )
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        BuildHandler builder( cx, stylesLoaded );
+        KMLStreamParser().parse( in, builder );
+        builder.flush();
+
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        OE_INFO << LC << "Built " << builder._numFeatures << " features in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
+    }
+
+    URIResultCache* cacheUsed = URIResultCache::from(cx._dbOptions.get());
+    CacheStats stats = cacheUsed->getStats();
+    OE_INFO << LC << "URI Cache: " << stats._queries << " reads, " << (stats._hitRatio*100.0) << "% hits" << std::endl;
+
+    return root.release();
+}
+
+osg::Node*
+KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
+{
+    osg::Group* root = new osg::Group();
+    root->ref();
+
+    URIContext context(dbOptions);
+
+	root->setName( context.referrer() );
+
+    KMLContext     cx;
+    URIResultCache defaultUriCache;
+    KMLOptions     blankOptions;
+    initContext( cx, root, dbOptions, defaultUriCache, blankOptions );
 
     //if ( cx._options->iconAndLabelGroup().valid() && cx._options->declutter() == true )
     //{
@@ -0,0 +1,299 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "KMLStreamParser"
+#include <osgEarth/Notify>
+#include <cctype>
+
+#define LC "[KMLStreamParser] "
+
+using namespace osgEarth_kml;
+
+#define BLOCK_SIZE 65536
+
+namespace
+{
+    inline bool endsWith(const std::string& str, const char* suffix, unsigned len)
+    {
+        return str.size() >= len && str.compare(str.size()-len, len, suffix) == 0;
+    }
+
+    // whether "tag" is still a prefix of "full"
+    inline bool isPrefixOf(const std::string& tag, const char* full)
+    {
+        for(unsigned i=0; i<tag.size(); ++i)
+        {
+            if ( full[i] == 0 || full[i] != tag[i] )
+                return false;
+        }
+        return true;
+    }
+}
+
+KMLStreamParser::KMLStreamParser() :
+_state       ( STATE_TEXT ),
+_quote       ( 0 ),
+_bracketDepth( 0 ),
+_depth       ( 0 ),
+_collecting  ( false )
+{
+    //nop
+}
+
+bool
+KMLStreamParser::parse(std::istream& in, Handler& handler)
+{
+    _state = STATE_TEXT;
+    _quote = 0;
+    _bracketDepth = 0;
+    _depth = 0;
+    _collecting = false;
+    _tag.clear();
+    _element.clear();
+    _containers.clear();
+
+    std::vector<char> block( BLOCK_SIZE );
+
+    while( in.good() )
+    {
+        in.read( &block[0], BLOCK_SIZE );
+        std::streamsize count = in.gcount();
+
+        for(std::streamsize i=0; i<count; ++i)
+        {
+            const char c = block[i];
+
+            switch( _state )
+            {
+            case STATE_TEXT:
+                if ( c == '<' )
+                {
+                    _tag = c;
+                    _state = STATE_TAG;
+                }
+                else if ( _collecting )
+                {
+                    _element.push_back( c );
+                }
+                break;
+
+            case STATE_TAG:
+                _tag.push_back( c );
+
+                if ( _tag[1] == '!' )
+                {
+                    // comment, CDATA, or a declaration like DOCTYPE:
+                    if ( _tag == "<!--" )
+                        _state = STATE_COMMENT;
+                    else if ( _tag == "<![CDATA[" )
+                        _state = STATE_CDATA;
+                    else if ( !isPrefixOf(_tag, "<!--") && !isPrefixOf(_tag, "<![CDATA[") )
+                    {
+                        _bracketDepth = c == '[' ? 1 : 0;
+                        _state = c == '>' ? STATE_TEXT : STATE_SPECIAL;
+                    }
+                }
+                else if ( _tag[1] == '?' )
+                {
+                    _bracketDepth = 0;
+                    _state = STATE_SPECIAL;
+                }
+                else if ( _quote != 0 )
+                {
+                    if ( c == _quote )
+                        _quote = 0;
+                }
+                else if ( c == '"' || c == '\'' )
+                {
+                    _quote = c;
+                }
+                else if ( c == '>' )
+                {
+                    _state = STATE_TEXT;
+                    processTag( handler );
+                }
+                break;
+
+            case STATE_COMMENT:
+                _tag.push_back( c );
+                if ( c == '>' && endsWith(_tag, "-->", 3) )
+                    _state = STATE_TEXT;
+                break;
+
+            case STATE_CDATA:
+                _tag.push_back( c );
+                if ( c == '>' && endsWith(_tag, "]]>", 3) )
+                {
+                    if ( _collecting )
+                        _element.append( _tag );
+                    _state = STATE_TEXT;
+                }
+                break;
+
+            case STATE_SPECIAL:
+                if ( c == '[' )
+                    ++_bracketDepth;
+                else if ( c == ']' )
+                    --_bracketDepth;
+                else if ( c == '>' && _bracketDepth <= 0 )
+                    _state = STATE_TEXT;
+                break;
+            }
+        }
+    }
+
+    if ( _state != STATE_TEXT || _depth > 0 || !_containers.empty() )
+    {
+        OE_WARN << LC << "KML document ended unexpectedly" << std::endl;
+
+        // close whatever is still open so the handler can finish up.
+        while( !_containers.empty() )
+        {
+            handler.endContainer( _containers.back() );
+            _containers.pop_back();
+        }
+        return false;
+    }
+
+    return true;
+}
+
+void
+KMLStreamParser::processTag(Handler& handler)
+{
+    if ( _tag[1] == '/' )
+    {
+        // end tag.
+        if ( _depth > 0 )
+        {
+            if ( _collecting )
+                _element.append( _tag );
+
+            if ( --_depth == 0 )
+                finishElement( handler );
+        }
+        else if ( !_containers.empty() )
+        {
+            handler.endContainer( _containers.back() );
+            _containers.pop_back();
+        }
+        return;
+    }
+
+    bool selfClosing = _tag[_tag.size()-2] == '/';
+
+    if ( _depth > 0 )
+    {
+        // inside an element that's being collected or skipped.
+        if ( _collecting )
+            _element.append( _tag );
+        if ( !selfClosing )
+            ++_depth;
+        return;
+    }
+
+    std::string name = getName( _tag, 1 );
+
+    if ( handler.isContainer(name) )
+    {
+        handler.startContainer( name );
+        if ( selfClosing )
+            handler.endContainer( name );
+        else
+            _containers.push_back( name );
+    }
+    else
+    {
+        _elementName = name;
+        _collecting = handler.wantElement( name );
+        if ( _collecting )
+            _element = _tag;
+
+        if ( selfClosing )
+            finishElement( handler );
+        else
+            _depth = 1;
+    }
+}
+
+void
+KMLStreamParser::finishElement(Handler& handler)
+{
+    if ( _collecting )
+    {
+        handler.element( _elementName, _element );
+        _element.clear();
+    }
+    _collecting = false;
+}
+
+std::string
+KMLStreamParser::getName(const std::string& tag, unsigned start)
+{
+    std::string name;
+    for(unsigned i=start; i<tag.size(); ++i)
+    {
+        char c = tag[i];
+        if ( ::isspace((unsigned char)c) || c == '/' || c == '>' )
+            break;
+        else if ( c == ':' )
+            name.clear();
+        else
+            name.push_back( (char)::tolower((unsigned char)c) );
+    }
+    return name;
+}
+
+bool
+KMLStreamParser::canRewind(std::istream& in, std::streampos& out_origin)
+{
+    out_origin = in.tellg();
+    if ( out_origin == std::streampos(-1) )
+    {
+        in.clear();
+        return false;
+    }
+
+    // some streams report a position but can't seek back to it, so try.
+    // Seeking to where we already are doesn't consume anything.
+    in.seekg( out_origin );
+    if ( in.fail() )
+    {
+        in.clear();
+        return false;
+    }
+
+    return true;
+}
+
+xml_node<>*
+KMLStreamParser::parseElement(std::string& source, xml_document<>& doc)
+{
+    // rapidxml parses in place and needs a terminating zero.
+    source.push_back( '\0' );
+    try
+    {
+        doc.parse<0>( &source[0] );
+    }
+    catch(const rapidxml::parse_error& e)
+    {
+        OE_WARN << LC << "Skipping malformed element: " << e.what() << std::endl;
+        return 0L;
+    }
+    return doc.first_node();
+}
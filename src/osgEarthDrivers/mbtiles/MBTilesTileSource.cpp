@@ -24,9 +24,11 @@
 
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/CacheContent>
 #include <osgDB/FileUtils>
 
 #include <sstream>
+#include <cstring>
 #include <iomanip>
 #include <algorithm>
 
@@ -63,11 +65,24 @@ _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_uncommitted( 0u ),
+_deduplicate( false )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    if ( _database )
+    {
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
+        commit();
+        sqlite3_close( _database );
+        _database = NULL;
+    }
+}
+
 Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {
@@ -124,6 +139,7 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     if ( isNewDatabase )
     {
         // create necessary db tables:
+        _deduplicate = _options.deduplicate().get();
         createTables();
 
         // write profile to metadata:
@@ -165,6 +181,8 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     // If the database pre-existed, read in the information from the metadata.
     else // !isNewDatabase
     {
+        _deduplicate = isDeduplicated();
+
         if ( _options.computeLevels() == true )
         {
             computeLevels();
@@ -399,9 +417,8 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     if ( (getMode() & MODE_WRITE) == 0 )
         return false;
 
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
-    // encode the data stream:
+    // encode the data stream; the plugin and compressor are safe to share
+    // between threads, so only the database work needs the lock.
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
     if ( _forceRGB && ImageUtils::hasAlphaChannel(image) )
@@ -443,47 +460,151 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    // batch writes into transactions:
+    if ( _uncommitted == 0u && _options.batchSize().get() > 1u )
+    {
+        if (SQLITE_OK != sqlite3_exec(_database, "BEGIN TRANSACTION", 0L, 0L, 0L))
+        {
+            OE_WARN << LC << "Failed to begin transaction: " << sqlite3_errmsg(_database) << std::endl;
+        }
+    }
+
+    bool ok = true;
+    std::string id;
+
+    if ( _deduplicate )
+    {
+        // identical tiles share one row of tile data. In the unlikely event
+        // of a hash collision, the tile gets a private row instead.
+        id = CacheContent::hash(value);
+        if ( !putTileData(id, value, false) )
+        {
+            id = Stringify() << id << "-" << z << "-" << x << "-" << y;
+            ok = putTileData(id, value, true);
+        }
+    }
+
     // Prep the insert statement:
     sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    std::string query = _deduplicate ?
+        "INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?)" :
+        "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+    int rc = ok ? sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L ) : SQLITE_ERROR;
+    if ( ok && rc != SQLITE_OK )
     {
         OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return false;
+        ok = false;
     }
 
-    // bind parameters:
-    sqlite3_bind_int( insert, 1, z );
-    sqlite3_bind_int( insert, 2, x );
-    sqlite3_bind_int( insert, 3, y );
+    if ( ok )
+    {
+        // bind parameters:
+        sqlite3_bind_int( insert, 1, z );
+        sqlite3_bind_int( insert, 2, x );
+        sqlite3_bind_int( insert, 3, y );
+
+        // bind the data blob, or its ID:
+        if ( _deduplicate )
+            sqlite3_bind_text( insert, 4, id.c_str(), id.length(), SQLITE_STATIC );
+        else
+            sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
 
-    // bind the data blob:
-    sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
+        // run the sql.
+        ok = step( insert, query );
 
-    // run the sql.
-    bool ok = true;
+        sqlite3_finalize( insert );
+    }
+
+    if ( _options.batchSize().get() > 1u && ++_uncommitted >= _options.batchSize().get() )
+    {
+        commit();
+    }
+
+    return ok;
+}
+
+bool
+MBTilesTileSource::step(sqlite3_stmt* stmt, const std::string& query)
+{
+    int rc;
     int tries = 0;
     do {
-        rc = sqlite3_step(insert);
+        rc = sqlite3_step(stmt);
     }
     while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
-    if (SQLITE_OK != rc && SQLITE_DONE != rc)
+    if (SQLITE_OK != rc && SQLITE_DONE != rc && SQLITE_ROW != rc)
     {
 #if SQLITE_VERSION_NUMBER >= 3007015
         OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
 #else
         OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
 #endif
-        ok = false;
+        return false;
     }
+    return true;
+}
 
-    sqlite3_finalize( insert );
+bool
+MBTilesTileSource::putTileData(const std::string& id, const std::string& data, bool replace)
+{
+    if ( !replace )
+    {
+        // already there? make sure it really is the same data.
+        sqlite3_stmt* select = NULL;
+        std::string query = "SELECT tile_data FROM images WHERE tile_id = ?";
+        if ( sqlite3_prepare_v2(_database, query.c_str(), -1, &select, 0L) != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            return false;
+        }
+
+        sqlite3_bind_text( select, 1, id.c_str(), id.length(), SQLITE_STATIC );
 
+        int rc = sqlite3_step( select );
+        if ( rc == SQLITE_ROW )
+        {
+            const char* stored = (const char*)sqlite3_column_blob( select, 0 );
+            int length = sqlite3_column_bytes( select, 0 );
+            bool same = (size_t)length == data.length() && (length == 0 || ::memcmp(stored, data.data(), length) == 0);
+            sqlite3_finalize( select );
+            return same;
+        }
+
+        sqlite3_finalize( select );
+    }
+
+    sqlite3_stmt* insert = NULL;
+    std::string query = "INSERT OR REPLACE INTO images (tile_data, tile_id) VALUES (?, ?)";
+    if ( sqlite3_prepare_v2(_database, query.c_str(), -1, &insert, 0L) != SQLITE_OK )
+    {
+        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+        return false;
+    }
+
+    sqlite3_bind_blob( insert, 1, data.c_str(), data.length(), SQLITE_STATIC );
+    sqlite3_bind_text( insert, 2, id.c_str(), id.length(), SQLITE_STATIC );
+
+    bool ok = step( insert, query );
+    sqlite3_finalize( insert );
     return ok;
 }
 
+void
+MBTilesTileSource::commit()
+{
+    if ( _uncommitted > 0u )
+    {
+        if (SQLITE_OK != sqlite3_exec(_database, "COMMIT", 0L, 0L, 0L))
+        {
+            OE_WARN << LC << "Failed to commit transaction: " << sqlite3_errmsg(_database) << std::endl;
+        }
+        _uncommitted = 0u;
+    }
+}
+
 bool
 MBTilesTileSource::getMetaData(const std::string& key, std::string& value)
 {
@@ -604,6 +725,49 @@ MBTilesTileSource::createTables()
         return false;
     }
 
+    char* errorMsg = 0L;
+
+    if ( _deduplicate )
+    {
+        // tile IDs by tile key, and unique tile data by ID, presented
+        // to readers as the standard tiles table:
+        const char* statements[] = {
+            "CREATE TABLE IF NOT EXISTS map ("
+            " zoom_level integer,"
+            " tile_column integer,"
+            " tile_row integer,"
+            " tile_id text)",
+
+            "CREATE UNIQUE INDEX IF NOT EXISTS map_index ON map ("
+            " zoom_level, tile_column, tile_row)",
+
+            "CREATE TABLE IF NOT EXISTS images ("
+            " tile_data blob,"
+            " tile_id text)",
+
+            "CREATE UNIQUE INDEX IF NOT EXISTS images_id ON images (tile_id)",
+
+            "CREATE VIEW IF NOT EXISTS tiles AS SELECT"
+            " map.zoom_level AS zoom_level,"
+            " map.tile_column AS tile_column,"
+            " map.tile_row AS tile_row,"
+            " images.tile_data AS tile_data"
+            " FROM map JOIN images ON images.tile_id = map.tile_id"
+        };
+
+        for(unsigned i = 0; i < sizeof(statements)/sizeof(statements[0]); ++i)
+        {
+            if (SQLITE_OK != sqlite3_exec(_database, statements[i], 0L, 0L, &errorMsg))
+            {
+                OE_WARN << LC << "Failed to create tables: " << errorMsg << std::endl;
+                sqlite3_free( errorMsg );
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     query =
         "CREATE TABLE IF NOT EXISTS tiles ("
         " zoom_level integer,"
@@ -611,8 +775,6 @@ MBTilesTileSource::createTables()
         " tile_row integer,"
         " tile_data blob)";
 
-    char* errorMsg = 0L;
-
     if (SQLITE_OK != sqlite3_exec(_database, query.c_str(), 0L, 0L, &errorMsg))
     {
         OE_WARN << LC << "Failed to create table [tiles]: " << errorMsg << std::endl;
@@ -638,6 +800,37 @@ MBTilesTileSource::createTables()
     return true;
 }
 
+bool
+MBTilesTileSource::isDeduplicated()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    sqlite3_stmt* select = NULL;
+    std::string query = "SELECT type FROM sqlite_master WHERE name = 'tiles'";
+    if ( sqlite3_prepare_v2(_database, query.c_str(), -1, &select, 0L) != SQLITE_OK )
+        return false;
+
+    bool view = false;
+    if ( sqlite3_step(select) == SQLITE_ROW )
+    {
+        const char* type = (const char*)sqlite3_column_text( select, 0 );
+        view = type && std::string(type) == "view";
+    }
+    sqlite3_finalize( select );
+
+    // a tiles view is normally the map/images layout; check that we can write to it.
+    if ( view )
+    {
+        query = "SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name IN ('map', 'images')";
+        if ( sqlite3_prepare_v2(_database, query.c_str(), -1, &select, 0L) != SQLITE_OK )
+            return false;
+        view = sqlite3_step(select) == SQLITE_ROW && sqlite3_column_int(select, 0) == 2;
+        sqlite3_finalize( select );
+    }
+
+    return view;
+}
+
 std::string
 MBTilesTileSource::getExtension() const
 {
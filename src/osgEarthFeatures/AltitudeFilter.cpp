@@ -103,7 +103,7 @@ AltitudeFilter::pushAndDontClamp( FeatureList& features, FilterContext& cx )
         if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
             offsetZ = feature->eval( offsetExpr, &cx );       
         
-        GeometryIterator gi( feature->getGeometry() );
+        GeometryIterator gi( feature->getGeometryForWrite() );
         while( gi.hasMore() )
         {
             Geometry* geom = gi.next();
@@ -222,7 +222,7 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             }
         }
         
-        GeometryIterator gi( feature->getGeometry() );
+        GeometryIterator gi( feature->getGeometryForWrite() );
         while( gi.hasMore() )
         {
             Geometry* geom = gi.next();
@@ -140,7 +140,7 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
             input->eval( temp, &context );
         }
 
-        GeometryIterator parts( input->getGeometry(), false );
+        GeometryIterator parts( input->getGeometryForWrite(), false );
         while( parts.hasMore() )
         {
             Geometry* part = parts.next();
@@ -332,7 +332,7 @@ BuildGeometryFilter::processPolygonizedLines(FeatureList&   features,
 
         // iterate over all the feature's geometry parts. We will treat
         // them as lines strings.
-        GeometryIterator parts( input->getGeometry(), true );
+        GeometryIterator parts( input->getGeometryForWrite(), true );
         while( parts.hasMore() )
         {
             Geometry* part = parts.next();
@@ -951,7 +951,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
         }
 
         // iterator over the parts.
-        GeometryIterator iter( input->getGeometry(), false );
+        GeometryIterator iter( input->getGeometryForWrite(), false );
         while( iter.hasMore() )
         {
             Geometry* part = iter.next();
@@ -145,17 +145,20 @@ AttributeValue::getBool( bool defaultValue ) const
 //----------------------------------------------------------------------------
 
 Feature::Feature( FeatureID fid ) :
-_fid( fid ),
-_srs( 0L )
+_fid       ( fid ),
+_srs       ( 0L ),
+_attrs     ( new SharedAttributeTable() )
 //_cachedBoundingPolytopeValid( false )
 {
     //NOP
 }
 
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
-_geom ( geom ),
-_srs  ( srs ),
-_fid  ( fid )
+_geom      ( geom ),
+_geomOwners( geom ? new osg::Referenced() : 0L ),
+_srs       ( srs ),
+_fid       ( fid ),
+_attrs     ( new SharedAttributeTable() )
 {
     if ( !style.empty() )
         _style = style;
@@ -164,14 +167,28 @@ _fid  ( fid )
 }
 
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
-_fid      ( rhs._fid ),
-_attrs    ( rhs._attrs ),
-_style    ( rhs._style ),
-_geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_fid       ( rhs._fid ),
+_style     ( rhs._style ),
+_geoInterp ( rhs._geoInterp ),
+_srs       ( rhs._srs.get() )
 {
-    if ( rhs._geom.valid() )
-        _geom = rhs._geom->clone();
+    if ( copyOp.getCopyFlags() == osg::CopyOp::SHALLOW_COPY )
+    {
+        // share until somebody writes. Joining the owner token bumps its
+        // (atomic) reference count, so rhs itself is left untouched.
+        _attrs      = rhs._attrs.get();
+        _geom       = rhs._geom.get();
+        _geomOwners = rhs._geomOwners.get();
+    }
+    else
+    {
+        _attrs = new SharedAttributeTable( *rhs._attrs.get() );
+        if ( rhs._geom.valid() )
+        {
+            _geom       = rhs._geom->clone();
+            _geomOwners = new osg::Referenced();
+        }
+    }
 
     dirty();
 }
@@ -198,8 +215,32 @@ Feature::setSRS( const SpatialReference* srs )
 void
 Feature::setGeometry( Geometry* geom )
 {
-    _geom = geom;
+    _geom       = geom;
+    _geomOwners = geom ? new osg::Referenced() : 0L;
+    dirty();
+}
+
+Geometry*
+Feature::getGeometryForWrite()
+{
+    // take a private copy if another feature shares the geometry. Clone before
+    // leaving the owner token so the other side can't start writing in place
+    // while we are still reading from it.
+    if ( _geomOwners.valid() && _geomOwners->referenceCount() > 1 )
+    {
+        _geom       = _geom->clone();
+        _geomOwners = new osg::Referenced();
+    }
     dirty();
+    return _geom.get();
+}
+
+AttributeTable&
+Feature::writeAttrs()
+{
+    if ( _attrs->referenceCount() > 1 )
+        _attrs = new SharedAttributeTable( *_attrs.get() );
+    return _attrs->_table;
 }
 
 void
@@ -213,7 +254,7 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = writeAttrs()[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
     a.second.set = true;
@@ -222,7 +263,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = writeAttrs()[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
     a.second.set = true;
@@ -231,7 +272,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = writeAttrs()[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
     a.second.set = true;
@@ -240,13 +281,13 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
-    _attrs[ name ] = value;
+    writeAttrs()[ name ] = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = writeAttrs()[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
     a.second.set = true;
@@ -255,14 +296,14 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::setNull( const std::string& name)
 {
-    AttributeValue& a = _attrs[name];    
+    AttributeValue& a = writeAttrs()[name];    
     a.second.set = false;
 }
 
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
-    AttributeValue& a = _attrs[name];
+    AttributeValue& a = writeAttrs()[name];
     a.first = type;    
     a.second.set = false;
 }
@@ -273,42 +314,42 @@ Feature::setNull( const std::string& name, AttributeType type)
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    return _attrs->_table.find(toLower(name)) != _attrs->_table.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
+    AttributeTable::const_iterator i = _attrs->_table.find(toLower(name));
+    return i != _attrs->_table.end()? i->second.getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
+    AttributeTable::const_iterator i = _attrs->_table.find(toLower(name));
+    return i != _attrs->_table.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
 
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
+    AttributeTable::const_iterator i = _attrs->_table.find(toLower(name));
+    return i != _attrs->_table.end()? i->second.getInt(defaultValue) : defaultValue;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
+    AttributeTable::const_iterator i = _attrs->_table.find(toLower(name));
+    return i != _attrs->_table.end()? i->second.getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.second.set : false;
+    AttributeTable::const_iterator i = _attrs->_table.find(toLower(name));
+    return i != _attrs->_table.end()? i->second.second.set : false;
 }
 
 double
@@ -318,8 +359,8 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      AttributeTable::const_iterator ai = _attrs->_table.find(toLower(i->first));
+      if (ai != _attrs->_table.end())
       {
         val = ai->second.getDouble(0.0);
       }
@@ -351,8 +392,8 @@ Feature::eval(NumericExpression& expr, Session* session) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeTable::const_iterator ai = _attrs->_table.find(toLower(i->first));
+        if (ai != _attrs->_table.end())
         {
             val = ai->second.getDouble(0.0);
         }
@@ -387,8 +428,8 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      AttributeTable::const_iterator ai = _attrs->_table.find(toLower(i->first));
+      if (ai != _attrs->_table.end())
       {
         val = ai->second.getString();
       }
@@ -423,8 +464,8 @@ Feature::eval(StringExpression& expr, Session* session) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        AttributeTable::const_iterator ai = _attrs->_table.find(toLower(i->first));
+        if (ai != _attrs->_table.end())
         {
             val = ai->second.getString();
         }
@@ -643,7 +684,7 @@ std::string Feature::featuresToGeoJSON( FeatureList& features)
 
 void Feature::transform( const SpatialReference* srs )
 {
-    if (!getGeometry())
+    if (!_geom.valid())
     {
         return;
     }
@@ -651,7 +692,7 @@ void Feature::transform( const SpatialReference* srs )
     if (getSRS()->isEquivalentTo( srs )) return;
 
     // iterate over the feature geometry.
-    GeometryIterator iter( getGeometry() );
+    GeometryIterator iter( getGeometryForWrite() );
     while( iter.hasMore() )
     {
         Geometry* geom = iter.next();
@@ -673,14 +714,14 @@ void Feature::splitAcrossDateLine(FeatureList& splitFeatures)
             double maxLon = minLon + 360.0;
             Bounds bounds(minLon, -90.0, maxLon, 90.0);
             osg::ref_ptr< Geometry > croppedGeometry;
-            if (getGeometry()->crop(bounds, croppedGeometry))
+            if (_geom->crop(bounds, croppedGeometry))
             {
                 // If the geometry was cropped, offset the x coordinate so it's within normal longitude ranges.
                 for (int j = 0; j < croppedGeometry->size(); j++)
                 {
                     (*croppedGeometry)[j].x() -= offset;
                 }
-                osg::ref_ptr< Feature > croppedFeature = new Feature(*this);
+                osg::ref_ptr< Feature > croppedFeature = new Feature(*this, osg::CopyOp::SHALLOW_COPY);
                 croppedFeature->setGeometry(croppedGeometry.get());
                 splitFeatures.push_back(croppedFeature);
             }
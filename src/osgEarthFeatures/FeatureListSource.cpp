@@ -17,18 +17,66 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/FeatureListSource>
+#include <algorithm>
 
 using namespace osgEarth::Features;
 
+namespace
+{
+    // Cursor that hands out copy-on-write views of the stored features.
+    // Filters may modify what they get, but only the parts they actually
+    // change get copied; the originals stay untouched.
+    class SharedFeatureCursor : public FeatureCursor
+    {
+    public:
+        SharedFeatureCursor() : _next( 0u ) { }
+
+        std::vector< osg::ref_ptr<Feature> >& features() { return _features; }
+
+        bool hasMore() const
+        {
+            return _next < _features.size();
+        }
+
+        Feature* nextFeature()
+        {
+            if ( !hasMore() )
+                return 0L;
+
+            _lastFeatureReturned = new Feature( *_features[_next].get(), osg::CopyOp::SHALLOW_COPY );
+            _features[_next++] = 0L;
+            return _lastFeatureReturned.get();
+        }
+
+    private:
+        std::vector< osg::ref_ptr<Feature> > _features;
+        unsigned                             _next;
+        osg::ref_ptr<Feature>                _lastFeatureReturned;
+    };
+
+    // extent of a feature's geometry, or an invalid extent if it has none.
+    GeoExtent extentOf(const Feature* feature)
+    {
+        if ( feature && feature->getGeometry() && feature->getSRS() )
+            return GeoExtent( feature->getSRS(), feature->getGeometry()->getBounds() );
+        else
+            return GeoExtent::INVALID;
+    }
+}
+
 FeatureListSource::FeatureListSource():
-FeatureSource()
+FeatureSource  (),
+_indexSequence( 0u ),
+_indexDirty   ( true )
 {
     //nop
 }
 
 FeatureListSource::FeatureListSource(const GeoExtent& defaultExtent ) :
 FeatureSource (),
-_defaultExtent( defaultExtent )
+_defaultExtent( defaultExtent ),
+_indexSequence( 0u ),
+_indexDirty   ( true )
 {
     //nop
 }
@@ -39,15 +87,38 @@ FeatureListSource::createFeatureCursor( const Symbology::Query& query )
     if (getFeatureProfile() == 0L)
         setFeatureProfile(createFeatureProfile());
 
-    //Create a copy of all of the features before returning the cursor.
-    //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed.
-    FeatureList cursorFeatures;
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+    // Resolve the query extent into the feature SRS.
+    optional<Bounds> bounds = query.bounds();
+    if ( !bounds.isSet() && query.tileKey().isSet() && getFeatureProfile() )
+    {
+        GeoExtent localEx = query.tileKey()->getExtent().transform( getFeatureProfile()->getSRS() );
+        if ( localEx.isValid() )
+            bounds = localEx.bounds();
+    }
+
+    // Collect the matching features.
+    osg::ref_ptr<SharedFeatureCursor> cursor = new SharedFeatureCursor();
+    std::vector< osg::ref_ptr<Feature> >& matches = cursor->features();
+    if ( bounds.isSet() && bounds->isValid() )
+    {
+        Threading::ScopedMutexLock lock( _indexMutex );
+        syncIndex();
+
+        std::vector<IndexedFeature> hits;
+        _index.search( bounds->xMin(), bounds->yMin(), bounds->xMax(), bounds->yMax(), hits );
+        hits.insert( hits.end(), _unindexed.begin(), _unindexed.end() );
+        std::sort( hits.begin(), hits.end() );
+
+        matches.reserve( hits.size() );
+        for (unsigned i = 0; i < hits.size(); ++i)
+            matches.push_back( hits[i].second );
+    }
+    else
     {
-        Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
-        cursorFeatures.push_back( feature );
-    }    
-    return new FeatureListCursor( cursorFeatures );
+        matches.assign( _features.begin(), _features.end() );
+    }
+
+    return cursor.release();
 }
 
 const FeatureProfile*
@@ -87,8 +158,17 @@ FeatureListSource::deleteFeature(FeatureID fid)
     {
         if (itr->get()->getFID() == fid)
         {
+            Threading::ScopedMutexLock lock( _indexMutex );
+
+            // keep the index current unless the feature moved since it was indexed.
+            bool current = !_indexDirty && inSyncWith(_indexRevision);
+            if ( current && !unindexFeature(itr->get()) )
+                _indexDirty = true;
+
+            dirtyExtent( extentOf(itr->get()) );
             _features.erase( itr );
-            dirty();
+            if ( current )
+                sync( _indexRevision );
             return true;
         }
     }
@@ -112,6 +192,88 @@ bool FeatureListSource::insertFeature(Feature* feature)
 {
     dirtyFeatureProfile();
     _features.push_back( feature );
-    dirty();
+
+    Threading::ScopedMutexLock lock( _indexMutex );
+    bool current = !_indexDirty && inSyncWith(_indexRevision);
+    dirtyExtent( extentOf(feature) );
+    if ( current )
+    {
+        indexFeature( feature );
+        sync( _indexRevision );
+    }
     return true;
 }
+
+FeatureList&
+FeatureListSource::getFeatures()
+{
+    Threading::ScopedMutexLock lock( _indexMutex );
+    _indexDirty = true;
+    return _features;
+}
+
+void
+FeatureListSource::syncIndex()
+{
+    // caller holds _indexMutex
+    if ( !_indexDirty && inSyncWith(_indexRevision) )
+        return;
+
+    std::vector<FeatureRTree::Entry> entries;
+    entries.reserve( _features.size() );
+    _unindexed.clear();
+    _indexSequence = 0u;
+
+    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+    {
+        IndexedFeature value( _indexSequence++, itr->get() );
+        Bounds b = value.second->getGeometry() ? value.second->getGeometry()->getBounds() : Bounds();
+        if ( b.isValid() )
+            entries.push_back( FeatureRTree::Entry(b.xMin(), b.yMin(), b.xMax(), b.yMax(), value) );
+        else
+            _unindexed.push_back( value );
+    }
+
+    _index.load( entries );
+    _indexDirty = false;
+    sync( _indexRevision );
+}
+
+void
+FeatureListSource::indexFeature(Feature* feature)
+{
+    IndexedFeature value( _indexSequence++, feature );
+    Bounds b = feature->getGeometry() ? feature->getGeometry()->getBounds() : Bounds();
+    if ( b.isValid() )
+        _index.insert( b.xMin(), b.yMin(), b.xMax(), b.yMax(), value );
+    else
+        _unindexed.push_back( value );
+}
+
+bool
+FeatureListSource::unindexFeature(Feature* feature)
+{
+    Bounds b = feature->getGeometry() ? feature->getGeometry()->getBounds() : Bounds();
+    if ( b.isValid() )
+    {
+        // the sequence number isn't known here, so find the entry by pointer.
+        std::vector<IndexedFeature> hits;
+        _index.search( b.xMin(), b.yMin(), b.xMax(), b.yMax(), hits );
+        for (unsigned i = 0; i < hits.size(); ++i)
+        {
+            if ( hits[i].second == feature )
+                return _index.remove( b.xMin(), b.yMin(), b.xMax(), b.yMax(), hits[i] );
+        }
+        return false;
+    }
+
+    for (std::vector<IndexedFeature>::iterator i = _unindexed.begin(); i != _unindexed.end(); ++i)
+    {
+        if ( i->second == feature )
+        {
+            _unindexed.erase( i );
+            return true;
+        }
+    }
+    return false;
+}
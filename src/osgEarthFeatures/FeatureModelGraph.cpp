@@ -27,6 +27,7 @@
 #include <osgEarth/Clamping>
 #include <osgEarth/ClampableNode>
 #include <osgEarth/CullingUtils>
+#include <osgEarth/DateTime>
 #include <osgEarth/ElevationLOD>
 #include <osgEarth/ElevationQuery>
 #include <osgEarth/FadeEffect>
@@ -228,8 +229,89 @@ namespace
             node->getOrCreateStateSet()->addUniform( u );
         }
     };
+
+    // parses the tile address out of a pseudo-loader URI.
+    bool s_parseURI(const std::string& uri, unsigned& lod, unsigned& x, unsigned& y)
+    {
+        return sscanf( uri.c_str(), "%u_%u_%u.%*s", &lod, &x, &y ) == 3;
+    }
+
+    // whether a tile extent overlaps or touches a changed extent (same SRS).
+    bool s_touches(const GeoExtent& tile, const GeoExtent& change)
+    {
+        if ( change.crossesAntimeridian() )
+        {
+            GeoExtent west, east;
+            change.splitAcrossAntimeridian( west, east );
+            return s_touches( tile, west ) || s_touches( tile, east );
+        }
+
+        return
+            tile.west()  <= change.east()  && tile.east()  >= change.west() &&
+            tile.south() <= change.north() && tile.north() >= change.south();
+    }
+
+    bool s_touchesAny(const GeoExtent& tile, const std::vector<GeoExtent>& changes)
+    {
+        for(std::vector<GeoExtent>::const_iterator i = changes.begin(); i != changes.end(); ++i)
+            if ( s_touches(tile, *i) )
+                return true;
+        return false;
+    }
+
+    // finds the paged-in feature tiles in a graph.
+    struct CollectLoadedTiles : public osg::NodeVisitor
+    {
+        CollectLoadedTiles() : osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ) { }
+
+        void apply(osg::PagedLOD& plod)
+        {
+            if ( plod.getNumFileNames() > 0 &&
+                 plod.getNumChildren() > 0 &&
+                 osgDB::getLowerCaseFileExtension(plod.getFileName(0)) == "osgearth_pseudo_fmg" )
+            {
+                _tiles.push_back( &plod );
+            }
+            traverse( plod );
+        }
+
+        std::vector<osg::PagedLOD*> _tiles;
+    };
 }
 
+//---------------------------------------------------------------------------
+
+// A paged-in tile to rebuild, and its replacement.
+struct FeatureModelGraph::RefreshTile
+{
+    osg::observer_ptr<osg::PagedLOD>   _plod;
+    unsigned                           _lod, _x, _y;
+    std::string                        _uri;
+    osg::ref_ptr<const osgDB::Options> _readOptions;
+    osg::ref_ptr<osg::Node>            _result;
+};
+
+// Rebuilds a set of tiles in the background. The graph swaps the results in
+// all together, during the update traversal, once every tile is done.
+struct FeatureModelGraph::RefreshTask : public TaskRequest
+{
+    FeatureModelGraph*       _graph;
+    std::vector<RefreshTile> _tiles;
+
+    void operator()(ProgressCallback* progress)
+    {
+        for(std::vector<RefreshTile>::iterator t = _tiles.begin(); t != _tiles.end(); ++t)
+        {
+            if ( progress && progress->isCanceled() )
+                return;
+
+            // skip tiles the pager expired in the meantime.
+            if ( t->_plod.valid() )
+                t->_result = _graph->load( t->_lod, t->_x, t->_y, t->_uri, t->_readOptions.get() );
+        }
+    }
+};
+
 
 //---------------------------------------------------------------------------
 
@@ -493,12 +575,20 @@ FeatureModelGraph::ctor()
 
     ADJUST_EVENT_TRAV_COUNT( this, 1 );
 
+    // identifies the tiles this graph writes to the cache, so it can tell which
+    // source revision they were built from.
+    _cacheSession = Stringify() << DateTime().asTimeStamp() << "." << Registry::instance()->createUID();
+    _session->getFeatureSource()->sync( _cacheBaseRev );
+
     redraw();
 }
 
 FeatureModelGraph::~FeatureModelGraph()
 {
-    //nop
+    // stop the refresh thread before it can touch a dead graph.
+    if ( _refresh.valid() )
+        _refresh->cancel();
+    _refreshService = 0L;
 }
 
 void
@@ -911,6 +1001,7 @@ namespace
 
 osg::Group*
 FeatureModelGraph::readTileFromCache(const std::string&    cacheKey,
+                                     const GeoExtent&      extent,
                                      const osgDB::Options* readOptions)
 {
     osg::ref_ptr<osg::Group> group;
@@ -935,6 +1026,12 @@ FeatureModelGraph::readTileFromCache(const std::string&    cacheKey,
             return 0L;
         }
 
+        if (rr.succeeded() && isStale(extent, rr.metadata()))
+        {
+            OE_DEBUG << LC << "Tile " << cacheKey << " is cached but features changed there since.\n";
+            return 0L;
+        }
+
         if (rr.succeeded())
         {
             group = dynamic_cast<osg::Group*>(rr.getNode());
@@ -971,6 +1068,7 @@ FeatureModelGraph::readTileFromCache(const std::string&    cacheKey,
 bool
 FeatureModelGraph::writeTileToCache(const std::string&    cacheKey,
                                     osg::Group*           node,
+                                    const Revision&       sourceRev,
                                     const osgDB::Options* writeOptions)
 {
     osg::ref_ptr<CacheBin> cacheBin;
@@ -983,7 +1081,10 @@ FeatureModelGraph::writeTileToCache(const std::string&    cacheKey,
 
     if (cacheBin && policy->isCacheWriteable())
     {
-        cacheBin->writeNode(cacheKey, node, Config(), writeOptions);
+        Config meta;
+        meta.set( "fmg_session",  _cacheSession );
+        meta.set( "fmg_revision", (int)sourceRev );
+        cacheBin->writeNode(cacheKey, node, meta, writeOptions);
         OE_DEBUG << LC << "Wrote " << cacheKey << " to cache\n";
     }
     return true;
@@ -1003,9 +1104,14 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
 {
     osg::ref_ptr<osg::Group> group;
 
-    // Try to read it from a cache:
+    // the revision of the features the tile is built from, recorded in the cache:
+    Revision sourceRev;
+    if ( _session->getFeatureSource() )
+        _session->getFeatureSource()->sync( sourceRev );
+
+    // Try to read it from a cache, unless features changed there since it was cached:
     std::string cacheKey = makeCacheKey(level, extent, key);
-    group = readTileFromCache(cacheKey, readOptions);
+    group = readTileFromCache(cacheKey, extent, readOptions);
     
     // Not there? Build it
     if (!group.valid())
@@ -1083,7 +1189,7 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
         // cache it if appropriate.
         if (_options.nodeCaching() == true)
         {
-            writeTileToCache(cacheKey, group.get(), readOptions);
+            writeTileToCache(cacheKey, group.get(), sourceRev, readOptions);
         }
     }
 
@@ -1152,7 +1258,7 @@ FeatureModelGraph::build(const Style&          defaultStyle,
         const FeatureProfile* featureProfile = source->getFeatureProfile();
 
         // each feature has its own style, so use that and ignore the style catalog.
-        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor( baseQuery );
+        osg::ref_ptr<FeatureCursor> cursor = _session->createFeatureCursor( baseQuery );
 
         while( cursor.valid() && cursor->hasMore() )
         {
@@ -1345,7 +1451,7 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
     const GeoExtent& extent = featureProfile->getExtent();
     
     // query the feature source:
-    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createFeatureCursor( query );
+    osg::ref_ptr<FeatureCursor> cursor = _session->createFeatureCursor( query );
     if ( !cursor.valid() )
         return;
 
@@ -1486,7 +1592,7 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
     const GeoExtent& extent = featureProfile->getExtent();
     
     // query the feature source:
-    osg::ref_ptr<FeatureCursor> cursor = _session->getFeatureSource()->createFeatureCursor( query );
+    osg::ref_ptr<FeatureCursor> cursor = _session->createFeatureCursor( query );
 
     if ( cursor.valid() && cursor->hasMore() )
     {
@@ -1627,7 +1733,8 @@ FeatureModelGraph::traverse(osg::NodeVisitor& nv)
             ADJUST_UPDATE_TRAV_COUNT( this, 1 );
         }
 
-        else if ( _overlayChange != OVERLAY_NO_CHANGE )
+        // (an overlay change waits for a pending update, which may take a few frames)
+        else if ( !_pendingUpdate && _overlayChange != OVERLAY_NO_CHANGE )
         {
             ADJUST_UPDATE_TRAV_COUNT( this, 1 );
         }
@@ -1637,9 +1744,32 @@ FeatureModelGraph::traverse(osg::NodeVisitor& nv)
     {
         if ( _pendingUpdate )
         {
-            redraw();
-            _pendingUpdate = false;
-            ADJUST_UPDATE_TRAV_COUNT( this, -1 );
+            bool done = true;
+
+            if ( _refresh.valid() )
+            {
+                // a refresh is in flight; swap it in once every tile is ready.
+                if ( _refresh->isCompleted() )
+                    finishRefresh();
+                else
+                    done = false;
+            }
+
+            else if ( _dirty || !startRefresh() )
+            {
+                redraw();
+            }
+
+            else if ( _refresh.valid() )
+            {
+                done = false;
+            }
+
+            if ( done )
+            {
+                _pendingUpdate = false;
+                ADJUST_UPDATE_TRAV_COUNT( this, -1 );
+            }
         }
 
         else if ( _overlayChange != OVERLAY_NO_CHANGE )
@@ -1826,6 +1956,180 @@ FeatureModelGraph::redraw()
     _dirty = false;
 }
 
+/**
+ * Starts rebuilding the paged-in tiles that intersect the areas where the
+ * feature source changed. Returns false if that's not possible and the
+ * caller should redraw the whole graph instead.
+ */
+bool
+FeatureModelGraph::startRefresh()
+{
+    // without paging, there is only one "tile" anyway.
+    if ( !_options.layout().isSet() && !_useTiledSource )
+        return false;
+
+    if ( !_usableFeatureExtent.isValid() )
+        return false;
+
+    if ( _modelSource.valid() && _modelSource->outOfSyncWith(_modelSourceRev) )
+        return false;
+
+    // where did the features change? (this syncs the revision on success)
+    std::vector<GeoExtent> changes;
+    if ( !_session->getFeatureSource()->getChangedExtents(_featureSourceRev, changes) )
+        return false;
+
+    for(std::vector<GeoExtent>::iterator i = changes.begin(); i != changes.end(); ++i)
+    {
+        if ( !i->getSRS()->isHorizEquivalentTo(_usableFeatureExtent.getSRS()) )
+        {
+            *i = i->transform( _usableFeatureExtent.getSRS() );
+            if ( !i->isValid() )
+                return false;
+        }
+    }
+
+    // tiles that came up empty before may not be empty anymore.
+    {
+        Threading::ScopedWriteLock exclusiveLock( _blacklistMutex );
+        for(std::set<std::string>::iterator i = _blacklist.begin(); i != _blacklist.end(); )
+        {
+            unsigned lod, x, y;
+            if ( s_parseURI(*i, lod, x, y) && s_touchesAny(s_getTileExtent(lod, x, y, _usableFeatureExtent), changes) )
+                _blacklist.erase( i++ );
+            else
+                ++i;
+        }
+    }
+
+    // find the paged-in tiles that need rebuilding. Tiles that aren't paged in
+    // will pick up the changes whenever they do page in.
+    CollectLoadedTiles collect;
+    accept( collect );
+
+    osg::ref_ptr<RefreshTask> task = new RefreshTask();
+    task->_graph = this;
+
+    for(std::vector<osg::PagedLOD*>::const_iterator i = collect._tiles.begin(); i != collect._tiles.end(); ++i)
+    {
+        osg::PagedLOD* plod = *i;
+
+        RefreshTile tile;
+        if ( !s_parseURI(plod->getFileName(0), tile._lod, tile._x, tile._y) )
+            continue;
+
+        if ( !s_touchesAny(s_getTileExtent(tile._lod, tile._x, tile._y, _usableFeatureExtent), changes) )
+            continue;
+
+        tile._plod        = plod;
+        tile._uri         = plod->getFileName(0);
+        tile._readOptions = dynamic_cast<const osgDB::Options*>( plod->getDatabaseOptions() );
+        task->_tiles.push_back( tile );
+    }
+
+    OE_DEBUG << LC << "Refreshing " << task->_tiles.size() << " of " << collect._tiles.size()
+        << " tiles for " << changes.size() << " changes" << std::endl;
+
+    if ( !task->_tiles.empty() )
+    {
+        if ( !_refreshService.valid() )
+            _refreshService = new TaskService( "FeatureModelGraph refresh", 1 );
+
+        _refresh = task.get();
+        _refreshService->add( task.get() );
+    }
+
+    return true;
+}
+
+/**
+ * Swaps the tiles rebuilt by startRefresh into the graph.
+ */
+void
+FeatureModelGraph::finishRefresh()
+{
+    for(std::vector<RefreshTile>::iterator t = _refresh->_tiles.begin(); t != _refresh->_tiles.end(); ++t)
+    {
+        // the pager may have expired the tile in the meantime; if so it
+        // will page in fresh next time.
+        osg::ref_ptr<osg::PagedLOD> plod;
+        if ( !t->_result.valid() || !t->_plod.lock(plod) || plod->getNumChildren() == 0 )
+            continue;
+
+        osg::Node* oldTile = plod->getChild(0);
+
+        // keep the subtiles that are already paged in; they refresh on their own.
+        osg::Group* oldGroup = oldTile->asGroup();
+        osg::Group* newGroup = t->_result->asGroup();
+        if ( oldGroup && newGroup )
+        {
+            for(unsigned i = 0; i < newGroup->getNumChildren(); ++i)
+            {
+                osg::PagedLOD* newSubtile = dynamic_cast<osg::PagedLOD*>( newGroup->getChild(i) );
+                if ( !newSubtile || newSubtile->getNumFileNames() == 0 )
+                    continue;
+
+                for(unsigned j = 0; j < oldGroup->getNumChildren(); ++j)
+                {
+                    osg::PagedLOD* oldSubtile = dynamic_cast<osg::PagedLOD*>( oldGroup->getChild(j) );
+                    if ( oldSubtile && oldSubtile->getNumFileNames() > 0 &&
+                         oldSubtile->getFileName(0) == newSubtile->getFileName(0) )
+                    {
+                        newGroup->setChild( i, oldSubtile );
+                        break;
+                    }
+                }
+            }
+        }
+
+        // runs the post-merge operations on the new tile.
+        plod->replaceChild( oldTile, t->_result.get() );
+    }
+
+    _refresh = 0L;
+}
+
+/**
+ * Whether features changed within a tile's extent since the tile was written
+ * to the cache. The record holds the source revision it was built from; records
+ * from another session are taken to date from when this graph was created.
+ */
+bool
+FeatureModelGraph::isStale(const GeoExtent& extent, const Config& cacheMeta) const
+{
+    FeatureSource* source = _session->getFeatureSource();
+    if ( !source )
+        return false;
+
+    Revision current;
+    source->sync( current );
+
+    Revision rev = _cacheBaseRev;
+    if ( cacheMeta.value("fmg_session") == _cacheSession )
+        rev = cacheMeta.value<int>("fmg_revision", -1);
+
+    if ( (int)rev == (int)current )
+        return false;
+
+    // unknown changes (e.g. a plain dirty()) may be anywhere.
+    std::vector<GeoExtent> changes;
+    if ( !source->getChangedExtents(rev, changes) )
+        return true;
+
+    if ( changes.empty() )
+        return false;
+
+    // no extent means the whole data set.
+    if ( !extent.isValid() )
+        return true;
+
+    GeoExtent local = extent;
+    if ( !local.getSRS()->isHorizEquivalentTo(changes.front().getSRS()) )
+        local = local.transform( changes.front().getSRS() );
+
+    return !local.isValid() || s_touchesAny( local, changes );
+}
+
 void
 FeatureModelGraph::setStyles( StyleSheet* styles )
 {
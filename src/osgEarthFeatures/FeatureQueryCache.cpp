@@ -0,0 +1,325 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureQueryCache>
+#include <osgEarthFeatures/FeatureSource>
+#include <osgEarth/Metrics>
+#include <osgEarth/StringUtils>
+#include <sstream>
+#include <iomanip>
+
+#define LC "[FeatureQueryCache] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+namespace
+{
+    // Cursor over copy-on-write views of the features in a cache entry. Holds a reference
+    // to the entry so it survives eviction while the cursor is in use.
+    class CachedFeatureCursor : public FeatureCursor
+    {
+    public:
+        CachedFeatureCursor(const FeatureList& features, osg::Referenced* owner) :
+            _owner( owner ),
+            _iter ( features.begin() ),
+            _end  ( features.end() ) { }
+
+        bool hasMore() const
+        {
+            return _iter != _end;
+        }
+
+        Feature* nextFeature()
+        {
+            if ( !hasMore() )
+                return 0L;
+
+            // consumers are free to modify what they get, so hand out a copy-on-write view.
+            _lastFeatureReturned = new Feature( *_iter->get(), osg::CopyOp::SHALLOW_COPY );
+            ++_iter;
+            return _lastFeatureReturned.get();
+        }
+
+    private:
+        osg::ref_ptr<osg::Referenced>  _owner;
+        FeatureList::const_iterator    _iter;
+        FeatureList::const_iterator    _end;
+        osg::ref_ptr<Feature>          _lastFeatureReturned;
+    };
+
+    // Rough estimate of the memory held by a feature.
+    unsigned estimateSize(const Feature* feature)
+    {
+        unsigned bytes = sizeof(Feature);
+
+        if ( feature->getGeometry() )
+        {
+            ConstGeometryIterator i( feature->getGeometry(), true );
+            while( i.hasMore() )
+            {
+                const Geometry* part = i.next();
+                bytes += sizeof(Geometry) + part->size() * sizeof(osg::Vec3d);
+            }
+        }
+
+        const AttributeTable& attrs = feature->getAttrs();
+        for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            // value plus the overhead of a map node:
+            bytes += sizeof(AttributeTable::value_type) + 4*sizeof(void*);
+            bytes += a->first.size() + a->second.second.stringValue.size();
+        }
+
+        return bytes;
+    }
+}
+
+//------------------------------------------------------------------------
+
+FeatureQueryCache::FeatureQueryCache(unsigned long long maxBytes) :
+osg::Referenced( true ),
+_maxBytes( maxBytes ),
+_bytes   ( 0ull ),
+_hits    ( 0u ),
+_misses  ( 0u )
+{
+    //nop
+}
+
+void
+FeatureQueryCache::setMaxBytes(unsigned long long value)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _maxBytes = value;
+    evict();
+}
+
+void
+FeatureQueryCache::clear()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    clearImpl();
+}
+
+void
+FeatureQueryCache::clearImpl()
+{
+    _slots.clear();
+    _lru.clear();
+    _bytes = 0ull;
+}
+
+std::string
+FeatureQueryCache::makeKey(const Query& query) const
+{
+    std::stringstream buf;
+    buf << std::setprecision(17);
+
+    if ( query.tileKey().isSet() )
+    {
+        buf << "k" << query.tileKey()->str();
+        if ( query.tileKey()->getProfile() )
+            buf << "@" << query.tileKey()->getProfile()->getHorizSignature();
+    }
+    if ( query.bounds().isSet() )
+    {
+        const Bounds& b = query.bounds().get();
+        buf << "|b" << b.xMin() << "," << b.yMin() << "," << b.xMax() << "," << b.yMax();
+    }
+    if ( query.expression().isSet() )
+        buf << "|e" << query.expression().get();
+    if ( query.orderby().isSet() )
+        buf << "|o" << query.orderby().get();
+    if ( query.limit().isSet() )
+        buf << "|l" << query.limit().get();
+
+    return buf.str();
+}
+
+FeatureCursor*
+FeatureQueryCache::createFeatureCursor(FeatureSource* source, const Query& query)
+{
+    if ( !source )
+        return 0L;
+
+    if ( _maxBytes == 0u )
+        return source->createFeatureCursor( query );
+
+    const std::string key = makeKey( query );
+
+    osg::ref_ptr<Entry>       entry;
+    Threading::Promise<Entry> promise;
+    Threading::Future<Entry>  future;
+    bool                      isLoader = false;
+    bool                      isWaiter = false;
+    Revision                  revision;
+
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+
+        if ( source->outOfSyncWith(_sourceRevision) )
+        {
+            clearImpl();
+            source->sync( _sourceRevision );
+
+            // a source that is always dirty can't be cached.
+            if ( source->outOfSyncWith(_sourceRevision) )
+                return source->createFeatureCursor( query );
+        }
+
+        revision = _sourceRevision;
+
+        Slots::iterator i = _slots.find( key );
+        if ( i != _slots.end() )
+        {
+            entry = i->second._entry.get();
+            _lru.splice( _lru.begin(), _lru, i->second._lru );
+            ++_hits;
+        }
+        else
+        {
+            InFlight::iterator f = _inFlight.find( key );
+            if ( f != _inFlight.end() )
+            {
+                // someone else is reading this query right now; wait for them.
+                future = f->second;
+                isWaiter = true;
+                ++_hits;
+            }
+            else
+            {
+                _inFlight[key] = promise.getFuture();
+                isLoader = true;
+                ++_misses;
+            }
+        }
+    }
+
+    if ( isWaiter )
+    {
+        entry = future.get();
+
+        // the loader failed; read it ourselves without caching.
+        if ( !entry.valid() )
+            return source->createFeatureCursor( query );
+    }
+
+    else if ( isLoader )
+    {
+        entry = load( source, query );
+
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _inFlight.erase( key );
+
+            // don't keep results that the source invalidated while we were reading.
+            if ( entry.valid() && revision == _sourceRevision && source->inSyncWith(_sourceRevision) )
+            {
+                insert( key, entry.get() );
+            }
+
+            reportMetrics();
+        }
+
+        // release any waiters only after the entry is in the cache.
+        promise.resolve( entry.get() );
+    }
+
+    return entry.valid() ? new CachedFeatureCursor( entry->_features, entry.get() ) : 0L;
+}
+
+FeatureQueryCache::Entry*
+FeatureQueryCache::load(FeatureSource* source, const Query& query) const
+{
+    osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor( query );
+    if ( !cursor.valid() )
+        return 0L;
+
+    Entry* entry = new Entry();
+    entry->_bytes = sizeof(Entry);
+
+    while( cursor->hasMore() )
+    {
+        Feature* feature = cursor->nextFeature();
+        if ( feature )
+        {
+            entry->_features.push_back( feature );
+            entry->_bytes += estimateSize( feature );
+        }
+    }
+
+    return entry;
+}
+
+void
+FeatureQueryCache::insert(const std::string& key, Entry* entry)
+{
+    Slots::iterator i = _slots.find( key );
+    if ( i != _slots.end() )
+    {
+        _bytes -= i->second._entry->_bytes;
+        _lru.erase( i->second._lru );
+        _slots.erase( i );
+    }
+
+    // results bigger than the whole cache are passed through, not cached.
+    if ( entry->_bytes > _maxBytes )
+        return;
+
+    _lru.push_front( key );
+    Slot& slot = _slots[key];
+    slot._entry = entry;
+    slot._lru   = _lru.begin();
+    _bytes += entry->_bytes;
+
+    evict();
+}
+
+void
+FeatureQueryCache::evict()
+{
+    while( _bytes > _maxBytes && !_lru.empty() )
+    {
+        Slots::iterator i = _slots.find( _lru.back() );
+        if ( i != _slots.end() )
+        {
+            _bytes -= i->second._entry->_bytes;
+            _slots.erase( i );
+        }
+        _lru.pop_back();
+    }
+}
+
+void
+FeatureQueryCache::reportMetrics() const
+{
+    if ( Metrics::enabled() )
+    {
+        unsigned total = _hits + _misses;
+        Metrics::counter(
+            _name.empty() ? "FeatureQueryCache" : "FeatureQueryCache " + _name,
+            "Hits",     _hits,
+            "Misses",   _misses,
+            "Hit rate", total > 0u ? 100.0*(double)_hits/(double)total : 0.0 );
+    }
+
+    OE_DEBUG << LC << _name << ": " << _slots.size() << " results, " << (_bytes/1024ull) << " KB, "
+        << _hits << " hits, " << _misses << " misses" << std::endl;
+}
@@ -27,12 +27,16 @@
 
 #define LC "[FeatureSource] "
 
+// number of recent changes that dirtyExtent remembers
+#define MAX_CHANGES 1024
+
 using namespace osgEarth::Features;
 using namespace osgEarth::Symbology;
 using namespace OpenThreads;
 
 FeatureSourceOptions::FeatureSourceOptions(const ConfigOptions& options) :
-DriverConfigOptions( options )
+DriverConfigOptions( options ),
+_queryCacheSizeMB  ( 32u )
 {
     fromConfig( _conf );
 }
@@ -54,6 +58,7 @@ FeatureSourceOptions::fromConfig(const Config& conf)
     conf.getIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.getIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
     conf.getIfSet   ( "fid_attribute", _fidAttribute );
+    conf.getIfSet   ( "query_cache_size_mb", _queryCacheSizeMB );
 
     // For backwards-compatibility (before adding the "filters" block)
     // TODO: Remove at some point in the distant future.
@@ -81,6 +86,7 @@ FeatureSourceOptions::getConfig() const
     conf.updateIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
     conf.updateIfSet   ( "geo_interpolation", "rhumb_line",   _geoInterp, GEOINTERP_RHUMB_LINE );
     conf.updateIfSet   ( "fid_attribute", _fidAttribute );
+    conf.updateIfSet   ( "query_cache_size_mb", _queryCacheSizeMB );
 
     if ( !_filterOptions.empty() )
     {
@@ -99,10 +105,17 @@ FeatureSourceOptions::getConfig() const
 
 FeatureSource::FeatureSource(const ConfigOptions&  options,
                              const osgDB::Options* readOptions) :
-_options( options )
+_options     ( options ),
+_numConsumers( 0u )
 {    
     _readOptions  = readOptions;
     _uriContext  = URIContext( _readOptions.get() );
+
+    if ( _options.queryCacheSizeMB().get() > 0u )
+    {
+        _queryCache = new FeatureQueryCache( (unsigned long long)_options.queryCacheSizeMB().get() * 1024ull * 1024ull );
+        _queryCache->setName( _options.name().get() );
+    }
 }
 
 FeatureSource::~FeatureSource()
@@ -132,6 +145,25 @@ FeatureSource::open(const osgDB::Options* readOptions)
     return _status;
 }
 
+void
+FeatureSource::addConsumer()
+{
+    Threading::ScopedMutexLock lock( _consumersMutex );
+    ++_numConsumers;
+}
+
+void
+FeatureSource::removeConsumer()
+{
+    Threading::ScopedMutexLock lock( _consumersMutex );
+    if ( _numConsumers > 0u )
+        --_numConsumers;
+
+    // nobody left to share with; release the memory.
+    if ( _numConsumers <= 1u && _queryCache.valid() )
+        _queryCache->clear();
+}
+
 void
 FeatureSource::setFeatureProfile(const FeatureProfile* fp)
 {
@@ -156,6 +188,12 @@ FeatureSource::addToBlacklist( FeatureID fid )
 {
     Threading::ScopedWriteLock exclusive( _blacklistMutex );
     _blacklist.insert( fid );
+
+    // cached query results may hold blacklisted features (or lack un-blacklisted
+    // ones). Don't dirty the source; that would make every consumer rebuild
+    // all of its tiles.
+    if ( _queryCache.valid() )
+        _queryCache->clear();
 }
 
 void
@@ -163,6 +201,9 @@ FeatureSource::removeFromBlacklist( FeatureID fid )
 {
     Threading::ScopedWriteLock exclusive( _blacklistMutex );
     _blacklist.erase( fid );
+
+    if ( _queryCache.valid() )
+        _queryCache->clear();
 }
 
 void
@@ -170,6 +211,9 @@ FeatureSource::clearBlacklist()
 {
     Threading::ScopedWriteLock exclusive( _blacklistMutex );
     _blacklist.clear();
+
+    if ( _queryCache.valid() )
+        _queryCache->clear();
 }
 
 bool
@@ -179,6 +223,66 @@ FeatureSource::isBlacklisted( FeatureID fid ) const
     return _blacklist.find( fid ) != _blacklist.end();
 }
 
+void
+FeatureSource::dirtyExtent(const GeoExtent& extent)
+{
+    Threading::ScopedMutexLock lock( _changesMutex );
+
+    dirty();
+
+    Revision revision;
+    sync( revision );
+
+    Change change;
+    change._revision = revision;
+    change._extent   = extent;
+    _changes.push_back( change );
+
+    if ( _changes.size() > MAX_CHANGES )
+        _changes.pop_front();
+}
+
+bool
+FeatureSource::getChangedExtents(Revision& revision, std::vector<GeoExtent>& output) const
+{
+    Threading::ScopedMutexLock lock( _changesMutex );
+
+    Revision current;
+    sync( current );
+
+    // nothing changed (unless the source is always dirty)
+    if ( (int)revision == (int)current )
+        return inSyncWith( revision );
+
+    // every revision since the caller's must be a recorded change with a
+    // usable extent; revisions increase by one, so count them.
+    if ( (int)revision > (int)current )
+        return false;
+
+    unsigned count = 0u;
+    for(std::deque<Change>::const_iterator i = _changes.begin(); i != _changes.end(); ++i)
+    {
+        if ( i->_revision > (int)revision && i->_revision <= (int)current )
+        {
+            if ( !i->_extent.isValid() )
+                return false;
+            ++count;
+        }
+    }
+
+    if ( (int)count != (int)current - (int)revision )
+        return false;
+
+    for(std::deque<Change>::const_iterator i = _changes.begin(); i != _changes.end(); ++i)
+    {
+        if ( i->_revision > (int)revision && i->_revision <= (int)current )
+            output.push_back( i->_extent );
+    }
+
+    revision = current;
+    return true;
+}
+
 void
 FeatureSource::applyFilters(FeatureList& features, const GeoExtent& extent) const
 {
@@ -367,11 +367,36 @@ FeatureSourceIndex::~FeatureSourceIndex()
         _masterIndex->remove( KeyIter<OIDMap>(_oids.begin()), KeyIter<OIDMap>(_oids.end()) );
     }
 
+    if ( _masterIndex.valid() && !_reservedOIDs.empty() )
+    {
+        _masterIndex->remove( _reservedOIDs.begin(), _reservedOIDs.end() );
+    }
+
     _oids.clear();
     _fids.clear();
     _embeddedFeatures.clear();
 }
 
+ObjectID
+FeatureSourceIndex::nextOID()
+{
+    // assumes the mutex is locked. Reserve OIDs from the master index in
+    // blocks so that tagging a tile full of features doesn't contend on it.
+    if ( _reservedOIDs.empty() )
+    {
+        _masterIndex->insert( this, 256u, _reservedOIDs );
+        if ( _reservedOIDs.empty() )
+            return OSGEARTH_OBJECTID_EMPTY;
+
+        // hand them out in the order they were allocated.
+        std::reverse( _reservedOIDs.begin(), _reservedOIDs.end() );
+    }
+
+    ObjectID oid = _reservedOIDs.back();
+    _reservedOIDs.pop_back();
+    return oid;
+}
+
 RefIDPair*
 FeatureSourceIndex::tagDrawable(osg::Drawable* drawable, Feature* feature)
 {
@@ -391,7 +416,8 @@ FeatureSourceIndex::tagDrawable(osg::Drawable* drawable, Feature* feature)
     }
     else
     {
-        ObjectID oid = _masterIndex->tagDrawable( drawable, this );
+        ObjectID oid = nextOID();
+        _masterIndex->tagDrawable( drawable, oid );
         p = new RefIDPair( fid, oid );
         _fids[fid] = p;
         _oids[oid] = fid;
@@ -424,7 +450,8 @@ FeatureSourceIndex::tagAllDrawables(osg::Node* node, Feature* feature)
     }
     else
     {
-        ObjectID oid = _masterIndex->tagAllDrawables( node, this );
+        ObjectID oid = nextOID();
+        _masterIndex->tagAllDrawables( node, oid );
         p = new RefIDPair( fid, oid );
         _fids[fid] = p;
         _oids[oid] = fid;
@@ -458,7 +485,8 @@ FeatureSourceIndex::tagNode(osg::Node* node, Feature* feature)
     }
     else
     {
-        oid = _masterIndex->tagNode( node, this );
+        oid = nextOID();
+        _masterIndex->tagNode( node, oid );
         p = new RefIDPair( fid, oid );
         _fids[fid] = p;
         _oids[oid] = fid;
@@ -63,7 +63,7 @@ ResampleFilter::push( Feature* input, FilterContext& context )
 
     bool success = true;
 
-    GeometryIterator i( input->getGeometry() );
+    GeometryIterator i( input->getGeometryForWrite() );
     while( i.hasMore() )
     {        
         Geometry* part = i.next();
@@ -46,7 +46,7 @@ ScaleFilter::push( FeatureList& input, FilterContext& cx )
             Bounds envelope = input->getGeometry()->getBounds();
 
             // now scale and shift everything
-            GeometryIterator scale_iter( input->getGeometry() );
+            GeometryIterator scale_iter( input->getGeometryForWrite() );
             while( scale_iter.hasMore() )
             {
                 Geometry* geom = scale_iter.next();
@@ -58,11 +58,15 @@ _dbOptions     ( dbOptions )
     _stateSetCache = new StateSetCache();
 
     _name = "Session (unnamed)";
+
+    if ( _featureSource.valid() )
+        _featureSource->addConsumer();
 }
 
 Session::~Session()
 {
-    //nop
+    if ( _featureSource.valid() )
+        _featureSource->removeConsumer();
 }
 
 const osgDB::Options*
@@ -142,7 +146,16 @@ Session::getScriptEngine() const
 void
 Session::setFeatureSource(FeatureSource* fs)
 {
+    if ( fs == _featureSource.get() )
+        return;
+
+    if ( _featureSource.valid() )
+        _featureSource->removeConsumer();
+
     _featureSource = fs;
+
+    if ( _featureSource.valid() )
+        _featureSource->addConsumer();
 }
 
 FeatureSource*
@@ -150,3 +163,18 @@ Session::getFeatureSource() const
 { 
     return _featureSource.get(); 
 }
+
+FeatureCursor*
+Session::createFeatureCursor(const Symbology::Query& query) const
+{
+    FeatureSource* source = _featureSource.get();
+    if ( !source )
+        return 0L;
+
+    // Only worth caching when another layer may ask for the same data.
+    FeatureQueryCache* cache = source->getQueryCache();
+    if ( cache && source->getNumConsumers() > 1u )
+        return cache->createFeatureCursor( source, query );
+
+    return source->createFeatureCursor( query );
+}
@@ -249,7 +249,7 @@ SubstituteModelFilter::process(const FeatureList&           features,
 
         if ( model.valid() )
         {
-            GeometryIterator gi( input->getGeometry(), false );
+            GeometryIterator gi( input->getGeometryForWrite(), false );
             while( gi.hasMore() )
             {
                 Geometry* geom = gi.next();
@@ -115,7 +115,7 @@ TessellateOperator::operator()( Feature* feature, FilterContext& context ) const
         sliceSize = _maxDistance->as(Units::METERS);
     }
 
-    GeometryIterator i( feature->getGeometry(), true );
+    GeometryIterator i( feature->getGeometryForWrite(), true );
     while( i.hasMore() )
     {
         Geometry* g = i.next();
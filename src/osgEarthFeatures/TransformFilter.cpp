@@ -34,7 +34,7 @@ namespace
     {
         if ( input && input->getGeometry() )
         {
-            GeometryIterator iter( input->getGeometry() );
+            GeometryIterator iter( input->getGeometryForWrite() );
             while( iter.hasMore() )
             {
                 Geometry* geom = iter.next();
@@ -86,7 +86,7 @@ TransformFilter::push( Feature* input, FilterContext& context )
         return true;
 
     // iterate over the feature geometry.
-    GeometryIterator iter( input->getGeometry() );
+    GeometryIterator iter( input->getGeometryForWrite() );
     while( iter.hasMore() )
     {
         Geometry* geom = iter.next();
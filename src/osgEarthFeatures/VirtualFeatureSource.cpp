@@ -33,9 +33,15 @@ namespace
      */
     struct VirtualFeatureCursor : public FeatureCursor
     {
-        VirtualFeatureCursor( const FeatureSourceMappingVector& sources, const Query& query ) :
+        VirtualFeatureCursor( const FeatureSourceMappingVector& sources, const Query& query, const SpatialReference* srs ) :
           _sources(sources), _query(query)
         {
+            // extent of the query, used to skip sources that cannot contribute.
+            if ( _query.tileKey().isSet() )
+                _queryExtent = _query.tileKey()->getExtent();
+            else if ( _query.bounds().isSet() && srs )
+                _queryExtent = GeoExtent( srs, *_query.bounds() );
+
             _si = _sources.begin();
             advance();
         }
@@ -68,7 +74,7 @@ namespace
                     return;
 
                 // if we're at the beginning, create the first cursor:
-                if ( _si == _sources.begin() && !_si_cursor.valid() )
+                if ( _si == _sources.begin() && !_si_cursor.valid() && mayIntersect(_si->_source.get()) )
                 {
                     _si_cursor = _si->_source->createFeatureCursor( _query );
                 }
@@ -81,7 +87,8 @@ namespace
                         return;
 
                     // make a cursor for the next source
-                    _si_cursor = _si->_source->createFeatureCursor( _query );
+                    _si_cursor = mayIntersect(_si->_source.get()) ?
+                        _si->_source->createFeatureCursor( _query ) : 0L;
                 }
 
                 // here, we have a valid cursor with pending data:
@@ -93,9 +100,23 @@ namespace
             }
         }
 
+        // whether a source's extent overlaps the query extent (true if unknown).
+        bool mayIntersect( FeatureSource* source ) const
+        {
+            if ( !_queryExtent.isValid() )
+                return true;
+
+            const FeatureProfile* profile = source->getFeatureProfile();
+            if ( !profile || !profile->getExtent().isValid() )
+                return true;
+
+            return profile->getExtent().intersects( _queryExtent );
+        }
+
     private:
         FeatureSourceMappingVector           _sources;
         Query                                _query;
+        GeoExtent                            _queryExtent;
         FeatureSourceMappingVector::iterator _si;        // points to current source
         osg::ref_ptr<FeatureCursor>          _si_cursor; // cursor into current source
         osg::ref_ptr<Feature>                _nextFeature;
@@ -118,7 +139,8 @@ VirtualFeatureSource::add( FeatureSource* source, FeaturePredicate* predicate )
 FeatureCursor* 
 VirtualFeatureSource::createFeatureCursor( const Query& query )
 {
-    return new VirtualFeatureCursor( _sources, query );
+    const FeatureProfile* profile = getFeatureProfile();
+    return new VirtualFeatureCursor( _sources, query, profile ? profile->getSRS() : 0L );
 }
 
 Status 
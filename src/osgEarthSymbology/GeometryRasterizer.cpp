@@ -17,10 +17,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthSymbology/GeometryRasterizer>
+#include <osgEarthSymbology/ScanlineRasterizer>
 #include <osgEarthSymbology/PointSymbol>
 #include <osgEarthSymbology/LineSymbol>
 #include <osgEarthSymbology/PolygonSymbol>
-#include <osgEarthSymbology/AGG.h>
+#include <string.h>
 
 using namespace osgEarth::Symbology;
 
@@ -28,22 +29,18 @@ using namespace osgEarth::Symbology;
 
 // --------------------------------------------------------------------------
 
-struct AggState : public osg::Referenced
+struct RasterizerState : public osg::Referenced
 {
-    AggState( osg::Image* image )
-        : _rbuf( image->data(), image->s(), image->t(), image->s()*4 ),
-          _ren( _rbuf )
+    RasterizerState( osg::Image* image )
     {
-        _ras.gamma( 1.3 );
-        _ras.filling_rule( agg::fill_even_odd );
+        _ras.setGamma( 1.3 );
+        _ras.setFillRule( ScanlineRasterizer::FILL_EVEN_ODD );
 
         // pre-clear the buffer....
-        _ren.clear(agg::rgba8(0,0,0,0));
+        memset( image->data(), 0, image->getTotalSizeInBytes() );
     }
 
-    agg::rendering_buffer           _rbuf;
-    agg::renderer<agg::span_abgr32, agg::rgba8> _ren;
-    agg::rasterizer                 _ras;
+    ScanlineRasterizer _ras;
 };
 
 // --------------------------------------------------------------------------
@@ -54,14 +51,14 @@ _style( style )
     _image = new osg::Image();
     _image->allocateImage( width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE );
     _image->setAllocationMode( osg::Image::USE_NEW_DELETE );
-    _state = new AggState( _image.get() );
+    _state = new RasterizerState( _image.get() );
 }
 
 GeometryRasterizer::GeometryRasterizer( osg::Image* image, const Style& style ) :
 _image( image ),
 _style( style )
 {
-    _state = new AggState( _image.get() );
+    _state = new RasterizerState( _image.get() );
 }
 
 GeometryRasterizer::~GeometryRasterizer()
@@ -71,13 +68,12 @@ GeometryRasterizer::~GeometryRasterizer()
 osg::Image*
 GeometryRasterizer::finalize()
 {
-    //convert from ABGR to RGBA
-    unsigned char* pixel = _image->data();
-    for(int i=0; i<_image->s()*_image->t()*4; i+=4, pixel+=4)
-    {
-        std::swap( pixel[0], pixel[3] );
-        std::swap( pixel[1], pixel[2] );
-    }
+    if ( !_image.valid() ) return 0L;
+
+    // shapes are queued by draw() and all rendered here in one pass.
+    RasterizerState* state = static_cast<RasterizerState*>( _state.get() );
+    state->_ras.render( _image.get() );
+
     osg::Image* result = _image.release();
     _image = 0L;
     return result;
@@ -88,7 +84,7 @@ GeometryRasterizer::draw( const Geometry* geom, const osg::Vec4f& c )
 {
     if ( !_image.valid() ) return;
 
-    AggState* state = static_cast<AggState*>( _state.get() );
+    RasterizerState* state = static_cast<RasterizerState*>( _state.get() );
 
     osg::Vec4f color = c;
     osg::ref_ptr<const Geometry> geomToRender = geom;
@@ -112,25 +108,7 @@ GeometryRasterizer::draw( const Geometry* geom, const osg::Vec4f& c )
             color = ls->stroke()->color();
     }
 
-    float a = 127+(color.a()*255)/2; // scale alpha up
-    agg::rgba8 fgColor = agg::rgba8( (unsigned int)(color.r()*255), (unsigned int)(color.g()*255), (unsigned int)(color.b()*255), (unsigned int)a );
-
-    ConstGeometryIterator gi( geomToRender.get() );
-    while( gi.hasMore() )
-    {
-        const Vec3dVector& g = gi.next()->asVector();
+    color.a() = (127.0f+(color.a()*255.0f)/2.0f)/255.0f; // scale alpha up
 
-        for( Vec3dVector::const_iterator p = g.begin(); p != g.end(); p++ )
-        {
-            const osg::Vec3d& p0 = *p;
-
-            if ( p == g.begin() )
-                state->_ras.move_to_d( p0.x(), p0.y() );
-            else
-                state->_ras.line_to_d( p0.x(), p0.y() );
-        }
-    }
-    state->_ras.render( state->_ren, fgColor );
-    state->_ras.reset();
+    state->_ras.addGeometry( geomToRender.get(), color );
 }
-
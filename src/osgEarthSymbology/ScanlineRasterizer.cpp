@@ -0,0 +1,413 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthSymbology/ScanlineRasterizer>
+#include <osg/Math>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace osgEarth::Symbology;
+
+#define LC "[ScanlineRasterizer] "
+
+// --------------------------------------------------------------------------
+
+ScanlineRasterizer::ScanlineRasterizer() :
+_xmin        ( 0.0 ),
+_ymin        ( 0.0 ),
+_xscale      ( 1.0 ),
+_yscale      ( 1.0 ),
+_fillRule    ( FILL_EVEN_ODD ),
+_gamma       ( 1.0 ),
+_antiAliasing( true )
+{
+    updateCoverTable();
+}
+
+void
+ScanlineRasterizer::setTransform(double xmin, double ymin, double xscale, double yscale)
+{
+    _xmin   = xmin;
+    _ymin   = ymin;
+    _xscale = xscale;
+    _yscale = yscale;
+}
+
+void
+ScanlineRasterizer::setGamma(double value)
+{
+    _gamma = value;
+    updateCoverTable();
+}
+
+void
+ScanlineRasterizer::setAntiAliasing(bool value)
+{
+    _antiAliasing = value;
+    updateCoverTable();
+}
+
+// maps 8-bit geometric coverage to the 8-bit alpha actually applied,
+// folding in the gamma curve or the hard threshold when not anti-aliasing.
+void
+ScanlineRasterizer::updateCoverTable()
+{
+    for(unsigned i=0; i<256; ++i)
+    {
+        if ( !_antiAliasing )
+            _coverTable[i] = i > 127 ? 255 : 0;
+        else
+            _coverTable[i] = (unsigned char)( pow((double)i/255.0, _gamma)*255.0 + 0.5 );
+    }
+}
+
+void
+ScanlineRasterizer::addGeometry(const Geometry* geometry, const osg::Vec4f& color)
+{
+    Shape shape;
+    shape._color[0] = (int)( osg::clampBetween(color.r(), 0.0f, 1.0f) * 255.0f );
+    shape._color[1] = (int)( osg::clampBetween(color.g(), 0.0f, 1.0f) * 255.0f );
+    shape._color[2] = (int)( osg::clampBetween(color.b(), 0.0f, 1.0f) * 255.0f );
+    shape._color[3] = (int)( osg::clampBetween(color.a(), 0.0f, 1.0f) * 255.0f );
+    shape._value    = 0.0f;
+    addShape( geometry, shape );
+}
+
+void
+ScanlineRasterizer::addGeometry(const Geometry* geometry, float value)
+{
+    Shape shape;
+    shape._color[0] = shape._color[1] = shape._color[2] = shape._color[3] = 255;
+    shape._value    = value;
+    addShape( geometry, shape );
+}
+
+void
+ScanlineRasterizer::addShape(const Geometry* geometry, Shape& shape)
+{
+    if ( !geometry )
+        return;
+
+    shape._firstEdge = _edges.size();
+    shape._xmin = shape._ymin =  DBL_MAX;
+    shape._xmax = shape._ymax = -DBL_MAX;
+
+    // every part becomes a closed contour, so holes and multi-geometries
+    // are handled by the fill rule without any special treatment.
+    ConstGeometryIterator gi( geometry, true );
+    while( gi.hasMore() )
+    {
+        const Geometry* part = gi.next();
+        if ( part->size() < 2 )
+            continue;
+
+        Edge edge;
+        const osg::Vec3d& first = part->front();
+        edge._x1 = (first.x() - _xmin) * _xscale;
+        edge._y1 = (first.y() - _ymin) * _yscale;
+        const double firstX = edge._x1, firstY = edge._y1;
+
+        for(Geometry::const_iterator p = part->begin()+1; p != part->end(); ++p)
+        {
+            edge._x0 = edge._x1;
+            edge._y0 = edge._y1;
+            edge._x1 = (p->x() - _xmin) * _xscale;
+            edge._y1 = (p->y() - _ymin) * _yscale;
+            _edges.push_back( edge );
+        }
+
+        edge._x0 = edge._x1;
+        edge._y0 = edge._y1;
+        edge._x1 = firstX;
+        edge._y1 = firstY;
+        _edges.push_back( edge );
+    }
+
+    shape._numEdges = _edges.size() - shape._firstEdge;
+    if ( shape._numEdges == 0 )
+        return;
+
+    for(unsigned i = shape._firstEdge; i < _edges.size(); ++i)
+    {
+        const Edge& e = _edges[i];
+        shape._xmin = std::min( shape._xmin, e._x0 );
+        shape._xmax = std::max( shape._xmax, e._x0 );
+        shape._ymin = std::min( shape._ymin, e._y0 );
+        shape._ymax = std::max( shape._ymax, e._y0 );
+    }
+
+    _shapes.push_back( shape );
+}
+
+void
+ScanlineRasterizer::clear()
+{
+    _edges.clear();
+    _shapes.clear();
+}
+
+bool
+ScanlineRasterizer::render(osg::Image* image)
+{
+    if ( !image || !image->data() )
+        return false;
+
+    bool isRGBA8 =
+        image->getPixelFormat() == GL_RGBA &&
+        image->getDataType()    == GL_UNSIGNED_BYTE;
+
+    bool isFloat =
+        image->getDataType() == GL_FLOAT &&
+        osg::Image::computeNumComponents( image->getPixelFormat() ) == 1;
+
+    if ( !isRGBA8 && !isFloat )
+    {
+        OE_WARN << LC << "Unsupported image format; only RGBA8 and single-channel float are supported" << std::endl;
+        return false;
+    }
+
+    const int width  = image->s();
+    const int height = image->t();
+
+    // the accumulation buffer has two extra columns, since a line's area can
+    // spill one pixel to the right of its rightmost x. It is always left
+    // zeroed after resolving a shape, so we only clear it on a size change.
+    const unsigned stride = width + 2;
+    if ( _accum.size() != stride * height )
+    {
+        _accum.assign( stride * height, 0.0f );
+    }
+    _cover.resize( stride );
+
+    for(std::vector<Shape>::const_iterator shape = _shapes.begin(); shape != _shapes.end(); ++shape)
+    {
+        // a closed contour lying entirely outside the image contributes no winding to it.
+        if ( shape->_xmin >= width || shape->_ymin >= height || shape->_ymax <= 0.0 || shape->_xmax <= 0.0 )
+            continue;
+
+        int row0 = (int)floor( osg::clampBetween(shape->_ymin, 0.0, (double)height) );
+        int row1 = (int)ceil ( osg::clampBetween(shape->_ymax, 0.0, (double)height) );
+        int col0 = (int)floor( osg::clampBetween(shape->_xmin, 0.0, (double)width) );
+        int col1 = std::min( width+1, (int)ceil(osg::clampBetween(shape->_xmax, 0.0, (double)width)) + 1 );
+        if ( row0 >= row1 )
+            continue;
+
+        for(unsigned i = shape->_firstEdge; i < shape->_firstEdge + shape->_numEdges; ++i)
+        {
+            accumulate( _edges[i], width, height );
+        }
+
+        const int count  = col1 - col0 + 1;
+        const int pixels = std::min(col1, width-1) - col0 + 1;
+        unsigned char* cover = &_cover[0];
+
+        for(int row = row0; row < row1; ++row)
+        {
+            resolveRow( &_accum[row*stride + col0], count, cover );
+
+            if ( isRGBA8 )
+            {
+                // same fixed-point blend as AGG's span renderers. Pixels in the bounding
+                // box that the shape doesn't touch are common enough to be worth skipping.
+                const int r = shape->_color[0], g = shape->_color[1], b = shape->_color[2], a = shape->_color[3];
+                unsigned char* p = image->data(col0, row);
+                for(int i = 0; i < pixels; ++i, p += 4)
+                {
+                    if ( cover[i] == 0 )
+                        continue;
+                    int alpha = cover[i] * a;
+                    p[0] = (unsigned char)( ((r - p[0]) * alpha + (p[0] << 16)) >> 16 );
+                    p[1] = (unsigned char)( ((g - p[1]) * alpha + (p[1] << 16)) >> 16 );
+                    p[2] = (unsigned char)( ((b - p[2]) * alpha + (p[2] << 16)) >> 16 );
+                    p[3] = (unsigned char)( ((a - p[3]) * alpha + (p[3] << 16)) >> 16 );
+                }
+            }
+            else
+            {
+                const float value = shape->_value;
+                float* p = (float*)image->data(col0, row);
+                for(int i = 0; i < pixels; ++i)
+                {
+                    if ( cover[i] > 127 )
+                        p[i] = value;
+                }
+            }
+        }
+    }
+
+    clear();
+    return true;
+}
+
+// Clips an edge to the rows of the image and splits it at the left and right
+// edges of the image. Parts left of the image still affect the winding of
+// every pixel in their rows, so they collapse onto the first column; parts
+// right of the image affect nothing and are dropped.
+void
+ScanlineRasterizer::accumulate(const Edge& edge, int width, int height)
+{
+    double x0 = edge._x0, y0 = edge._y0, x1 = edge._x1, y1 = edge._y1;
+
+    if ( y0 == y1 )
+        return;
+    if ( std::max(y0, y1) <= 0.0 || std::min(y0, y1) >= height )
+        return;
+
+    const double dxdy = (x1-x0)/(y1-y0);
+    if      ( y0 < 0.0    ) { x0 -= y0*dxdy;          y0 = 0.0; }
+    else if ( y0 > height ) { x0 += (height-y0)*dxdy; y0 = height; }
+    if      ( y1 < 0.0    ) { x1 -= y1*dxdy;          y1 = 0.0; }
+    else if ( y1 > height ) { x1 += (height-y1)*dxdy; y1 = height; }
+
+    double t[4];
+    int n = 0;
+    t[n++] = 0.0;
+    if ( (x0 < 0.0) != (x1 < 0.0) )
+        t[n++] = (0.0-x0)/(x1-x0);
+    if ( (x0 > width) != (x1 > width) )
+        t[n++] = (width-x0)/(x1-x0);
+    if ( n == 3 && t[1] > t[2] )
+        std::swap( t[1], t[2] );
+    t[n++] = 1.0;
+
+    for(int i=0; i<n-1; ++i)
+    {
+        double xa = x0 + (x1-x0)*t[i],   ya = y0 + (y1-y0)*t[i];
+        double xb = x0 + (x1-x0)*t[i+1], yb = y0 + (y1-y0)*t[i+1];
+        double xm = 0.5*(xa+xb);
+
+        if ( xm >= width )
+            continue;
+        else if ( xm <= 0.0 )
+            accumulateLine( 0.0, ya, 0.0, yb, width, height );
+        else
+            accumulateLine(
+                osg::clampBetween(xa, 0.0, (double)width), ya,
+                osg::clampBetween(xb, 0.0, (double)width), yb,
+                width, height );
+    }
+}
+
+// Adds the signed area that a line segment contributes to each pixel it
+// crosses, plus the coverage step it leaves for the pixels to its right.
+// Integrating a row of the buffer then yields the winding (and hence the
+// coverage) of each pixel. Input must already be clipped to the image.
+void
+ScanlineRasterizer::accumulateLine(double x0, double y0, double x1, double y1, int width, int height)
+{
+    if ( y0 == y1 )
+        return;
+
+    double dir = 1.0;
+    if ( y0 > y1 )
+    {
+        dir = -1.0;
+        std::swap( x0, x1 );
+        std::swap( y0, y1 );
+    }
+
+    const unsigned stride = width + 2;
+    const double   dxdy   = (x1-x0)/(y1-y0);
+    const int      rowEnd = std::min( height, (int)ceil(y1) );
+    double x = x0;
+
+    for(int row = (int)y0; row < rowEnd; ++row)
+    {
+        float* acc = &_accum[row*stride];
+
+        double dy    = std::min( (double)(row+1), y1 ) - std::max( (double)row, y0 );
+        double xnext = x + dxdy*dy;
+        double d     = dy*dir;
+        double xa    = std::min( x, xnext );
+        double xb    = std::max( x, xnext );
+        double xaFloor = floor( xa );
+        double xbCeil  = ceil( xb );
+        int    xai     = (int)xaFloor;
+        int    xbi     = (int)xbCeil;
+
+        if ( xbi <= xai+1 )
+        {
+            // the line stays within one pixel on this row.
+            double xmf = 0.5*(x+xnext) - xaFloor;
+            acc[xai]   += (float)(d - d*xmf);
+            acc[xai+1] += (float)(d*xmf);
+        }
+        else
+        {
+            double s    = 1.0/(xb-xa);
+            double xaf  = xa - xaFloor;
+            double a0   = 0.5*s*(1.0-xaf)*(1.0-xaf);
+            double xbf  = xb - xbCeil + 1.0;
+            double am   = 0.5*s*xbf*xbf;
+
+            acc[xai] += (float)(d*a0);
+
+            if ( xbi == xai+2 )
+            {
+                acc[xai+1] += (float)(d*(1.0-a0-am));
+            }
+            else
+            {
+                double a1 = s*(1.5-xaf);
+                acc[xai+1] += (float)(d*(a1-a0));
+
+                float ds = (float)(d*s);
+                for(int xi = xai+2; xi < xbi-1; ++xi)
+                    acc[xi] += ds;
+
+                double a2 = a1 + (xbi-xai-3)*s;
+                acc[xbi-1] += (float)(d*(1.0-a2-am));
+            }
+
+            acc[xbi] += (float)(d*am);
+        }
+
+        x = xnext;
+    }
+}
+
+// Integrates one row of the accumulation buffer into 8-bit per-pixel coverage,
+// clearing the buffer as it goes.
+void
+ScanlineRasterizer::resolveRow(float* accum, int count, unsigned char* cover) const
+{
+    float sum = 0.0f;
+
+    if ( _fillRule == FILL_EVEN_ODD )
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            sum += accum[i];
+            accum[i] = 0.0f;
+            int c = (int)( fabsf(sum)*256.0f + 0.5f ) & 511;
+            if ( c > 256 ) c = 512 - c;
+            cover[i] = _coverTable[ std::min(c, 255) ];
+        }
+    }
+    else
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            sum += accum[i];
+            accum[i] = 0.0f;
+            int c = (int)( fabsf(sum)*256.0f + 0.5f );
+            cover[i] = _coverTable[ std::min(c, 255) ];
+        }
+    }
+}
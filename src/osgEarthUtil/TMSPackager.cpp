@@ -28,6 +28,10 @@
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/WriteFile>
+#include <osgDB/Registry>
+#include <OpenThreads/Thread>
+#include <fstream>
+#include <sstream>
 
 
 #define LC "[TMSPackager] "
@@ -35,6 +39,78 @@
 using namespace osgEarth::Util;
 using namespace osgEarth;
 
+namespace
+{
+    // Writes one tile to disk, from encoded data or (if the plugin could
+    // not encode to a stream) from the image itself.
+    class WriteTileTask : public TaskRequest
+    {
+    public:
+        WriteTileTask(const std::string& path, const std::string& data) :
+            _path(path), _data(data) { }
+
+        WriteTileTask(const std::string& path, osg::Image* image, const osgDB::Options* options) :
+            _path(path), _image(image), _options(options) { }
+
+        virtual void operator()(ProgressCallback* progress)
+        {
+            // attempt to create the output folder:
+            osgEarth::makeDirectoryForFile( _path );
+
+            if ( _image.valid() )
+            {
+                if ( !osgDB::writeImageFile(*_image.get(), _path, _options.get()) )
+                    OE_WARN << LC << "Failed to write " << _path << std::endl;
+                return;
+            }
+
+            std::ofstream out( _path.c_str(), std::ios::out | std::ios::binary );
+            if ( out.is_open() )
+                out.write( _data.data(), _data.size() );
+            if ( !out.good() )
+                OE_WARN << LC << "Failed to write " << _path << std::endl;
+        }
+
+        std::string                       _path;
+        std::string                       _data;
+        osg::ref_ptr<osg::Image>          _image;
+        osg::ref_ptr<const osgDB::Options> _options;
+    };
+
+    // Encodes one tile and passes it to the write stage, or stores it
+    // in the output TileSource.
+    class EncodeTileTask : public TaskRequest
+    {
+    public:
+        EncodeTileTask(const TileKey& key, osg::Image* image, const std::string& path,
+                       const std::string& colorKey, TMSPackager* packager,
+                       TaskService* writeService) :
+            _key(key), _image(image), _path(path), _colorKey(colorKey),
+            _packager(packager), _writeService(writeService) { }
+
+        virtual void operator()(ProgressCallback* progress);
+
+        TileKey                   _key;
+        osg::ref_ptr<osg::Image>  _image;
+        std::string               _path;
+        std::string               _colorKey;
+        TMSPackager*              _packager;
+        osg::ref_ptr<TaskService> _writeService;
+    };
+
+    // Identifies the color and layout of a single-color image, such that two
+    // images with the same key encode to the same data.
+    std::string getColorKey(const osg::Image* image)
+    {
+        std::stringstream buf;
+        buf << image->s() << "," << image->t() << "," << image->r() << ","
+            << image->getPixelFormat() << "," << image->getDataType() << ","
+            << image->getPacking() << ":";
+        buf.write( (const char*)image->data(), image->getPixelSizeInBits()/8 );
+        return buf.str();
+    }
+}
+
 WriteTMSTileHandler::WriteTMSTileHandler(TerrainLayer* layer,  Map* map, TMSPackager* packager):
     _layer( layer ),
     _map(map),
@@ -106,26 +182,8 @@ bool WriteTMSTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
             }
 
             // OE_NOTICE << "Created image for " << key.str() << std::endl;
-            osg::ref_ptr< osg::Image > final = geoImage.getImage();
-
-            // convert to RGB if necessary
-            if ( _packager->getExtension() == "jpg" && final->getPixelFormat() != GL_RGB )
-            {
-                final = ImageUtils::convertToRGB8( final );
-            }
-
-            // use the TileSource provided if set, else use writeImageFile
-            if (tileSource)
-            {
-                tileSource->storeImage(key, final.get(), 0L);
-                return true;
-            }
-            else
-            {
-                // attempt to create the output folder:
-                osgEarth::makeDirectoryForFile( path );
-                return osgDB::writeImageFile(*final, path, _packager->getOptions());
-            }
+            _packager->queueTile( key, geoImage.getImage(), path );
+            return true;
         }
     }
     else if (elevationLayer )
@@ -137,18 +195,8 @@ bool WriteTMSTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
             ImageToHeightFieldConverter conv;
             osg::ref_ptr< osg::Image > image = conv.convert( hf.getHeightField(), _packager->getElevationPixelDepth() );
 
-            // use the TileSource provided if set, else use writeImageFile
-            if (tileSource)
-            {
-                tileSource->storeImage(key, image.get(), 0L);
-                return true;
-            }
-            else
-            {
-                // attempt to create the output folder:
-                osgEarth::makeDirectoryForFile( path );
-                return osgDB::writeImageFile(*image.get(), path, _packager->getOptions());
-            }
+            _packager->queueTile( key, image.get(), path );
+            return true;
         }
     }
 
@@ -228,6 +276,40 @@ std::string WriteTMSTileHandler::getProcessString() const
 }
 
 
+/*****************************************************************************************************/
+
+void
+EncodeTileTask::operator()(ProgressCallback* progress)
+{
+    // an output TileSource does its own encoding.
+    TileSource* tileSource = _packager->getTileSource();
+    if ( tileSource )
+    {
+        if ( !tileSource->storeImage(_key, _image.get(), 0L) )
+            OE_WARN << LC << "Failed to store tile " << _key.str() << std::endl;
+        return;
+    }
+
+    // convert to RGB if necessary
+    if ( _packager->getExtension() == "jpg" && _image->getPixelFormat() != GL_RGB )
+    {
+        _image = ImageUtils::convertToRGB8( _image.get() );
+    }
+
+    std::string data;
+    if ( _packager->encode(_image.get(), data) )
+    {
+        if ( !_colorKey.empty() )
+            _packager->setSingleColorData( _colorKey, data );
+
+        _writeService->add( new WriteTileTask(_path, data) );
+    }
+    else
+    {
+        _writeService->add( new WriteTileTask(_path, _image.get(), _packager->getOptions()) );
+    }
+}
+
 /*****************************************************************************************************/
 
 TMSPackager::TMSPackager():
@@ -240,7 +322,10 @@ _visitor(new TileVisitor()),
     _overwrite(false),
     _keepEmpties(false),
     _applyAlphaMask(false),
-    _tileSource(0L)
+    _tileSource(0L),
+    _numEncodeThreads(OpenThreads::GetNumberOfProcessors()),
+    _numWriteThreads(2),
+    _queueSize(64)
 {
 }
 
@@ -334,6 +419,114 @@ void TMSPackager::setApplyAlphaMask(bool applyAlphaMask)
     _applyAlphaMask = applyAlphaMask;
 }
 
+unsigned TMSPackager::getNumEncodeThreads() const
+{
+    return _numEncodeThreads;
+}
+
+void TMSPackager::setNumEncodeThreads(unsigned value)
+{
+    _numEncodeThreads = osg::maximum(value, 1u);
+}
+
+unsigned TMSPackager::getNumWriteThreads() const
+{
+    return _numWriteThreads;
+}
+
+void TMSPackager::setNumWriteThreads(unsigned value)
+{
+    _numWriteThreads = osg::maximum(value, 1u);
+}
+
+unsigned TMSPackager::getQueueSize() const
+{
+    return _queueSize;
+}
+
+void TMSPackager::setQueueSize(unsigned value)
+{
+    _queueSize = osg::maximum(value, 1u);
+}
+
+void TMSPackager::queueTile(const TileKey& key, osg::Image* image, const std::string& path)
+{
+    // A single-color tile encodes to the same data as any other tile of the
+    // same color, so skip the encoder when we've seen its color before.
+    std::string colorKey;
+    if ( !_tileSource.valid() && ImageUtils::isSingleColorImage(image, 0.0f) )
+    {
+        colorKey = getColorKey(image);
+
+        std::string data;
+        if ( getSingleColorData(colorKey, data) )
+        {
+            _writeService->add( new WriteTileTask(path, data) );
+            return;
+        }
+    }
+
+    // blocks while the encode queue is full.
+    _encodeService->add( new EncodeTileTask(key, image, path, colorKey, this, _writeService.get()) );
+}
+
+bool TMSPackager::encode(const osg::Image* image, std::string& out) const
+{
+    if ( !_rw.valid() )
+        return false;
+
+    std::stringstream buf;
+    osgDB::ReaderWriter::WriteResult wr = _rw->writeImage(*image, buf, _writeOptions.get());
+    if ( !wr.success() )
+        return false;
+
+    out = buf.str();
+    return true;
+}
+
+bool TMSPackager::getSingleColorData(const std::string& colorKey, std::string& out) const
+{
+    Threading::ScopedMutexLock lock(_singleColorMutex);
+    SingleColorData::const_iterator i = _singleColorData.find(colorKey);
+    if ( i == _singleColorData.end() )
+        return false;
+    out = i->second;
+    return true;
+}
+
+void TMSPackager::setSingleColorData(const std::string& colorKey, const std::string& data)
+{
+    Threading::ScopedMutexLock lock(_singleColorMutex);
+
+    // most maps have a handful of fill colors; don't let a noisy one grow without bound.
+    if ( _singleColorData.size() < 1024 )
+        _singleColorData[colorKey] = data;
+}
+
+void TMSPackager::finish()
+{
+    // The fetch stage is done. Stop each stage only after the one feeding it
+    // has stopped, so that every queued tile makes it to the output.
+    if ( _encodeService.valid() )
+    {
+        _encodeService->add( new PoisonPill() );
+        while (_encodeService->areThreadsRunning())
+            OpenThreads::Thread::microSleep(10000);
+        _encodeService = 0L;
+    }
+
+    if ( _writeService.valid() )
+    {
+        _writeService->add( new PoisonPill() );
+        while (_writeService->areThreadsRunning())
+            OpenThreads::Thread::microSleep(10000);
+        _writeService = 0L;
+    }
+
+    Threading::ScopedMutexLock lock(_singleColorMutex);
+    _singleColorData.clear();
+}
+
 TileVisitor* TMSPackager::getTileVisitor() const
 {
     return _visitor;
@@ -431,9 +624,18 @@ void TMSPackager::run( TerrainLayer* layer,  Map* map  )
     }
 
 
+    // Look up the plugin here; the osgDB registry isn't safe to search from
+    // the encode threads.
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension( _extension );
+
+    _encodeService = new TaskService( "TMSPackager encode", _numEncodeThreads, _queueSize );
+    _writeService  = new TaskService( "TMSPackager write", _numWriteThreads, _queueSize );
+
     _handler = new WriteTMSTileHandler(layer, map, this);
     _visitor->setTileHandler( _handler );
     _visitor->run( map->getProfile() );
+
+    finish();
 }
 
 void TMSPackager::writeXML(TerrainLayer* layer, Map* map)
@@ -0,0 +1,525 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/Viewshed>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/ImageUtils>
+#include <cfloat>
+#include <cstring>
+
+#define LC "[ViewshedEngine] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+//------------------------------------------------------------------------
+
+// Square grid of elevations centered on the observer, with a pyramid of
+// maximum heights above it. Heights are already lowered for the curvature
+// of the earth, so the rays can treat the ground as flat.
+struct ViewshedEngine::Grid
+{
+    int                               size;       // cells per side (odd)
+    int                               center;     // index of the observer's cell
+    double                            cellSize;   // meters
+    double                            lon, lat;   // observer location (degrees)
+    double                            dLon, dLat; // cell size (degrees)
+    double                            eyeZ;       // observer's eye height
+    std::vector< std::vector<float> > levels;     // level 0 = elevations
+    std::vector<int>                  dims;       // cells per side of each level
+
+    float at(int level, int x, int y) const
+    {
+        return levels[level][y*dims[level] + x];
+    }
+
+    // Builds the levels above level 0.
+    void buildPyramid()
+    {
+        dims.resize(1);
+        dims[0] = size;
+        levels.resize(1);
+
+        while( dims.back() > 1 )
+        {
+            const std::vector<float>& below = levels.back();
+            int n0 = dims.back();
+            int n1 = (n0 + 1) / 2;
+
+            std::vector<float> above( n1*n1, NO_DATA_VALUE );
+            for(int y=0; y<n0; ++y)
+            {
+                for(int x=0; x<n0; ++x)
+                {
+                    float& m = above[(y>>1)*n1 + (x>>1)];
+                    m = osg::maximum( m, below[y*n0 + x] );
+                }
+            }
+
+            levels.push_back( std::vector<float>() );
+            levels.back().swap( above );
+            dims.push_back( n1 );
+        }
+    }
+};
+
+namespace
+{
+    // Marches one ray from the observer toward grid location (tx, ty).
+    // Marks visible cells in "cells" and/or records every sample in "spoke".
+    void marchRay(const ViewshedEngine::Grid& g,
+                  double                      tx,
+                  double                      ty,
+                  double                      targetHeight,
+                  unsigned char*              cells,
+                  ViewshedEngine::Spoke*      spoke)
+    {
+        const double c  = (double)g.center;
+        const double dx = tx - c;
+        const double dy = ty - c;
+
+        int steps = (int)ceil( osg::maximum(fabs(dx), fabs(dy)) );
+        if ( steps <= 0 )
+            return;
+
+        const double stepLength = sqrt(dx*dx + dy*dy) / (double)steps * g.cellSize;
+        const int    top = (int)g.levels.size() - 1;
+
+        // slope of the horizon so far:
+        double horizon = -DBL_MAX;
+
+        int s = 1;
+        while( s <= steps )
+        {
+            int ix = (int)floor( c + dx*(double)s/(double)steps + 0.5 );
+            int iy = (int)floor( c + dy*(double)s/(double)steps + 0.5 );
+            if ( ix < 0 || iy < 0 || ix >= g.size || iy >= g.size )
+                break;
+
+            double d = (double)s * stepLength;
+
+            // Look for the largest block around this sample that cannot reach
+            // above the horizon anywhere along the rest of its path through
+            // the ray. Every sample in such a block is hidden, so skip it.
+            int next = 0;
+            for(int level = top; level >= 1 && next == 0; --level)
+            {
+                double num   = (double)g.at(level, ix>>level, iy>>level) + targetHeight - g.eyeZ;
+                double reach = (double)(1 << level) * g.cellSize * 1.5;
+                double bound = num >= 0.0 ? num/d : num/(d + reach);
+
+                if ( bound < horizon )
+                {
+                    // find the step at which the ray leaves the block:
+                    int lo_x = (ix >> level) << level, hi_x = lo_x + (1 << level) - 1;
+                    int lo_y = (iy >> level) << level, hi_y = lo_y + (1 << level) - 1;
+                    double exit_x = DBL_MAX, exit_y = DBL_MAX;
+
+                    if ( dx > 0.0 )      exit_x = ceil( ((double)hi_x + 0.5 - c) * (double)steps / dx );
+                    else if ( dx < 0.0 ) exit_x = floor( (c - (double)lo_x + 0.5) * (double)steps / -dx ) + 1.0;
+                    if ( dy > 0.0 )      exit_y = ceil( ((double)hi_y + 0.5 - c) * (double)steps / dy );
+                    else if ( dy < 0.0 ) exit_y = floor( (c - (double)lo_y + 0.5) * (double)steps / -dy ) + 1.0;
+
+                    // back off one step to stay safe from round-off at the block edge.
+                    double exit = osg::minimum( osg::minimum(exit_x, exit_y), (double)steps + 1.0 ) - 1.0;
+                    next = osg::maximum( (int)exit, s + 1 );
+                }
+            }
+
+            if ( next > 0 )
+            {
+                if ( spoke )
+                {
+                    for( ; s < next && s <= steps; ++s )
+                    {
+                        spoke->ranges.push_back( (double)s * stepLength );
+                        spoke->visible.push_back( false );
+                    }
+                }
+                s = next;
+                continue;
+            }
+
+            float h = g.at(0, ix, iy);
+            bool visible = false;
+
+            if ( h != NO_DATA_VALUE )
+            {
+                visible = ((double)h + targetHeight - g.eyeZ)/d >= horizon;
+                horizon = osg::maximum( horizon, ((double)h - g.eyeZ)/d );
+            }
+
+            if ( visible && cells )
+                cells[iy*g.size + ix] = 255;
+
+            if ( spoke )
+            {
+                spoke->ranges.push_back( d );
+                spoke->visible.push_back( visible );
+            }
+
+            ++s;
+        }
+    }
+
+    // Samples a band of rows of the elevation grid.
+    struct SampleRowsJob
+    {
+        ElevationPool*          _pool;
+        const SpatialReference* _srs;
+        unsigned                _lod;
+        ViewshedEngine::Grid*   _grid;
+        int                     _firstRow, _lastRow;
+
+        void execute()
+        {
+            osg::ref_ptr<ElevationEnvelope> envelope = _pool->createEnvelope( _srs, _lod );
+            if ( !envelope.valid() )
+                return;
+
+            ViewshedEngine::Grid& g = *_grid;
+            std::vector<osg::Vec3d> points;
+            points.reserve( (_lastRow - _firstRow + 1) * g.size );
+
+            for(int y=_firstRow; y<=_lastRow; ++y)
+            {
+                for(int x=0; x<g.size; ++x)
+                {
+                    points.push_back( osg::Vec3d(
+                        g.lon + (double)(x - g.center)*g.dLon,
+                        g.lat + (double)(y - g.center)*g.dLat,
+                        0.0) );
+                }
+            }
+
+            std::vector<float> heights;
+            envelope->getElevations( points, heights );
+
+            std::copy( heights.begin(), heights.end(), g.levels[0].begin() + _firstRow*g.size );
+        }
+    };
+
+    // Marches a set of rays into a private visibility buffer.
+    struct MarchJob
+    {
+        const ViewshedEngine::Grid*   _grid;
+        const std::vector<osg::Vec2d>* _targets;
+        unsigned                      _first, _last;
+        double                        _targetHeight;
+        std::vector<unsigned char>    _cells;
+
+        void execute()
+        {
+            _cells.assign( _grid->size * _grid->size, 0 );
+            for(unsigned i=_first; i<_last; ++i)
+            {
+                marchRay( *_grid, (*_targets)[i].x(), (*_targets)[i].y(), _targetHeight, &_cells[0], 0L );
+            }
+        }
+    };
+}
+
+namespace osgEarth { namespace Util
+{
+    // Computes one observer's viewshed in batch mode.
+    struct ObserverJob
+    {
+        const ViewshedEngine*              _engine;
+        const GeoPoint*                    _observer;
+        GeoImage*                          _output;
+        ProgressCallback*                  _progressCallback;
+
+        void execute()
+        {
+            if ( _progressCallback && _progressCallback->isCanceled() )
+                return;
+
+            *_output = _engine->viewshed( *_observer, false, _progressCallback );
+        }
+    };
+} }
+
+//------------------------------------------------------------------------
+
+ViewshedEngine::ViewshedEngine(const Map* map, unsigned numThreads) :
+_map           ( map ),
+_numThreads    ( osg::maximum(numThreads, 1u) ),
+_observerHeight( 2.0 ),
+_targetHeight  ( 0.0 ),
+_radius        ( 5000.0 ),
+_resolution    ( 30.0 ),
+_earthCurvature( true ),
+_refraction    ( 0.13 )
+{
+    _service = new TaskService( "ViewshedEngine", (int)_numThreads );
+}
+
+bool
+ViewshedEngine::createGrid(const GeoPoint& observer, Grid& g, bool parallel, ProgressCallback* progress) const
+{
+    osg::ref_ptr<const Map> map;
+    if ( !_map.lock(map) || !map->getElevationPool() )
+        return false;
+
+    if ( _resolution <= 0.0 || _radius < _resolution )
+        return false;
+
+    const SpatialReference* geoSRS = map->getSRS()->getGeographicSRS();
+
+    GeoPoint center;
+    if ( !observer.transform(geoSRS, center) )
+        return false;
+
+    const osg::EllipsoidModel* em = geoSRS->getEllipsoid();
+    double R = em->getRadiusEquator();
+
+    int half    = (int)ceil( _radius/_resolution );
+    g.size      = 2*half + 1;
+    g.center    = half;
+    g.cellSize  = _resolution;
+    g.lon       = center.x();
+    g.lat       = center.y();
+    g.dLat      = osg::RadiansToDegrees( _resolution / R );
+    g.dLon      = osg::RadiansToDegrees( _resolution / (R * osg::maximum(cos(osg::DegreesToRadians(g.lat)), 0.01)) );
+
+    g.levels.resize( 1 );
+    g.levels[0].assign( g.size*g.size, NO_DATA_VALUE );
+
+    // choose the LOD whose data best matches the sample spacing:
+    const Profile* profile = map->getProfile();
+    double profileRes = profile->getSRS()->isGeographic() ? g.dLat : _resolution;
+    unsigned lod = profile->getLevelOfDetailForHorizResolution( profileRes, map->getElevationPool()->getTileSize() );
+
+    // sample the elevations, in bands of rows:
+    int numBands = parallel ? (int)_numThreads * 2 : 1;
+    int rowsPerBand = (g.size + numBands - 1) / numBands;
+
+    if ( parallel && numBands > 1 )
+    {
+        numBands = (g.size + rowsPerBand - 1) / rowsPerBand;
+        Threading::MultiEvent semaphore( numBands );
+        for(int b=0; b<numBands; ++b)
+        {
+            ParallelTask<SampleRowsJob>* job = new ParallelTask<SampleRowsJob>( &semaphore );
+            job->_pool     = map->getElevationPool();
+            job->_srs      = geoSRS;
+            job->_lod      = lod;
+            job->_grid     = &g;
+            job->_firstRow = b*rowsPerBand;
+            job->_lastRow  = osg::minimum( (b+1)*rowsPerBand, g.size ) - 1;
+            _service->add( job );
+        }
+        semaphore.wait();
+    }
+    else
+    {
+        SampleRowsJob job;
+        job._pool     = map->getElevationPool();
+        job._srs      = geoSRS;
+        job._lod      = lod;
+        job._grid     = &g;
+        job._firstRow = 0;
+        job._lastRow  = g.size - 1;
+        job.execute();
+    }
+
+    if ( progress && progress->isCanceled() )
+        return false;
+
+    float ground = g.at( 0, g.center, g.center );
+    if ( ground == NO_DATA_VALUE )
+    {
+        OE_DEBUG << LC << "No elevation data at observer location" << std::endl;
+        ground = 0.0f;
+    }
+
+    g.eyeZ = observer.altitudeMode() == ALTMODE_ABSOLUTE ?
+        center.z() :
+        (double)ground + _observerHeight;
+
+    // lower the terrain to follow the curvature of the earth:
+    if ( _earthCurvature )
+    {
+        double k = (1.0 - _refraction) / (2.0 * R);
+        std::vector<float>& h = g.levels[0];
+        for(int y=0; y<g.size; ++y)
+        {
+            for(int x=0; x<g.size; ++x)
+            {
+                float& z = h[y*g.size + x];
+                if ( z != NO_DATA_VALUE )
+                {
+                    double d2 = (double)((x-g.center)*(x-g.center) + (y-g.center)*(y-g.center)) * g.cellSize * g.cellSize;
+                    z -= (float)(d2 * k);
+                }
+            }
+        }
+    }
+
+    g.buildPyramid();
+    return true;
+}
+
+GeoImage
+ViewshedEngine::viewshed(const GeoPoint& observer, bool parallel, ProgressCallback* progress) const
+{
+    Grid g;
+    if ( !createGrid(observer, g, parallel, progress) )
+        return GeoImage::INVALID;
+
+    // one ray to each cell on the edge of the grid:
+    std::vector<osg::Vec2d> targets;
+    targets.reserve( 4*g.size );
+    for(int i=0; i<g.size; ++i)
+    {
+        targets.push_back( osg::Vec2d(i, 0) );
+        targets.push_back( osg::Vec2d(i, g.size-1) );
+    }
+    for(int i=1; i<g.size-1; ++i)
+    {
+        targets.push_back( osg::Vec2d(0, i) );
+        targets.push_back( osg::Vec2d(g.size-1, i) );
+    }
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( g.size, g.size, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    image->setInternalTextureFormat( GL_LUMINANCE8 );
+    unsigned char* cells = image->data();
+    ::memset( cells, 0, g.size*g.size );
+
+    if ( parallel && _numThreads > 1u )
+    {
+        // each job writes into its own buffer; combine them afterwards.
+        unsigned numJobs = _numThreads * 2u;
+        unsigned perJob = (targets.size() + numJobs - 1) / numJobs;
+        numJobs = (targets.size() + perJob - 1) / perJob;
+
+        std::vector< osg::ref_ptr< ParallelTask<MarchJob> > > jobs;
+        Threading::MultiEvent semaphore( numJobs );
+        for(unsigned j=0; j<numJobs; ++j)
+        {
+            ParallelTask<MarchJob>* job = new ParallelTask<MarchJob>( &semaphore );
+            job->_grid         = &g;
+            job->_targets      = &targets;
+            job->_first        = j*perJob;
+            job->_last         = osg::minimum( (j+1)*perJob, (unsigned)targets.size() );
+            job->_targetHeight = _targetHeight;
+            jobs.push_back( job );
+            _service->add( job );
+        }
+        semaphore.wait();
+
+        for(unsigned j=0; j<jobs.size(); ++j)
+        {
+            const std::vector<unsigned char>& jc = jobs[j]->_cells;
+            for(unsigned i=0; i<jc.size(); ++i)
+                cells[i] |= jc[i];
+        }
+    }
+    else
+    {
+        for(unsigned i=0; i<targets.size(); ++i)
+            marchRay( g, targets[i].x(), targets[i].y(), _targetHeight, cells, 0L );
+    }
+
+    // the observer sees its own cell; nothing beyond the radius counts.
+    cells[g.center*g.size + g.center] = 255;
+
+    double r2 = (_radius/g.cellSize) * (_radius/g.cellSize);
+    for(int y=0; y<g.size; ++y)
+    {
+        for(int x=0; x<g.size; ++x)
+        {
+            if ( (double)((x-g.center)*(x-g.center) + (y-g.center)*(y-g.center)) > r2 )
+                cells[y*g.size + x] = 0;
+        }
+    }
+
+    osg::ref_ptr<const Map> map;
+    if ( !_map.lock(map) )
+        return GeoImage::INVALID;
+
+    GeoExtent extent(
+        map->getSRS()->getGeographicSRS(),
+        g.lon - ((double)g.center + 0.5)*g.dLon,
+        g.lat - ((double)g.center + 0.5)*g.dLat,
+        g.lon + ((double)g.center + 0.5)*g.dLon,
+        g.lat + ((double)g.center + 0.5)*g.dLat );
+
+    return GeoImage( image.get(), extent );
+}
+
+GeoImage
+ViewshedEngine::computeViewshed(const GeoPoint& observer, ProgressCallback* progress)
+{
+    return viewshed( observer, true, progress );
+}
+
+void
+ViewshedEngine::computeViewsheds(const std::vector<GeoPoint>& observers,
+                                 std::vector<GeoImage>&       out_viewsheds,
+                                 ProgressCallback*            progress)
+{
+    out_viewsheds.assign( observers.size(), GeoImage::INVALID );
+    if ( observers.empty() )
+        return;
+
+    // Parallelize over the observers rather than the rays; each job does its
+    // own observer serially so the jobs never wait on each other.
+    Threading::MultiEvent semaphore( (int)observers.size() );
+    for(unsigned i=0; i<observers.size(); ++i)
+    {
+        ParallelTask<ObserverJob>* job = new ParallelTask<ObserverJob>( &semaphore );
+        job->_engine   = this;
+        job->_observer = &observers[i];
+        job->_output   = &out_viewsheds[i];
+        job->_progressCallback = progress;
+        _service->add( job );
+    }
+    semaphore.wait();
+}
+
+bool
+ViewshedEngine::computeRadialLineOfSight(const GeoPoint&     observer,
+                                         unsigned            numSpokes,
+                                         std::vector<Spoke>& out_spokes,
+                                         ProgressCallback*   progress)
+{
+    out_spokes.clear();
+
+    Grid g;
+    if ( numSpokes == 0u || !createGrid(observer, g, true, progress) )
+        return false;
+
+    double reach = _radius / g.cellSize;
+
+    out_spokes.resize( numSpokes );
+    for(unsigned i=0; i<numSpokes; ++i)
+    {
+        Spoke& spoke = out_spokes[i];
+        spoke.azimuth = 360.0 * (double)i / (double)numSpokes;
+
+        double a = osg::DegreesToRadians( spoke.azimuth );
+        marchRay( g, g.center + sin(a)*reach, g.center + cos(a)*reach, _targetHeight, 0L, &spoke );
+    }
+
+    return true;
+}
@@ -0,0 +1,84 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/CacheContent>
+#include <cstring>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::Image* makeImage(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        image->setInternalTextureFormat(GL_RGBA8);
+        for(unsigned i=0; i<image->getTotalSizeInBytes(); i += 4)
+        {
+            image->data()[i+0] = r;
+            image->data()[i+1] = g;
+            image->data()[i+2] = b;
+            image->data()[i+3] = a;
+        }
+        return image;
+    }
+}
+
+TEST_CASE( "CacheContent hashes equal payloads equally" ) {
+
+    std::string a("ocean"), b("ocean"), c("ocean!");
+    REQUIRE( CacheContent::hash(a) == CacheContent::hash(b) );
+    REQUIRE( CacheContent::hash(a) != CacheContent::hash(c) );
+}
+
+TEST_CASE( "CacheContent round-trips a single-color image" ) {
+
+    osg::ref_ptr<osg::Image> image = makeImage(10, 60, 200, 255);
+
+    std::string data;
+    REQUIRE( CacheContent::encodeSingleColor(image.get(), data) );
+    REQUIRE( CacheContent::isSingleColor(data) );
+    REQUIRE( data.size() < 100u );
+
+    osg::ref_ptr<osg::Image> decoded = CacheContent::decodeSingleColor(data);
+    REQUIRE( decoded.valid() );
+    REQUIRE( decoded->s() == image->s() );
+    REQUIRE( decoded->t() == image->t() );
+    REQUIRE( decoded->getPixelFormat() == image->getPixelFormat() );
+    REQUIRE( decoded->getDataType() == image->getDataType() );
+    REQUIRE( decoded->getInternalTextureFormat() == image->getInternalTextureFormat() );
+    REQUIRE( decoded->getTotalSizeInBytes() == image->getTotalSizeInBytes() );
+    REQUIRE( ::memcmp(decoded->data(), image->data(), image->getTotalSizeInBytes()) == 0 );
+}
+
+TEST_CASE( "CacheContent leaves other images alone" ) {
+
+    osg::ref_ptr<osg::Image> image = makeImage(10, 60, 200, 255);
+    image->data()[4*300] = 11;
+
+    std::string data;
+    REQUIRE( CacheContent::encodeSingleColor(image.get(), data) == false );
+    REQUIRE( CacheContent::isSingleColor(std::string("OSGB stream")) == false );
+    REQUIRE( CacheContent::decodeSingleColor(std::string("OSGB stream")) == 0L );
+}
@@ -0,0 +1,115 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/DataExtentIndex>
+#include <climits>
+#include <cstdlib>
+
+using namespace osgEarth;
+
+namespace
+{
+    double randomIn(double lo, double hi)
+    {
+        return lo + (hi-lo)*(double)::rand()/(double)RAND_MAX;
+    }
+
+    // reference implementation of DataExtentIndex::getMaxLevel
+    bool linearMaxLevel(const DataExtentList& de, const GeoExtent& ex, unsigned lod, unsigned& out)
+    {
+        bool found = false;
+        out = 0u;
+        for(unsigned i=0; i<de.size(); ++i)
+        {
+            if ( de[i].minLevel().isSet() && lod < de[i].minLevel().get() )
+                continue;
+            if ( ex.intersects(de[i]) )
+            {
+                found = true;
+                out = std::max(out, de[i].maxLevel().isSet() ? de[i].maxLevel().get() : UINT_MAX);
+            }
+        }
+        return found;
+    }
+}
+
+TEST_CASE( "DataExtentIndex agrees with a linear scan" ) {
+
+    osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+
+    ::srand(0);
+    DataExtentList extents;
+    for(unsigned i=0; i<2000; ++i)
+    {
+        double x = randomIn(-179.0, 178.0), y = randomIn(-89.0, 88.0);
+        GeoExtent e(srs.get(), x, y, x+randomIn(0.01, 1.0), y+randomIn(0.01, 1.0));
+        unsigned minLevel = (unsigned)randomIn(0.0, 6.0);
+        if ( i % 5 == 0 )
+            extents.push_back(DataExtent(e, minLevel));
+        else
+            extents.push_back(DataExtent(e, minLevel, minLevel + (unsigned)randomIn(0.0, 12.0)));
+    }
+
+    osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex(extents);
+    REQUIRE(index->size() == extents.size());
+
+    for(unsigned q=0; q<500; ++q)
+    {
+        double x = randomIn(-180.0, 175.0), y = randomIn(-90.0, 85.0);
+        GeoExtent query(srs.get(), x, y, x+randomIn(0.001, 5.0), y+randomIn(0.001, 5.0));
+        unsigned lod = (unsigned)randomIn(0.0, 20.0);
+
+        bool any = false;
+        for(unsigned i=0; i<extents.size() && !any; ++i)
+            any = query.intersects(extents[i]);
+        REQUIRE(index->intersects(query) == any);
+
+        unsigned expected, actual;
+        bool found = linearMaxLevel(extents, query, lod, expected);
+        REQUIRE(index->getMaxLevel(query, lod, actual) == found);
+
+        // the index may stop early once the level reaches "lod".
+        if ( found && expected < lod )
+            REQUIRE(actual == expected);
+        else if ( found )
+            REQUIRE(actual >= lod);
+    }
+}
+
+TEST_CASE( "DataExtentIndex handles extents that cross the antimeridian" ) {
+
+    osg::ref_ptr<const SpatialReference> srs = SpatialReference::create("wgs84");
+
+    DataExtentList extents;
+    extents.push_back(DataExtent(GeoExtent(srs.get(), 175.0, 0.0, 185.0, 10.0), 0u, 8u));
+    osg::ref_ptr<DataExtentIndex> index = new DataExtentIndex(extents);
+
+    REQUIRE(index->intersects(GeoExtent(srs.get(), 176.0, 1.0, 177.0, 2.0)));
+    REQUIRE(index->intersects(GeoExtent(srs.get(), -179.0, 1.0, -178.0, 2.0)));
+    REQUIRE(!index->intersects(GeoExtent(srs.get(), 0.0, 1.0, 1.0, 2.0)));
+
+    unsigned maxLevel;
+    REQUIRE(index->getMaxLevel(GeoExtent(srs.get(), -179.0, 1.0, -178.0, 2.0), 12u, maxLevel));
+    REQUIRE(maxLevel == 8u);
+}
@@ -0,0 +1,164 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ElevationPool>
+#include <osgEarth/Registry>
+#include <sstream>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Morton code of a tile address, with the x bit above the y bit at each level.
+    unsigned morton(unsigned tx, unsigned ty)
+    {
+        unsigned code = 0u;
+        for(int b = 15; b >= 0; --b)
+            code = (code << 2) | (((tx >> b) & 1u) << 1) | ((ty >> b) & 1u);
+        return code;
+    }
+
+    ElevationLayer* makeLayer(const std::string& name, int maxDataLevel, bool enabled =true)
+    {
+        ElevationLayerOptions options( name );
+        if ( maxDataLevel >= 0 )
+            options.maxDataLevel() = (unsigned)maxDataLevel;
+        options.enabled() = enabled;
+        return new ElevationLayer( options );
+    }
+}
+
+TEST_CASE( "ElevationPool bins points by tile in Morton order" ) {
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    SECTION( "Points share the bin of their tile, in input order" ) {
+        // LOD 1 is 4x2 tiles of 90 degrees, with row 0 in the north.
+        std::vector<osg::Vec3d> points;
+        points.push_back( osg::Vec3d(-135.0,  45.0, 0.0) ); // (0,0)
+        points.push_back( osg::Vec3d( 135.0, -45.0, 0.0) ); // (3,1)
+        points.push_back( osg::Vec3d(-130.0,  40.0, 0.0) ); // (0,0)
+        points.push_back( osg::Vec3d(  45.0,  45.0, 0.0) ); // (2,0)
+        points.push_back( osg::Vec3d( 200.0,   0.0, 0.0) ); // off the profile
+
+        std::vector<ElevationPool::TileBin> bins;
+        ElevationPool::binPoints( points, profile, 1u, bins );
+
+        REQUIRE( bins.size() == 3u );
+
+        REQUIRE( bins[0]._tx == 0u );
+        REQUIRE( bins[0]._ty == 0u );
+        REQUIRE( bins[0]._indices.size() == 2u );
+        REQUIRE( bins[0]._indices[0] == 0u );
+        REQUIRE( bins[0]._indices[1] == 2u );
+
+        REQUIRE( bins[1]._tx == 2u );
+        REQUIRE( bins[1]._ty == 0u );
+        REQUIRE( bins[1]._indices.size() == 1u );
+        REQUIRE( bins[1]._indices[0] == 3u );
+
+        REQUIRE( bins[2]._tx == 3u );
+        REQUIRE( bins[2]._ty == 1u );
+        REQUIRE( bins[2]._indices.size() == 1u );
+        REQUIRE( bins[2]._indices[0] == 1u );
+    }
+
+    SECTION( "Bins follow the Z curve" ) {
+        // one point in the middle of every LOD 3 tile (16x8), in reverse order.
+        std::vector<osg::Vec3d> points;
+        for(int ty = 7; ty >= 0; --ty)
+            for(int tx = 15; tx >= 0; --tx)
+                points.push_back( osg::Vec3d(-180.0 + 22.5*(tx+0.5), 90.0 - 22.5*(ty+0.5), 0.0) );
+
+        std::vector<ElevationPool::TileBin> bins;
+        ElevationPool::binPoints( points, profile, 3u, bins );
+
+        REQUIRE( bins.size() == 128u );
+        for(unsigned i = 0; i < bins.size(); ++i)
+        {
+            REQUIRE( bins[i]._indices.size() == 1u );
+            if ( i > 0 )
+                REQUIRE( morton(bins[i-1]._tx, bins[i-1]._ty) < morton(bins[i]._tx, bins[i]._ty) );
+        }
+    }
+}
+
+TEST_CASE( "ElevationPool reads x,y points from delimited text" ) {
+
+    std::istringstream in(
+        "x,y\n"
+        "# comment\n"
+        "1.5,2.5\n"
+        "3 4\n"
+        "lon\tlat\n"
+        "5,abc\n"
+        "6x,7\n"
+        "-7.25,\t8e1,100\n"
+        "\n"
+        "9\n" );
+
+    std::vector<osg::Vec3d> points;
+    REQUIRE( ElevationPool::readPoints(in, points) == 3u );
+    REQUIRE( points.size() == 3u );
+    REQUIRE( points[0] == osg::Vec3d(1.5, 2.5, 0.0) );
+    REQUIRE( points[1] == osg::Vec3d(3.0, 4.0, 0.0) );
+    REQUIRE( points[2] == osg::Vec3d(-7.25, 80.0, 0.0) );
+}
+
+TEST_CASE( "ElevationPool reports the deepest level its layers have data for" ) {
+
+    osg::ref_ptr<ElevationPool> pool = new ElevationPool();
+
+    SECTION( "No layers means the default" ) {
+        REQUIRE( pool->getMaxDataLevel(15u) == 15u );
+    }
+
+    SECTION( "The deepest max_data_level wins" ) {
+        ElevationLayerVector layers;
+        layers.push_back( makeLayer("a", 12) );
+        layers.push_back( makeLayer("b", 9) );
+        pool->setElevationLayers( layers );
+        REQUIRE( pool->getMaxDataLevel(15u) == 12u );
+    }
+
+    SECTION( "Layers that don't say are ignored" ) {
+        ElevationLayerVector layers;
+        layers.push_back( makeLayer("a", -1) );
+        layers.push_back( makeLayer("b", 9) );
+        pool->setElevationLayers( layers );
+        REQUIRE( pool->getMaxDataLevel(15u) == 9u );
+
+        layers.pop_back();
+        pool->setElevationLayers( layers );
+        REQUIRE( pool->getMaxDataLevel(15u) == 15u );
+    }
+
+    SECTION( "Disabled layers are ignored" ) {
+        ElevationLayerVector layers;
+        layers.push_back( makeLayer("a", 18, false) );
+        layers.push_back( makeLayer("b", 9) );
+        pool->setElevationLayers( layers );
+        REQUIRE( pool->getMaxDataLevel(15u) == 9u );
+    }
+}
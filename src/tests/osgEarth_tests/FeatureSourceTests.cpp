@@ -0,0 +1,121 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthSymbology/Geometry>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+namespace
+{
+    Feature* makePoint(double x, double y, FeatureID fid)
+    {
+        PointSet* points = new PointSet();
+        points->push_back( osg::Vec3d(x, y, 0) );
+        return new Feature( points, SpatialReference::get("wgs84"), Style(), fid );
+    }
+}
+
+TEST_CASE( "FeatureSource reports the extents of inserted and deleted features" ) {
+
+    osg::ref_ptr<FeatureListSource> source = new FeatureListSource();
+
+    Revision rev;
+    source->sync( rev );
+
+    source->insertFeature( makePoint(10, 20, 1) );
+    source->insertFeature( makePoint(-30, 5, 2) );
+    REQUIRE( source->outOfSyncWith(rev) );
+
+    std::vector<GeoExtent> changes;
+    REQUIRE( source->getChangedExtents(rev, changes) );
+    REQUIRE( changes.size() == 2 );
+    REQUIRE( changes[0].contains(10, 20) );
+    REQUIRE( changes[1].contains(-30, 5) );
+    REQUIRE( source->inSyncWith(rev) );
+
+    SECTION( "Nothing new since the last call" ) {
+        changes.clear();
+        REQUIRE( source->getChangedExtents(rev, changes) );
+        REQUIRE( changes.empty() );
+    }
+
+    SECTION( "Deleting reports where the feature was" ) {
+        changes.clear();
+        REQUIRE( source->deleteFeature(1) );
+        REQUIRE( source->getChangedExtents(rev, changes) );
+        REQUIRE( changes.size() == 1 );
+        REQUIRE( changes[0].contains(10, 20) );
+    }
+
+    SECTION( "A plain dirty() means everything changed" ) {
+        source->insertFeature( makePoint(0, 0, 3) );
+        source->dirty();
+        Revision before = rev;
+        changes.clear();
+        REQUIRE( !source->getChangedExtents(rev, changes) );
+        REQUIRE( (int)rev == (int)before );
+    }
+}
+
+TEST_CASE( "Shallow feature copies share geometry until one of them writes" ) {
+
+    osg::ref_ptr<Feature> original = makePoint(10, 20, 1);
+    original->set( "name", std::string("a") );
+
+    osg::ref_ptr<Feature> copy = new Feature( *original.get(), osg::CopyOp::SHALLOW_COPY );
+    const Feature* originalView = original.get();
+    const Feature* copyView = copy.get();
+    REQUIRE( copyView->getGeometry() == originalView->getGeometry() );
+
+    SECTION( "Writing the copy leaves the original alone" ) {
+        Geometry* g = copy->getGeometryForWrite();
+        REQUIRE( g != originalView->getGeometry() );
+        (*g)[0].x() = 50.0;
+        REQUIRE( (*originalView->getGeometry())[0].x() == 10.0 );
+
+        copy->set( "name", std::string("b") );
+        REQUIRE( original->getString("name") == "a" );
+        REQUIRE( copy->getString("name") == "b" );
+    }
+
+    SECTION( "Writing the original leaves the copy alone" ) {
+        (*original->getGeometryForWrite())[0].x() = 50.0;
+        REQUIRE( (*copyView->getGeometry())[0].x() == 10.0 );
+    }
+
+    SECTION( "The non-const getGeometry() detaches too" ) {
+        (*copy->getGeometry())[0].x() = 50.0;
+        REQUIRE( (*originalView->getGeometry())[0].x() == 10.0 );
+        REQUIRE( (*copyView->getGeometry())[0].x() == 50.0 );
+    }
+
+    SECTION( "A sole owner writes in place" ) {
+        copy = 0L;
+        const Geometry* before = originalView->getGeometry();
+        REQUIRE( original->getGeometryForWrite() == before );
+    }
+}
@@ -0,0 +1,84 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeoData>
+#include <cmath>
+
+using namespace osgEarth;
+
+TEST_CASE( "GeoImage reprojects mercator imagery to geodetic within a pixel" ) {
+
+    const SpatialReference* merc = SpatialReference::create("spherical-mercator");
+    const SpatialReference* wgs84 = SpatialReference::create("wgs84");
+
+    // Encode each source pixel's column in red and its row in green.
+    const int size = 256;
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    for(int t=0; t<size; ++t)
+    {
+        for(int s=0; s<size; ++s)
+        {
+            unsigned char* p = image->data(s, t);
+            p[0] = s; p[1] = t; p[2] = 0; p[3] = 255;
+        }
+    }
+
+    const double half = 20037508.342789244;
+    GeoExtent srcExtent(merc, -half, 0.0, 0.0, half);
+    GeoImage geoImage(image.get(), srcExtent);
+
+    GeoExtent destExtent = srcExtent.transform(wgs84);
+    GeoImage result = geoImage.reproject(wgs84, &destExtent, size, size, true);
+    REQUIRE(result.valid());
+    REQUIRE(result.getImage()->getPixelFormat() == GL_RGBA);
+
+    // Compare every pixel against an exact transform of its center.
+    const double dx = destExtent.width() / size;
+    const double dy = destExtent.height() / size;
+    const double xfac = (size - 1) / srcExtent.width();
+    const double yfac = (size - 1) / srcExtent.height();
+
+    double maxError = 0.0;
+    for(int c=0; c<size; ++c)
+    {
+        for(int r=0; r<size; ++r)
+        {
+            osg::Vec3d p(destExtent.xMin() + (c + 0.5)*dx, destExtent.yMin() + (r + 0.5)*dy, 0.0);
+            osg::Vec3d q;
+            REQUIRE(wgs84->transform(p, merc, q));
+            if (!srcExtent.contains(q.x(), q.y()))
+                continue;
+
+            double px = (q.x() - srcExtent.xMin()) * xfac;
+            double py = (q.y() - srcExtent.yMin()) * yfac;
+
+            const unsigned char* out = result.getImage()->data(c, r);
+            maxError = osg::maximum(maxError, fabs((double)out[0] - px));
+            maxError = osg::maximum(maxError, fabs((double)out[1] - py));
+        }
+    }
+
+    REQUIRE(maxError <= 1.0);
+}
@@ -0,0 +1,82 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ImageUtils>
+#include <vector>
+#include <cstring>
+
+using namespace osgEarth;
+
+namespace
+{
+    void checkRowsMatchPixels(GLenum pixelFormat, GLenum dataType)
+    {
+        const int size = 37;
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(size, size, 1, pixelFormat, dataType);
+        for(unsigned i=0; i<image->getTotalSizeInBytes(); ++i)
+            image->data()[i] = (unsigned char)((i*31u + 7u) & 0xff);
+        if (dataType == GL_FLOAT)
+        {
+            float* f = (float*)image->data();
+            for(unsigned i=0; i<image->getTotalSizeInBytes()/sizeof(float); ++i)
+                f[i] = (float)i * 0.25f;
+        }
+
+        ImageUtils::PixelReader read(image.get());
+        std::vector<osg::Vec4> row(size);
+
+        // rows must read exactly what single pixels do:
+        for(int t=0; t<size; ++t)
+        {
+            read.readRow(&row[0], 0, t, size);
+            for(int s=0; s<size; ++s)
+                REQUIRE(row[s] == read(s, t));
+        }
+
+        // and writing them back must produce the same bytes:
+        osg::ref_ptr<osg::Image> perPixel = osg::clone(image.get(), osg::CopyOp::DEEP_COPY_ALL);
+        osg::ref_ptr<osg::Image> perRow = osg::clone(image.get(), osg::CopyOp::DEEP_COPY_ALL);
+        ImageUtils::PixelWriter writePixel(perPixel.get());
+        ImageUtils::PixelWriter writeRow(perRow.get());
+        for(int t=0; t<size; ++t)
+        {
+            for(int s=0; s<size; ++s)
+                row[s].set(s/(float)size, t/(float)size, 0.5f, 0.25f);
+            for(int s=0; s<size; ++s)
+                writePixel(row[s], s, t);
+            writeRow.writeRow(&row[0], 0, t, size);
+        }
+        REQUIRE(::memcmp(perPixel->data(), perRow->data(), image->getTotalSizeInBytes()) == 0);
+    }
+}
+
+TEST_CASE( "PixelReader and PixelWriter rows match single pixel access" ) {
+
+    SECTION("RGBA8") { checkRowsMatchPixels(GL_RGBA, GL_UNSIGNED_BYTE); }
+    SECTION("RGB8")  { checkRowsMatchPixels(GL_RGB, GL_UNSIGNED_BYTE); }
+    SECTION("R32F")  { checkRowsMatchPixels(GL_LUMINANCE, GL_FLOAT); }
+    SECTION("R16")   { checkRowsMatchPixels(GL_LUMINANCE, GL_UNSIGNED_SHORT); }
+    SECTION("LA8")   { checkRowsMatchPixels(GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE); }
+}
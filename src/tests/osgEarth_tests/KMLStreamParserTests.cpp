@@ -0,0 +1,211 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthDrivers/kml/KMLStreamParser>
+#include <osgEarth/StringUtils>
+#include <algorithm>
+#include <sstream>
+#include <streambuf>
+
+using namespace osgEarth;
+using namespace osgEarth_kml;
+
+namespace
+{
+    // records what the parser reports.
+    struct Recorder : public KMLStreamParser::Handler
+    {
+        Recorder() : _stylesOnly(false) { }
+
+        bool isContainer(const std::string& name)
+        {
+            return name == "kml" || name == "document" || name == "folder";
+        }
+
+        void startContainer(const std::string& name) { _events.push_back("+" + name); }
+
+        void endContainer(const std::string& name) { _events.push_back("-" + name); }
+
+        bool wantElement(const std::string& name)
+        {
+            return !_stylesOnly || name == "style" || name == "stylemap";
+        }
+
+        void element(const std::string& name, std::string& source)
+        {
+            _events.push_back(name);
+            _sources.push_back(source);
+        }
+
+        bool                     _stylesOnly;
+        std::vector<std::string> _events;
+        std::vector<std::string> _sources;
+    };
+
+    // hands out a few bytes at a time and can report its position, but
+    // can't seek, like a decompressing or network stream.
+    class TrickleBuf : public std::streambuf
+    {
+    public:
+        TrickleBuf(const std::string& data) : _data(data), _pos(0u) { }
+
+    protected:
+        int_type underflow()
+        {
+            if ( _pos >= _data.size() )
+                return traits_type::eof();
+            unsigned n = std::min((unsigned)_data.size() - _pos, 7u);
+            char* p = const_cast<char*>(_data.data()) + _pos;
+            setg(p, p, p + n);
+            _pos += n;
+            return traits_type::to_int_type(*p);
+        }
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode)
+        {
+            if ( off == 0 && dir == std::ios_base::cur )
+                return pos_type(_pos - (egptr() - gptr()));
+            return pos_type(off_type(-1));
+        }
+
+        pos_type seekpos(pos_type, std::ios_base::openmode)
+        {
+            return pos_type(off_type(-1));
+        }
+
+    private:
+        std::string _data;
+        unsigned    _pos;
+    };
+
+    std::string placemark(unsigned i)
+    {
+        return Stringify()
+            << "<Placemark><name>p" << i << "</name>"
+            << "<Point><coordinates>" << i << ",0,0</coordinates></Point></Placemark>";
+    }
+}
+
+TEST_CASE( "KMLStreamParser reports containers and their children" ) {
+
+    std::istringstream in(
+        "<?xml version=\"1.0\"?>\n"
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\"><Document>"
+        "<name>doc</name>"
+        "<!-- <Placemark>not this one</Placemark> -->"
+        "<Folder><Placemark><name><![CDATA[a <b> c]]></name></Placemark></Folder>"
+        "</Document></kml>" );
+
+    Recorder rec;
+    REQUIRE( KMLStreamParser().parse(in, rec) );
+
+    REQUIRE( rec._events.size() == 8u );
+    REQUIRE( rec._events[0] == "+kml" );
+    REQUIRE( rec._events[1] == "+document" );
+    REQUIRE( rec._events[2] == "name" );
+    REQUIRE( rec._events[3] == "+folder" );
+    REQUIRE( rec._events[4] == "placemark" );
+    REQUIRE( rec._events[5] == "-folder" );
+    REQUIRE( rec._events[6] == "-document" );
+    REQUIRE( rec._events[7] == "-kml" );
+
+    // the CDATA survives intact.
+    xml_document<> doc;
+    xml_node<>* node = KMLStreamParser::parseElement( rec._sources[1], doc );
+    REQUIRE( node != 0L );
+    REQUIRE( node->first_node("name") != 0L );
+    xml_node<>* cdata = node->first_node("name")->first_node();
+    REQUIRE( cdata != 0L );
+    REQUIRE( cdata->type() == node_cdata );
+    REQUIRE( std::string(cdata->value()) == "a <b> c" );
+}
+
+TEST_CASE( "KMLStreamParser delivers placemarks whole across read blocks" ) {
+
+    // big enough to span several of the parser's read blocks.
+    const unsigned count = 5000u;
+    std::string kml = "<kml><Document>";
+    for(unsigned i = 0; i < count; ++i)
+        kml += placemark(i);
+    kml += "</Document></kml>";
+    REQUIRE( kml.size() > 3u*65536u );
+
+    std::istringstream in( kml );
+    Recorder rec;
+    KMLStreamParser().parse( in, rec );
+
+    REQUIRE( rec._sources.size() == count );
+    for(unsigned i = 0; i < count; ++i)
+    {
+        REQUIRE( rec._sources[i] == placemark(i) );
+    }
+}
+
+TEST_CASE( "KMLStreamParser skips unwanted elements" ) {
+
+    std::istringstream in(
+        "<kml><Document>"
+        "<Placemark><Style id=\"inner\"/></Placemark>"
+        "<Style id=\"a\"><IconStyle><scale>2</scale></IconStyle></Style>"
+        "<StyleMap id=\"m\"><Pair><key>normal</key><styleUrl>#a</styleUrl></Pair></StyleMap>"
+        "</Document></kml>" );
+
+    Recorder rec;
+    rec._stylesOnly = true;
+    KMLStreamParser().parse( in, rec );
+
+    // only the shared styles; the one inside the placemark goes with it.
+    REQUIRE( rec._sources.size() == 2u );
+    REQUIRE( rec._sources[0].find("id=\"a\"") != std::string::npos );
+    REQUIRE( rec._sources[1].find("<StyleMap") == 0u );
+}
+
+TEST_CASE( "KMLStreamParser handles streams that can't rewind" ) {
+
+    std::string kml = "<kml><Document>" + placemark(1) + placemark(2) + "</Document></kml>";
+
+    SECTION( "A string stream can rewind" ) {
+        std::istringstream in( kml );
+        std::streampos origin;
+        REQUIRE( KMLStreamParser::canRewind(in, origin) );
+        REQUIRE( in.good() );
+    }
+
+    SECTION( "A stream that reports a position but can't seek parses in one pass" ) {
+        TrickleBuf buf( kml );
+        std::istream in( &buf );
+
+        std::streampos origin;
+        REQUIRE( in.tellg() != std::streampos(-1) );
+        REQUIRE( !KMLStreamParser::canRewind(in, origin) );
+        REQUIRE( in.good() );
+
+        Recorder rec;
+        KMLStreamParser().parse( in, rec );
+        REQUIRE( rec._sources.size() == 2u );
+        REQUIRE( rec._sources[0] == placemark(1) );
+        REQUIRE( rec._sources[1] == placemark(2) );
+    }
+}
@@ -0,0 +1,97 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/MapSnapshot>
+#include <osgEarth/Config>
+#include <cstdio>
+#include <fstream>
+
+using namespace osgEarth;
+
+namespace
+{
+    Config createMapConfig()
+    {
+        Config map("map");
+        map.setReferrer("/data/maps/world.earth");
+        map.set("name", "world");
+
+        Config image("image");
+        image.set("name", "imagery");
+        image.set("driver", "gdal");
+        Config url("url", "world.tif");
+        url.setIsLocation(true);
+        image.add(url);
+        map.add(image);
+
+        // a layer pulled in from an include keeps that file's referrer.
+        Config elevation("elevation");
+        elevation.setReferrer("/data/maps/includes/terrain.xml");
+        elevation.set("name", "terrain");
+        elevation.set("driver", "gdal");
+        elevation.set("url", "../dem/terrain.tif");
+        map.add(elevation);
+
+        return map;
+    }
+}
+
+TEST_CASE( "MapSnapshot round-trips the map Config" ) {
+
+    const std::string filename = "osgEarth_tests_mapsnapshot.tmp";
+    Config mapConf = createMapConfig();
+
+    osg::ref_ptr<MapSnapshot> snapshot = new MapSnapshot(mapConf, 0L);
+    snapshot->setSourceHash("12345678");
+    REQUIRE( snapshot->write(filename) );
+
+    osg::ref_ptr<MapSnapshot> restored = MapSnapshot::read(filename);
+    ::remove(filename.c_str());
+
+    REQUIRE( restored.valid() );
+    REQUIRE( restored->getSourceHash() == "12345678" );
+
+    const Config& conf = restored->getMapConfig();
+    REQUIRE( conf.toJSON() == mapConf.toJSON() );
+    REQUIRE( conf.referrer() == "/data/maps/world.earth" );
+    REQUIRE( conf.child("image").child("url").isLocation() );
+    REQUIRE( conf.child("image").child("url").referrer() == "/data/maps/world.earth" );
+    REQUIRE( conf.child("elevation").referrer() == "/data/maps/includes/terrain.xml" );
+    REQUIRE( conf.child("elevation").child("url").referrer() == "/data/maps/includes/terrain.xml" );
+}
+
+TEST_CASE( "MapSnapshot rejects files it did not write" ) {
+
+    const std::string filename = "osgEarth_tests_notasnapshot.tmp";
+    {
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        out << "<map name=\"world\"/>";
+    }
+
+    osg::ref_ptr<MapSnapshot> restored = MapSnapshot::read(filename);
+    ::remove(filename.c_str());
+
+    REQUIRE( !restored.valid() );
+    REQUIRE( MapSnapshot::read("osgEarth_tests_does_not_exist.tmp") == 0L );
+}
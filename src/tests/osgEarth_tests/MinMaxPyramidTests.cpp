@@ -0,0 +1,142 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/MinMaxPyramid>
+#include <osgEarth/GeoCommon>
+#include <cfloat>
+#include <cstdlib>
+#include <cmath>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::HeightField* createHeightField(unsigned cols, unsigned rows)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(cols, rows);
+        for(unsigned r=0; r<rows; ++r)
+            for(unsigned c=0; c<cols; ++c)
+                hf->setHeight(c, r, (float)(::rand() % 10000) - 2000.0f);
+        return hf;
+    }
+
+    // brute-force bounds over the posts in a normalized region
+    void bruteForce(const osg::HeightField* hf, double u0, double v0, double u1, double v1, float& out_min, float& out_max)
+    {
+        out_min = FLT_MAX, out_max = -FLT_MAX;
+        for(unsigned r=0; r<hf->getNumRows(); ++r)
+        {
+            double v = (double)r/(double)(hf->getNumRows()-1);
+            for(unsigned c=0; c<hf->getNumColumns(); ++c)
+            {
+                double u = (double)c/(double)(hf->getNumColumns()-1);
+                float h = hf->getHeight(c, r);
+                if ( u >= u0 && u <= u1 && v >= v0 && v <= v1 && h != NO_DATA_VALUE )
+                {
+                    out_min = std::min(out_min, h);
+                    out_max = std::max(out_max, h);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "MinMaxPyramid root holds the heightfield bounds" ) {
+    osg::ref_ptr<osg::HeightField> hf = createHeightField(257, 257);
+    osg::ref_ptr<MinMaxPyramid> pyramid = new MinMaxPyramid(hf.get());
+
+    float hmin, hmax;
+    bruteForce(hf.get(), 0.0, 0.0, 1.0, 1.0, hmin, hmax);
+
+    REQUIRE( pyramid->valid() );
+    REQUIRE( pyramid->getMinHeight() == hmin );
+    REQUIRE( pyramid->getMaxHeight() == hmax );
+    REQUIRE( pyramid->getNumColumns(0) == 32u );
+    REQUIRE( pyramid->getNumColumns(pyramid->getNumLevels()-1) == 1u );
+}
+
+TEST_CASE( "MinMaxPyramid region bounds are conservative" ) {
+    osg::ref_ptr<osg::HeightField> hf = createHeightField(65, 33);
+    osg::ref_ptr<MinMaxPyramid> pyramid = new MinMaxPyramid(hf.get(), 4u);
+
+    for(unsigned i=0; i<500; ++i)
+    {
+        double u0 = (double)::rand()/(double)RAND_MAX, u1 = (double)::rand()/(double)RAND_MAX;
+        double v0 = (double)::rand()/(double)RAND_MAX, v1 = (double)::rand()/(double)RAND_MAX;
+
+        float pmin, pmax, bmin, bmax;
+        REQUIRE( pyramid->getMinMax(u0, v0, u1, v1, pmin, pmax) );
+
+        bruteForce(hf.get(), std::min(u0,u1), std::min(v0,v1), std::max(u0,u1), std::max(v0,v1), bmin, bmax);
+        if ( bmin <= bmax )
+        {
+            REQUIRE( pmin <= bmin );
+            REQUIRE( pmax >= bmax );
+        }
+    }
+}
+
+TEST_CASE( "MinMaxPyramid ignores NO_DATA_VALUE" ) {
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate(17, 17);
+    for(unsigned r=0; r<17; ++r)
+        for(unsigned c=0; c<17; ++c)
+            hf->setHeight(c, r, c < 8 ? NO_DATA_VALUE : 100.0f);
+
+    osg::ref_ptr<MinMaxPyramid> pyramid = new MinMaxPyramid(hf.get(), 4u);
+    REQUIRE( pyramid->getMinHeight() == 100.0f );
+    REQUIRE( pyramid->getMaxHeight() == 100.0f );
+
+    float hmin, hmax;
+    REQUIRE_FALSE( pyramid->getMinMax(0.0, 0.0, 0.2, 0.2, hmin, hmax) );
+    REQUIRE( pyramid->getMinMax(0.0, 0.0, 1.0, 1.0, hmin, hmax) );
+}
+
+TEST_CASE( "MinMaxPyramid survives an image round trip" ) {
+    osg::ref_ptr<osg::HeightField> hf = createHeightField(257, 129);
+    osg::ref_ptr<MinMaxPyramid> pyramid = new MinMaxPyramid(hf.get());
+
+    osg::ref_ptr<osg::Image> image = pyramid->createImage();
+    osg::ref_ptr<MinMaxPyramid> restored = MinMaxPyramid::create(image.get());
+    REQUIRE( restored.valid() );
+    REQUIRE( restored->getNumLevels() == pyramid->getNumLevels() );
+
+    for(unsigned i=0; i<pyramid->getNumLevels(); ++i)
+    {
+        REQUIRE( restored->getNumColumns(i) == pyramid->getNumColumns(i) );
+        REQUIRE( restored->getNumRows(i) == pyramid->getNumRows(i) );
+        for(unsigned r=0; r<pyramid->getNumRows(i); ++r)
+        {
+            for(unsigned c=0; c<pyramid->getNumColumns(i); ++c)
+            {
+                REQUIRE( restored->getMin(i, c, r) == pyramid->getMin(i, c, r) );
+                REQUIRE( restored->getMax(i, c, r) == pyramid->getMax(i, c, r) );
+            }
+        }
+    }
+
+    osg::ref_ptr<osg::Image> empty = new osg::Image();
+    REQUIRE( MinMaxPyramid::create(empty.get()) == 0L );
+}
@@ -0,0 +1,131 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ObjectIndex>
+#include <set>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    struct Thing : public osg::Referenced
+    {
+        Thing(int value) : _value(value) { }
+        int _value;
+    };
+}
+
+TEST_CASE( "ObjectIndex inserts, finds and removes objects" ) {
+
+    osg::ref_ptr<ObjectIndex> index = new ObjectIndex();
+    osg::ref_ptr<Thing> a = new Thing(1), b = new Thing(2);
+
+    ObjectID ida = index->insert( a.get() );
+    ObjectID idb = index->insert( b.get() );
+
+    REQUIRE( ida != idb );
+    REQUIRE( ida > OSGEARTH_OBJECTID_TERRAIN );
+    REQUIRE( idb > OSGEARTH_OBJECTID_TERRAIN );
+    REQUIRE( index->size() == 2u );
+    REQUIRE( index->get<Thing>(ida) == a.get() );
+    REQUIRE( index->get<Thing>(idb) == b.get() );
+    REQUIRE( index->get<Thing>(OSGEARTH_OBJECTID_EMPTY).valid() == false );
+
+    index->remove( ida );
+    REQUIRE( index->size() == 1u );
+    REQUIRE( index->get<Thing>(ida).valid() == false );
+    REQUIRE( index->get<Thing>(idb) == b.get() );
+
+    // removing twice is harmless
+    index->remove( ida );
+    REQUIRE( index->size() == 1u );
+}
+
+TEST_CASE( "ObjectIndex never resolves a stale ID to a newer object" ) {
+
+    osg::ref_ptr<ObjectIndex> index = new ObjectIndex();
+    osg::ref_ptr<Thing> a = new Thing(1);
+
+    std::vector<ObjectID> stale;
+    for(int i=0; i<64; ++i)
+        stale.push_back( index->insert(a.get()) );
+    index->remove( stale.begin(), stale.end() );
+    REQUIRE( index->size() == 0u );
+
+    // reuse every freed slot
+    std::set<ObjectID> fresh;
+    for(int i=0; i<64; ++i)
+    {
+        osg::ref_ptr<Thing> t = new Thing(i);
+        fresh.insert( index->insert(t.get()) );
+    }
+
+    for(std::vector<ObjectID>::const_iterator i = stale.begin(); i != stale.end(); ++i)
+    {
+        REQUIRE( fresh.find(*i) == fresh.end() );
+        REQUIRE( index->get<Thing>(*i).valid() == false );
+    }
+}
+
+TEST_CASE( "ObjectIndex retires a slot instead of reusing its IDs" ) {
+
+    osg::ref_ptr<ObjectIndex> index = new ObjectIndex();
+    osg::ref_ptr<Thing> a = new Thing(1);
+
+    // enough cycles to run every shard's first slot past its last generation.
+    const unsigned cycles = 16u * 300u;
+    std::set<ObjectID> seen;
+    for(unsigned i = 0; i < cycles; ++i)
+    {
+        ObjectID id = index->insert( a.get() );
+        REQUIRE( seen.insert(id).second );
+        index->remove( id );
+    }
+
+    REQUIRE( index->size() == 0u );
+}
+
+TEST_CASE( "ObjectIndex batch insert and bulk remove" ) {
+
+    osg::ref_ptr<ObjectIndex> index = new ObjectIndex();
+    osg::ref_ptr<Thing> a = new Thing(7);
+
+    std::vector<ObjectID> ids;
+    index->insert( a.get(), 1000u, ids );
+    REQUIRE( ids.size() == 1000u );
+    REQUIRE( index->size() == 1000u );
+    REQUIRE( std::set<ObjectID>(ids.begin(), ids.end()).size() == 1000u );
+
+    for(std::vector<ObjectID>::const_iterator i = ids.begin(); i != ids.end(); ++i)
+        REQUIRE( index->get<Thing>(*i) == a.get() );
+
+    index->remove( ids.begin(), ids.begin() + 500 );
+    REQUIRE( index->size() == 500u );
+    REQUIRE( index->get<Thing>(ids[0]).valid() == false );
+    REQUIRE( index->get<Thing>(ids[999]) == a.get() );
+
+    index->remove( ids.begin(), ids.end() );
+    REQUIRE( index->size() == 0u );
+}
@@ -0,0 +1,102 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/RTree>
+#include <algorithm>
+
+using namespace osgEarth;
+
+namespace
+{
+    // brute-force reference for a grid of unit boxes
+    unsigned countGrid(double xmin, double ymin, double xmax, double ymax, int n)
+    {
+        unsigned count = 0;
+        for(int y=0; y<n; ++y)
+            for(int x=0; x<n; ++x)
+                if ( x <= xmax && x+1 >= xmin && y <= ymax && y+1 >= ymin )
+                    ++count;
+        return count;
+    }
+}
+
+TEST_CASE( "RTree incremental insert and bulk load agree with a linear scan" ) {
+
+    const int n = 50;
+    RTree<int> inserted;
+    std::vector<RTree<int>::Entry> entries;
+    for(int y=0; y<n; ++y)
+    {
+        for(int x=0; x<n; ++x)
+        {
+            inserted.insert(x, y, x+1, y+1, y*n+x);
+            entries.push_back(RTree<int>::Entry(x, y, x+1, y+1, y*n+x));
+        }
+    }
+
+    RTree<int> loaded;
+    loaded.load(entries);
+
+    REQUIRE(inserted.size() == n*n);
+    REQUIRE(loaded.size() == n*n);
+
+    std::vector<int> a, b;
+    REQUIRE(inserted.search(10.5, 20.5, 14.5, 22.5, a) == countGrid(10.5, 20.5, 14.5, 22.5, n));
+    REQUIRE(loaded.search(10.5, 20.5, 14.5, 22.5, b) == countGrid(10.5, 20.5, 14.5, 22.5, n));
+
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    REQUIRE(a == b);
+}
+
+TEST_CASE( "RTree remove" ) {
+
+    RTree<int> tree;
+    for(int i=0; i<100; ++i)
+        tree.insert(i, 0, i+0.5, 0.5, i);
+
+    SECTION("removing a value takes it out of search results") {
+        REQUIRE(tree.remove(42, 0, 42.5, 0.5, 42));
+        std::vector<int> hits;
+        tree.search(41.9, 0, 42.6, 1, hits);
+        REQUIRE(hits.empty());
+        REQUIRE(tree.size() == 99);
+    }
+
+    SECTION("removing with the wrong box fails") {
+        REQUIRE(!tree.remove(10, 0, 10.5, 0.5, 11));
+        REQUIRE(tree.size() == 100);
+    }
+
+    SECTION("removing everything leaves an empty, usable tree") {
+        for(int i=0; i<100; ++i)
+            REQUIRE(tree.remove(i, 0, i+0.5, 0.5, i));
+        REQUIRE(tree.empty());
+
+        tree.insert(0, 0, 1, 1, 7);
+        std::vector<int> hits;
+        tree.search(0, 0, 1, 1, hits);
+        REQUIRE(hits.size() == 1);
+    }
+}
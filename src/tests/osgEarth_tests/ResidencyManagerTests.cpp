@@ -0,0 +1,101 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Registry>
+#include <osgEarthDrivers/engine_rex/ResidencyManager>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::RexTerrainEngine;
+
+namespace
+{
+    ResidencyManager::Candidate candidate(unsigned x, unsigned long long bytes, float importance, unsigned lastUsed, unsigned frame)
+    {
+        ResidencyManager::Candidate c;
+        c._key   = TileKey(5, x, 0, Registry::instance()->getGlobalGeodeticProfile());
+        c._bytes = bytes;
+        c._score = ResidencyManager::score(bytes, importance, lastUsed, frame);
+        return c;
+    }
+}
+
+TEST_CASE( "ResidencyManager only evicts idle leaves" ) {
+
+    REQUIRE( ResidencyManager::isIdleLeaf(false, 10u, 12u) == true );
+    REQUIRE( ResidencyManager::isIdleLeaf(false, 11u, 12u) == false ); // drawn last frame
+    REQUIRE( ResidencyManager::isIdleLeaf(true,  1u,  12u) == false ); // has subtiles
+}
+
+TEST_CASE( "ResidencyManager ranks candidates by bytes per benefit" ) {
+
+    const unsigned frame = 100u;
+    std::vector<ResidencyManager::Candidate> candidates;
+    candidates.push_back( candidate(0, 1000ull, 1.0f,  98u, frame) ); // recent, important
+    candidates.push_back( candidate(1, 1000ull, 0.1f,  98u, frame) ); // unimportant
+    candidates.push_back( candidate(2, 1000ull, 1.0f,  50u, frame) ); // stale
+    candidates.push_back( candidate(3, 4000ull, 1.0f,  98u, frame) ); // big
+
+    std::sort( candidates.begin(), candidates.end() );
+
+    REQUIRE( candidates[0]._key.getTileX() == 2u );
+    REQUIRE( candidates[1]._key.getTileX() == 1u );
+    REQUIRE( candidates[2]._key.getTileX() == 3u );
+    REQUIRE( candidates[3]._key.getTileX() == 0u );
+}
+
+TEST_CASE( "ResidencyManager evicts just enough to meet the budget" ) {
+
+    const unsigned frame = 100u;
+    std::vector<ResidencyManager::Candidate> candidates;
+    for(unsigned i=0; i<5; ++i)
+        candidates.push_back( candidate(i, 1000ull, 1.0f, 90u - i, frame) );
+
+    SECTION( "under budget" ) {
+        std::vector<TileKey> keys;
+        REQUIRE( ResidencyManager::select(candidates, 5000ull, 8000ull, keys) == 0ull );
+        REQUIRE( keys.empty() );
+    }
+
+    SECTION( "unlimited" ) {
+        std::vector<TileKey> keys;
+        REQUIRE( ResidencyManager::select(candidates, 5000ull, 0ull, keys) == 0ull );
+        REQUIRE( keys.empty() );
+    }
+
+    SECTION( "over budget" ) {
+        std::vector<TileKey> keys;
+        REQUIRE( ResidencyManager::select(candidates, 10000ull, 7500ull, keys) == 3000ull );
+        REQUIRE( keys.size() == 3u );
+        // stalest first:
+        REQUIRE( keys[0].getTileX() == 4u );
+        REQUIRE( keys[1].getTileX() == 3u );
+        REQUIRE( keys[2].getTileX() == 2u );
+    }
+
+    SECTION( "not enough candidates" ) {
+        std::vector<TileKey> keys;
+        REQUIRE( ResidencyManager::select(candidates, 100000ull, 1000ull, keys) == 5000ull );
+        REQUIRE( keys.size() == 5u );
+    }
+}
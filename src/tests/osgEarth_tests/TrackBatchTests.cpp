@@ -0,0 +1,180 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthAnnotation/TrackBatch>
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+namespace
+{
+    // terrain that is 100m high west of the prime meridian and not loaded east of it.
+    struct WestHalfSampler : public TerrainHeightSampler
+    {
+        mutable unsigned _numSampled;
+        WestHalfSampler() : _numSampled(0u) { }
+
+        unsigned getHeights(const std::vector<osg::Vec3d>& points, std::vector<float>& out_heights) const
+        {
+            _numSampled += points.size();
+            out_heights.resize(points.size());
+            for(unsigned i = 0; i < points.size(); ++i)
+                out_heights[i] = points[i].x() < 0.0 ? 100.0f : NO_DATA_VALUE;
+            return points.size();
+        }
+    };
+
+    // a batch whose world coordinates are the map coordinates, so that an
+    // identity matrix puts entity (x, y) at window (x, y).
+    TrackBatch* makeBatch()
+    {
+        return new TrackBatch( SpatialReference::get("wgs84"), false );
+    }
+}
+
+TEST_CASE( "TrackBatch moves entities in bulk" ) {
+
+    osg::ref_ptr<TrackBatch> batch = makeBatch();
+    batch->add( osg::Vec3d(1, 2, 3), 0.0f, 0u );
+    batch->add( osg::Vec3d(4, 5, 6), 0.0f, 0u );
+
+    REQUIRE( batch->computeWorldPositions() == 2u );
+    REQUIRE( batch->computeWorldPositions() == 0u );
+
+    std::vector<TrackBatch::Update> updates;
+    updates.push_back( TrackBatch::Update(1u, osg::Vec3d(7, 8, 9), 90.0f) );
+    updates.push_back( TrackBatch::Update(5u, osg::Vec3d(0, 0, 0), 0.0f) ); // no such entity
+    batch->update( updates );
+
+    REQUIRE( batch->getPosition(0) == osg::Vec3d(1, 2, 3) );
+    REQUIRE( batch->getPosition(1) == osg::Vec3d(7, 8, 9) );
+    REQUIRE( batch->getHeading(1) == 90.0f );
+
+    REQUIRE( batch->computeWorldPositions() == 1u );
+    REQUIRE( batch->getWorldPosition(1) == osg::Vec3d(7, 8, 9) );
+
+    GeoExtent extent = batch->getExtent();
+    REQUIRE( extent.isValid() );
+    REQUIRE( extent.contains(1, 2) );
+    REQUIRE( extent.contains(7, 8) );
+}
+
+TEST_CASE( "TrackBatch clamps only what needs it" ) {
+
+    osg::ref_ptr<TrackBatch> batch = makeBatch();
+    batch->add( osg::Vec3d(-10, 0, 5), 0.0f, 0u );
+    batch->add( osg::Vec3d(-20, 0, 5), 0.0f, 0u );
+    batch->add( osg::Vec3d( 10, 0, 5), 0.0f, 0u );
+    for(unsigned i = 0; i < 3u; ++i)
+        batch->setClamped( i, true );
+
+    REQUIRE( batch->hasClampedEntities() );
+
+    WestHalfSampler sampler;
+    REQUIRE( batch->clamp(&sampler) == 3u );
+    REQUIRE( batch->clamp(&sampler) == 0u );
+
+    batch->computeWorldPositions();
+    REQUIRE( batch->getWorldPosition(0).z() == 105.0 ); // offset above the terrain
+    REQUIRE( batch->getWorldPosition(2).z() == 5.0 );   // no terrain there yet
+
+    SECTION( "A moved entity is re-clamped" ) {
+        std::vector<TrackBatch::Update> updates;
+        updates.push_back( TrackBatch::Update(1u, osg::Vec3d(-25, 0, 5), 0.0f) );
+        batch->update( updates );
+        REQUIRE( batch->clamp(&sampler) == 1u );
+    }
+
+    SECTION( "New terrain re-clamps the entities under it" ) {
+        GeoExtent tile( SpatialReference::get("wgs84"), -15, -5, -5, 5 );
+        REQUIRE( batch->invalidateClamping(tile) == 1u );
+        REQUIRE( batch->clamp(&sampler) == 1u );
+    }
+
+    SECTION( "Unclamping drops the terrain height" ) {
+        batch->setClamped( 0, false );
+        REQUIRE( batch->clamp(&sampler, true) == 2u );
+        batch->computeWorldPositions();
+        REQUIRE( batch->getWorldPosition(0).z() == 5.0 );
+    }
+}
+
+TEST_CASE( "TrackBatch culls in priority order" ) {
+
+    osg::ref_ptr<TrackBatch> batch = makeBatch();
+    batch->add( osg::Vec3d(10, 10, 0), 0.0f, 0u, "", 1.0f );
+    batch->add( osg::Vec3d(50, 50, 0), 0.0f, 0u, "", 3.0f );
+    batch->add( osg::Vec3d(80, 20, 0), 0.0f, 0u, "", 2.0f );
+    batch->add( osg::Vec3d(-50, 20, 0), 0.0f, 0u, "", 9.0f ); // off screen
+    batch->computeWorldPositions();
+
+    TrackBatch::CullResult out;
+    const osg::Matrixd mvpw;
+
+    SECTION( "Unsorted entities come out in index order" ) {
+        REQUIRE( batch->cull(mvpw, osg::Vec3d(), 100.0, 100.0, 4.0f, false, out) == 3u );
+        REQUIRE( out._indices[0] == 0u );
+        REQUIRE( out._indices[1] == 1u );
+        REQUIRE( out._indices[2] == 2u );
+    }
+
+    SECTION( "Sorted entities come out highest priority first" ) {
+        batch->updateOrder();
+        REQUIRE( batch->cull(mvpw, osg::Vec3d(), 100.0, 100.0, 4.0f, false, out) == 3u );
+        REQUIRE( out._indices[0] == 1u );
+        REQUIRE( out._indices[1] == 2u );
+        REQUIRE( out._indices[2] == 0u );
+        REQUIRE( out._window[0] == osg::Vec2f(50, 50) );
+
+        batch->setPriority( 0, 5.0f );
+        batch->updateOrder();
+        batch->cull( mvpw, osg::Vec3d(), 100.0, 100.0, 4.0f, false, out );
+        REQUIRE( out._indices[0] == 0u );
+    }
+
+    SECTION( "Hidden entities are skipped" ) {
+        batch->setVisible( 1, false );
+        REQUIRE( batch->cull(mvpw, osg::Vec3d(), 100.0, 100.0, 4.0f, false, out) == 2u );
+    }
+}
+
+TEST_CASE( "TrackBatch declutters overlapping icons" ) {
+
+    osg::ref_ptr<TrackBatch> batch = makeBatch();
+    batch->add( osg::Vec3d(10, 10, 0), 0.0f, 0u, "", 1.0f );
+    batch->add( osg::Vec3d(13, 10, 0), 0.0f, 0u, "", 2.0f ); // overlaps the first
+    batch->add( osg::Vec3d(40, 10, 0), 0.0f, 0u, "", 0.0f ); // clear of both
+    batch->computeWorldPositions();
+    batch->updateOrder();
+
+    TrackBatch::CullResult out;
+    const osg::Matrixd mvpw;
+
+    REQUIRE( batch->cull(mvpw, osg::Vec3d(), 100.0, 100.0, 8.0f, false, out) == 3u );
+
+    REQUIRE( batch->cull(mvpw, osg::Vec3d(), 100.0, 100.0, 8.0f, true, out) == 2u );
+    REQUIRE( out._indices[0] == 1u ); // the higher priority one wins
+    REQUIRE( out._indices[1] == 2u );
+}
@@ -0,0 +1,206 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthUtil/Viewshed>
+#include <osgEarth/Map>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/HeightFieldUtils>
+#include <cstring>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    void makeObservers(const Map* map, std::vector<GeoPoint>& observers)
+    {
+        const SpatialReference* srs = map->getSRS()->getGeographicSRS();
+        observers.push_back( GeoPoint(srs, -77.0, 38.9, 0.0, ALTMODE_RELATIVE) );
+        observers.push_back( GeoPoint(srs,   2.3, 48.8, 0.0, ALTMODE_RELATIVE) );
+        observers.push_back( GeoPoint(srs, 139.7, 35.7, 0.0, ALTMODE_RELATIVE) );
+    }
+
+    // Flat ground at sea level, except for a 100m wall about 130-200m north
+    // of (0,0) that is about 110m wide.
+    class WallElevationLayer : public ElevationLayer
+    {
+    public:
+        WallElevationLayer()
+        {
+            setTileSourceExpected( false );
+            setProfile( Profile::create("global-geodetic") );
+        }
+
+    protected:
+        virtual void createImplementation(const TileKey&                  key,
+                                          osg::ref_ptr<osg::HeightField>& out_hf,
+                                          osg::ref_ptr<NormalMap>&        out_normalMap,
+                                          ProgressCallback*               progress)
+        {
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(
+                key.getExtent(), 257u, 257u, 0u, false );
+
+            for(unsigned row=0; row<hf->getNumRows(); ++row)
+            {
+                double lat = hf->getOrigin().y() + (double)row * hf->getYInterval();
+                for(unsigned col=0; col<hf->getNumColumns(); ++col)
+                {
+                    double lon = hf->getOrigin().x() + (double)col * hf->getXInterval();
+                    if ( lat >= 0.0012 && lat <= 0.0018 && fabs(lon) <= 0.001 )
+                        hf->setHeight( col, row, 100.0f );
+                }
+            }
+
+            out_hf = hf;
+        }
+    };
+}
+
+TEST_CASE( "ViewshedEngine batch jobs match single viewsheds" ) {
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<ViewshedEngine> engine = new ViewshedEngine( map.get(), 2u );
+    engine->setRadius( 300.0 );
+    engine->setResolution( 30.0 );
+
+    std::vector<GeoPoint> observers;
+    makeObservers( map.get(), observers );
+
+    std::vector<GeoImage> batch;
+    engine->computeViewsheds( observers, batch );
+    REQUIRE( batch.size() == observers.size() );
+
+    for(unsigned i=0; i<observers.size(); ++i)
+    {
+        GeoImage single = engine->computeViewshed( observers[i] );
+        REQUIRE( single.valid() );
+        REQUIRE( batch[i].valid() );
+        REQUIRE( batch[i].getExtent() == single.getExtent() );
+
+        const osg::Image* a = batch[i].getImage();
+        const osg::Image* b = single.getImage();
+        REQUIRE( a->getTotalSizeInBytes() == b->getTotalSizeInBytes() );
+        REQUIRE( ::memcmp(a->data(), b->data(), a->getTotalSizeInBytes()) == 0 );
+
+        // the observer always sees its own cell.
+        REQUIRE( *a->data(a->s()/2, a->t()/2) == 255 );
+    }
+}
+
+TEST_CASE( "ViewshedEngine batch jobs honor cancelation" ) {
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<ViewshedEngine> engine = new ViewshedEngine( map.get(), 2u );
+    engine->setRadius( 300.0 );
+
+    std::vector<GeoPoint> observers;
+    makeObservers( map.get(), observers );
+
+    osg::ref_ptr<ProgressCallback> progress = new ProgressCallback();
+    progress->cancel();
+
+    std::vector<GeoImage> batch;
+    engine->computeViewsheds( observers, batch, progress.get() );
+    REQUIRE( batch.size() == observers.size() );
+    for(unsigned i=0; i<batch.size(); ++i)
+        REQUIRE( batch[i].valid() == false );
+}
+
+TEST_CASE( "ViewshedEngine batch jobs report failed observers" ) {
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<ViewshedEngine> engine = new ViewshedEngine( map.get(), 2u );
+
+    // a radius smaller than the sample spacing is unusable.
+    engine->setRadius( 10.0 );
+    engine->setResolution( 30.0 );
+
+    std::vector<GeoPoint> observers;
+    makeObservers( map.get(), observers );
+
+    std::vector<GeoImage> batch;
+    engine->computeViewsheds( observers, batch );
+    REQUIRE( batch.size() == observers.size() );
+    for(unsigned i=0; i<batch.size(); ++i)
+        REQUIRE( batch[i].valid() == false );
+
+    std::vector<GeoPoint> none;
+    engine->computeViewsheds( none, batch );
+    REQUIRE( batch.empty() );
+}
+
+TEST_CASE( "ViewshedEngine sees over open ground but not through a wall" ) {
+
+    osg::ref_ptr<Map> map = new Map();
+    map->addLayer( new WallElevationLayer() );
+
+    osg::ref_ptr<ViewshedEngine> engine = new ViewshedEngine( map.get(), 2u );
+    engine->setRadius( 300.0 );
+    engine->setResolution( 10.0 );
+    engine->setEarthCurvature( false );
+
+    GeoPoint observer( map->getSRS()->getGeographicSRS(), 0.0, 0.0, 0.0, ALTMODE_RELATIVE );
+
+    SECTION( "Radial line of sight" ) {
+        std::vector<ViewshedEngine::Spoke> spokes;
+        REQUIRE( engine->computeRadialLineOfSight(observer, 4u, spokes) );
+        REQUIRE( spokes.size() == 4u );
+
+        // north runs into the wall: open ground in front of it, hidden ground behind it.
+        const ViewshedEngine::Spoke& north = spokes[0];
+        REQUIRE( north.ranges.size() == north.visible.size() );
+        REQUIRE( north.ranges.empty() == false );
+        unsigned hidden = 0u;
+        for(unsigned i=0; i<north.ranges.size(); ++i)
+        {
+            if ( north.ranges[i] < 110.0 )
+                REQUIRE( north.visible[i] == true );
+            else if ( north.ranges[i] > 220.0 )
+            {
+                REQUIRE( north.visible[i] == false );
+                ++hidden;
+            }
+        }
+        REQUIRE( hidden > 0u );
+
+        // south is open ground all the way out.
+        const ViewshedEngine::Spoke& south = spokes[2];
+        REQUIRE( south.azimuth == 180.0 );
+        REQUIRE( south.ranges.size() == south.visible.size() );
+        REQUIRE( south.ranges.empty() == false );
+        for(unsigned i=0; i<south.visible.size(); ++i)
+            REQUIRE( south.visible[i] == true );
+    }
+
+    SECTION( "Viewshed image" ) {
+        GeoImage result = engine->computeViewshed( observer );
+        REQUIRE( result.valid() );
+
+        // rows run from south to north.
+        const osg::Image* image = result.getImage();
+        REQUIRE( *image->data(image->s()/2, image->t()-1) == 0 );
+        REQUIRE( *image->data(image->s()/2, 0) == 255 );
+    }
+}